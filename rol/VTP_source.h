@@ -25,6 +25,8 @@
 int vtpUploadAll(char *string, int length);
 extern int vtpConfig(char *fname);
 extern void vtpInitGlobals();
+extern int vtpReadConfigFile(char *filename);
+extern int vtpDownloadAll();
 
 /* Accessor functions for streaming config values */
 extern const char* vtpGetStatsHost(void);
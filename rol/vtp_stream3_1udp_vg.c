@@ -15,6 +15,7 @@
 #define STREAMING_MODE
 
 #include <VTP_source.h>
+#include "vtpConfig.h"
 
 /* --- Added system headers for timestamp/frame reads and UDP sender thread --- */
 #include <stdint.h>
@@ -50,6 +51,18 @@ int vtpComptonEnableScalerReadout = 0;
 int trigBankType = 0xff10;
 int firstEvent;
 
+/* VTP settings read back at Prestart (vtpConfigBankBuild), copied into
+   bank 0x12 of the first event */
+static uint32_t vtpCfgBank[VTP_CFGBANK_MAXWORDS];
+static int vtpCfgBankWords = 0;
+
+/* Hot reconfiguration (VTP_STREAMING_HOT_RECONFIG 1): the network links of
+   the last Prestart stay up and the next Prestart only reconfigures the
+   streams whose destination changed.  Firmware load or Reset clears it. */
+static int vtpHotValid = 0;
+static int vtpHotNetMode = -1;
+static int vtpHotEjfat = -1;
+
 /*
  * Network streaming configuration now read from config file.
  * Default values in vtpConfig.c match previous hard-coded values:
@@ -233,27 +246,33 @@ static int vtp_get_src_id(uint32_t *out)
   return OK;
 }
 
-/* Helper: read ALL required network parameters from auto-generated config file.
+/* Helper: network parameters of the auto-generated config file.
  *
  * IMPORTANT: This function reads from auto-generated vtp_<rocname>.cnf files ONLY.
  * Expected location: $CODA_CONFIG/vtp_<rocname>.cnf
  *
- * Bypasses broken VTP library getters (vtpGetNumConnections, vtpGetLocalPort, etc.)
- * that return 0 even after successful vtpConfig() parsing.
+ * The file is loaded through the parsed config cache of the VTP library
+ * (vtpConfigLoad): it is parsed at the first call and again only when it
+ * changed, Go and End get the config parsed at Prestart.  The cached copy is
+ * not touched by vtpUploadAll(), which overwrites the live config with the
+ * hardware settings.
  *
  * Parameters:
  *   cfg_path - Path to auto-generated vtp_<rocname>.cnf file
  *   Pass NULL for any output parameter you don't need
  *
- * Reads from config file:
- *   - VTP_NUM_CONNECTIONS or VTP_STREAMING_NSTREAMS -> numConnections
+ * From the parsed config (the per-EB keys follow the global ones in the
+ * generated file and take precedence, as they always did):
+ *   - VTP_STREAMING_NSTREAMS or VTP_NUM_CONNECTIONS -> numConnections
  *   - VTP_NET_MODE -> netMode
- *   - VTP_LOCAL_PORT or VTP_STREAMING_LOCALPORT -> localPort
+ *   - VTP_STREAMING_LOCALPORT or VTP_LOCAL_PORT -> localPort
  *   - VTP_ENABLE_EJFAT -> enableEjfat
- *   - VTP_STREAMING_DESTIP -> emuip
- *   - VTP_STREAMING_DESTIPPORT -> emuport
+ *   - VTP_STREAMING_DESTIP -> emuip (left unchanged if not set)
+ *   - VTP_STREAMING_DESTIPPORT -> emuport (left unchanged if not set)
+ *
+ * Returns OK, ERROR if the file can't be read or parsed.
  */
-static void
+static int
 vtp_read_all_from_cfg(const char *cfg_path,
                        int *numConnections,
                        int *netMode,
@@ -262,276 +281,147 @@ vtp_read_all_from_cfg(const char *cfg_path,
                        unsigned int *emuip,
                        unsigned int *emuport)
 {
-  FILE *f;
-  char line[1024];
+  const VTP_CONF *conf;
+  const unsigned char *ip;
 
   if (!cfg_path)
-    return;
+    return ERROR;
 
-  f = fopen(cfg_path, "r");
-  if (!f)
+  conf = vtpConfigLoad(cfg_path);
+  if (!conf)
   {
-    printf("vtp_read_all_from_cfg: cannot open config file '%s'\n", cfg_path);
-    return;
+    printf("vtp_read_all_from_cfg: cannot load config file '%s'\n", cfg_path);
+    return ERROR;
   }
 
-  while (fgets(line, sizeof(line), f))
+  if (numConnections)
   {
-    char key[128];
-    char val[512];
-
-    /* Skip comments and blank lines */
-    if (line[0] == '#' || line[0] == '\n')
-      continue;
+    if (conf->fadc_streaming.eb[0].nstreams > 0)
+      *numConnections = conf->fadc_streaming.eb[0].nstreams;
+    else
+      *numConnections = vtpGetNumConnections();
+    printf("CONFIG: numConnections = %d\n", *numConnections);
+  }
 
-    if (sscanf(line, "%127s %511s", key, val) != 2)
-      continue;
+  if (netMode)
+    *netMode = vtpGetNetMode();
 
-    if (strcmp(key, "VTP_STREAMING_DESTIP") == 0)
-    {
-      if (emuip)
-      {
-        /* Expect dotted-quad string, e.g. 192.188.29.11 */
-        printf("DDD = '%s'\n", val);
-        unsigned int ip = vtpRoc_inet_addr(val);
-        if (ip != 0)
-          *emuip = ip;
-        printf("DDD = '%08x'\n", *emuip);
-      }
-    }
-    else if (strcmp(key, "VTP_STREAMING_DESTIPPORT") == 0)
-    {
-      if (emuport)
-      {
-        unsigned int port_tmp;
-        printf("DDD = '%s'\n", val);
-        if (sscanf(val, "%u", &port_tmp) == 1)
-          *emuport = port_tmp;
-        printf("DDD = '%08x'\n", *emuport);
-      }
-    }
-    /* NEW: Read network configuration parameters */
-    else if (strcmp(key, "VTP_NUM_CONNECTIONS") == 0 ||
-             strcmp(key, "VTP_STREAMING_NSTREAMS") == 0)
-    {
-      if (numConnections)
-      {
-        int val_tmp;
-        if (sscanf(val, "%d", &val_tmp) == 1 && val_tmp > 0)
-        {
-          *numConnections = val_tmp;
-          printf("CONFIG: Read numConnections = %d from key '%s'\n", val_tmp, key);
-        }
-      }
-    }
-    else if (strcmp(key, "VTP_NET_MODE") == 0)
-    {
-      if (netMode)
-      {
-        int val_tmp;
-        if (sscanf(val, "%d", &val_tmp) == 1)
-        {
-          *netMode = val_tmp;
-          printf("CONFIG: Read netMode = %d from key 'VTP_NET_MODE'\n", val_tmp);
-        }
-      }
-    }
-    else if (strcmp(key, "VTP_LOCAL_PORT") == 0 ||
-             strcmp(key, "VTP_STREAMING_LOCALPORT") == 0)
-    {
-      if (localPort)
-      {
-        int val_tmp;
-        if (sscanf(val, "%d", &val_tmp) == 1 && val_tmp > 0)
-        {
-          *localPort = val_tmp;
-          printf("CONFIG: Read localPort = %d from key '%s'\n", val_tmp, key);
-        }
-      }
-    }
-    else if (strcmp(key, "VTP_ENABLE_EJFAT") == 0)
-    {
-      if (enableEjfat)
-      {
-        int val_tmp;
-        if (sscanf(val, "%d", &val_tmp) == 1)
-        {
-          *enableEjfat = val_tmp;
-          printf("CONFIG: Read enableEjfat = %d from key 'VTP_ENABLE_EJFAT'\n", val_tmp);
-        }
-      }
-    }
+  if (localPort)
+  {
+    if (conf->fadc_streaming.eb[0].localport > 0)
+      *localPort = conf->fadc_streaming.eb[0].localport;
+    else
+      *localPort = vtpGetLocalPort();
   }
 
-  fclose(f);
+  if (enableEjfat)
+    *enableEjfat = vtpGetEnableEjfat();
+
+  ip = conf->fadc_streaming.eb[0].destip;
+  if (emuip && (ip[0] | ip[1] | ip[2] | ip[3]))
+    *emuip = (ip[0] << 24) | (ip[1] << 16) | (ip[2] << 8) | ip[3];
+
+  if (emuport && conf->fadc_streaming.eb[0].destipport)
+    *emuport = conf->fadc_streaming.eb[0].destipport;
+
+  return OK;
 }
 
 /* =========================[ ADDED: UDP stats sender ]========================= */
 /*
- * Stats sender configuration now read from config file.
- * Default values in vtpConfig.c match previous hard-coded values:
+ * Load balancer sync packets are sent by the VTP library
+ * (vtpStreamingSyncStart).  Configuration read from config file:
+ * - VTP_SYNC_DEST <host> <port> [stream mask]: one line per destination
+ * - VTP_SYNC_RATE: 1-1000 Hz (default 1)
+ * - VTP_SYNC_PKT_LEN: 28-1472 bytes (default 28, the LC packet; zero padded)
+ * Without VTP_SYNC_DEST the previous single destination is used:
  * - VTP_STATS_HOST: "129.57.29.231" (indra-s2 IP for forwarding sync packets)
  * - VTP_STATS_PORT: 19531
  * - VTP_STATS_INST: 0
- * - VTP_SYNC_PKT_LEN: 28
  */
 
-static pthread_t g_vtp_stats_thr;
-static volatile int g_vtp_stats_run = 0;
-static int g_vtp_stats_sock = -1;
-static struct sockaddr_storage g_vtp_stats_dst;
-static socklen_t g_vtp_stats_dst_len = 0;
 static int g_vtp_stats_inst = 0;  /* Set by vtp_stats_sender_launch() from config */
 
-/* Helper for 64-bit network byte order (big endian) */
-static inline uint64_t htonll(uint64_t val) {
-  uint32_t hi = htonl((uint32_t)(val >> 32));
-  uint32_t lo = htonl((uint32_t)(val & 0xFFFFFFFFU));
-  return ((uint64_t)hi << 32) | (uint64_t)lo;
-}
-
-/**
- * Set sync packet data in the specified format for load balancer.
- *
- * @param buffer   Buffer in which to write the data.
- * @param version  Software version.
- * @param srcId    Identifier for this data source.
- * @param evtNum   64-bit event (frame) number used by the load balancer
- *                 to determine which backend host should receive the packet.
- *                 This message indicates that this application has already
- *                 sent this most recent event.
- * @param evtRate  Event (frame) rate in Hz — the rate at which this application
- *                 is sending events to the load balancer (0 if unknown).
- * @param nanos    Unix timestamp in nanoseconds representing when this message
- *                 was sent (0 if unknown).
- */
-static void setSyncData(char* buffer, int version, uint32_t srcId,
-                        uint64_t evtNum, uint32_t evtRate, uint64_t nanos) {
-    buffer[0] = 'L';
-    buffer[1] = 'C';
-    buffer[2] = (char)version;
-    buffer[3] = 0; /* reserved byte */
-
-    /* Store fields in network byte order (big endian) */
-    *((uint32_t *)(buffer + 4))  = htonl(srcId);
-    *((uint64_t *)(buffer + 8))  = htonll(evtNum);
-    *((uint32_t *)(buffer + 16)) = htonl(evtRate);
-    *((uint64_t *)(buffer + 20)) = htonll(nanos);
-}
-
-static int _resolve_udp(const char *host, uint16_t port, struct sockaddr_storage *out, socklen_t *out_len)
-{
-  char port_str[16];
-  struct addrinfo hints, *res = NULL;
-  snprintf(port_str, sizeof(port_str), "%u", (unsigned)port);
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET; hints.ai_socktype = SOCK_DGRAM; hints.ai_protocol = IPPROTO_UDP;
-  int rc = getaddrinfo(host, port_str, &hints, &res);
-  if (rc != 0 || !res) return ERROR;
-  if (res->ai_addrlen > sizeof(*out)) { freeaddrinfo(res); return ERROR; }
-  memcpy(out, res->ai_addr, res->ai_addrlen);
-  *out_len = (socklen_t)res->ai_addrlen;
-  freeaddrinfo(res);
-  return OK;
-}
-
-static void *_vtp_stats_sender_main(void *arg)
+static int vtp_stats_sender_launch(const char *host, uint16_t port, int stream_inst)
 {
-  (void)arg;
+  const char *dhost;
+  int idest, dport, dmask;
   uint32_t src_id = 0;
-  (void)vtp_get_src_id(&src_id);
-
-  /* Initialize frame counter tracking - extend 32-bit to 64-bit */
-  uint32_t prev_fc_low32 = vtpStreamingGetEbFrameCnt(g_vtp_stats_inst);
-  uint64_t prev_fc_ext = (uint64_t)prev_fc_low32;
 
-  struct timespec t_prev;
-  clock_gettime(CLOCK_MONOTONIC, &t_prev);
+  vtpStreamingSyncClearDest();
 
-  while (g_vtp_stats_run)
-  {
-    /* sleep ~1s, resilient to EINTR */
-    struct timespec req = { .tv_sec = 1, .tv_nsec = 0 }, rem;
-    while (nanosleep(&req, &rem) != 0 && errno == EINTR) req = rem;
-
-    struct timespec t_now;
-    clock_gettime(CLOCK_MONOTONIC, &t_now);
-    double dt = (t_now.tv_sec - t_prev.tv_sec) + (t_now.tv_nsec - t_prev.tv_nsec)/1e9;
-    if (dt <= 0) dt = 1.0;
-    t_prev = t_now;
-
-    /* Get current 32-bit frame counter from VTP library */
-    uint32_t cur_fc_low32 = vtpStreamingGetEbFrameCnt(g_vtp_stats_inst);
-
-    /* Extend to 64-bit by detecting wraps */
-    uint64_t fc_ext;
-    if (cur_fc_low32 < prev_fc_low32) {
-      /* Wrap detected - increment upper 32 bits */
-      prev_fc_ext += (1ULL << 32);
+  if (vtpGetSyncDestCount() > 0) {
+    for (idest = 0; idest < vtpGetSyncDestCount(); idest++) {
+      if (vtpGetSyncDest(idest, &dhost, &dport, &dmask) == OK)
+        (void)vtpStreamingSyncAddDest(dhost, dport, dmask);
     }
-    fc_ext = (prev_fc_ext & 0xFFFFFFFF00000000ULL) | (uint64_t)cur_fc_low32;
-    prev_fc_low32 = cur_fc_low32;
-
-    /* Calculate event rate (frames per second) */
-    double dframes = (fc_ext >= prev_fc_ext) ? (double)(fc_ext - prev_fc_ext) : 0.0;
-    uint32_t evt_rate = (uint32_t)((dframes / dt) + 0.5);
+  } else {
+    if (!host || !*host || port == 0 || stream_inst < 0) return ERROR;
+    if (vtpStreamingSyncAddDest(host, port, 1 << stream_inst) != OK) {
+      printf("vtp_stats_sender: resolve failed for %s:%u\n", host, (unsigned)port);
+      return ERROR;
+    }
+    /* Single destination keeps reporting ROCID as the source id */
+    (void)vtp_get_src_id(&src_id);
+    vtpStreamingSyncSetSrcId(stream_inst, src_id);
+  }
 
-    /* Compute timestamp: frame_number × 65.535 microseconds (in nanoseconds)
-     * 65.535 µs = 65535 ns */
-    uint64_t timestamp_ns = fc_ext * 65535ULL;
+  g_vtp_stats_inst = stream_inst;
 
-    /* Prepare sync packet buffer */
-    int pkt_len = vtpGetSyncPktLen();
-    char buf[256];  /* Large enough for any reasonable sync packet */
-    if (pkt_len > (int)sizeof(buf)) pkt_len = sizeof(buf);
-    setSyncData(buf, 1, src_id, fc_ext, evt_rate, timestamp_ns);
+  (void)vtpStreamingSyncSetPktLen(vtpGetSyncPktLen());
 
-    /* Send sync packet */
-    (void)sendto(g_vtp_stats_sock, buf, pkt_len, 0,
-                 (struct sockaddr *)&g_vtp_stats_dst, g_vtp_stats_dst_len);
+  return vtpStreamingSyncStart(vtpGetSyncRate());
+}
 
-    /* Update previous frame count for next iteration */
-    prev_fc_ext = fc_ext;
-  }
-  return NULL;
+static int vtp_stats_sender_stop(void)
+{
+  vtpStreamingSyncStop();
+  vtpStreamingSyncPrintStats();
+  g_vtp_stats_inst = 0;
+  return OK;
 }
 
-static int vtp_stats_sender_launch(const char *host, uint16_t port, int stream_inst)
+/* =========================[ Link supervisor ]=========================
+ * Config keys (vtpConfig.c):
+ * - VTP_LINK_SUPERVISOR: 0/1 (default 0)
+ * - VTP_LINK_FAILOVER:   0 alarm only, 1 remap payloads, 2 standby destination
+ * - VTP_LINK_STALL_MS:   no frames sent for this long = stalled link (default 500)
+ * - VTP_LINK_STANDBY:    <stream 1-4> <a.b.c.d> <port>
+ */
+static void vtp_link_alarm(int stream, int reason, int action, void *arg)
 {
-  if (!host || !*host || port == 0 || stream_inst < 0) return ERROR;
-  if (g_vtp_stats_run) return OK; /* idempotent */
+  if (reason)
+    daLogMsg("ERROR", "VTP stream %d link failed (reason 0x%x, failover %d)",
+             stream + 1, reason, action);
+  else
+    daLogMsg("WARN", "VTP stream %d link failover complete", stream + 1);
+}
 
-  if (_resolve_udp(host, port, &g_vtp_stats_dst, &g_vtp_stats_dst_len) != OK) {
-    printf("vtp_stats_sender: resolve failed for %s:%u\n", host, (unsigned)port);
-    return ERROR;
-  }
-  int s = socket(g_vtp_stats_dst.ss_family, SOCK_DGRAM, IPPROTO_UDP);
-  if (s < 0) { printf("vtp_stats_sender: socket failed: %s\n", strerror(errno)); return ERROR; }
+static int vtp_link_supervisor_start(int numConnections)
+{
+  unsigned char ip[4];
+  int inst, port;
 
-  g_vtp_stats_sock = s;
-  g_vtp_stats_inst = stream_inst;
-  g_vtp_stats_run = 1;
+  if (!vtpGetLinkSupervisor()) return OK;
 
-  int rc = pthread_create(&g_vtp_stats_thr, NULL, _vtp_stats_sender_main, NULL);
-  if (rc != 0) {
-    g_vtp_stats_run = 0;
-    close(g_vtp_stats_sock); g_vtp_stats_sock = -1;
-    printf("vtp_stats_sender: pthread_create failed: %s\n", strerror(rc));
-    return ERROR;
+  for (inst = 0; inst < numConnections; inst++) {
+    if (vtpGetLinkStandby(inst, ip, &port) == OK)
+      vtpStreamingSupervisorSetStandby(inst, ip, (unsigned short)port);
+    else
+      vtpStreamingSupervisorSetStandby(inst, NULL, 0);
   }
-  return OK;
+  vtpStreamingSupervisorSetAlarm(vtp_link_alarm, NULL);
+
+  return vtpStreamingSupervisorStart((1 << numConnections) - 1, vtpGetLinkFailover(),
+                                     vtpGetLinkStallMs(), ppInfo);
 }
 
-static int vtp_stats_sender_stop(void)
+static int vtp_link_supervisor_stop(void)
 {
-  if (!g_vtp_stats_run) return OK;
-  g_vtp_stats_run = 0;
-  (void)pthread_join(g_vtp_stats_thr, NULL);
-  if (g_vtp_stats_sock >= 0) { close(g_vtp_stats_sock); g_vtp_stats_sock = -1; }
-  memset(&g_vtp_stats_dst, 0, sizeof(g_vtp_stats_dst));
-  g_vtp_stats_dst_len = 0;
-  g_vtp_stats_inst = 0;
-  return OK;
+  if (!vtpGetLinkSupervisor()) return OK;
+
+  vtpStreamingSupervisorStop();
+  return vtpStreamingSupervisorPrint();
 }
 
 /* =========================[ Original code + mods ]========================= */
@@ -568,6 +458,7 @@ if (!coda || !*coda) {
   }
 
   firstEvent = 1;
+  vtpHotValid = 0;
 
   /* Open VTP library */
   stat = vtpOpen(VTP_FPGA_OPEN | VTP_I2C_OPEN | VTP_SPI_OPEN);
@@ -603,36 +494,21 @@ void
 rocPrestart()
 {
   unsigned int emuip = 0, emuport = 0;
-  int ii, stat, ppmask=0;
+  int ii, stat, ppmask=0, hot=0;
+  int frame_len = 0xffff;
+  VTP_STREAMING_FRAMELEN framelen;
 
-  /* CRITICAL: Initialize with invalid sentinel values (0) to detect parsing failures.
-   *
-   * DO NOT use "safe defaults" - any 0 value after config parsing means the config is
-   * missing required keys and we must error out.
-   *
-   * BUG: vtpGet*() functions return 0 even after successful vtpConfig() parsing.
-   * FIX: Read parameters directly from config file using vtp_read_all_from_cfg().
+  /* Set from the parsed config, see vtp_read_all_from_cfg().  Keys missing
+   * from the file keep the VTP library defaults (vtpInitGlobals); a value of
+   * 0 left after loading is an invalid config and we must error out.
    */
-  int netMode = 0;         // MUST be read from config (0=TCP, 1=UDP)
-  int localport = 0;       // MUST be read from config
-  int numConnections = 0;  // MUST be read from config
-  int enableEjfat = 0;     // MUST be read from config
+  int netMode = 0;         // from config (0=TCP, 1=UDP)
+  int localport = 0;       // from config
+  int numConnections = 0;  // from config
+  int enableEjfat = 0;     // from config
 
   VTPflag = 0;
 
-  /* Initialize the VTP here since external clock is stable now */
-  if(vtpInit(VTP_INIT_CLK_VXS_250))
-  {
-    printf("vtpInit() **FAILED**. User should not continue.\n");
-    return;
-  }
-
-  /* Read back frame counter for verification */
-  {
-    uint32_t fc = vtpStreamingGetEbFrameCnt(0);
-    printf("VTP frame counter (inst 0, PRESTART): 0x%08x (%u)\n", fc, fc);
-  }
-
   printf("Calling VTP_READ_CONF_FILE ..\n");fflush(stdout);
 
   /* Read Config file and Initialize VTP variables */
@@ -661,20 +537,19 @@ rocPrestart()
 
     printf("Using auto-generated VTP config: %s\n", vtp_config_path);
 
-    /* Load the config file */
-    vtpInitGlobals();
-    vtpConfig(vtp_config_path);
-
-    /* Read ALL required parameters from VTP config file.
-     * Bypasses broken vtpGet*() functions that return 0.
-     */
-    vtp_read_all_from_cfg(vtp_config_path, &numConnections, &netMode,
-                          &localport, &enableEjfat, &emuip, &emuport);
+    /* Load the config file (parsed only if it changed since the last
+     * run) and read ALL required parameters from it */
+    if (vtp_read_all_from_cfg(vtp_config_path, &numConnections, &netMode,
+                              &localport, &enableEjfat, &emuip, &emuport) != OK)
+    {
+      printf("ERROR: Generated VTP config file '%s' could not be parsed\n", vtp_config_path);
+      return;
+    }
   }
 
   /* VALIDATION: Verify all required parameters were read from config file.
    *
-   * Any 0 value means config file is missing required keys - this is a FATAL error.
+   * Any 0 value means the config file is invalid - this is a FATAL error.
    */
   if (numConnections == 0)
   {
@@ -720,6 +595,41 @@ rocPrestart()
   printf("EMU DEST from cfg/ROC: IP=0x%08x port=%d localport=%d\n",
          emuip, emuport, localport);
 
+  /* Links are still up from the last run and the transport is unchanged:
+     skip the VTP, MIG and EBIO initialization and only move the streams
+     whose destination changed */
+  hot = vtpGetStreamingHotReconfig() && vtpHotValid &&
+    (netMode == vtpHotNetMode) && (enableEjfat == vtpHotEjfat);
+  vtpHotValid = 0;
+
+  if(hot)
+  {
+    printf("Hot reconfiguration: keeping the VTP initialization of the last run\n");
+  }
+  else
+  {
+    /* Initialize the VTP here since external clock is stable now */
+    if(vtpInit(VTP_INIT_CLK_VXS_250))
+    {
+      printf("vtpInit() **FAILED**. User should not continue.\n");
+      return;
+    }
+  }
+
+  /* Download to the VTP after vtpInit(), which resets the V7.  Skipped if
+   * this config (content hash) is what the VTP already has and it was not
+   * reset since */
+  if (vtpConfigDownloaded())
+    printf("VTP config unchanged since the last download, download skipped\n");
+  else
+    vtpDownloadAll();
+
+  /* Read back frame counter for verification */
+  {
+    uint32_t fc = vtpStreamingGetEbFrameCnt(0);
+    printf("VTP frame counter (inst 0, PRESTART): 0x%08x (%u)\n", fc, fc);
+  }
+
   /* ========================================================================
    * DYNAMIC PAYLOAD CONFIGURATION
    * ========================================================================
@@ -781,9 +691,25 @@ rocPrestart()
   }
   /* ======================================================================== */
 
+  /* Spread the payloads over the streams using the saved payload volume profile */
+  if ((vtpGetStreamingBalance() > 0) && (numConnections > 1))
+  {
+    float weight[VTP_STREAMING_NPAYLOAD];
+    const char *profile = vtpGetStreamingProfile();
+
+    if (!profile[0] || vtpStreamingProfileLoad(profile, weight) <= 0)
+      memset(weight, 0, sizeof(weight));
+    vtpStreamingBalance(ppmask, numConnections, weight, ppInfo);
+  }
+
+  /* Frame length: fixed, or selected from the rates measured in the last run */
+  if (vtpGetFrameLenAdapt())
+    frame_len = vtpStreamingFrameLenSelect(vtpGetFrameLenState(), vtpGetFrameLenTarget(),
+                                           vtpGetFrameLenMaxNs(), frame_len, &framelen);
+
   /* Update the Streaming EB configuration for the new firmware to get the correct PP Mask and ROCID
      PP mask, nstreams, frame_len (ns), ROCID, ppInfo  */
-  vtpStreamingSetEbCfg(ppmask, numConnections, 0xffff, ROCID, ppInfo);
+  vtpStreamingSetEbCfg(ppmask, numConnections, frame_len, ROCID, ppInfo);
   emuData[4] = ROCID;  /* define ROCID in the EMU Connection data as well*/
   emuData[6] = numConnections;  /* Update number of connections from config */
 
@@ -798,12 +724,15 @@ rocPrestart()
   if(stat != OK)
     printf("Error in vtpStreamingEbEnable()\n");
 
-  /* Reset the MIG - DDR memory write tagging - for Streaming Ebio */
-  vtpStreamingMigReset();
+  if(!hot)
+  {
+    /* Reset the MIG - DDR memory write tagging - for Streaming Ebio */
+    vtpStreamingMigReset();
 
-  /* Reset the data links between V7 Streaming EB and the Zync TCP client
-     Set the Network output mode */
-  vtpStreamingEbioReset(netMode);
+    /* Reset the data links between V7 Streaming EB and the Zync TCP client
+       Set the Network output mode */
+    vtpStreamingEbioReset(netMode);
+  }
 
   /* Get Stream connection info from file. Then Setup the VTP connection registers manually and connect */
   {
@@ -814,6 +743,7 @@ rocPrestart()
     unsigned char mac[6];
     unsigned char udpaddr[4], tcpaddr[4], destip[4];
     unsigned int tcpport, udpport;
+    VTP_STREAMING_NETCFG netcfg[4];
 
     /* fix the destination IP address so it is correct (from emuip) */
     destip[3] = (emuip & 0xFF);
@@ -861,6 +791,19 @@ rocPrestart()
       printf(" tcpaddr=%d.%d.%d.%d\n",tcpaddr[0],tcpaddr[1],tcpaddr[2],tcpaddr[3]);
       printf(" udpport=0x%08x  tcpport=0x%08x\n",udpport, tcpport);
 
+      /* Hot reconfiguration compares them with the live registers later */
+      if(hot)
+      {
+        memcpy(netcfg[inst].ipaddr,  ipaddr,  4);
+        memcpy(netcfg[inst].subnet,  subnet,  4);
+        memcpy(netcfg[inst].gateway, gateway, 4);
+        memcpy(netcfg[inst].mac,     mac,     6);
+        memcpy(netcfg[inst].destip,  destip,  4);
+        netcfg[inst].destport  = emuport;
+        netcfg[inst].localport = localport;
+        continue;
+      }
+
       /* Set VTP connection registers */
       vtpStreamingSetNetCfg(
           inst,
@@ -903,10 +846,32 @@ rocPrestart()
       if (udpaddr[0] == 0 && udpaddr[1] == 0 && udpaddr[2] == 0 && udpaddr[3] == 0)
         printf("WARNING: UDP destination still 0.0.0.0 after vtpStreamingSetNetCfg!\n");
 
-      /* Make the Connection - only for Client mode - to disable the cMSg connection data set last arg 8->0 */
-      vtpStreamingTcpConnect(inst, (netMode+1), emuData, 0);
       /* vtpStreamingTcpAccept(inst); */
     }
+
+    /* Make the Connections together - only for Client mode - to disable the cMSg connection data set dlen 8->0 */
+    if(numConnections > 0)
+      {
+        /* Lower the MTU if the path to a destination carries less (probed
+           from the management interface: cannot verify jumbo frames) */
+        if(!hot && (vtpGetMtuProbePort() > 0))
+          vtpStreamingMtuTune((1<<numConnections)-1, vtpGetMtuProbePort(), vtpGetMtuProbeMax(),
+                              vtpGetMtuProbeTimeout());
+
+        if(hot)
+          stat = vtpStreamingReconfigure(numConnections, netMode, netcfg, emuData, 0, 20000);
+        else
+          stat = vtpStreamingConnectAll((1<<numConnections)-1, (netMode+1), emuData, 0, 20000);
+        if(stat != ((1<<numConnections)-1))
+          printf("rocPrestart: ERROR: Streams ready mask 0x%x (expected 0x%x)\n",
+                 stat, (1<<numConnections)-1);
+        else
+          {
+            vtpHotValid   = 1;
+            vtpHotNetMode = netMode;
+            vtpHotEjfat   = enableEjfat;
+          }
+      }
   }
 
   /* Send a Prestart Event to each stream */
@@ -914,6 +879,27 @@ rocPrestart()
     vtpStreamingEvioWriteControl(ii,EV_PRESTART,rol->runNumber,rol->runType);
   }
 
+  /* The VTP configuration file is not shipped as a User Event: it does not
+     fit the async FIFO of the streaming EB, and events larger than the FIFO
+     are not verified yet (vtpStreamingSetAsyncLarge).  The settings go into
+     the first event as the config bank instead. */
+
+  /* Record the selected frame length in the data stream */
+  if (vtpGetFrameLenAdapt() &&
+      (vtpStreamingFrameLenRecord((1<<numConnections)-1, &framelen) != OK))
+    printf("ERROR: Failed to send VTP frame length User Event\n");
+
+  /* Configuration record of the first event, prepared here so the trigger
+     routine only copies it */
+  vtpCfgBankWords = vtpConfigBankBuild(vtpCfgBank, VTP_CFGBANK_MAXWORDS);
+  if (vtpCfgBankWords == ERROR)
+  {
+    printf("ERROR: Failed to build the VTP config bank\n");
+    vtpCfgBankWords = 0;
+  }
+  else
+    vtpConfigBankPrint(vtpCfgBank, vtpCfgBankWords);
+
   printf(" Done with User Prestart\n");
 }
 
@@ -928,6 +914,7 @@ rocPause()
   CDODISABLE(VTP, 1, 0);
   /* ADDED: stop stats thread */
   (void)vtp_stats_sender_stop();
+  (void)vtp_link_supervisor_stop();
 }
 
 /**
@@ -938,7 +925,7 @@ rocGo()
 {
   int ii, stat;
 
-  /* Read from config file instead of broken getter - must match rocPrestart */
+  /* Config parsed at rocPrestart (cached, not parsed again) - must match rocPrestart */
   int numConnections = 0;
   char vtp_config_path[512];
   if (vtp_get_generated_config_path(vtp_config_path, sizeof(vtp_config_path)) == 0 &&
@@ -948,7 +935,7 @@ rocGo()
   }
   if (numConnections == 0) numConnections = 1;  /* Emergency fallback */
 
-  /* ADDED: launch 1 Hz UDP status sender at GO begin */
+  /* ADDED: launch UDP sync sender at GO begin */
   /* Get config values, but allow env var override for backward compatibility */
   const char *host = getenv("VTP_STATS_HOST");
   char *port_env = getenv("VTP_STATS_PORT");
@@ -969,6 +956,13 @@ rocGo()
 
   (void)vtp_stats_sender_launch(host, port, inst);
 
+  /* Per-link throughput statistics (query with vtpStreamingGetRates) */
+  vtpStreamingRateStart(1000);
+
+  /* Measure the achieved payload balance */
+  if ((vtpGetStreamingBalance() > 0) && (numConnections > 1))
+    vtpStreamingBalanceStart();
+
   /* Enable the Streaming EB */
   /* vtpStreamingEbGo(); */
   /* vtpStreamingAsyncInfoWrite(8); */
@@ -1005,6 +999,10 @@ rocGo()
   if(stat != OK)
     printf("Error in vtpStreamingEbEnable()\n");
 
+  /* Watch the network links for the rest of the run */
+  if(vtp_link_supervisor_start(numConnections) != OK)
+    printf("Error starting the VTP link supervisor\n");
+
   /* Enable to recieve Triggers */
   CDOENABLE(VTP, 1, 0);
   VTPflag=0; /* disable polling for triggers in streaming mode */
@@ -1018,8 +1016,10 @@ rocEnd()
 {
   int ii, stat, status;
   unsigned int nFrames;
+  VTP_STREAMING_DRAIN drain;
+  VTP_STREAMING_SNAPSHOT endSnap;
 
-  /* Read from config file instead of broken getter - must match rocPrestart */
+  /* Config parsed at rocPrestart (cached, not parsed again) - must match rocPrestart */
   int numConnections = 0;
   char vtp_config_path[512];
   if (vtp_get_generated_config_path(vtp_config_path, sizeof(vtp_config_path)) == 0 &&
@@ -1034,13 +1034,26 @@ rocEnd()
 
   /* ADDED: stop stats thread */
   (void)vtp_stats_sender_stop();
+  (void)vtp_link_supervisor_stop();
+
+  vtpStreamingRateStop();
+  vtpStreamingRatePrint();
+
+  /* Rates of this run select the frame length of the next one */
+  if (vtpGetFrameLenAdapt() && vtpGetFrameLenState()[0])
+    vtpStreamingFrameLenSave(vtpGetFrameLenState());
 
   vtpStats(0);
 
   /* Disconnect Streaming sockets */
   /* for(inst=0;inst<NUM_VTP_CONNECTIONS;inst++) { vtpStreamingTcpConnect(inst,0); } */
 
-  sleep(2);  /* wait a bit to make sure the VTP sends all its data */
+  /* Wait for the VTP to send all its data */
+  if(vtpStreamingDrain((1<<numConnections)-1, 2000, &drain) == OK)
+    printf("rocEnd: Data drained in %u us\n", drain.drain_us);
+  else
+    printf("rocEnd: ERROR: Data not drained - MIG backlog %d, %d\n",
+           drain.mig_backlog[0], drain.mig_backlog[1]);
 
   /* Send an End Event */
   /* Enable StreamingEB AsyncFiFo processing */
@@ -1049,21 +1062,74 @@ rocEnd()
     printf("Error in vtpStreamingEbEnable()\n");
 
   /*Send End Event to instance 0*/
+  vtpStreamingSnapshot(&endSnap);
   for(ii=0;ii<numConnections;ii++) {
     nFrames = vtpStreamingFramesSent(ii);
     vtpStreamingEvioWriteControl(ii,EV_END,rol->runNumber,nFrames);
     printf("rocEnd: Stream %d - Wrote End Event (total %d frames)\n",ii, nFrames);
   }
-  sleep(2);
+
+  /* Wait for the End Events to leave.  They go through the async FIFO, not
+     the MIG: wait until every stream sent at least the End Event and the
+     output is quiet */
+  if(vtpStreamingDrainSent((1<<numConnections)-1, &endSnap, VTP_STREAMING_CONTROL_EVENT_BYTES,
+                           2000, &drain) == OK)
+    {
+      for(ii=0;ii<numConnections;ii++)
+        printf("rocEnd: Stream %d - %llu frames, %llu bytes sent (End drained in %u us)\n", ii,
+               (unsigned long long)drain.frames_sent[ii],
+               (unsigned long long)drain.bytes_sent[ii], drain.drain_us);
+    }
+  else if(drain.sent)
+    printf("rocEnd: End Events sent, output still not quiet after 2 s\n");
+  else
+    printf("rocEnd: ERROR: End Events not sent\n");
+
+  vtpStreamingMtuPrint((1<<numConnections)-1);
+
+  /* Achieved payload balance; unless the profile is fixed (2), update the
+     payloads measured on the board (alone on a stream) and keep the rest */
+  if ((vtpGetStreamingBalance() > 0) && (numConnections > 1))
+  {
+    float weight[VTP_STREAMING_NPAYLOAD], prof[VTP_STREAMING_NPAYLOAD];
+    const char *profile = vtpGetStreamingProfile();
+    int ipp, nmeas = 0;
+
+    if ((vtpStreamingBalanceEnd(weight) == OK) && (vtpGetStreamingBalance() == 1) && profile[0])
+    {
+      if (vtpStreamingProfileLoad(profile, prof) <= 0)
+        memset(prof, 0, sizeof(prof));
+      for (ipp = 0; ipp < VTP_STREAMING_NPAYLOAD; ipp++)
+        if (weight[ipp] > 0)
+        {
+          prof[ipp] = weight[ipp];
+          nmeas++;
+        }
+      if (nmeas > 0)
+        vtpStreamingProfileSave(profile, prof);
+    }
+  }
 
   /* Disable Streaming EB - careful. If the User Sync is not high this can drop packets from a frame using UDP */
   /* vtpStreamingEbReset(); */
 
-  /* Disconnect the Socket - Client Mode TCP connections */
-  for(ii=0;ii<numConnections;ii++) {
-    status = vtpStreamingTcpConnect(ii,0,0,0);
-    if(status == ERROR) {
-      printf("rocEnd: Error closing socket on link %d\n",ii);
+  /* Disconnect the Socket - Client Mode TCP connections.
+     With hot reconfiguration the UDP sockets stay open for the next run */
+  if(vtpHotValid && (vtpHotNetMode == 1) && vtpGetStreamingHotReconfig())
+  {
+    printf("rocEnd: Keeping UDP streams open for hot reconfiguration\n");
+    /* Disable stream building, as the disconnect does, only once the output
+       went quiet after the End Events (no UDP frame in flight).  Otherwise
+       the EB is left to the EB reset of vtpStreamingReconfigure() at the next
+       Prestart */
+    if(drain.drained)
+      vtpStreamingEbReset();
+  }
+  else
+  {
+    status = vtpStreamingConnectAll((1<<numConnections)-1, 0, 0, 0, 500);
+    if(status != ((1<<numConnections)-1)) {
+      printf("rocEnd: Error closing sockets (closed mask 0x%x)\n",status);
     }
   }
 
@@ -1108,9 +1174,8 @@ rocTrigger(int EVTYPE)
 
     if(trigBankType == 0xff11)
     {
-      /* Compute timestamp from frame counter: frame × 65.535 µs (in nanoseconds) */
-      uint32_t fc = vtpStreamingGetEbFrameCnt(g_vtp_stats_inst);
-      uint64_t ts = (uint64_t)fc * 65535ULL;
+      /* Timestamp from the 64-bit frame clock: frame x frame length (in nanoseconds) */
+      uint64_t ts = vtpStreamingGetFrameTime(g_vtp_stats_inst);
       *rol->dabufp++ = (uint32_t)(ts & 0xffffffffu);
       *rol->dabufp++ = (uint32_t)(ts >> 32);
     }
@@ -1127,28 +1192,14 @@ rocTrigger(int EVTYPE)
   }
   CBCLOSE;
 
-  /* If this is the first event then get the config file info and put it in a Bank */
+  /* If this is the first event then put the VTP config bank (built at
+     Prestart, see vtpConfigBankDecode) in a Bank */
   if(firstEvent)
   {
-    char str[10000];
-    int len = vtpUploadAll(str, sizeof(str)-4);
-    str[len] = 0;
-    str[len+1] = 0;
-    str[len+2] = 0;
-    str[len+3] = 0;
     firstEvent = 0;
-    printf("VTP string(len = %d bytes): \n%s\n",len,str);
-    CBOPEN(0x12, BT_UC1, blklevel);
-    /* CBOPEN(0x12, BT_UI4, blklevel); */
-    for(ii = 0; ii < (len+3)/4; ii++)
-    {
-      unsigned int val;
-      val = ((unsigned char)str[ii*4+0] << 0)  |
-            ((unsigned char)str[ii*4+1] << 8)  |
-            ((unsigned char)str[ii*4+2] << 16) |
-            ((unsigned char)str[ii*4+3] << 24);
-      *rol->dabufp++ = val;
-    }
+    CBOPEN(0x12, BT_UI4, blklevel);
+    memcpy(rol->dabufp, vtpCfgBank, vtpCfgBankWords*4);
+    rol->dabufp += vtpCfgBankWords;
     CBCLOSE;
   }
 
@@ -1172,6 +1223,8 @@ rocTrigger_done()
 void
 rocReset()
 {
+  vtpHotValid = 0;
+
   /* close VTP device */
   vtpClose(VTP_FPGA_OPEN|VTP_I2C_OPEN|VTP_SPI_OPEN);
 }
@@ -32,18 +32,24 @@
 #define FIBER_LATENCY_OFFSET 0x4A
 
 /* Additional includes for pedestal generation and config file creation */
+#include <stdlib.h>         /* malloc, free */
 #include <string.h>         /* strerror, strcmp, strlen */
 #include <errno.h>          /* errno */
 #include <unistd.h>         /* gethostname, access */
 #include <sys/utsname.h>    /* uname */
 #include <sys/wait.h>       /* waitpid */
 #include <ctype.h>          /* isalnum */
+#include <stdint.h>         /* uint64_t */
+#include <sys/stat.h>       /* stat */
+#include <time.h>           /* time */
+#include <signal.h>         /* kill */
 
 #include "dmaBankTools.h"   /* Macros for handling CODA banks */
 #include "tiprimary_list.c" /* Source required for CODA readout lists using the TI */
 #include "fadcLib.h"        /* library of FADC250 routines */
 #include "sdLib.h"          /* VXS Signal Distribution board header */
 #include "fadc250Config.h"  /* Support for reading FADC config files */
+#include "peds/fadcPeds.c"  /* Pedestal engine for the raw mode readout */
 
 extern int vtpConfig(char *fname);  /* VTP config-file parser (vtpConfig.c / libvtp) */
 
@@ -98,6 +104,13 @@ typedef struct {
   int fadc_trg_mask[16];
   int fadc_tet_ignore_mask[16];
 
+  /* Pedestal cache */
+  int peds_valid;          /* seconds cached pedestals are reused, 0: acquire at every Download */
+  double peds_max_drift;   /* ADC counts a pedestal may move between acquisitions and be reused */
+  int peds_background;     /* refresh the cache at End, in the background */
+  int peds_raw;            /* pedestals from the raw mode readout of each run */
+  int peds_max_spread;     /* ADC counts, max - min of a raw window without a pulse */
+
   /* VTP streaming parameters */
   int vtp_streaming_rocid;
   int vtp_streaming_nframe_buf;
@@ -149,6 +162,12 @@ static void init_config_params(user_config_params_t *params)
   params->fadc_tet = 20;
   params->fadc_dac = 3270;
 
+  params->peds_valid = 3600;
+  params->peds_max_drift = 2.0;
+  params->peds_background = 1;
+  params->peds_raw = 0;
+  params->peds_max_spread = FADC_PEDS_DEF_MAX_SPREAD;
+
   for (i = 0; i < 16; i++) {
     params->fadc_adc_mask[i] = 1;
     params->fadc_trg_mask[i] = 0;
@@ -224,6 +243,26 @@ static int parse_user_config(const char *config_file, user_config_params_t *para
       sscanf(line, "%*s %d", &params->fadc_dac);
       printf("INFO:   FADC250_DAC = %d\n", params->fadc_dac);
     }
+    else if (strcmp(keyword, "FADC250_PEDS_VALID") == 0) {
+      sscanf(line, "%*s %d", &params->peds_valid);
+      printf("INFO:   FADC250_PEDS_VALID = %d s\n", params->peds_valid);
+    }
+    else if (strcmp(keyword, "FADC250_PEDS_MAX_DRIFT") == 0) {
+      sscanf(line, "%*s %lf", &params->peds_max_drift);
+      printf("INFO:   FADC250_PEDS_MAX_DRIFT = %.3f\n", params->peds_max_drift);
+    }
+    else if (strcmp(keyword, "FADC250_PEDS_BACKGROUND") == 0) {
+      sscanf(line, "%*s %d", &params->peds_background);
+      printf("INFO:   FADC250_PEDS_BACKGROUND = %d\n", params->peds_background);
+    }
+    else if (strcmp(keyword, "FADC250_PEDS_RAW") == 0) {
+      sscanf(line, "%*s %d", &params->peds_raw);
+      printf("INFO:   FADC250_PEDS_RAW = %d\n", params->peds_raw);
+    }
+    else if (strcmp(keyword, "FADC250_PEDS_MAX_SPREAD") == 0) {
+      sscanf(line, "%*s %d", &params->peds_max_spread);
+      printf("INFO:   FADC250_PEDS_MAX_SPREAD = %d\n", params->peds_max_spread);
+    }
     else if (strcmp(keyword, "FADC250_ADC_MASK") == 0) {
       sscanf(line, "%*s %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
              &params->fadc_adc_mask[0], &params->fadc_adc_mask[1],
@@ -514,6 +553,543 @@ static int parse_rocname_from_peds(const char *peds_file, char *rocname_buf, siz
   return 0;
 }
 
+/**
+ * Generated config files start with a content hash stamp:
+ *   # CONFIG_HASH fnv1a64 <16 hex digits>
+ * the 64 bit FNV-1a of the rest of the file (VTP_CONFIG_HASH_STAMP in
+ * vtp/vtpConfig.h, the VTP side keys its config cache and download on it)
+ */
+#define CONFIG_HASH_STAMP "# CONFIG_HASH fnv1a64"
+
+static uint64_t config_hash(const char *buf, size_t len)
+{
+  uint64_t h = 14695981039346656037ull;
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    h = (h ^ (unsigned char)buf[i]) * 1099511628211ull;
+
+  return h;
+}
+
+/**
+ * Install generated config content as 'path'.  A file with the same
+ * content is left untouched (so consumers see no change); otherwise the
+ * stamped content goes to a temporary file in the same directory that is
+ * renamed over 'path', so readers never see a partial file.
+ * Returns: 1 unchanged, 0 written, -1 on failure
+ */
+static int write_config_if_changed(const char *path, const char *buf, size_t len)
+{
+  char stamp[64], tmp_path[600];
+  char *old;
+  struct stat st;
+  size_t slen;
+  FILE *fp;
+  int same = 0;
+
+  snprintf(stamp, sizeof(stamp), "%s %016llx\n", CONFIG_HASH_STAMP,
+           (unsigned long long)config_hash(buf, len));
+  slen = strlen(stamp);
+
+  /* Same stamp and content as the file in place? */
+  if ((stat(path, &st) == 0) && ((size_t)st.st_size == slen + len) &&
+      ((fp = fopen(path, "r")) != NULL))
+  {
+    old = malloc(slen + len + 1);
+    if (old && (fread(old, 1, slen + len, fp) == slen + len))
+      same = (memcmp(old, stamp, slen) == 0) && (memcmp(old + slen, buf, len) == 0);
+    free(old);
+    fclose(fp);
+  }
+
+  if (same)
+  {
+    printf("INFO: %s unchanged (%.*s), left as is\n", path, (int)slen - 1, stamp);
+    return 1;
+  }
+
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp%d", path, (int)getpid());
+  fp = fopen(tmp_path, "w");
+  if (!fp)
+  {
+    printf("ERROR: Cannot create '%s': %s\n", tmp_path, strerror(errno));
+    return -1;
+  }
+
+  if ((fputs(stamp, fp) == EOF) || (fwrite(buf, 1, len, fp) != len) ||
+      (fflush(fp) != 0) || (fsync(fileno(fp)) != 0))
+  {
+    printf("ERROR: Cannot write '%s': %s\n", tmp_path, strerror(errno));
+    fclose(fp);
+    unlink(tmp_path);
+    return -1;
+  }
+  fclose(fp);
+
+  if (rename(tmp_path, path) != 0)
+  {
+    printf("ERROR: Cannot rename '%s' to '%s': %s\n", tmp_path, path, strerror(errno));
+    unlink(tmp_path);
+    return -1;
+  }
+
+  printf("INFO: %s written (%.*s)\n", path, (int)slen - 1, stamp);
+  return 0;
+}
+
+/****************************************
+ * PEDESTAL CACHE
+ ****************************************/
+
+/**
+ * fadc250peds takes seconds, so its results are kept per slot and channel
+ * in $CODA_DATA/<hostname>_peds.cache, with the time of the last
+ * acquisition, the change from the acquisition before (drift) and the
+ * number of acquisitions.  Download reuses them while every channel is
+ * younger than FADC250_PEDS_VALID seconds and its drift is within
+ * FADC250_PEDS_MAX_DRIFT.  With FADC250_PEDS_BACKGROUND, End starts the
+ * refresh of an aging or unsettled cache in the background; it programs
+ * the FADCs, so Download or Prestart wait for it before touching them.
+ */
+#define PEDS_MAX_SLOT  21
+#define PEDS_NCHAN     16
+
+typedef struct {
+  int    valid;
+  double ped;              /* ADC counts */
+  double drift;            /* change at the last acquisition, -1: first acquisition */
+  time_t acquired;         /* time of the last acquisition */
+  int    nacq;             /* acquisitions */
+} peds_channel_t;
+
+typedef struct {
+  char rocname[256];
+  peds_channel_t ch[PEDS_MAX_SLOT][PEDS_NCHAN];
+} peds_cache_t;
+
+static peds_cache_t peds_cache;
+static int    peds_valid = 3600;       /* user config, see user_config_params_t */
+static double peds_max_drift = 2.0;
+static int    peds_background = 1;
+static int    peds_raw = 0;
+static FADC_PEDS fadc_peds;            /* raw mode readout of the current run */
+static char   peds_cache_file[512], peds_new_file[512], peds_program[512];
+static pid_t  peds_refresh_pid = 0;    /* background refresh running */
+static time_t peds_refresh_time;
+static int    peds_fadc_dirty = 0;     /* FADCs programmed by a refresh since fadc_setup() */
+static char   fadc_vme_config[512];    /* VME config of the last Download */
+
+/**
+ * Read the pedestal cache file, a missing file is an empty cache
+ * Returns: 0 on success, -1 on failure
+ */
+static int peds_cache_load(const char *path, peds_cache_t *cache)
+{
+  FILE *fp;
+  char line[256];
+  int slot, chan, nacq;
+  double ped, drift;
+  long acquired;
+  peds_channel_t *c;
+
+  memset(cache, 0, sizeof(peds_cache_t));
+
+  fp = fopen(path, "r");
+  if (!fp)
+    return (errno == ENOENT) ? 0 : -1;
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (line[0] == '#') continue;
+    if (sscanf(line, "PEDS_CACHE_CRATE %255s", cache->rocname) == 1) continue;
+    if ((sscanf(line, "%d %d %lf %ld %lf %d", &slot, &chan, &ped, &acquired, &drift, &nacq) == 6) &&
+        (slot >= 0) && (slot < PEDS_MAX_SLOT) && (chan >= 0) && (chan < PEDS_NCHAN))
+    {
+      c = &cache->ch[slot][chan];
+      c->valid = 1;
+      c->ped = ped;
+      c->drift = drift;
+      c->acquired = acquired;
+      c->nacq = nacq;
+    }
+  }
+  fclose(fp);
+
+  return 0;
+}
+
+/**
+ * Write the pedestal cache file (see write_config_if_changed())
+ * Returns: 0 on success, -1 on failure
+ */
+static int peds_cache_save(const char *path, const peds_cache_t *cache)
+{
+  const peds_channel_t *c;
+  char *content = NULL;
+  size_t content_len = 0;
+  FILE *fp;
+  int slot, chan, rval;
+
+  fp = open_memstream(&content, &content_len);
+  if (!fp)
+    return -1;
+
+  fprintf(fp, "# FADC pedestal cache: slot channel pedestal acquired drift nacq\n");
+  fprintf(fp, "PEDS_CACHE_CRATE %s\n", cache->rocname[0] ? cache->rocname : "unknown");
+  for (slot = 0; slot < PEDS_MAX_SLOT; slot++)
+  {
+    for (chan = 0; chan < PEDS_NCHAN; chan++)
+    {
+      c = &cache->ch[slot][chan];
+      if (c->valid)
+        fprintf(fp, "%2d %2d %9.3f %ld %7.3f %d\n", slot, chan, c->ped,
+                (long)c->acquired, c->drift, c->nacq);
+    }
+  }
+  fclose(fp);
+
+  rval = write_config_if_changed(path, content, content_len);
+  free(content);
+
+  return (rval < 0) ? -1 : 0;
+}
+
+/**
+ * Merge a fadc250peds output file acquired at 'when' into the cache.
+ * Slots missing from it are dropped (board removed).
+ * Returns: number of channels merged, -1 on failure
+ */
+static int peds_cache_merge(peds_cache_t *cache, const char *peds_file, time_t when)
+{
+  FILE *fp;
+  char line[1024], keyword[64], name[256];
+  double v[PEDS_NCHAN], d;
+  int seen[PEDS_MAX_SLOT];
+  int slot = -1, nmerged = 0, chan;
+  peds_channel_t *c;
+
+  fp = fopen(peds_file, "r");
+  if (!fp)
+  {
+    printf("ERROR: Cannot open peds file '%s': %s\n", peds_file, strerror(errno));
+    return -1;
+  }
+
+  memset(seen, 0, sizeof(seen));
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (sscanf(line, "%63s", keyword) != 1) continue;
+
+    if (strcmp(keyword, "FADC250_CRATE") == 0)
+    {
+      if ((sscanf(line, "%*s %255s", name) == 1) && (strcmp(name, "end") != 0))
+        strcpy(cache->rocname, name);
+    }
+    else if (strcmp(keyword, "FADC250_SLOT") == 0)
+    {
+      if ((sscanf(line, "%*s %d", &slot) != 1) || (slot < 0) || (slot >= PEDS_MAX_SLOT))
+        slot = -1;
+    }
+    else if ((strcmp(keyword, "FADC250_ALLCH_PED") == 0) && (slot >= 0))
+    {
+      if (sscanf(line, "%*s %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                 &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7],
+                 &v[8], &v[9], &v[10], &v[11], &v[12], &v[13], &v[14], &v[15]) != PEDS_NCHAN)
+        continue;
+
+      seen[slot] = 1;
+      for (chan = 0; chan < PEDS_NCHAN; chan++)
+      {
+        c = &cache->ch[slot][chan];
+        d = v[chan] - c->ped;
+        c->drift = c->valid ? ((d < 0) ? -d : d) : -1;
+        c->ped = v[chan];
+        c->acquired = when;
+        c->nacq++;
+        c->valid = 1;
+        nmerged++;
+      }
+    }
+  }
+  fclose(fp);
+
+  if (nmerged == 0)
+  {
+    printf("ERROR: No pedestals in '%s'\n", peds_file);
+    return -1;
+  }
+
+  for (slot = 0; slot < PEDS_MAX_SLOT; slot++)
+    if (!seen[slot])
+      memset(cache->ch[slot], 0, sizeof(cache->ch[slot]));
+
+  return nmerged;
+}
+
+/**
+ * The cache can stand in for an acquisition at time 'now': every channel
+ * younger than the validity window and settled
+ * Returns: 1 usable, 0 not (reason printed if 'verbose')
+ */
+static int peds_cache_check(const peds_cache_t *cache, time_t now, int verbose)
+{
+  const peds_channel_t *c;
+  int slot, chan, n = 0;
+
+  if (peds_valid <= 0)
+  {
+    if (verbose) printf("INFO: Pedestal cache disabled (FADC250_PEDS_VALID 0)\n");
+    return 0;
+  }
+
+  for (slot = 0; slot < PEDS_MAX_SLOT; slot++)
+  {
+    for (chan = 0; chan < PEDS_NCHAN; chan++)
+    {
+      c = &cache->ch[slot][chan];
+      if (!c->valid) continue;
+      n++;
+      if (now - c->acquired > peds_valid)
+      {
+        if (verbose)
+          printf("INFO: Cached pedestals are %ld s old (FADC250_PEDS_VALID %d)\n",
+                 (long)(now - c->acquired), peds_valid);
+        return 0;
+      }
+      if ((c->drift < 0) || (c->drift > peds_max_drift))
+      {
+        if (verbose)
+          printf("INFO: Slot %d channel %d pedestal not settled (drift %.3f, FADC250_PEDS_MAX_DRIFT %.3f)\n",
+                 slot, chan, c->drift, peds_max_drift);
+        return 0;
+      }
+    }
+  }
+
+  if (n == 0)
+  {
+    if (verbose) printf("INFO: No cached pedestals\n");
+    return 0;
+  }
+
+  return 1;
+}
+
+/**
+ * Write the cached pedestals in the fadc250peds output format
+ * Returns: 0 on success, -1 on failure
+ */
+static int peds_cache_write_peds(const peds_cache_t *cache, const char *peds_file)
+{
+  FILE *fp;
+  int slot, chan;
+
+  fp = fopen(peds_file, "w");
+  if (!fp)
+  {
+    printf("ERROR: Cannot create peds file '%s': %s\n", peds_file, strerror(errno));
+    return -1;
+  }
+
+  fprintf(fp, "FADC250_CRATE %s\n", cache->rocname);
+  for (slot = 0; slot < PEDS_MAX_SLOT; slot++)
+  {
+    if (!cache->ch[slot][0].valid) continue;
+    fprintf(fp, "FADC250_SLOT %d\n", slot);
+    fprintf(fp, "FADC250_ALLCH_PED");
+    for (chan = 0; chan < PEDS_NCHAN; chan++)
+      fprintf(fp, " %8.3f", cache->ch[slot][chan].ped);
+    fprintf(fp, "\n");
+  }
+  fprintf(fp, "FADC250_CRATE end\n");
+  fclose(fp);
+
+  return 0;
+}
+
+/**
+ * Start fadc250peds writing 'out_file', its output to 'log_file' unless NULL
+ * Returns: pid of the child, -1 on failure
+ */
+static pid_t peds_acquire_start(const char *out_file, const char *log_file)
+{
+  char command[1600];
+  pid_t pid;
+
+  if (log_file)
+    snprintf(command, sizeof(command), "%s %s > %s 2>&1", peds_program, out_file, log_file);
+  else
+    snprintf(command, sizeof(command), "%s %s", peds_program, out_file);
+
+  printf("INFO: Executing pedestal generation command:\n");
+  printf("INFO:   %s\n", command);
+
+  /* Execute command using fork/exec for better control */
+  pid = fork();
+  if (pid < 0)
+  {
+    printf("ERROR: fork() failed: %s\n", strerror(errno));
+    return -1;
+  }
+  else if (pid == 0)
+  {
+    /* Child process - own process group, so the shell and fadc250peds
+       can be stopped together (peds_refresh_stop) */
+    setpgid(0, 0);
+    execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+    /* If execl returns, it failed */
+    printf("ERROR: execl() failed: %s\n", strerror(errno));
+    _exit(127);
+  }
+  setpgid(pid, pid);  /* also here, so it is set before a kill */
+
+  return pid;
+}
+
+/**
+ * Wait for a fadc250peds child
+ * Returns: 0 if it succeeded, -1 otherwise
+ */
+static int peds_acquire_wait(pid_t pid)
+{
+  int status;
+
+  if (waitpid(pid, &status, 0) < 0)
+  {
+    printf("ERROR: waitpid() failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  if (WIFEXITED(status))
+  {
+    if (WEXITSTATUS(status) != 0)
+    {
+      printf("ERROR: fadc250peds command failed with exit code %d\n", WEXITSTATUS(status));
+      return -1;
+    }
+    printf("INFO: fadc250peds command completed successfully\n");
+    return 0;
+  }
+  else if (WIFSIGNALED(status))
+  {
+    printf("ERROR: fadc250peds command terminated by signal %d\n", WTERMSIG(status));
+    return -1;
+  }
+
+  printf("ERROR: fadc250peds command terminated abnormally\n");
+  return -1;
+}
+
+/**
+ * End: refresh an aging (older than half the validity window) or
+ * unsettled cache in the background
+ */
+static void peds_refresh_start(void)
+{
+  char log_file[600];
+
+  if (!peds_background || (peds_valid <= 0) || (peds_refresh_pid > 0) || !peds_cache_file[0])
+    return;
+  if (peds_cache_check(&peds_cache, time(NULL) + peds_valid/2, 0))
+    return;
+
+  snprintf(log_file, sizeof(log_file), "%s.log", peds_new_file);
+  peds_refresh_time = time(NULL);
+  peds_refresh_pid = peds_acquire_start(peds_new_file, log_file);
+  if (peds_refresh_pid > 0)
+  {
+    peds_fadc_dirty = 1;
+    printf("INFO: Pedestal refresh running in the background (pid %d)\n", (int)peds_refresh_pid);
+  }
+  else
+    peds_refresh_pid = 0;
+}
+
+/**
+ * Wait for the background refresh, if any, and merge its result
+ */
+static void peds_refresh_reap(void)
+{
+  time_t t0;
+
+  if (peds_refresh_pid <= 0)
+    return;
+
+  t0 = time(NULL);
+  printf("INFO: Waiting for the background pedestal refresh (pid %d)\n", (int)peds_refresh_pid);
+  if ((peds_acquire_wait(peds_refresh_pid) == 0) &&
+      (peds_cache_merge(&peds_cache, peds_new_file, peds_refresh_time) > 0))
+  {
+    peds_cache_save(peds_cache_file, &peds_cache);
+    printf("INFO: Background pedestal refresh merged (waited %ld s)\n", (long)(time(NULL) - t0));
+  }
+  else
+    printf("WARNING: Background pedestal refresh failed, see %s.log\n", peds_new_file);
+
+  peds_refresh_pid = 0;
+}
+
+/**
+ * Stop the background refresh, if any, and discard its result.  Used
+ * before resetting the FADCs, which it may still be programming.
+ */
+static void peds_refresh_stop(void)
+{
+  int status;
+
+  if (peds_refresh_pid <= 0)
+    return;
+
+  printf("INFO: Stopping the background pedestal refresh (pid %d)\n", (int)peds_refresh_pid);
+  if ((kill(-peds_refresh_pid, SIGTERM) < 0) && (errno != ESRCH))
+    printf("ERROR: kill() failed: %s\n", strerror(errno));
+  if (waitpid(peds_refresh_pid, &status, 0) < 0)
+    printf("ERROR: waitpid() failed: %s\n", strerror(errno));
+
+  unlink(peds_new_file);
+  peds_refresh_pid = 0;
+  peds_fadc_dirty = 1;
+}
+
+/**
+ * End: with FADC250_PEDS_RAW, merge the pedestals of the raw mode readout
+ * of the run into the cache.  The next Download uses them like the ones of
+ * fadc250peds, and End does not refresh a cache they keep valid.
+ */
+static void peds_raw_update(void)
+{
+  FILE *fp;
+  int nslot, rval;
+
+  if (!peds_raw || !peds_new_file[0])
+    return;
+
+  nslot = fadcPedsComplete(&fadc_peds);
+  if (nslot == 0)
+  {
+    printf("INFO: Raw mode pedestals not complete (%llu windows, %llu errors), cache not updated\n",
+           (unsigned long long)fadc_peds.windows, (unsigned long long)fadc_peds.errors);
+    return;
+  }
+
+  fp = fopen(peds_new_file, "w");
+  if (!fp)
+  {
+    printf("ERROR: Cannot create peds file '%s': %s\n", peds_new_file, strerror(errno));
+    return;
+  }
+  rval = fadcPedsWrite(&fadc_peds, fp, peds_cache.rocname[0] ? peds_cache.rocname : "unknown");
+  fclose(fp);
+
+  if ((rval == OK) && (peds_cache_merge(&peds_cache, peds_new_file, time(NULL)) > 0))
+  {
+    peds_cache_save(peds_cache_file, &peds_cache);
+    printf("INFO: Raw mode pedestals of %d FADCs (%llu windows) merged into %s\n",
+           nslot, (unsigned long long)fadc_peds.windows, peds_cache_file);
+  }
+}
+
 /**
  * Generate vme_<rocname>.cnf configuration file
  * Uses parsed user config parameters and appends peds.txt content
@@ -525,8 +1101,10 @@ static int generate_vme_config(const char *config_dir, const char *rocname,
   char vme_config_path[512];
   FILE *out_fp, *peds_fp;
   char line[1024];
+  char *content = NULL;
+  size_t content_len = 0;
   int line_count = 0;
-  int i;
+  int i, rval;
 
   if (!config_dir || !rocname || !peds_file || !params) return -1;
 
@@ -536,8 +1114,8 @@ static int generate_vme_config(const char *config_dir, const char *rocname,
   printf("INFO: Generating VME config file: %s\n", vme_config_path);
   printf("INFO: Using parameters from user config\n");
 
-  /* Open output file */
-  out_fp = fopen(vme_config_path, "w");
+  /* Build the content in memory, see write_config_if_changed() */
+  out_fp = open_memstream(&content, &content_len);
   if (!out_fp)
   {
     printf("ERROR: Cannot create VME config file '%s': %s\n", vme_config_path, strerror(errno));
@@ -623,6 +1201,7 @@ static int generate_vme_config(const char *config_dir, const char *rocname,
   {
     printf("ERROR: Cannot open peds file '%s' for appending to VME config: %s\n", peds_file, strerror(errno));
     fclose(out_fp);
+    free(content);
     return -1;
   }
 
@@ -635,6 +1214,11 @@ static int generate_vme_config(const char *config_dir, const char *rocname,
 
   fclose(out_fp);
 
+  rval = write_config_if_changed(vme_config_path, content, content_len);
+  free(content);
+  if (rval < 0)
+    return -1;
+
   printf("INFO: Successfully created VME config file '%s' (%d lines from peds appended)\n",
          vme_config_path, line_count);
   return 0;
@@ -744,7 +1328,9 @@ static int generate_vtp_config(const char *config_dir, const char *rocname,
   int active_slots[20];  /* Max 20 slots */
   int num_active_slots;
   int payload_enable[16]; /* 16 payloads */
-  int i, slot, payload;
+  int i, slot, payload, rval;
+  char *content = NULL;
+  size_t content_len = 0;
 
   if (!config_dir || !rocname || !peds_file) return -1;
 
@@ -790,8 +1376,8 @@ static int generate_vtp_config(const char *config_dir, const char *rocname,
 
   printf("INFO: Generating VTP config file: %s\n", vtp_config_path);
 
-  /* Open output file */
-  out_fp = fopen(vtp_config_path, "w");
+  /* Build the content in memory, see write_config_if_changed() */
+  out_fp = open_memstream(&content, &content_len);
   if (!out_fp)
   {
     printf("ERROR: Cannot create VTP config file '%s': %s\n", vtp_config_path, strerror(errno));
@@ -887,6 +1473,11 @@ static int generate_vtp_config(const char *config_dir, const char *rocname,
 
   fclose(out_fp);
 
+  rval = write_config_if_changed(vtp_config_path, content, content_len);
+  free(content);
+  if (rval < 0)
+    return -1;
+
   printf("INFO: Successfully created VTP config file '%s'\n", vtp_config_path);
   return 0;
 }
@@ -922,6 +1513,111 @@ static void strip_trailing_vtp(const char *rocname, char *out, size_t outsize)
   }
 }
 
+/**
+ * Initialize and program the FADCs from the generated VME config file
+ */
+static void fadc_setup(const char *vme_config)
+{
+  int stat, ifa;
+  unsigned short iflag;
+
+#ifndef FADC_VXS  
+  /* Init FADC Library and modules here id using a SDC board in a non-VXS crate */
+  iflag = 0xea00; /* SDC Board address A16 */
+  iflag |= FA_INIT_EXT_SYNCRESET;  /* Front panel sync-reset */
+  iflag |= FA_INIT_FP_TRIG;  /* Front Panel Input trigger source */
+  iflag |= FA_INIT_FP_CLKSRC;  /* Internal 250MHz Clock source */
+#else
+  /* If this is in a VXS crate Get CLK, TRIG, and Sync Reset from VXS */
+  iflag = 0x25;
+#endif
+
+  /* Initialize FADC library */
+  fadcA32Base = 0x09000000;
+  vmeSetQuietFlag(0);
+  faInit(FADC_ADDR, FADC_INCR, NFADC, (iflag|FA_INIT_SKIP_FIRMWARE_CHECK));
+  vmeSetQuietFlag(1);
+
+  /* create a slot mask */
+  for(ifa=0; ifa < nfadc; ifa++) {
+    fadcmask |= (1<<faSlot(ifa));
+  }
+
+#ifdef FADC_USE_CONFIG_FILE
+  /* Read in the GENERATED FADC250 Config file (NOT rol->usrConfig) */
+  printf("INFO: ============================================\n");
+  printf("INFO: PHASE 4: Configure FADC using generated VME config\n");
+  printf("INFO: ============================================\n");
+  printf("INFO: Using generated VME config file: %s\n", vme_config);
+  stat = fadc250Config(vme_config);
+  if(stat<0) {
+    printf("ERROR: Reading FADC250 Config file '%s' FAILED\n", vme_config);
+  }else{
+    printf("INFO: Successfully loaded FADC250 Config from generated file\n");
+  }
+
+  /* Enable Bus Error and SyncReset for readout */
+  for(ifa=0; ifa < nfadc; ifa++) {
+    faSoftReset(faSlot(ifa),0);
+    faResetTriggerCount(faSlot(ifa));
+    faEnableSyncReset(faSlot(ifa));
+    faEnableBusError(faSlot(ifa));
+  }
+
+#else
+  /* Program/Init VME Modules Here */
+  for(ifa=0; ifa < nfadc; ifa++) 
+    {
+
+      faSoftReset(faSlot(ifa),0);
+      faResetTriggerCount(faSlot(ifa));
+
+      faEnableSyncReset(faSlot(ifa));
+
+      faEnableBusError(faSlot(ifa));
+
+      /* Set input DAC level - 3250 basically corresponds to 0 shift in the baseline. */
+      faSetDAC(faSlot(ifa), 3250, 0);
+
+      /*  Set All channel thresholds the same */
+      faSetThreshold(faSlot(ifa), FADC_THRESHOLD, 0xffff);
+  
+      /*********************************************************************************
+       * faSetProcMode(int id, int pmode, unsigned int PL, unsigned int PTW, 
+       *    int NSB, unsigned int NSA, unsigned int NP, 
+       *    unsigned int NPED, unsigned int MAXPED, unsigned int NSAT);
+       *
+       *  id    : fADC250 Slot number
+       *  pmode : Processing Mode
+       *          9 - Pulse Parameter (ped, sum, time)
+       *         10 - Debug Mode (9 + Raw Samples)
+       *    PL : Window Latency
+       *   PTW : Window Width
+
+       *   NSB : Number of samples before pulse over threshold
+       *   NSA : Number of samples after pulse over threshold
+       *    NP : Number of pulses processed per window
+       *  BANK : (Hall B option - replaces NPED,MAXPED,NSAT)
+       *  NPED : Number of samples to sum for pedestal (4)
+       *MAXPED : Maximum value of sample to be included in pedestal sum (250)
+       *  NSAT : Number of consecutive samples over threshold for valid pulse (2)
+       */
+      faSetProcMode(faSlot(ifa),
+		    FADC_MODE,   /* Processing Mode */
+		    FADC_WINDOW_LAT, /* PL */
+		    FADC_WINDOW_WIDTH,  /* PTW */
+		    5,   /* NSB */
+		    20,  /* NSA */
+		    1,   /* NP */
+		    0    /* BANK */
+		    );
+
+    }
+#endif
+
+  peds_fadc_dirty = 0;
+}
+
 /****************************************
  *  DOWNLOAD
  ****************************************/
@@ -930,8 +1626,6 @@ rocDownload()
 {
   int stat;
   unsigned int ival = SYNC_INTERVAL;
-  unsigned short iflag;
-  int ifa;
   char generated_vme_config[512];  /* Path to generated VME config file */
   char generated_vtp_config[512];  /* Path to generated VTP config file (for reading) */
 
@@ -945,10 +1639,7 @@ rocDownload()
     char hostname[256];
     char peds_file[512];
     char rocname[256];
-    char command[1024];
     const char *coda_env, *coda_data_env, *coda_config_env;
-    pid_t pid;
-    int status;
     user_config_params_t config_params;
 
     printf("INFO: ============================================\n");
@@ -1011,61 +1702,42 @@ rocDownload()
 
     /* Build paths */
     snprintf(peds_file, sizeof(peds_file), "%s/%s_peds.txt", coda_data_env, hostname);
-    snprintf(command, sizeof(command), "%s/linuxvme/fadc-peds/fadc250peds %s",
-             coda_env, peds_file);
-
-    printf("INFO: Executing pedestal generation command:\n");
-    printf("INFO:   %s\n", command);
-
-    /* Execute command using fork/exec for better control */
-    pid = fork();
-    if (pid < 0)
+    snprintf(peds_cache_file, sizeof(peds_cache_file), "%s/%s_peds.cache", coda_data_env, hostname);
+    snprintf(peds_new_file, sizeof(peds_new_file), "%s/%s_peds.new", coda_data_env, hostname);
+    snprintf(peds_program, sizeof(peds_program), "%s/linuxvme/fadc-peds/fadc250peds", coda_env);
+    peds_valid = config_params.peds_valid;
+    peds_max_drift = config_params.peds_max_drift;
+    peds_background = config_params.peds_background;
+    peds_raw = config_params.peds_raw;
+    fadcPedsInit(&fadc_peds, config_params.peds_max_spread, FADC_PEDS_DEF_MIN_WINDOWS);
+
+    /* A refresh started at End must be done with the FADCs */
+    peds_refresh_reap();
+
+    if (peds_cache_load(peds_cache_file, &peds_cache) != 0)
     {
-      printf("ERROR: rocDownload - fork() failed: %s\n", strerror(errno));
-      printf("ERROR: rocDownload - DOWNLOAD TRANSITION FAILED\n");
-      return;
+      printf("WARNING: Cannot read pedestal cache '%s': %s\n", peds_cache_file, strerror(errno));
+      memset(&peds_cache, 0, sizeof(peds_cache));
     }
-    else if (pid == 0)
+
+    if (peds_cache_check(&peds_cache, time(NULL), 1) &&
+        (peds_cache_write_peds(&peds_cache, peds_file) == 0))
     {
-      /* Child process - execute command */
-      execl("/bin/sh", "sh", "-c", command, (char *)NULL);
-      /* If execl returns, it failed */
-      printf("ERROR: rocDownload - execl() failed: %s\n", strerror(errno));
-      _exit(127);
+      printf("INFO: Using cached pedestals from %s, fadc250peds skipped\n", peds_cache_file);
     }
     else
     {
-      /* Parent process - wait for child */
-      if (waitpid(pid, &status, 0) < 0)
-      {
-        printf("ERROR: rocDownload - waitpid() failed: %s\n", strerror(errno));
-        printf("ERROR: rocDownload - DOWNLOAD TRANSITION FAILED\n");
-        return;
-      }
+      time_t when = time(NULL);
+      pid_t pid = peds_acquire_start(peds_file, NULL);
 
-      if (WIFEXITED(status))
+      if ((pid < 0) || (peds_acquire_wait(pid) != 0))
       {
-        int exit_code = WEXITSTATUS(status);
-        if (exit_code != 0)
-        {
-          printf("ERROR: rocDownload - fadc250peds command failed with exit code %d\n", exit_code);
-          printf("ERROR: rocDownload - DOWNLOAD TRANSITION FAILED\n");
-          return;
-        }
-        printf("INFO: fadc250peds command completed successfully\n");
-      }
-      else if (WIFSIGNALED(status))
-      {
-        printf("ERROR: rocDownload - fadc250peds command terminated by signal %d\n", WTERMSIG(status));
-        printf("ERROR: rocDownload - DOWNLOAD TRANSITION FAILED\n");
-        return;
-      }
-      else
-      {
-        printf("ERROR: rocDownload - fadc250peds command terminated abnormally\n");
         printf("ERROR: rocDownload - DOWNLOAD TRANSITION FAILED\n");
         return;
       }
+
+      if (peds_cache_merge(&peds_cache, peds_file, when) > 0)
+        peds_cache_save(peds_cache_file, &peds_cache);
     }
 
     /* Verify peds file exists */
@@ -1202,100 +1874,8 @@ rocDownload()
 
 
   /* Do FADC Programming in Download to support Streaming when the TI is is master mode */
-
-#ifndef FADC_VXS  
-  /* Init FADC Library and modules here id using a SDC board in a non-VXS crate */
-  iflag = 0xea00; /* SDC Board address A16 */
-  iflag |= FA_INIT_EXT_SYNCRESET;  /* Front panel sync-reset */
-  iflag |= FA_INIT_FP_TRIG;  /* Front Panel Input trigger source */
-  iflag |= FA_INIT_FP_CLKSRC;  /* Internal 250MHz Clock source */
-#else
-  /* If this is in a VXS crate Get CLK, TRIG, and Sync Reset from VXS */
-  iflag = 0x25;
-#endif
-
-  /* Initialize FADC library */
-  fadcA32Base = 0x09000000;
-  vmeSetQuietFlag(0);
-  faInit(FADC_ADDR, FADC_INCR, NFADC, (iflag|FA_INIT_SKIP_FIRMWARE_CHECK));
-  vmeSetQuietFlag(1);
-
-  /* create a slot mask */
-  for(ifa=0; ifa < nfadc; ifa++) {
-    fadcmask |= (1<<faSlot(ifa));
-  }
-
-#ifdef FADC_USE_CONFIG_FILE
-  /* Read in the GENERATED FADC250 Config file (NOT rol->usrConfig) */
-  printf("INFO: ============================================\n");
-  printf("INFO: PHASE 4: Configure FADC using generated VME config\n");
-  printf("INFO: ============================================\n");
-  printf("INFO: Using generated VME config file: %s\n", generated_vme_config);
-  stat = fadc250Config(generated_vme_config);
-  if(stat<0) {
-    printf("ERROR: Reading FADC250 Config file '%s' FAILED\n", generated_vme_config);
-  }else{
-    printf("INFO: Successfully loaded FADC250 Config from generated file\n");
-  }
-
-  /* Enable Bus Error and SyncReset for readout */
-  for(ifa=0; ifa < nfadc; ifa++) {
-    faSoftReset(faSlot(ifa),0);
-    faResetTriggerCount(faSlot(ifa));
-    faEnableSyncReset(faSlot(ifa));
-    faEnableBusError(faSlot(ifa));
-  }
-
-#else
-  /* Program/Init VME Modules Here */
-  for(ifa=0; ifa < nfadc; ifa++) 
-    {
-
-      faSoftReset(faSlot(ifa),0);
-      faResetTriggerCount(faSlot(ifa));
-
-      faEnableSyncReset(faSlot(ifa));
-
-      faEnableBusError(faSlot(ifa));
-
-      /* Set input DAC level - 3250 basically corresponds to 0 shift in the baseline. */
-      faSetDAC(faSlot(ifa), 3250, 0);
-
-      /*  Set All channel thresholds the same */
-      faSetThreshold(faSlot(ifa), FADC_THRESHOLD, 0xffff);
-  
-      /*********************************************************************************
-       * faSetProcMode(int id, int pmode, unsigned int PL, unsigned int PTW, 
-       *    int NSB, unsigned int NSA, unsigned int NP, 
-       *    unsigned int NPED, unsigned int MAXPED, unsigned int NSAT);
-       *
-       *  id    : fADC250 Slot number
-       *  pmode : Processing Mode
-       *          9 - Pulse Parameter (ped, sum, time)
-       *         10 - Debug Mode (9 + Raw Samples)
-       *    PL : Window Latency
-       *   PTW : Window Width
-
-       *   NSB : Number of samples before pulse over threshold
-       *   NSA : Number of samples after pulse over threshold
-       *    NP : Number of pulses processed per window
-       *  BANK : (Hall B option - replaces NPED,MAXPED,NSAT)
-       *  NPED : Number of samples to sum for pedestal (4)
-       *MAXPED : Maximum value of sample to be included in pedestal sum (250)
-       *  NSAT : Number of consecutive samples over threshold for valid pulse (2)
-       */
-      faSetProcMode(faSlot(ifa),
-		    FADC_MODE,   /* Processing Mode */
-		    FADC_WINDOW_LAT, /* PL */
-		    FADC_WINDOW_WIDTH,  /* PTW */
-		    5,   /* NSB */
-		    20,  /* NSA */
-		    1,   /* NP */
-		    0    /* BANK */
-		    );
-
-    }
-#endif
+  snprintf(fadc_vme_config, sizeof(fadc_vme_config), "%s", generated_vme_config);
+  fadc_setup(fadc_vme_config);
 
   /* Read in the generated VTP config file */
   printf("INFO: ============================================\n");
@@ -1334,6 +1914,14 @@ rocPrestart()
   int islot;
   unsigned int ival = SYNC_INTERVAL;
 
+  /* A pedestal refresh ran since End: wait for it and restore the FADC
+     settings of the last Download (its pedestals stay in effect) */
+  if (peds_fadc_dirty)
+    {
+      peds_refresh_reap();
+      fadc_setup(fadc_vme_config);
+    }
+
   /* Unlock the VME Mutex */
   vmeBusUnlock();
 
@@ -1394,6 +1982,10 @@ rocGo()
     /* MAXFADCWORDS = 2 + 4 + blockLevel * (8 + FADC_WINDOW_WIDTH/2); */
     MAXFADCWORDS = 2000;
   
+  /* Pedestals of this run, from the raw mode readout */
+  if (peds_raw)
+    fadcPedsReset(&fadc_peds);
+
   /*  Enable FADC */
   faGEnable(0, 0);
 
@@ -1438,6 +2030,10 @@ rocEnd()
   //tiStatus(0);
 
   printf("rocEnd: Ended after %d blocks\n",tiGetIntCount());
+
+  /* Refresh aging pedestals while the run is stopped */
+  peds_raw_update();
+  peds_refresh_start();
   
 }
 
@@ -1498,6 +2094,8 @@ rocTrigger(int arg)
 	    } 
 	  else 
 	    {
+	      if(peds_raw && (nwords > 0))
+		fadcPedsAddBlock(&fadc_peds, (const uint32_t *)dma_dabufp, nwords);
 	      dma_dabufp += nwords;
 	    }
 	}
@@ -1525,7 +2123,10 @@ rocCleanup()
   int islot=0;
 
   printf("%s: Reset all Modules\n",__FUNCTION__);
-  
+
+  /* A background pedestal refresh may still be programming the FADCs */
+  peds_refresh_stop();
+
   /* Reset the FADCs */
   faGReset(1);
 
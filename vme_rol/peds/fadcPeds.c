@@ -0,0 +1,369 @@
+/*----------------------------------------------------------------------------*
+ *  Copyright (c) 2016        Southeastern Universities Research Association, *
+ *                            Thomas Jefferson National Accelerator Facility  *
+ *                                                                            *
+ *    This software was developed under a United States Government license    *
+ *    described in the NOTICE file included as part of this distribution.     *
+ *                                                                            *
+ *----------------------------------------------------------------------------*
+ *
+ * Description:
+ *     FADC250 pedestal engine (see fadcPeds.h).
+ *
+ *     FADC250 data words: bit 31 set starts a data type (bits 30-27),
+ *     0: block header (slot in bits 26-22), 1: block trailer, 4: window
+ *     raw data (channel in bits 26-23, window width in samples in bits
+ *     11-0), followed by width/2 (rounded up) words of two samples each:
+ *     bits 28-16 and 12-0, bits 29 and 13 flag a sample not valid.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include "fadcPeds.h"
+
+#define FA_DATA_TYPE_DEFINE   0x80000000
+#define FA_DATA_TYPE(w)       (((w) >> 27) & 0xF)
+#define FA_DATA_BLOCK_HEADER  0
+#define FA_DATA_BLOCK_TRAILER 1
+#define FA_DATA_WINDOW_RAW    4
+#define FA_SAMPLE_MASK        0x1FFF
+
+#define PEDS_VEC_WORDS        (FADC_PEDS_VEC_BYTES/4)
+/* Iterations before the 32 bit sum of squares lanes are flushed:
+   16 x 2 x 0x1FFF^2 < 2^32 */
+#define PEDS_VEC_CHUNK        16
+
+typedef uint32_t peds_vec __attribute__((vector_size(FADC_PEDS_VEC_BYTES)));
+
+static inline uint32_t
+pedsSwap(uint32_t w)
+{
+  return __builtin_bswap32(w);
+}
+
+#define PEDS_SWAP_VEC(x) \
+  (((x) >> 24) | (((x) >> 8) & 0xFF00) | (((x) << 8) & 0xFF0000) | ((x) << 24))
+
+/* Scalar reference of fadcPedsWindow(), and its tail */
+static void
+pedsWindowTail(const uint32_t *w, int nwords, int swap, FADC_PEDS_WSTAT *st)
+{
+  uint32_t x, s[2];
+  int i, k;
+
+  for(i=0; i<nwords; i++)
+    {
+      x = swap ? pedsSwap(w[i]) : w[i];
+      st->bad |= x;
+      s[0] = (x & 0x20000000) ? 0xFFFFFFFF : ((x >> 16) & FA_SAMPLE_MASK);
+      s[1] = (x & 0x2000)     ? 0xFFFFFFFF : (x & FA_SAMPLE_MASK);
+      for(k=0; k<2; k++)
+	{
+	  if(s[k] == 0xFFFFFFFF)
+	    continue;
+	  st->n++;
+	  st->sum   += s[k];
+	  st->sumsq += s[k]*s[k];
+	  if(s[k] < st->min) st->min = s[k];
+	  if(s[k] > st->max) st->max = s[k];
+	}
+    }
+}
+
+void
+fadcPedsWindowRef(const uint32_t *w, int nwords, int swap, FADC_PEDS_WSTAT *st)
+{
+  memset(st, 0, sizeof(FADC_PEDS_WSTAT));
+  st->min = FA_SAMPLE_MASK;
+  pedsWindowTail(w, nwords, swap, st);
+}
+
+void
+fadcPedsWindow(const uint32_t *w, int nwords, int swap, FADC_PEDS_WSTAT *st)
+{
+  peds_vec x, hi, lo, ih, il, m;
+  peds_vec vn = {0}, vsum = {0}, vsq = {0}, vmax = {0}, vor = {0}, vmin;
+  int i = 0, k, l;
+
+  memset(st, 0, sizeof(FADC_PEDS_WSTAT));
+  vmin = vn + FA_SAMPLE_MASK;
+
+  while(i + PEDS_VEC_WORDS <= nwords)
+    {
+      for(k=0; (k < PEDS_VEC_CHUNK) && (i + PEDS_VEC_WORDS <= nwords); k++, i += PEDS_VEC_WORDS)
+	{
+	  memcpy(&x, &w[i], sizeof(x));
+	  if(swap)
+	    x = PEDS_SWAP_VEC(x);
+	  vor |= x;
+
+	  /* Not valid samples: 0 for the sums and max, 0x1FFF for min */
+	  ih = (x >> 29) & 1;
+	  il = (x >> 13) & 1;
+	  hi = (x >> 16) & FA_SAMPLE_MASK & (ih - 1);
+	  lo = x & FA_SAMPLE_MASK & (il - 1);
+
+	  vn   += 2 - ih - il;
+	  vsum += hi + lo;
+	  vsq  += hi*hi + lo*lo;
+
+	  m    = (peds_vec)(hi > vmax);
+	  vmax = (hi & m) | (vmax & ~m);
+	  m    = (peds_vec)(lo > vmax);
+	  vmax = (lo & m) | (vmax & ~m);
+
+	  hi  |= FA_SAMPLE_MASK & -ih;
+	  lo  |= FA_SAMPLE_MASK & -il;
+	  m    = (peds_vec)(hi < vmin);
+	  vmin = (hi & m) | (vmin & ~m);
+	  m    = (peds_vec)(lo < vmin);
+	  vmin = (lo & m) | (vmin & ~m);
+	}
+
+      for(l=0; l<PEDS_VEC_WORDS; l++)
+	st->sumsq += vsq[l];
+      vsq = vsq ^ vsq;
+    }
+
+  for(l=0; l<PEDS_VEC_WORDS; l++)
+    {
+      st->n   += vn[l];
+      st->sum += vsum[l];
+      st->bad |= vor[l];
+    }
+  st->min = FA_SAMPLE_MASK;
+  for(l=0; l<PEDS_VEC_WORDS; l++)
+    {
+      if(vmin[l] < st->min) st->min = vmin[l];
+      if(vmax[l] > st->max) st->max = vmax[l];
+    }
+
+  pedsWindowTail(&w[i], nwords - i, swap, st);
+}
+
+void
+fadcPedsInit(FADC_PEDS *p, int max_spread, int min_windows)
+{
+  memset(p, 0, sizeof(FADC_PEDS));
+  p->max_spread  = (max_spread > 0) ? max_spread : FADC_PEDS_DEF_MAX_SPREAD;
+  p->min_windows = (min_windows > 0) ? min_windows : FADC_PEDS_DEF_MIN_WINDOWS;
+}
+
+/* Clear the accumulators, keep the settings */
+void
+fadcPedsReset(FADC_PEDS *p)
+{
+  fadcPedsInit(p, p->max_spread, p->min_windows);
+}
+
+/**
+ * Accumulate the raw windows of a faReadBlock() block (one or more slots)
+ * Returns: windows accumulated, ERROR if the block is not FADC250 data
+ */
+int
+fadcPedsAddBlock(FADC_PEDS *p, const uint32_t *data, int nwords)
+{
+  FADC_PEDS_WSTAT st;
+  FADC_PEDS_ACC *a;
+  uint32_t w;
+  int i, n, swap, slot = -1, nwin = 0;
+
+  if((p == NULL) || (data == NULL) || (nwords <= 0))
+    return ERROR;
+
+  /* Starts with a block header, in host or VME (big endian) order */
+  if((data[0] & 0xF8000000) == FA_DATA_TYPE_DEFINE)
+    swap = 0;
+  else if((pedsSwap(data[0]) & 0xF8000000) == FA_DATA_TYPE_DEFINE)
+    swap = 1;
+  else
+    {
+      p->errors++;
+      return ERROR;
+    }
+
+  for(i=0; i<nwords; i++)
+    {
+      w = swap ? pedsSwap(data[i]) : data[i];
+      if(!(w & FA_DATA_TYPE_DEFINE))
+	continue;
+
+      switch(FA_DATA_TYPE(w))
+	{
+	case FA_DATA_BLOCK_HEADER:
+	  slot = (w >> 22) & 0x1F;
+	  if(slot >= FADC_PEDS_MAX_SLOT)
+	    {
+	      p->errors++;
+	      slot = -1;
+	      break;
+	    }
+	  p->slotmask |= 1 << slot;
+	  p->blocks++;
+	  break;
+
+	case FA_DATA_BLOCK_TRAILER:
+	  slot = -1;
+	  break;
+
+	case FA_DATA_WINDOW_RAW:
+	  n = ((w & 0xFFF) + 1)/2;
+	  if((slot < 0) || (i + 1 + n > nwords))
+	    {
+	      p->errors++;
+	      break;
+	    }
+	  fadcPedsWindow(&data[i+1], n, swap, &st);
+	  /* Window cut short: resync on the next data type word */
+	  if(st.bad & FA_DATA_TYPE_DEFINE)
+	    {
+	      p->errors++;
+	      break;
+	    }
+	  i += n;
+	  if(st.n == 0)
+	    break;
+
+	  a = &p->acc[slot][(w >> 23) & 0xF];
+	  a->windows++;
+	  a->samples += st.n;
+	  a->sum     += st.sum;
+	  a->sumsq   += st.sumsq;
+	  if((int)(st.max - st.min) <= p->max_spread)
+	    {
+	      a->cwindows++;
+	      a->csamples += st.n;
+	      a->csum     += st.sum;
+	      a->csumsq   += st.sumsq;
+	    }
+	  nwin++;
+	  break;
+
+	default:
+	  break;
+	}
+    }
+  p->windows += nwin;
+
+  return nwin;
+}
+
+static void
+pedsMoments(uint64_t n, uint64_t sum, uint64_t sumsq, double *mean, double *rms)
+{
+  double var;
+
+  *mean = *rms = 0;
+  if(n == 0)
+    return;
+  *mean = (double)sum/n;
+  var   = (double)sumsq/n - (*mean)*(*mean);
+  *rms  = (var > 0) ? sqrt(var) : 0;
+}
+
+/**
+ * Pedestal of a slot and channel
+ * Returns: OK if valid, ERROR otherwise (r is filled in anyway)
+ */
+int
+fadcPedsResult(const FADC_PEDS *p, int slot, int chan, FADC_PEDS_RESULT *r)
+{
+  const FADC_PEDS_ACC *a;
+
+  memset(r, 0, sizeof(FADC_PEDS_RESULT));
+  if((slot < 0) || (slot >= FADC_PEDS_MAX_SLOT) || (chan < 0) || (chan >= FADC_PEDS_NCHAN))
+    return ERROR;
+
+  a = &p->acc[slot][chan];
+  pedsMoments(a->samples, a->sum, a->sumsq, &r->mean, &r->rms);
+  pedsMoments(a->csamples, a->csum, a->csumsq, &r->ped, &r->ped_rms);
+  r->windows  = a->windows;
+  r->cwindows = a->cwindows;
+  r->valid    = (a->cwindows >= (uint64_t)p->min_windows);
+
+  return r->valid ? OK : ERROR;
+}
+
+/**
+ * Returns: number of slots seen, 0 if none or if a channel of one of them
+ *          has no valid pedestal
+ */
+int
+fadcPedsComplete(const FADC_PEDS *p)
+{
+  FADC_PEDS_RESULT r;
+  int slot, chan, n = 0;
+
+  for(slot=0; slot<FADC_PEDS_MAX_SLOT; slot++)
+    {
+      if(!(p->slotmask & (1 << slot)))
+	continue;
+      for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+	if(fadcPedsResult(p, slot, chan, &r) != OK)
+	  return 0;
+      n++;
+    }
+
+  return n;
+}
+
+/**
+ * Write the pedestals in the fadc250peds output format
+ * Returns: OK, ERROR if they are not complete
+ */
+int
+fadcPedsWrite(const FADC_PEDS *p, FILE *f, const char *crate)
+{
+  FADC_PEDS_RESULT r;
+  int slot, chan;
+
+  if(fadcPedsComplete(p) == 0)
+    return ERROR;
+
+  fprintf(f, "FADC250_CRATE %s\n", crate);
+  for(slot=0; slot<FADC_PEDS_MAX_SLOT; slot++)
+    {
+      if(!(p->slotmask & (1 << slot)))
+	continue;
+      fprintf(f, "FADC250_SLOT %d\n", slot);
+      fprintf(f, "FADC250_ALLCH_PED");
+      for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+	{
+	  fadcPedsResult(p, slot, chan, &r);
+	  fprintf(f, " %8.3f", r.ped);
+	}
+      fprintf(f, "\n");
+    }
+  fprintf(f, "FADC250_CRATE end\n");
+
+  return OK;
+}
+
+void
+fadcPedsPrint(const FADC_PEDS *p)
+{
+  FADC_PEDS_RESULT r;
+  int slot, chan;
+
+  printf("FADC pedestals: %llu blocks, %llu windows, %llu errors, max spread %d, min windows %d\n",
+	 (unsigned long long)p->blocks, (unsigned long long)p->windows,
+	 (unsigned long long)p->errors, p->max_spread, p->min_windows);
+  printf("  slot chan      ped  ped_rms     mean      rms   windows  rejected\n");
+  for(slot=0; slot<FADC_PEDS_MAX_SLOT; slot++)
+    {
+      if(!(p->slotmask & (1 << slot)))
+	continue;
+      for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+	{
+	  fadcPedsResult(p, slot, chan, &r);
+	  printf("  %4d %4d %8.3f %8.3f %8.3f %8.3f %9llu %8.2f%%%s\n", slot, chan,
+		 r.ped, r.ped_rms, r.mean, r.rms, (unsigned long long)r.windows,
+		 r.windows ? 100.0*(r.windows - r.cwindows)/r.windows : 0.0,
+		 r.valid ? "" : "  NOT VALID");
+	}
+    }
+}
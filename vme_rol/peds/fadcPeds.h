@@ -0,0 +1,89 @@
+#ifndef FADCPEDS_H
+#define FADCPEDS_H
+/*----------------------------------------------------------------------------*
+ *  Copyright (c) 2016        Southeastern Universities Research Association, *
+ *                            Thomas Jefferson National Accelerator Facility  *
+ *                                                                            *
+ *    This software was developed under a United States Government license    *
+ *    described in the NOTICE file included as part of this distribution.     *
+ *                                                                            *
+ *----------------------------------------------------------------------------*
+ *
+ * Description:
+ *     FADC250 pedestal engine.  Takes the blocks of the raw mode readout
+ *     (faReadBlock() output, window raw data words, either byte order) and
+ *     accumulates per slot and channel the mean and RMS of all the samples,
+ *     and of the samples of the windows without a pulse (outlier rejected
+ *     baseline: window max - min <= 'max_spread').  Needs neither the FADC
+ *     library nor the hardware, so it runs as well on recorded blocks.
+ *
+ *     The window kernel uses the GCC vector extensions, FADC_PEDS_VEC_BYTES
+ *     wide (default 16: one SSE2 / NEON register; 32 needs AVX2, build with
+ *     -march=native).
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+#ifndef OK
+#define OK 0
+#endif
+
+#ifndef FADC_PEDS_VEC_BYTES
+#define FADC_PEDS_VEC_BYTES        16
+#endif
+
+#define FADC_PEDS_MAX_SLOT         21
+#define FADC_PEDS_NCHAN            16
+#define FADC_PEDS_DEF_MAX_SPREAD   32     /* ADC counts */
+#define FADC_PEDS_DEF_MIN_WINDOWS  100    /* clean windows for a valid pedestal */
+
+/* One raw window */
+typedef struct
+{
+  uint32_t n;                           /* valid samples */
+  uint32_t min, max;
+  uint64_t sum, sumsq;
+  uint32_t bad;                         /* OR of the words: bit 31 = not a window word */
+} FADC_PEDS_WSTAT;
+
+typedef struct
+{
+  uint64_t windows, samples, sum, sumsq;      /* all windows */
+  uint64_t cwindows, csamples, csum, csumsq;  /* windows passing the spread cut */
+} FADC_PEDS_ACC;
+
+typedef struct
+{
+  int      valid;                       /* 'min_windows' clean windows */
+  double   mean, rms;                   /* all samples */
+  double   ped, ped_rms;                /* outlier rejected */
+  uint64_t windows, cwindows;
+} FADC_PEDS_RESULT;
+
+typedef struct
+{
+  int      max_spread;
+  int      min_windows;
+  uint32_t slotmask;                    /* slots seen */
+  uint64_t blocks, windows, errors;
+  FADC_PEDS_ACC acc[FADC_PEDS_MAX_SLOT][FADC_PEDS_NCHAN];
+} FADC_PEDS;
+
+void fadcPedsInit(FADC_PEDS *p, int max_spread, int min_windows);
+void fadcPedsReset(FADC_PEDS *p);
+int  fadcPedsAddBlock(FADC_PEDS *p, const uint32_t *data, int nwords);
+int  fadcPedsResult(const FADC_PEDS *p, int slot, int chan, FADC_PEDS_RESULT *r);
+int  fadcPedsComplete(const FADC_PEDS *p);
+int  fadcPedsWrite(const FADC_PEDS *p, FILE *f, const char *crate);
+void fadcPedsPrint(const FADC_PEDS *p);
+
+/* Window kernels: vector and scalar reference */
+void fadcPedsWindow(const uint32_t *w, int nwords, int swap, FADC_PEDS_WSTAT *st);
+void fadcPedsWindowRef(const uint32_t *w, int nwords, int swap, FADC_PEDS_WSTAT *st);
+
+#endif /* FADCPEDS_H */
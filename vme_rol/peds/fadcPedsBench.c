@@ -0,0 +1,380 @@
+/*
+ * File:
+ *    fadcPedsBench.c
+ *
+ * Description:
+ *    Benchmark / check of the FADC250 pedestal engine (fadcPeds), no crate
+ *    needed.
+ *
+ *    Without -f, builds raw mode blocks the way faReadBlock() returns them
+ *    (block header, per event: event header, trigger time, one raw window
+ *    per channel, block trailer; VME byte order) for 'slots' FADCs, with a
+ *    known pedestal per channel, gaussian noise and a fraction (-p) of the
+ *    windows with a pulse.  Checks that the vector and the scalar window
+ *    kernels agree, that the outlier rejected pedestals match the generated
+ *    ones and that the pulse windows are the ones rejected, and reports the
+ *    throughput.  -w records the generated blocks to a file.
+ *
+ *    With -f, replays recorded blocks (faReadBlock() output, concatenated,
+ *    either byte order) and prints the pedestals, in the fadc250peds
+ *    format with -o.
+ *
+ *    usage: fadcPedsBench [-s slots] [-n blocks] [-b block_level] [-W width]
+ *                         [-N noise] [-p pulse_fraction] [-S max_spread]
+ *                         [-m min_windows] [-w file] [-f file] [-o file]
+ *                         [-c crate]
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <arpa/inet.h>
+#include "fadcPeds.h"
+
+/* VXS payload slots */
+static const int benchSlots[16] = { 3, 4, 5, 6, 7, 8, 9, 10, 13, 14, 15, 16, 17, 18, 19, 20 };
+
+static double   truePed[FADC_PEDS_MAX_SLOT][FADC_PEDS_NCHAN];
+static uint64_t pulses[FADC_PEDS_MAX_SLOT][FADC_PEDS_NCHAN];
+static uint64_t rng = 88172645463325252ull;
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t
+xorshift(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static double
+uniform(void)
+{
+  return ((xorshift() >> 11) + 0.5) * (1.0/9007199254740992.0);
+}
+
+static double
+gauss(void)
+{
+  return sqrt(-2.0*log(uniform())) * cos(2.0*M_PI*uniform());
+}
+
+/* Raw mode block of one slot, in VME byte order; returns words */
+static int
+buildBlock(uint32_t *w, int slot, int iblock, int level, int width, double noise, double pfrac)
+{
+  int n = 0, ev, chan, i, k, at;
+  uint32_t s[2];
+  double v;
+
+  w[n++] = 0x80000000 | (slot << 22) | ((iblock & 0x3FF) << 8) | level;
+  for(ev=0; ev<level; ev++)
+    {
+      w[n++] = 0x90000000 | (slot << 22) | ((iblock*level + ev) & 0x3FFFFF);
+      w[n++] = 0x98000000 | (xorshift() & 0xFFFFFF);
+      w[n++] = xorshift() & 0xFFFFFF;
+      for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+	{
+	  at = (uniform() < pfrac) ? (int)(xorshift() % width) : -1;
+	  if(at >= 0)
+	    pulses[slot][chan]++;
+	  w[n++] = 0xA0000000 | (chan << 23) | width;
+	  for(i=0; i<width; i+=2)
+	    {
+	      s[0] = s[1] = 0;
+	      for(k=0; k<2; k++)
+		{
+		  if(i + k >= width)
+		    {
+		      s[k] = 0x2000;          /* not valid */
+		      continue;
+		    }
+		  v = truePed[slot][chan] + noise*gauss();
+		  if((at >= 0) && (i + k >= at) && (i + k < at + 12))
+		    v += 600.0 * (1.0 - (i + k - at)/12.0);
+		  v = floor(v + 0.5);
+		  s[k] = (v < 0) ? 0 : (v > 4095) ? 4095 : (uint32_t)v;
+		}
+	      w[n++] = (s[0] << 16) | s[1];
+	    }
+	}
+    }
+  w[n] = 0x88000000 | (slot << 22) | (n + 1);
+  n++;
+
+  for(i=0; i<n; i++)
+    w[i] = htonl(w[i]);
+
+  return n;
+}
+
+static uint32_t *
+readFile(const char *fname, int *nwords)
+{
+  FILE *f;
+  uint32_t *buf;
+  long len;
+
+  if((f = fopen(fname, "r")) == NULL)
+    {
+      perror(fname);
+      return NULL;
+    }
+  fseek(f, 0, SEEK_END);
+  len = ftell(f);
+  rewind(f);
+  buf = malloc(len + 4);
+  if((buf == NULL) || (fread(buf, 1, len, f) != (size_t)len))
+    {
+      printf("%s: read failed\n", fname);
+      fclose(f);
+      free(buf);
+      return NULL;
+    }
+  fclose(f);
+  *nwords = len/4;
+
+  return buf;
+}
+
+static int
+writeOut(const FADC_PEDS *p, const char *out, const char *crate)
+{
+  FILE *f;
+  int rval;
+
+  if(out == NULL)
+    return OK;
+  if((f = fopen(out, "w")) == NULL)
+    {
+      perror(out);
+      return ERROR;
+    }
+  rval = fadcPedsWrite(p, f, crate);
+  fclose(f);
+  if(rval != OK)
+    printf("%s: pedestals not complete, not written\n", out);
+
+  return rval;
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-s slots] [-n blocks] [-b block_level] [-W width] [-N noise]\n"
+	 "          [-p pulse_fraction] [-S max_spread] [-m min_windows] [-w file]\n"
+	 "          [-f file] [-o file] [-c crate]\n"
+	 "  -s slots      FADCs (default 16)\n"
+	 "  -n blocks     blocks per FADC (default 2000)\n"
+	 "  -b level      events per block (default 10)\n"
+	 "  -W width      window width in samples (default 90)\n"
+	 "  -N noise      pedestal noise, ADC counts (default 1.5)\n"
+	 "  -p fraction   windows with a pulse (default 0.1)\n"
+	 "  -S spread     max window spread of a pedestal window (default %d)\n"
+	 "  -m windows    min windows for a valid pedestal (default %d)\n"
+	 "  -w file       record the generated blocks\n"
+	 "  -f file       replay recorded blocks instead\n"
+	 "  -o file       write the pedestals (fadc250peds format)\n"
+	 "  -c crate      crate name for -o (default bench)\n",
+	 prog, FADC_PEDS_DEF_MAX_SPREAD, FADC_PEDS_DEF_MIN_WINDOWS);
+}
+
+int
+main(int argc, char *argv[])
+{
+  FADC_PEDS *p;
+  FADC_PEDS_RESULT r;
+  FADC_PEDS_WSTAT sv, ss;
+  uint32_t *buf, w;
+  uint64_t t0, t1, nsamples = 0, nwin = 0, sum = 0, badped = 0, badrej = 0, mismatch = 0;
+  const char *rec = NULL, *replay = NULL, *out = NULL, *crate = "bench";
+  int opt, nslot = 16, nblock = 2000, level = 10, width = 90, spread = 0, minwin = 0;
+  int i, j, b, slot, chan, n, nwords = 0, maxwords, ok;
+  double noise = 1.5, pfrac = 0.1, dt, tol, rej;
+  FILE *f;
+
+  while((opt = getopt(argc, argv, "s:n:b:W:N:p:S:m:w:f:o:c:h")) != -1)
+    {
+      switch(opt)
+	{
+	case 's': nslot  = atoi(optarg); break;
+	case 'n': nblock = atoi(optarg); break;
+	case 'b': level  = atoi(optarg); break;
+	case 'W': width  = atoi(optarg); break;
+	case 'N': noise  = atof(optarg); break;
+	case 'p': pfrac  = atof(optarg); break;
+	case 'S': spread = atoi(optarg); break;
+	case 'm': minwin = atoi(optarg); break;
+	case 'w': rec    = optarg; break;
+	case 'f': replay = optarg; break;
+	case 'o': out    = optarg; break;
+	case 'c': crate  = optarg; break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+  if((nslot < 1) || (nslot > 16) || (nblock < 1) || (level < 1) || (width < 1) ||
+     (width > 0xFFF) || (noise < 0) || (pfrac < 0) || (pfrac > 1))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  p = malloc(sizeof(FADC_PEDS));
+  if(p == NULL)
+    exit(1);
+  fadcPedsInit(p, spread, minwin);
+
+  if(replay)
+    {
+      buf = readFile(replay, &nwords);
+      if(buf == NULL)
+	exit(1);
+      t0 = nowNs();
+      n = fadcPedsAddBlock(p, buf, nwords);
+      t1 = nowNs();
+      if(n < 0)
+	{
+	  printf("%s: not FADC250 raw mode blocks\n", replay);
+	  exit(1);
+	}
+      fadcPedsPrint(p);
+      printf("\n%s: %d words, %d windows in %.3f ms\n", replay, nwords, n, (t1 - t0)*1.0e-6);
+      free(buf);
+      ok = (writeOut(p, out, crate) == OK);
+      free(p);
+      return ok ? 0 : 1;
+    }
+
+  /* Generate */
+  maxwords = 2 + level*(3 + FADC_PEDS_NCHAN*(1 + (width + 1)/2));
+  buf = malloc((size_t)nslot*nblock*maxwords*4);
+  if(buf == NULL)
+    exit(1);
+  for(i=0; i<nslot; i++)
+    for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+      truePed[benchSlots[i]][chan] = 90.0 + 200.0*uniform();
+
+  for(b=0; b<nblock; b++)
+    for(i=0; i<nslot; i++)
+      nwords += buildBlock(&buf[nwords], benchSlots[i], b, level, width, noise, pfrac);
+
+  printf("%d FADCs x %d blocks x %d events, %d samples/window, noise %.2f, pulses %.3f: %.1f MB\n",
+	 nslot, nblock, level, width, noise, pfrac, nwords*4.0e-6);
+
+  if(rec)
+    {
+      if(((f = fopen(rec, "w")) == NULL) || (fwrite(buf, 4, nwords, f) != (size_t)nwords))
+	{
+	  perror(rec);
+	  exit(1);
+	}
+      fclose(f);
+      printf("recorded to %s\n", rec);
+    }
+
+  /* The kernels agree, window by window */
+  for(i=0; i<nwords; i++)
+    {
+      w = ntohl(buf[i]);
+      if((w & 0xF8000000) != 0xA0000000)
+	continue;
+      n = ((w & 0xFFF) + 1)/2;
+      fadcPedsWindow(&buf[i+1], n, 1, &sv);
+      fadcPedsWindowRef(&buf[i+1], n, 1, &ss);
+      if(memcmp(&sv, &ss, sizeof(sv)) != 0)
+	mismatch++;
+      nsamples += sv.n;
+      nwin++;
+      i += n;
+    }
+
+  /* Kernel throughput */
+  for(j=0; j<2; j++)
+    {
+      t0 = nowNs();
+      for(i=0; i<nwords; i++)
+	{
+	  w = ntohl(buf[i]);
+	  if((w & 0xF8000000) != 0xA0000000)
+	    continue;
+	  n = ((w & 0xFFF) + 1)/2;
+	  if(j == 0)
+	    fadcPedsWindow(&buf[i+1], n, 1, &sv);
+	  else
+	    fadcPedsWindowRef(&buf[i+1], n, 1, &sv);
+	  sum += sv.sum;
+	  i += n;
+	}
+      t1 = nowNs();
+      dt = (t1 - t0)*1.0e-9;
+      printf("%-14s %8.3f ms  %7.1f M samples/s  %6.2f GB/s\n",
+	     j ? "scalar kernel" : "vector kernel", dt*1.0e3, nsamples/dt*1.0e-6, nwords*4.0/dt*1.0e-9);
+    }
+
+  /* Engine, block by block as the readout list hands them over */
+  t0 = nowNs();
+  for(i=0; i<nwords; i+=n)
+    {
+      /* Block length from its trailer */
+      for(n=1; (ntohl(buf[i+n-1]) & 0xF8000000) != 0x88000000; n++)
+	;
+      fadcPedsAddBlock(p, &buf[i], n);
+    }
+  t1 = nowNs();
+  dt = (t1 - t0)*1.0e-9;
+  printf("%-14s %8.3f ms  %7.1f M samples/s  %6.2f GB/s  (%llu blocks, %llu windows, %llu errors)\n",
+	 "engine", dt*1.0e3, nsamples/dt*1.0e-6, nwords*4.0/dt*1.0e-9,
+	 (unsigned long long)p->blocks, (unsigned long long)p->windows,
+	 (unsigned long long)p->errors);
+
+  /* Pedestals match, the pulse windows are the rejected ones */
+  for(i=0; i<nslot; i++)
+    {
+      slot = benchSlots[i];
+      for(chan=0; chan<FADC_PEDS_NCHAN; chan++)
+	{
+	  fadcPedsResult(p, slot, chan, &r);
+	  tol = 0.05 + 5.0*(noise + 0.3)/sqrt(r.cwindows*(double)width + 1);
+	  if(!r.valid || (fabs(r.ped - truePed[slot][chan]) > tol))
+	    {
+	      if(badped++ < 5)
+		printf("  slot %d chan %d: ped %.3f, generated %.3f (tolerance %.3f)\n",
+		       slot, chan, r.ped, truePed[slot][chan], tol);
+	    }
+	  rej = (double)(r.windows - r.cwindows);
+	  if(fabs(rej - pulses[slot][chan]) > 0.01*r.windows + 2)
+	    badrej++;
+	}
+    }
+
+  ok = (mismatch == 0) && (badped == 0) && (badrej == 0) && (p->errors == 0) &&
+    (p->windows == nwin) && (fadcPedsComplete(p) == nslot);
+  printf("check: %llu windows, %llu kernel mismatches, %llu pedestals off, "
+	 "%llu channels with wrong rejections: %s\n",
+	 (unsigned long long)nwin, (unsigned long long)mismatch, (unsigned long long)badped,
+	 (unsigned long long)badrej, ok ? "OK" : "FAILED");
+
+  if(writeOut(p, out, crate) != OK)
+    ok = 0;
+
+  free(buf);
+  free(p);
+
+  return ok ? 0 : 1;
+}
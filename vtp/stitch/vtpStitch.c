@@ -0,0 +1,535 @@
+/*----------------------------------------------------------------------------*
+ *  Copyright (c) 2016        Southeastern Universities Research Association, *
+ *                            Thomas Jefferson National Accelerator Facility  *
+ *                                                                            *
+ *    This software was developed under a United States Government license    *
+ *    described in the NOTICE file included as part of this distribution.     *
+ *                                                                            *
+ *----------------------------------------------------------------------------*
+ *
+ * Description:
+ *     Frame stitcher for the VTP streaming output (see vtpStitch.h).
+ *
+ *     Frames live in a ring of 'window' slots indexed by the low bits of
+ *     the frame number.  'base' is the oldest frame not yet emitted:
+ *     frames are emitted in order, as soon as the base frame is complete,
+ *     or incomplete once a frame 'max_lag' newer has arrived.  Banks for
+ *     frames before 'base' are late and dropped.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "vtpStitch.h"
+
+#define EVIO_BLOCK_MAGIC     0xc0da0100
+#define EVIO_ROC_TSB_TYPE    0x10       /* ROC Time Slice Bank */
+#define EVIO_SIB_TAG         0xff30     /* Stream Info Bank */
+#define EVIO_TSS_TAG         0x31       /* Time Slice Segment */
+
+#define STITCH_HASH_BITS     10         /* >= 4 x VTP_STITCH_MAX_SRC */
+#define STITCH_HASH_SIZE     (1 << STITCH_HASH_BITS)
+
+typedef struct
+{
+  uint64_t frame;
+  uint64_t timestamp;
+  uint32_t flags;
+  int      npresent;
+  uint64_t present[VTP_STITCH_MASK_WORDS];
+  uint64_t swapped[VTP_STITCH_MASK_WORDS];
+  uint32_t off[VTP_STITCH_MAX_SRC];     /* words into buf */
+  uint32_t nwords[VTP_STITCH_MAX_SRC];
+  uint32_t used, cap;                   /* words */
+  uint32_t *buf;
+} stitch_slot;
+
+typedef struct
+{
+  uint32_t id;
+  int      idx;                         /* -1: empty */
+} stitch_hash;
+
+struct vtp_stitch
+{
+  VTP_STITCH_CONFIG cfg;
+  VTP_STITCH_FUNC   func;
+  void             *arg;
+
+  stitch_hash hash[STITCH_HASH_SIZE];
+  uint64_t valid[VTP_STITCH_MASK_WORDS]; /* bits of the configured contributors */
+  int      learning;                    /* still learning the contributors */
+
+  int      started;
+  uint64_t first, base, newest;
+  uint32_t mask;                        /* window - 1 */
+  uint32_t max_words;                   /* max_frame_bytes / 4 */
+  stitch_slot *slot;
+
+  VTP_STITCH_FRAME  out;
+  VTP_STITCH_STATS  stats;
+};
+
+static int
+stitchHashFind(VTP_STITCH *s, uint32_t id)
+{
+  uint32_t h = (id * 2654435761u) >> (32 - STITCH_HASH_BITS);
+
+  while(s->hash[h].idx >= 0)
+    {
+      if(s->hash[h].id == id)
+	return s->hash[h].idx;
+      h = (h + 1) & (STITCH_HASH_SIZE - 1);
+    }
+  return -1;
+}
+
+static int
+stitchSrcAdd(VTP_STITCH *s, uint32_t id)
+{
+  uint32_t h = (id * 2654435761u) >> (32 - STITCH_HASH_BITS);
+  int idx = s->cfg.nsrc;
+
+  if(idx >= VTP_STITCH_MAX_SRC)
+    return -1;
+
+  while(s->hash[h].idx >= 0)
+    h = (h + 1) & (STITCH_HASH_SIZE - 1);
+  s->hash[h].id  = id;
+  s->hash[h].idx = idx;
+
+  s->cfg.src[idx] = id;
+  s->cfg.nsrc++;
+  s->out.nsrc = s->cfg.nsrc;
+  s->valid[idx >> 6] |= 1ull << (idx & 63);
+  return idx;
+}
+
+/* Hand a slot to the consumer and make it free again */
+static void
+stitchEmit(VTP_STITCH *s, stitch_slot *sl, uint32_t why)
+{
+  VTP_STITCH_FRAME *f = &s->out;
+  int i, w, nmiss = 0;
+
+  f->frame     = sl->frame;
+  f->timestamp = sl->timestamp;
+  f->npresent  = sl->npresent;
+  f->flags     = sl->flags;
+  for(w=0; w<VTP_STITCH_MASK_WORDS; w++)
+    {
+      f->present[w] = sl->present[w];
+      f->swapped[w] = sl->swapped[w];
+      f->missing[w] = s->valid[w] & ~sl->present[w];
+      nmiss += __builtin_popcountll(f->missing[w]);
+    }
+  for(i=0; i<s->cfg.nsrc; i++)
+    {
+      if(VTP_STITCH_ISSET(sl->present, i))
+	{
+	  f->bank[i]   = sl->buf + sl->off[i];
+	  f->nwords[i] = sl->nwords[i];
+	}
+      else
+	{
+	  f->bank[i]   = NULL;
+	  f->nwords[i] = 0;
+	}
+    }
+
+  if(nmiss == 0)
+    {
+      f->flags |= VTP_STITCH_COMPLETE;
+      s->stats.complete++;
+    }
+  else
+    {
+      f->flags |= why;
+      s->stats.incomplete++;
+      s->stats.missing += nmiss;
+    }
+  if(f->flags & VTP_STITCH_TS_MISMATCH)
+    s->stats.ts_mismatch++;
+  s->stats.frames++;
+
+  if(s->func)
+    (*s->func)(f, s->arg);
+
+  sl->npresent = 0;
+  sl->flags    = 0;
+  sl->used     = 0;
+  memset(sl->present, 0, sizeof(sl->present));
+  memset(sl->swapped, 0, sizeof(sl->swapped));
+}
+
+/* Emit the complete frames at the base */
+static void
+stitchEmitReady(VTP_STITCH *s)
+{
+  stitch_slot *sl;
+
+  if(s->learning)
+    return;
+
+  for(;;)
+    {
+      sl = &s->slot[s->base & s->mask];
+      if((sl->npresent == 0) || (sl->frame != s->base) || (sl->npresent < s->cfg.nsrc))
+	break;
+      stitchEmit(s, sl, 0);
+      s->base++;
+    }
+}
+
+/* Emit (incomplete) every frame before 'upto', skipping empty slots */
+static void
+stitchAdvance(VTP_STITCH *s, uint64_t upto, uint32_t why)
+{
+  stitch_slot *sl;
+  uint64_t f, end;
+
+  end = (upto - s->base > s->mask) ? s->base + s->mask + 1 : upto;
+  for(f = s->base; f < end; f++)
+    {
+      sl = &s->slot[f & s->mask];
+      if(sl->npresent && (sl->frame == f))
+	stitchEmit(s, sl, why);
+    }
+  s->base = upto;
+}
+
+/**
+ * Create a frame stitcher.
+ *
+ * @param cfg    Contributors, window and memory bounds (defaults for 0).
+ *               With cfg->nsrc = 0 the contributors are learned from the
+ *               first max_lag frames; later newcomers count as unknown.
+ * @param func   Called for every frame, in frame order.
+ * @param arg    Passed to func.
+ *
+ * @return Stitcher, or NULL on a bad configuration.
+ */
+VTP_STITCH *
+vtpStitchCreate(const VTP_STITCH_CONFIG *cfg, VTP_STITCH_FUNC func, void *arg)
+{
+  VTP_STITCH *s;
+  int i, window, max_lag;
+
+  window  = cfg->window ? cfg->window : VTP_STITCH_DEF_WINDOW;
+  max_lag = cfg->max_lag ? cfg->max_lag : window/2;
+
+  if((window < 2) || (window > 65536) || (window & (window - 1)))
+    {
+      printf("%s: ERROR: window (%d) must be a power of 2 (2 - 65536)\n", __func__, window);
+      return NULL;
+    }
+  if((max_lag < 1) || (max_lag >= window))
+    {
+      printf("%s: ERROR: max_lag (%d) must be 1 - %d\n", __func__, max_lag, window - 1);
+      return NULL;
+    }
+  if((cfg->nsrc < 0) || (cfg->nsrc > VTP_STITCH_MAX_SRC))
+    {
+      printf("%s: ERROR: nsrc (%d) must be 0 - %d\n", __func__, cfg->nsrc, VTP_STITCH_MAX_SRC);
+      return NULL;
+    }
+
+  s = calloc(1, sizeof(VTP_STITCH));
+  if(s == NULL)
+    {
+      printf("%s: ERROR: out of memory\n", __func__);
+      return NULL;
+    }
+
+  s->cfg.window          = window;
+  s->cfg.max_lag         = max_lag;
+  s->cfg.max_frame_bytes = cfg->max_frame_bytes ? cfg->max_frame_bytes : VTP_STITCH_DEF_FRAME_BYTES;
+  s->func      = func;
+  s->arg       = arg;
+  s->mask      = window - 1;
+  s->max_words = s->cfg.max_frame_bytes / 4;
+  s->learning  = (cfg->nsrc == 0);
+  s->out.src   = s->cfg.src;
+
+  for(i=0; i<STITCH_HASH_SIZE; i++)
+    s->hash[i].idx = -1;
+
+  for(i=0; i<cfg->nsrc; i++)
+    {
+      if(stitchHashFind(s, cfg->src[i]) >= 0)
+	{
+	  printf("%s: ERROR: contributor rocid %u stream %u listed twice\n", __func__,
+		 VTP_STITCH_SRC_ROCID(cfg->src[i]), VTP_STITCH_SRC_STREAM(cfg->src[i]));
+	  free(s);
+	  return NULL;
+	}
+      stitchSrcAdd(s, cfg->src[i]);
+    }
+
+  s->slot = calloc(window, sizeof(stitch_slot));
+  if(s->slot == NULL)
+    {
+      printf("%s: ERROR: out of memory\n", __func__);
+      free(s);
+      return NULL;
+    }
+
+  return s;
+}
+
+/**
+ * Free a stitcher.  Frames still pending are dropped; call
+ * vtpStitchFlush() first to get them.
+ */
+void
+vtpStitchDestroy(VTP_STITCH *s)
+{
+  int i;
+
+  if(s == NULL)
+    return;
+
+  for(i=0; i<=(int)s->mask; i++)
+    free(s->slot[i].buf);
+  free(s->slot);
+  free(s);
+}
+
+/**
+ * Add the ROC Time Slice Bank of one contributor.  The bank is copied.
+ *
+ * @param rocid      ROC id (bank tag).
+ * @param stream     Stream (bank num).
+ * @param frame      Frame number from the Time Slice Segment (32 bit,
+ *                   unwrapped against the newest frame).
+ * @param timestamp  Frame timestamp from the Time Slice Segment.
+ * @param bank       Bank, including its 2 header words.
+ * @param nwords     Bank length in words.
+ * @param swapped    1 if the bank is not in host byte order.
+ *
+ * @return OK, ERROR on bad arguments.  Late, duplicate and unknown banks
+ *         are dropped and counted in the statistics.
+ */
+int
+vtpStitchAddBank(VTP_STITCH *s, uint32_t rocid, uint32_t stream, uint32_t frame,
+		 uint64_t timestamp, const uint32_t *bank, uint32_t nwords, int swapped)
+{
+  stitch_slot *sl;
+  uint32_t id = VTP_STITCH_SRC_ID(rocid, stream), cap, *buf;
+  uint64_t f;
+  int idx;
+
+  if((s == NULL) || (bank == NULL) || (nwords == 0))
+    return ERROR;
+
+  s->stats.banks++;
+  s->stats.bytes += (uint64_t)nwords*4;
+
+  idx = stitchHashFind(s, id);
+  if(idx < 0)
+    {
+      if(!s->learning || ((idx = stitchSrcAdd(s, id)) < 0))
+	{
+	  s->stats.unknown++;
+	  return OK;
+	}
+    }
+
+  if(!s->started)
+    {
+      s->started = 1;
+      s->first = s->base = s->newest = frame;
+    }
+
+  f = s->newest + (int64_t)(int32_t)(frame - (uint32_t)s->newest);
+  if((int64_t)(f - s->newest) > 0)
+    {
+      s->newest = f;
+      if(s->learning && (f - s->first >= (uint64_t)s->cfg.max_lag))
+	s->learning = 0;
+      if(f - s->base > (uint64_t)s->cfg.max_lag)
+	stitchAdvance(s, f - s->cfg.max_lag, VTP_STITCH_LAG);
+    }
+
+  if((int64_t)(f - s->base) < 0)
+    {
+      s->stats.late++;
+      return OK;
+    }
+
+  sl = &s->slot[f & s->mask];
+  if(sl->npresent == 0)
+    {
+      sl->frame     = f;
+      sl->timestamp = timestamp;
+    }
+  else if(VTP_STITCH_ISSET(sl->present, idx))
+    {
+      s->stats.dup++;
+      return OK;
+    }
+  else if(timestamp != sl->timestamp)
+    sl->flags |= VTP_STITCH_TS_MISMATCH;
+
+  if(sl->used + nwords > s->max_words)
+    {
+      sl->flags |= VTP_STITCH_OVERFLOW;
+      s->stats.overflow++;
+      return OK;
+    }
+
+  if(sl->used + nwords > sl->cap)
+    {
+      cap = sl->cap ? sl->cap : 1024;
+      while(cap < sl->used + nwords)
+	cap *= 2;
+      if(cap > s->max_words)
+	cap = s->max_words;
+      buf = realloc(sl->buf, (size_t)cap*4);
+      if(buf == NULL)
+	{
+	  printf("%s: ERROR: out of memory (%u bytes)\n", __func__, cap*4);
+	  return ERROR;
+	}
+      s->stats.mem_bytes += (uint64_t)(cap - sl->cap)*4;
+      sl->buf = buf;
+      sl->cap = cap;
+    }
+
+  memcpy(sl->buf + sl->used, bank, (size_t)nwords*4);
+  sl->off[idx]    = sl->used;
+  sl->nwords[idx] = nwords;
+  sl->used       += nwords;
+  sl->present[idx >> 6] |= 1ull << (idx & 63);
+  if(swapped)
+    sl->swapped[idx >> 6] |= 1ull << (idx & 63);
+  sl->npresent++;
+
+  stitchEmitReady(s);
+  return OK;
+}
+
+/**
+ * Add an EVIO block as received from the VTP (TCP: after the cMsg
+ * header, UDP: reassembled).  The ROC Time Slice Banks are stitched,
+ * control and user events are counted and skipped.
+ *
+ * @param block    Block, 4 byte aligned, either byte order.
+ * @param nbytes   Block length in bytes.
+ *
+ * @return OK, or ERROR for a malformed block.
+ */
+int
+vtpStitchAddBlock(VTP_STITCH *s, const void *block, uint32_t nbytes)
+{
+  const uint32_t *w = block;
+  uint32_t pos, len, limit, tag, type, swap;
+  uint64_t ts;
+
+  if((s == NULL) || (block == NULL))
+    return ERROR;
+
+  if((nbytes < 32) ||
+     ((w[7] != EVIO_BLOCK_MAGIC) && (w[7] != __builtin_bswap32(EVIO_BLOCK_MAGIC))))
+    {
+      s->stats.errors++;
+      return ERROR;
+    }
+  swap = (w[7] != EVIO_BLOCK_MAGIC);
+
+#define EW(i) (swap ? __builtin_bswap32(w[i]) : w[i])
+
+  s->stats.blocks++;
+  limit = EW(0);
+  if(limit > nbytes/4)
+    limit = nbytes/4;
+
+  for(pos = EW(2); pos + 1 < limit; pos += len)
+    {
+      len = EW(pos) + 1;
+      if((len < 2) || (pos + len > limit))
+	{
+	  s->stats.errors++;
+	  return ERROR;
+	}
+
+      tag  = EW(pos+1) >> 16;
+      type = (EW(pos+1) >> 8) & 0x3F;
+      if(type != EVIO_ROC_TSB_TYPE)
+	{
+	  s->stats.other++;
+	  continue;
+	}
+
+      /* Stream Info Bank, Time Slice Segment: frame, timestamp */
+      if((len < 8) || ((EW(pos+3) >> 16) != EVIO_SIB_TAG) || ((EW(pos+4) >> 24) != EVIO_TSS_TAG))
+	{
+	  s->stats.errors++;
+	  continue;
+	}
+      ts = EW(pos+6) | ((uint64_t)EW(pos+7) << 32);
+      if(vtpStitchAddBank(s, tag, EW(pos+1) & 0xFF, EW(pos+5), ts, &w[pos], len, swap) != OK)
+	return ERROR;
+    }
+#undef EW
+
+  return OK;
+}
+
+/**
+ * Emit every pending frame (incomplete ones flagged VTP_STITCH_FLUSH),
+ * e.g. at the end of the run.
+ *
+ * @return OK, ERROR if s is NULL.
+ */
+int
+vtpStitchFlush(VTP_STITCH *s)
+{
+  if(s == NULL)
+    return ERROR;
+
+  if(!s->started)
+    return OK;
+
+  s->learning = 0;
+  stitchEmitReady(s);
+  stitchAdvance(s, s->newest + 1, VTP_STITCH_FLUSH);
+  return OK;
+}
+
+int
+vtpStitchGetStats(VTP_STITCH *s, VTP_STITCH_STATS *stats)
+{
+  if((s == NULL) || (stats == NULL))
+    return ERROR;
+
+  *stats = s->stats;
+  return OK;
+}
+
+void
+vtpStitchPrintStats(VTP_STITCH *s)
+{
+  VTP_STITCH_STATS *st;
+
+  if(s == NULL)
+    return;
+  st = &s->stats;
+
+  printf("Stitcher: %d contributors, window %d, max lag %d, %u bytes/frame max\n",
+	 s->cfg.nsrc, s->cfg.window, s->cfg.max_lag, s->cfg.max_frame_bytes);
+  printf("  in:  %llu blocks  %llu banks  %llu bytes\n",
+	 (unsigned long long)st->blocks, (unsigned long long)st->banks,
+	 (unsigned long long)st->bytes);
+  printf("  out: %llu frames  %llu complete  %llu incomplete  %llu missing contributions\n",
+	 (unsigned long long)st->frames, (unsigned long long)st->complete,
+	 (unsigned long long)st->incomplete, (unsigned long long)st->missing);
+  printf("  dropped: late %llu  dup %llu  unknown %llu  overflow %llu\n",
+	 (unsigned long long)st->late, (unsigned long long)st->dup,
+	 (unsigned long long)st->unknown, (unsigned long long)st->overflow);
+  printf("  ts mismatch %llu  other events %llu  errors %llu  memory %llu bytes\n",
+	 (unsigned long long)st->ts_mismatch, (unsigned long long)st->other,
+	 (unsigned long long)st->errors, (unsigned long long)st->mem_bytes);
+}
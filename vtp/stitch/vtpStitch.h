@@ -0,0 +1,110 @@
+#ifndef VTPSTITCH_H
+#define VTPSTITCH_H
+/*----------------------------------------------------------------------------*
+ *  Copyright (c) 2016        Southeastern Universities Research Association, *
+ *                            Thomas Jefferson National Accelerator Facility  *
+ *                                                                            *
+ *    This software was developed under a United States Government license    *
+ *    described in the NOTICE file included as part of this distribution.     *
+ *                                                                            *
+ *----------------------------------------------------------------------------*
+ *
+ * Description:
+ *     Frame stitcher for the VTP streaming output.  Host side library (no
+ *     VTP hardware or library needed) for the consumers of the TCP / UDP
+ *     streams: EVIO blocks of any number of streams and crates go in, the
+ *     ROC Time Slice Banks are grouped by frame number and handed back as
+ *     one time frame per frame number, in frame order, with the missing
+ *     contributors flagged.
+ *
+ *     Memory is bounded: at most 'window' frames are in flight, each with
+ *     at most 'max_frame_bytes' of bank data.  The slot buffers are kept
+ *     and reused, so the steady state does not allocate.
+ *
+ *     A stitcher is not thread safe; use one per consumer thread, or lock
+ *     around the vtpStitchAdd* calls.
+ *
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#ifndef ERROR
+#define ERROR -1
+#endif
+#ifndef OK
+#define OK 0
+#endif
+
+#define VTP_STITCH_MAX_SRC          256
+#define VTP_STITCH_MASK_WORDS       (VTP_STITCH_MAX_SRC/64)
+#define VTP_STITCH_DEF_WINDOW       64
+#define VTP_STITCH_DEF_FRAME_BYTES  (4*1024*1024)
+
+/* Contributor id: ROC id (bank tag) and stream (bank num) */
+#define VTP_STITCH_SRC_ID(rocid, stream)  ((((uint32_t)(rocid)) << 8) | ((stream) & 0xFF))
+#define VTP_STITCH_SRC_ROCID(id)          ((id) >> 8)
+#define VTP_STITCH_SRC_STREAM(id)         ((id) & 0xFF)
+
+/* Frame flags */
+#define VTP_STITCH_COMPLETE      0x01  /* all contributors present */
+#define VTP_STITCH_LAG           0x02  /* incomplete: 'max_lag' newer frames arrived */
+#define VTP_STITCH_FLUSH         0x04  /* incomplete: vtpStitchFlush() */
+#define VTP_STITCH_TS_MISMATCH   0x08  /* contributors disagree on the timestamp */
+#define VTP_STITCH_OVERFLOW      0x10  /* a bank did not fit 'max_frame_bytes' */
+
+#define VTP_STITCH_ISSET(mask, i)  (((mask)[(i) >> 6] >> ((i) & 63)) & 1)
+
+typedef struct
+{
+  int      nsrc;                        /* expected contributors, 0: learn from the data */
+  uint32_t src[VTP_STITCH_MAX_SRC];     /* VTP_STITCH_SRC_ID() of each contributor */
+  int      window;                      /* frames in flight, power of 2 (default 64) */
+  int      max_lag;                     /* give up on a frame this many frames behind
+					   the newest (default window/2) */
+  uint32_t max_frame_bytes;             /* bank data per frame (default 4 MB) */
+} VTP_STITCH_CONFIG;
+
+/* A stitched frame, valid for the duration of the callback */
+typedef struct
+{
+  uint64_t frame;                       /* frame number (unwrapped) */
+  uint64_t timestamp;                   /* from the first contributor */
+  uint32_t flags;                       /* VTP_STITCH_COMPLETE, ... */
+  int      nsrc;                        /* contributors expected */
+  int      npresent;                    /* contributors present */
+  const uint32_t *src;                  /* contributor ids, index = mask bit */
+  uint64_t present[VTP_STITCH_MASK_WORDS];
+  uint64_t missing[VTP_STITCH_MASK_WORDS];
+  uint64_t swapped[VTP_STITCH_MASK_WORDS]; /* bank is not in host byte order */
+  const uint32_t *bank[VTP_STITCH_MAX_SRC]; /* ROC Time Slice Bank, NULL if missing */
+  uint32_t nwords[VTP_STITCH_MAX_SRC];
+} VTP_STITCH_FRAME;
+
+typedef struct
+{
+  uint64_t blocks, banks, bytes;        /* input */
+  uint64_t frames, complete, incomplete;/* output */
+  uint64_t missing;                     /* contributions missing in the output */
+  uint64_t late;                        /* bank for a frame already emitted */
+  uint64_t dup;                         /* second bank of a contributor */
+  uint64_t unknown;                     /* contributor not in the config */
+  uint64_t overflow, ts_mismatch;
+  uint64_t other;                       /* control / user events */
+  uint64_t errors;                      /* malformed blocks */
+  uint64_t mem_bytes;                   /* slot buffers allocated */
+} VTP_STITCH_STATS;
+
+typedef void (*VTP_STITCH_FUNC)(const VTP_STITCH_FRAME *frame, void *arg);
+
+typedef struct vtp_stitch VTP_STITCH;
+
+VTP_STITCH *vtpStitchCreate(const VTP_STITCH_CONFIG *cfg, VTP_STITCH_FUNC func, void *arg);
+void vtpStitchDestroy(VTP_STITCH *s);
+int  vtpStitchAddBlock(VTP_STITCH *s, const void *block, uint32_t nbytes);
+int  vtpStitchAddBank(VTP_STITCH *s, uint32_t rocid, uint32_t stream, uint32_t frame,
+		      uint64_t timestamp, const uint32_t *bank, uint32_t nwords, int swapped);
+int  vtpStitchFlush(VTP_STITCH *s);
+int  vtpStitchGetStats(VTP_STITCH *s, VTP_STITCH_STATS *stats);
+void vtpStitchPrintStats(VTP_STITCH *s);
+
+#endif /* VTPSTITCH_H */
@@ -0,0 +1,261 @@
+/*
+ * File:
+ *    vtpStitchBench.c
+ *
+ * Description:
+ *    Benchmark / check of the frame stitcher (vtpStitch).  Builds EVIO
+ *    blocks the way the VTP streams them (big endian, one ROC Time Slice
+ *    Bank per block) for crates x streams contributors and feeds them to
+ *    the stitcher:
+ *
+ *    - each contributor runs a fixed number of frames (0 - jitter) behind
+ *      the others, and the contributors come in a different order every
+ *      round, like independent TCP / UDP receivers would deliver them
+ *    - a fraction (-l) of the banks is dropped
+ *
+ *    Every stitched frame is checked (in order, contributor banks carry
+ *    the right rocid / stream / frame), the missing contributions must
+ *    match the dropped banks.  Reports the throughput and the memory used.
+ *
+ *    usage: vtpStitchBench [-c crates] [-s streams] [-n frames] [-w words]
+ *                          [-j jitter] [-l loss] [-W window] [-L max_lag]
+ *                          [-f first_frame]
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "vtpStitch.h"
+
+#define BENCH_HDR_WORDS    16     /* block header + ROC TSB + SIB + TSS + AIS */
+
+typedef struct
+{
+  uint32_t *blk;
+  uint32_t  nwords;
+  int       delay;
+} bench_src;
+
+typedef struct
+{
+  uint64_t frames, missing, bad, order;
+  uint64_t next;
+  int      have_next;
+  uint64_t sum;
+} bench_check;
+
+static bench_src src[VTP_STITCH_MAX_SRC];
+static uint64_t  rng = 88172645463325252ull;
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t
+xorshift(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* EVIO block of one contributor, as vtpStreamEmu / the VTP build it */
+static void
+buildBlock(bench_src *b, int rocid, int stream, int words)
+{
+  uint32_t *w, i;
+
+  b->nwords = BENCH_HDR_WORDS + 2 + words;
+  b->blk = calloc(b->nwords, 4);
+  w = b->blk;
+
+  w[0]  = htonl(b->nwords);                             /* block header */
+  w[1]  = htonl(1);
+  w[2]  = htonl(8);
+  w[3]  = htonl(1);
+  w[4]  = htonl(rocid);
+  w[5]  = htonl(0x200|4);
+  w[7]  = htonl(0xc0da0100);
+  w[8]  = htonl(b->nwords - 9);                         /* ROC Time Slice Bank */
+  w[9]  = htonl((rocid<<16) | (0x10<<8) | stream);
+  w[10] = htonl(5);                                     /* Stream Info Bank */
+  w[11] = htonl((0xff30<<16) | (0x20<<8) | stream);
+  w[12] = htonl((0x31<<24) | (0x01<<16) | 3);           /* Time Slice Segment */
+  w[16] = htonl((0x41<<24) | (0x85<<16) | 1);           /* Aggregation Info Segment */
+  w[17] = htonl(1<<16);
+  w[BENCH_HDR_WORDS]   = htonl(words + 1);              /* payload bank */
+  w[BENCH_HDR_WORDS+1] = htonl((1<<16) | (0x01<<8));
+  for(i=0; i<(uint32_t)words; i++)
+    w[BENCH_HDR_WORDS+2+i] = htonl(xorshift());
+}
+
+static void
+frameCheck(const VTP_STITCH_FRAME *f, void *arg)
+{
+  bench_check *c = arg;
+  const uint32_t *b;
+  uint32_t id;
+  int i;
+
+  if(c->have_next && (f->frame < c->next))
+    c->order++;
+  c->next = f->frame + 1;
+  c->have_next = 1;
+  c->frames++;
+
+  for(i=0; i<f->nsrc; i++)
+    {
+      if(VTP_STITCH_ISSET(f->missing, i))
+	{
+	  c->missing++;
+	  continue;
+	}
+      b  = f->bank[i];
+      id = f->src[i];
+      if((b == NULL) || !VTP_STITCH_ISSET(f->swapped, i) ||
+	 (ntohl(b[1]) != ((VTP_STITCH_SRC_ROCID(id)<<16) | (0x10<<8) | VTP_STITCH_SRC_STREAM(id))) ||
+	 (ntohl(b[5]) != (uint32_t)f->frame) || (ntohl(b[0]) + 1 != f->nwords[i]))
+	c->bad++;
+      /* Touch the data, like a consumer would */
+      c->sum += b ? b[f->nwords[i] - 1] : 0;
+    }
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-c crates] [-s streams] [-n frames] [-w words] [-j jitter]\n"
+	 "          [-l loss] [-W window] [-L max_lag] [-f first_frame]\n"
+	 "  -c crates    crates (default 16)\n"
+	 "  -s streams   streams per crate (default 4)\n"
+	 "  -n frames    frames (default 200000)\n"
+	 "  -w words     payload words per bank (default 256)\n"
+	 "  -j jitter    max frames a contributor runs behind (default 8)\n"
+	 "  -l loss      fraction of banks dropped (default 0.001)\n"
+	 "  -W window    stitcher window (default 64)\n"
+	 "  -L max_lag   stitcher max lag (default window/2)\n"
+	 "  -f frame     first frame number (default: 32 bit wrap in the run)\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  VTP_STITCH_CONFIG cfg;
+  VTP_STITCH_STATS st;
+  VTP_STITCH *s;
+  bench_check chk;
+  uint32_t first = 0, frame, lossThr;
+  uint64_t r, nframes = 200000, dropped = 0, ts, t0, t1;
+  int opt, ncrate = 16, nstream = 4, words = 256, jitter = 8, nsrc, i, k, rot;
+  double loss = 0.001, dt;
+  int firstSet = 0, ok;
+
+  memset(&cfg, 0, sizeof(cfg));
+  while((opt = getopt(argc, argv, "c:s:n:w:j:l:W:L:f:h")) != -1)
+    {
+      switch(opt)
+	{
+	case 'c': ncrate       = atoi(optarg); break;
+	case 's': nstream      = atoi(optarg); break;
+	case 'n': nframes      = strtoull(optarg, NULL, 0); break;
+	case 'w': words        = atoi(optarg); break;
+	case 'j': jitter       = atoi(optarg); break;
+	case 'l': loss         = atof(optarg); break;
+	case 'W': cfg.window   = atoi(optarg); break;
+	case 'L': cfg.max_lag  = atoi(optarg); break;
+	case 'f': first = strtoul(optarg, NULL, 0); firstSet = 1; break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+
+  nsrc = ncrate*nstream;
+  if((ncrate < 1) || (nstream < 1) || (nstream > 4) || (nsrc > VTP_STITCH_MAX_SRC) ||
+     (words < 0) || (jitter < 0) || (loss < 0) || (loss >= 1) || (nframes == 0))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+  if(!firstSet)
+    first = 0xFFFFFFFFu - (uint32_t)(nframes/2);
+
+  for(k=0; k<nsrc; k++)
+    {
+      buildBlock(&src[k], 2 + k/nstream, k%nstream, words);
+      src[k].delay = jitter ? xorshift() % (jitter + 1) : 0;
+      cfg.src[k] = VTP_STITCH_SRC_ID(2 + k/nstream, k%nstream);
+    }
+  cfg.nsrc = nsrc;
+
+  memset(&chk, 0, sizeof(chk));
+  s = vtpStitchCreate(&cfg, frameCheck, &chk);
+  if(s == NULL)
+    exit(1);
+
+  printf("%d crates x %d streams, %llu frames, %d bytes/bank, jitter %d, loss %g\n",
+	 ncrate, nstream, (unsigned long long)nframes, (BENCH_HDR_WORDS - 8 + 2 + words)*4,
+	 jitter, loss);
+
+  lossThr = (uint32_t)(loss * 4294967296.0);
+  t0 = nowNs();
+  for(r=0; r<nframes + jitter; r++)
+    {
+      rot = (r * 7) % nsrc;
+      for(i=0; i<nsrc; i++)
+	{
+	  k = (i + rot) % nsrc;
+	  if((r < (uint64_t)src[k].delay) || (r - src[k].delay >= nframes))
+	    continue;
+	  if(lossThr && ((uint32_t)xorshift() < lossThr))
+	    {
+	      dropped++;
+	      continue;
+	    }
+	  frame = first + (uint32_t)(r - src[k].delay);
+	  ts    = (uint64_t)frame * 8192;
+	  src[k].blk[13] = htonl(frame);
+	  src[k].blk[14] = htonl((uint32_t)ts);
+	  src[k].blk[15] = htonl((uint32_t)(ts >> 32));
+	  if(vtpStitchAddBlock(s, src[k].blk, src[k].nwords*4) != OK)
+	    {
+	      printf("vtpStitchAddBlock failed\n");
+	      exit(1);
+	    }
+	}
+    }
+  vtpStitchFlush(s);
+  t1 = nowNs();
+
+  vtpStitchGetStats(s, &st);
+  vtpStitchPrintStats(s);
+
+  dt = (double)(t1 - t0)*1.0e-9;
+  printf("\n%.3f s: %.2f M banks/s  %.2f GB/s  %.0f frames/s  %.1f ns/bank\n",
+	 dt, st.banks/dt*1.0e-6, st.bytes/dt*1.0e-9, st.frames/dt, dt*1.0e9/st.banks);
+
+  /* Late banks were emitted as missing too */
+  ok = (chk.bad == 0) && (chk.order == 0) && (chk.missing == dropped + st.late);
+  printf("check: %llu frames, %llu missing (%llu dropped, %llu late), %llu bad banks, "
+	 "%llu out of order: %s\n",
+	 (unsigned long long)chk.frames, (unsigned long long)chk.missing,
+	 (unsigned long long)dropped, (unsigned long long)st.late,
+	 (unsigned long long)chk.bad, (unsigned long long)chk.order, ok ? "OK" : "FAILED");
+
+  vtpStitchDestroy(s);
+  for(k=0; k<nsrc; k++)
+    free(src[k].blk);
+
+  return ok ? 0 : 1;
+}
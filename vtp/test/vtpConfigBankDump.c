@@ -0,0 +1,119 @@
+/*
+ * File:
+ *    vtpConfigBankDump.c
+ *
+ * Description:
+ *    Prints a binary VTP configuration bank (vtpConfigBankBuild()), the
+ *    data words of bank 0x12 of the first event, as raw words in either
+ *    byte order.
+ *
+ *    With -c the bank is made from a config file instead, for the given
+ *    firmware type (default FADC streaming), decoded again and checked
+ *    to encode to the same words.  -o writes it to a file.
+ *
+ *    usage: vtpConfigBankDump [-c config] [-t fw_type] [-o file] [bankfile]
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "vtpLib.h"
+#include "vtpConfig.h"
+
+static uint32_t bank[VTP_CFGBANK_MAXWORDS], check[VTP_CFGBANK_MAXWORDS];
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-c config] [-t fw_type] [-o file] [bankfile]\n"
+	 "  -c config   make the bank from this config file (absolute or ./ path)\n"
+	 "  -t fw_type  firmware type for -c (default %d, FADC streaming)\n"
+	 "  -o file     write the bank to this file\n", prog, VTP_FW_TYPE_FADCSTREAM);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char *cfg = NULL, *out = NULL;
+  VTP_CONF *conf;
+  FILE *f;
+  int opt, fw_type = VTP_FW_TYPE_FADCSTREAM, nwords, n;
+
+  while((opt = getopt(argc, argv, "c:t:o:h")) != -1)
+    {
+      switch(opt)
+	{
+	case 'c': cfg = optarg; break;
+	case 't': fw_type = atoi(optarg); break;
+	case 'o': out = optarg; break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+  if((cfg == NULL) == (optind >= argc))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  conf = calloc(2, sizeof(VTP_CONF));
+  if(conf == NULL)
+    exit(1);
+
+  if(cfg)
+    {
+      vtpInitGlobals();
+      if(vtpReadConfigFile(cfg) < 0)
+	exit(1);
+      vtpGetConf(&conf[0]);
+      conf[0].fw_type[0] = fw_type;
+      nwords = vtpConfigBankEncode(&conf[0], bank, VTP_CFGBANK_MAXWORDS);
+      if(nwords == ERROR)
+	exit(1);
+
+      /* Round trip */
+      memcpy(&conf[1], &conf[0], sizeof(VTP_CONF));
+      memset(&conf[1].fw_rev, 0xff, sizeof(conf[1].fw_rev) + sizeof(conf[1].fw_type));
+      n = vtpConfigBankDecode(bank, nwords, &conf[1]);
+      if((n == ERROR) ||
+	 (vtpConfigBankEncode(&conf[1], check, VTP_CFGBANK_MAXWORDS) != nwords) ||
+	 memcmp(bank, check, nwords*4))
+	{
+	  printf("%s: ERROR: bank does not decode to the same settings\n", argv[0]);
+	  exit(1);
+	}
+    }
+  else
+    {
+      if((f = fopen(argv[optind], "r")) == NULL)
+	{
+	  perror(argv[optind]);
+	  exit(1);
+	}
+      nwords = fread(bank, 4, VTP_CFGBANK_MAXWORDS, f);
+      fclose(f);
+      n = vtpConfigBankDecode(bank, nwords, &conf[0]);
+      if(n == ERROR)
+	exit(1);
+    }
+
+  vtpConfigBankPrint(bank, nwords);
+  printf("%d records\n", n);
+
+  if(out)
+    {
+      if(((f = fopen(out, "w")) == NULL) || (fwrite(bank, 4, nwords, f) != (size_t)nwords))
+	{
+	  perror(out);
+	  exit(1);
+	}
+      fclose(f);
+    }
+
+  free(conf);
+  exit(0);
+}
@@ -0,0 +1,220 @@
+/*
+ * File:
+ *    vtpConfigBench.c
+ *
+ * Description:
+ *    Times vtpReadConfigFile() on a large multi-crate config file and
+ *    prints a hash of the parsed VTP_CONF, so that two versions of libvtp
+ *    can be compared for speed and for identical parsed state.
+ *
+ *    Without -f a file is generated: 'crates' sections of the typical
+ *    streaming keys, with the section of this host in the middle.
+ *    The library output is sent to /dev/null while timing.  The first
+ *    parse reads the whole file and builds the crate index, it is
+ *    reported apart from the (indexed) parses that follow.
+ *
+ *    usage: vtpConfigBench [-c crates] [-n parses] [-f file] [-k]
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "vtpLib.h"
+#include "vtpConfig.h"
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static void
+writeCrate(FILE *f, const char *name, int icrate)
+{
+  int i;
+
+  fprintf(f, "\n#\n# crate %d\n#\nVTP_CRATE %s\n\n", icrate, name);
+  fprintf(f, "VTP_FIRMWARE_V7 fe_vtp_hallb_v7_streaming_fw%d.bin\n", icrate % 4);
+  fprintf(f, "VTP_FIRMWARE_Z7 fe_vtp_hallb_z7_streaming_fw%d.bin\n", icrate % 4);
+  fprintf(f, "VTP_REFCLK 250\n");
+  fprintf(f, "VTP_W_OFFSET %d\n", 2000 + icrate);
+  fprintf(f, "VTP_W_WIDTH 800\n");
+  fprintf(f, "VTP_PAYLOAD_EN  1 1 1 1 1 1 1 1 1 1 1 1 1 1 1 %d\n", icrate & 1);
+  fprintf(f, "VTP_FIBER_EN 1 0 0 0\n\n");
+  fprintf(f, "VTP_STREAMING_ROCID %d\n", icrate + 1);
+  fprintf(f, "VTP_STREAMING_NFRAME_BUF 1000\n");
+  fprintf(f, "VTP_STREAMING_FRAMELEN 65536\n");
+  fprintf(f, "VTP_NUM_CONNECTIONS 1\n");
+  fprintf(f, "VTP_NET_MODE 0\n");
+  fprintf(f, "VTP_LOCAL_PORT %d\n", 10001 + icrate);
+  fprintf(f, "VTP_STATS_HOST stats%d.jlab.org\n", icrate % 8);
+  fprintf(f, "VTP_STATS_PORT 9000\n");
+  fprintf(f, "VTP_SYNC_RATE 1\n");
+  fprintf(f, "VTP_SYNC_DEST sync%d.jlab.org 19531\n", icrate % 8);
+  fprintf(f, "VTP_LINK_SUPERVISOR 1\n");
+  fprintf(f, "VTP_LINK_STALL_MS 500\n");
+  fprintf(f, "VTP_FRAMELEN_ADAPT 1\n");
+  fprintf(f, "VTP_MTU_PROBE_TIMEOUT_MS 200\n\n");
+  for(i=0; i<2; i++)
+    {
+      fprintf(f, "VTP_STREAMING %d\n", i);
+      fprintf(f, "VTP_STREAMING_CONNECT 1\n");
+      fprintf(f, "VTP_STREAMING_IPADDR 129 57 %d %d\n", 69 + i, (icrate + 10) & 0xFF);
+      fprintf(f, "VTP_STREAMING_SUBNET 255 255 255 0\n");
+      fprintf(f, "VTP_STREAMING_GATEWAY 129 57 %d 1\n", 69 + i);
+      fprintf(f, "VTP_STREAMING_MAC 0xce 0xba 0xf0 0x03 0x%02x 0x%02x\n", icrate & 0xFF, i);
+      fprintf(f, "VTP_STREAMING_DESTIP 129.57.177.%d\n", 3 + i);
+      fprintf(f, "VTP_STREAMING_DESTIPPORT %d\n", 46100 + i);
+      fprintf(f, "VTP_STREAMING_LOCALPORT %d\n\n", 10001 + i);
+    }
+  fprintf(f, "VTP_CRATE end\n");
+}
+
+static int
+makeConfig(char *fname, int ncrate)
+{
+  char host[ROCLEN], name[ROCLEN];
+  FILE *f;
+  int fd, i;
+
+  gethostname(host, ROCLEN);
+  host[ROCLEN-1] = '\0';
+  host[strcspn(host, ".")] = '\0';
+
+  fd = mkstemp(fname);
+  if((fd < 0) || ((f = fdopen(fd, "w")) == NULL))
+    {
+      perror("vtpConfigBench: mkstemp");
+      return ERROR;
+    }
+
+  fprintf(f, "#\n# vtpConfigBench: %d crates, this host (%s) is crate %d\n#\n",
+	  ncrate, host, ncrate/2);
+  for(i=0; i<ncrate; i++)
+    {
+      if(i == ncrate/2)
+	snprintf(name, ROCLEN, "%s", host);
+      else
+	snprintf(name, ROCLEN, "vtpbench%d", i);
+      writeCrate(f, name, i);
+    }
+  fclose(f);
+
+  return OK;
+}
+
+static int
+countLines(const char *fname)
+{
+  FILE *f;
+  int c, n = 0;
+
+  if((f = fopen(fname, "r")) == NULL)
+    return 0;
+  while((c = getc(f)) != EOF)
+    if(c == '\n')
+      n++;
+  fclose(f);
+
+  return n;
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-c crates] [-n parses] [-f file] [-k]\n"
+	 "  -c crates   crates in the generated file (default 200)\n"
+	 "  -n parses   parses to time (default 100)\n"
+	 "  -f file     time this config file instead (absolute or ./ path)\n"
+	 "  -k          keep the generated file\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  char fname[256] = "/tmp/vtpConfigBench_XXXXXX";
+  VTP_CONF *conf;
+  uint64_t t0, t1, tfirst = 0;
+  uint32_t hash = 2166136261u;
+  unsigned char *p;
+  int opt, ncrate = 200, nparse = 100, keep = 0, given = 0, nlines, i, rval = OK, out;
+  double ms;
+
+  while((opt = getopt(argc, argv, "c:n:f:kh")) != -1)
+    {
+      switch(opt)
+	{
+	case 'c': ncrate = atoi(optarg); break;
+	case 'n': nparse = atoi(optarg); break;
+	case 'f': snprintf(fname, sizeof(fname), "%s", optarg); given = 1; break;
+	case 'k': keep = 1; break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+  if((ncrate < 1) || (nparse < 1))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  if(!given && (makeConfig(fname, ncrate) != OK))
+    exit(1);
+  nlines = countLines(fname);
+
+  conf = malloc(sizeof(VTP_CONF));
+  if(conf == NULL)
+    exit(1);
+
+  /* Keep the library chatter out of the timing */
+  fflush(stdout);
+  out = dup(1);
+  i = open("/dev/null", O_WRONLY);
+  dup2(i, 1);
+  close(i);
+
+  t0 = nowNs();
+  for(i=0; i<nparse; i++)
+    {
+      vtpInitGlobals();
+      rval = vtpReadConfigFile(fname);
+      if(i == 0)
+	tfirst = nowNs();
+    }
+  t1 = nowNs();
+
+  fflush(stdout);
+  dup2(out, 1);
+  close(out);
+
+  vtpGetConf(conf);
+  p = (unsigned char *)conf;
+  for(i=0; i<(int)sizeof(VTP_CONF); i++)
+    hash = (hash ^ p[i]) * 16777619u;
+
+  printf("%s: %d lines, %d parses, vtpReadConfigFile returned %d\n",
+	 fname, nlines, nparse, rval);
+  ms = (double)(tfirst - t0)*1.0e-6;
+  printf("  first parse %.3f ms  %.2f M lines/s\n", ms, nlines/ms*1.0e-3);
+  if(nparse > 1)
+    {
+      ms = (double)(t1 - tfirst)*1.0e-6/(nparse - 1);
+      printf("  then        %.3f ms/parse\n", ms);
+    }
+  printf("  VTP_CONF hash 0x%08x (%d bytes)\n", hash, (int)sizeof(VTP_CONF));
+
+  if(!given && !keep)
+    unlink(fname);
+  free(conf);
+
+  exit(rval == OK ? 0 : 1);
+}
@@ -0,0 +1,812 @@
+/*
+ * File:
+ *    vtpSkewMon.c
+ *
+ * Description:
+ *    Cross-crate frame skew monitor.  Runs on a Linux host and collects
+ *    the LC sync packets (vtpStreamingSyncSetData) of every ROC / stream,
+ *    either live on a UDP port (VTP_SYNC_DEST) or from a capture file
+ *    (pcap: Ethernet, Linux cooked, raw IP), so it can be run and tested
+ *    fully offline.  -w records the live sync packets to a pcap file for
+ *    a later replay with -r.
+ *
+ *    Each source (src_id) reports the last frame sent and its wall clock
+ *    time.  With a common frame length, the time of frame 0
+ *
+ *        offset = nanos - evt_num * frame_ns
+ *
+ *    is the same for all crates of a synchronized system.  The skew of a
+ *    source is its offset against the median offset of all active
+ *    sources; the frame skew is the difference of the frame numbers,
+ *    extrapolated (evt_rate) to a common time.  The drift of a source is
+ *    the slope of its skew over time (least squares, exponentially
+ *    weighted with the -W window), so a crate whose frame clock runs off
+ *    is flagged long before its skew reaches the -k limit.
+ *
+ *    Reports the per source skew / drift every interval (live: wall
+ *    clock, offline: capture time), alarms when a source crosses the
+ *    skew or drift limit or stops sending, and the skew distribution
+ *    (log2 histogram) at the end.
+ *
+ *    usage: vtpSkewMon [-p port | -r file] [-w file] [-f frame_ns]
+ *                      [-i interval] [-d seconds] [-k skew_ns]
+ *                      [-D drift_ns_per_s] [-W window_s]
+ *
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "vtpLib.h"
+
+#define SKEW_MAX_SRC         64
+#define SKEW_HIST_BINS       40
+#define SKEW_PKT_MAX         65536
+#define SKEW_DRIFT_MIN_PTS   10
+
+#define PCAP_MAGIC_US        0xa1b2c3d4
+#define PCAP_MAGIC_NS        0xa1b23c4d
+#define PCAP_LINK_NULL       0
+#define PCAP_LINK_EN10MB     1
+#define PCAP_LINK_RAW        101
+#define PCAP_LINK_SLL        113
+#define PCAP_LINK_IPV4       228
+#define PCAP_LINK_SLL2       276
+
+typedef struct
+{
+  uint32_t magic;
+  uint16_t version_major;
+  uint16_t version_minor;
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+} pcap_file_hdr;
+
+typedef struct
+{
+  uint32_t ts_sec;
+  uint32_t ts_frac;              /* us or ns, from the file magic */
+  uint32_t incl_len;
+  uint32_t orig_len;
+} pcap_rec_hdr;
+
+#define SKEW_ALARM_SKEW      0x1
+#define SKEW_ALARM_DRIFT     0x2
+#define SKEW_ALARM_LOST      0x4
+
+typedef struct
+{
+  int      used;
+  uint32_t src_id;
+  uint64_t npkts, nerrors, nbackwards;
+
+  uint64_t evt_num, nanos, t_arr;  /* last packet */
+  uint32_t evt_rate;
+  int64_t  offset;                 /* nanos - evt_num*frame_ns */
+
+  int      have_skew;
+  double   skew, skew_min, skew_max, skew_sum, skew_sum2;
+  uint64_t nskew;
+  double   frame_skew;
+
+  /* Exponentially weighted least squares of skew vs. time */
+  uint64_t t_ref;
+  double   skew_ref;
+  double   w, wx, wy, wxx, wxy;
+  uint64_t t_fit;
+  uint64_t nfit;
+  uint32_t fit_gen;
+  double   drift;                  /* ns/s */
+
+  int      alarm;
+  uint64_t nalarm;
+  uint64_t hist[SKEW_HIST_BINS];
+} skew_src;
+
+static skew_src srcs[SKEW_MAX_SRC];
+static uint64_t skewHist[SKEW_HIST_BINS];
+static int      nsrc = 0;
+static uint64_t refMask = 0;     /* sources in the median reference */
+static uint32_t refGen = 0;      /* bumped when refMask changes */
+
+static volatile int running = 1;
+static int      syncPort = 0;
+static char    *readFile = NULL, *writeFile = NULL;
+static FILE    *wfp = NULL;
+static uint32_t frameNs = 65536;
+static double   skewLimitNs = 0, driftLimit = 100.0, windowS = 60.0;
+static uint64_t staleNs = 0;
+
+static uint64_t
+nowNs(clockid_t clk)
+{
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static int
+histBin(double ns)
+{
+  uint64_t v = (uint64_t)fabs(ns);
+  int bin = 0;
+
+  while(v && (bin < SKEW_HIST_BINS-1))
+    {
+      v >>= 1;
+      bin++;
+    }
+  return bin;
+}
+
+static void
+sigHandler(int sig)
+{
+  running = 0;
+}
+
+static skew_src *
+srcGet(uint32_t id)
+{
+  int i;
+
+  for(i=0; i<nsrc; i++)
+    if(srcs[i].src_id == id)
+      return &srcs[i];
+
+  if(nsrc >= SKEW_MAX_SRC)
+    return NULL;
+
+  memset(&srcs[nsrc], 0, sizeof(skew_src));
+  srcs[nsrc].used   = 1;
+  srcs[nsrc].src_id = id;
+  return &srcs[nsrc++];
+}
+
+static int
+cmpDouble(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+/*
+ * Median of the frame 0 offsets of the sources heard within the stale time.
+ * A source joining or leaving shifts the median, so the drift fits restart.
+ */
+static int
+medianOffset(uint64_t t, double *median)
+{
+  double v[SKEW_MAX_SRC];
+  uint64_t mask = 0;
+  int i, n = 0;
+
+  for(i=0; i<nsrc; i++)
+    if(srcs[i].npkts && ((t - srcs[i].t_arr) <= staleNs))
+      {
+	v[n++] = (double)srcs[i].offset;
+	mask |= 1ull << i;
+      }
+
+  if(mask != refMask)
+    {
+      refMask = mask;
+      refGen++;
+    }
+
+  if(n == 0)
+    return 0;
+
+  /* Lower median: the offset of an actual crate, a drifting crate of an
+     even count does not drag the reference along */
+  qsort(v, n, sizeof(double), cmpDouble);
+  *median = v[(n-1)/2];
+  return n;
+}
+
+static void
+alarmUpdate(skew_src *s, int alarm)
+{
+  int set = alarm & ~s->alarm, clr = s->alarm & ~alarm;
+
+  if(set)
+    {
+      s->nalarm++;
+      printf("ALARM   src %u:%s%s%s skew %.0f ns (%.2f frames) drift %.1f ns/s\n",
+	     s->src_id,
+	     (set & SKEW_ALARM_SKEW)  ? " SKEW"  : "",
+	     (set & SKEW_ALARM_DRIFT) ? " DRIFT" : "",
+	     (set & SKEW_ALARM_LOST)  ? " LOST"  : "",
+	     s->skew, s->skew / frameNs, s->drift);
+      fflush(stdout);
+    }
+  if(clr)
+    {
+      printf("CLEARED src %u:%s%s%s\n", s->src_id,
+	     (clr & SKEW_ALARM_SKEW)  ? " SKEW"  : "",
+	     (clr & SKEW_ALARM_DRIFT) ? " DRIFT" : "",
+	     (clr & SKEW_ALARM_LOST)  ? " LOST"  : "");
+      fflush(stdout);
+    }
+  s->alarm = alarm;
+}
+
+/* Add a skew sample to the drift fit of a source */
+static void
+driftUpdate(skew_src *s, uint64_t t)
+{
+  double x, y, d, den;
+
+  if(s->fit_gen != refGen)
+    {
+      s->fit_gen = refGen;
+      s->w = s->wx = s->wy = s->wxx = s->wxy = 0;
+      s->nfit  = 0;
+      s->drift = 0;
+    }
+
+  if(s->nfit == 0)
+    {
+      s->t_ref    = t;
+      s->skew_ref = s->skew;
+      s->t_fit    = t;
+    }
+
+  /* Forget old samples with the window time constant */
+  d = exp(-(double)(t - s->t_fit)*1.0e-9 / windowS);
+  s->w *= d; s->wx *= d; s->wy *= d; s->wxx *= d; s->wxy *= d;
+  s->t_fit = t;
+
+  x = (double)(t - s->t_ref)*1.0e-9;
+  y = s->skew - s->skew_ref;
+  s->w   += 1.0;
+  s->wx  += x;
+  s->wy  += y;
+  s->wxx += x*x;
+  s->wxy += x*y;
+  s->nfit++;
+
+  den = s->w*s->wxx - s->wx*s->wx;
+  if((s->nfit >= SKEW_DRIFT_MIN_PTS) && (den > 0))
+    s->drift = (s->w*s->wxy - s->wx*s->wy) / den;
+}
+
+/* Sync packet from any input, t = arrival (live) or capture time */
+static void
+syncPacket(const uint8_t *p, int n, uint64_t t)
+{
+  VTP_SYNC_PKT pkt;
+  skew_src *s;
+  uint64_t evt;
+  double median;
+  int alarm;
+
+  if((n < VTP_SYNC_PKT_LEN) ||
+     (p[0] != VTP_SYNC_MAGIC_0) || (p[1] != VTP_SYNC_MAGIC_1))
+    return;
+
+  memcpy(&pkt, p, sizeof(pkt));
+  s = srcGet(ntohl(pkt.src_id));
+  if(s == NULL)
+    return;
+
+  s->npkts++;
+  if(pkt.version != VTP_SYNC_VERSION)
+    {
+      s->nerrors++;
+      return;
+    }
+
+  evt = be64toh(pkt.evt_num);
+  if((s->npkts > 1) && (evt < s->evt_num))
+    s->nbackwards++;
+
+  s->evt_num  = evt;
+  s->evt_rate = ntohl(pkt.evt_rate);
+  s->nanos    = be64toh(pkt.nanos);
+  s->t_arr    = t;
+  s->offset   = (int64_t)(s->nanos - evt*(uint64_t)frameNs);
+
+  /* Need at least one other source for a skew */
+  if(medianOffset(t, &median) < 2)
+    return;
+
+  s->skew = (double)s->offset - median;
+  if(!s->have_skew)
+    {
+      s->have_skew = 1;
+      s->skew_min = s->skew_max = s->skew;
+    }
+  if(s->skew < s->skew_min) s->skew_min = s->skew;
+  if(s->skew > s->skew_max) s->skew_max = s->skew;
+  s->skew_sum  += s->skew;
+  s->skew_sum2 += s->skew*s->skew;
+  s->nskew++;
+  s->hist[histBin(s->skew)]++;
+  skewHist[histBin(s->skew)]++;
+
+  driftUpdate(s, t);
+
+  alarm = 0;
+  if(fabs(s->skew) > skewLimitNs)
+    alarm |= SKEW_ALARM_SKEW;
+  if((s->nfit >= SKEW_DRIFT_MIN_PTS) && (fabs(s->drift) > driftLimit))
+    alarm |= SKEW_ALARM_DRIFT;
+  alarmUpdate(s, alarm);
+}
+
+/* Frame numbers extrapolated to time t, against their median */
+static void
+frameSkew(uint64_t t)
+{
+  double v[SKEW_MAX_SRC], f[SKEW_MAX_SRC], median;
+  int i, n = 0;
+
+  for(i=0; i<nsrc; i++)
+    {
+      skew_src *s = &srcs[i];
+
+      s->frame_skew = 0;
+      f[i] = 0;
+      if(!s->npkts || ((t - s->t_arr) > staleNs))
+	continue;
+      f[i] = (double)s->evt_num + (double)(int64_t)(t - s->t_arr)*1.0e-9*s->evt_rate;
+      v[n++] = f[i];
+    }
+  if(n < 2)
+    return;
+
+  qsort(v, n, sizeof(double), cmpDouble);
+  median = v[(n-1)/2];
+
+  for(i=0; i<nsrc; i++)
+    if(srcs[i].npkts && ((t - srcs[i].t_arr) <= staleNs))
+      srcs[i].frame_skew = f[i] - median;
+}
+
+static void
+printHist(const char *name, uint64_t *h)
+{
+  int i, first = -1, last = -1;
+
+  for(i=0; i<SKEW_HIST_BINS; i++)
+    if(h[i])
+      {
+	if(first < 0)
+	  first = i;
+	last = i;
+      }
+  if(last < 0)
+    return;
+
+  printf("  %s histogram |skew| (ns):\n", name);
+  for(i=first; i<=last; i++)
+    printf("    %12llu - %-12llu %12llu\n",
+	   i ? (1ull<<(i-1)) : 0ull, (1ull<<i), (unsigned long long)h[i]);
+}
+
+static void
+report(uint64_t t, int final)
+{
+  skew_src *s;
+  double rms;
+  int i, active = 0, ndrift = 0;
+
+  frameSkew(t);
+
+  for(i=0; i<nsrc; i++)
+    {
+      s = &srcs[i];
+      if((t - s->t_arr) > staleNs)
+	alarmUpdate(s, s->alarm | SKEW_ALARM_LOST);
+      else
+	{
+	  active++;
+	  if(s->alarm & SKEW_ALARM_LOST)
+	    alarmUpdate(s, s->alarm & ~SKEW_ALARM_LOST);
+	}
+      if(s->alarm & SKEW_ALARM_DRIFT)
+	ndrift++;
+    }
+
+  printf("%d of %d sources active, %d drifting\n", active, nsrc, ndrift);
+  printf("  %6s %8s %12s %9s %12s %12s %12s %10s %9s %10s %s\n",
+	 "src", "pkts", "frame", "rate", "skew(ns)", "min", "max", "rms",
+	 "dframe", "drift ns/s", "");
+  for(i=0; i<nsrc; i++)
+    {
+      s = &srcs[i];
+      rms = s->nskew ? sqrt(s->skew_sum2 / s->nskew) : 0;
+      printf("  %6u %8llu %12llu %9u %12.0f %12.0f %12.0f %10.0f %9.2f %10.1f %s%s%s\n",
+	     s->src_id, (unsigned long long)s->npkts, (unsigned long long)s->evt_num,
+	     s->evt_rate, s->skew, s->skew_min, s->skew_max, rms, s->frame_skew, s->drift,
+	     (s->alarm & SKEW_ALARM_SKEW)  ? " SKEW"  : "",
+	     (s->alarm & SKEW_ALARM_DRIFT) ? " DRIFT" : "",
+	     (s->alarm & SKEW_ALARM_LOST)  ? " LOST"  : "");
+      if(final && (s->nerrors || s->nbackwards))
+	printf("         errors %llu backwards %llu\n",
+	       (unsigned long long)s->nerrors, (unsigned long long)s->nbackwards);
+    }
+
+  if(final)
+    {
+      printHist("All sources", skewHist);
+      for(i=0; i<nsrc; i++)
+	if(srcs[i].nalarm)
+	  printf("  src %u: %llu alarms\n", srcs[i].src_id,
+		 (unsigned long long)srcs[i].nalarm);
+    }
+  fflush(stdout);
+}
+
+/*
+ * pcap input / output
+ */
+
+static uint16_t
+ipChecksum(const uint8_t *p, int n)
+{
+  uint32_t sum = 0;
+  int i;
+
+  for(i=0; i<n; i+=2)
+    sum += (p[i] << 8) | p[i+1];
+  while(sum >> 16)
+    sum = (sum & 0xffff) + (sum >> 16);
+  return htons(~sum & 0xffff);
+}
+
+static int
+pcapOpenWrite(const char *fname)
+{
+  pcap_file_hdr fh;
+
+  wfp = fopen(fname, "w");
+  if(wfp == NULL)
+    {
+      printf("%s: ERROR: cannot open %s: %s\n", __func__, fname, strerror(errno));
+      return -1;
+    }
+
+  memset(&fh, 0, sizeof(fh));
+  fh.magic         = PCAP_MAGIC_NS;
+  fh.version_major = 2;
+  fh.version_minor = 4;
+  fh.snaplen       = SKEW_PKT_MAX;
+  fh.linktype      = PCAP_LINK_RAW;
+  fwrite(&fh, sizeof(fh), 1, wfp);
+  return 0;
+}
+
+/* Record a received datagram as raw IPv4/UDP */
+static void
+pcapWrite(const struct sockaddr_in *peer, int dport, const uint8_t *p, int n, uint64_t t)
+{
+  pcap_rec_hdr rh;
+  uint8_t hdr[28];
+
+  memset(hdr, 0, sizeof(hdr));
+  hdr[0] = 0x45;
+  hdr[2] = (n + 28) >> 8;
+  hdr[3] = (n + 28) & 0xff;
+  hdr[6] = 0x40;                 /* DF */
+  hdr[8] = 64;
+  hdr[9] = IPPROTO_UDP;
+  memcpy(&hdr[12], &peer->sin_addr, 4);
+  hdr[16] = 127; hdr[19] = 1;    /* destination: local */
+  *(uint16_t *)&hdr[10] = ipChecksum(hdr, 20);
+  memcpy(&hdr[20], &peer->sin_port, 2);
+  hdr[22] = dport >> 8;
+  hdr[23] = dport & 0xff;
+  hdr[24] = (n + 8) >> 8;
+  hdr[25] = (n + 8) & 0xff;
+
+  rh.ts_sec   = t / 1000000000ull;
+  rh.ts_frac  = t % 1000000000ull;
+  rh.incl_len = n + 28;
+  rh.orig_len = n + 28;
+  fwrite(&rh, sizeof(rh), 1, wfp);
+  fwrite(hdr, sizeof(hdr), 1, wfp);
+  fwrite(p, n, 1, wfp);
+}
+
+/* UDP payload of a captured packet, or NULL */
+static const uint8_t *
+pcapUdp(uint32_t link, const uint8_t *p, int n, int *len, int *dport)
+{
+  int off = 0, ihl, proto, ulen;
+  uint16_t etype = 0x0800;
+
+  switch(link)
+    {
+    case PCAP_LINK_EN10MB:
+      if(n < 14)
+	return NULL;
+      etype = (p[12] << 8) | p[13];
+      off = 14;
+      while(((etype == 0x8100) || (etype == 0x88a8)) && (n >= off + 4))
+	{
+	  etype = (p[off+2] << 8) | p[off+3];
+	  off += 4;
+	}
+      break;
+    case PCAP_LINK_SLL:
+      if(n < 16)
+	return NULL;
+      etype = (p[14] << 8) | p[15];
+      off = 16;
+      break;
+    case PCAP_LINK_SLL2:
+      if(n < 20)
+	return NULL;
+      etype = (p[0] << 8) | p[1];
+      off = 20;
+      break;
+    case PCAP_LINK_NULL:
+      off = 4;
+      break;
+    case PCAP_LINK_RAW:
+    case PCAP_LINK_IPV4:
+      break;
+    default:
+      return NULL;
+    }
+
+  if((etype != 0x0800) || (n < off + 20) || ((p[off] >> 4) != 4))
+    return NULL;
+
+  ihl   = (p[off] & 0xf) * 4;
+  proto = p[off+9];
+  if((proto != IPPROTO_UDP) || (n < off + ihl + 8))
+    return NULL;
+  /* Fragments: sync packets are never fragmented */
+  if(((p[off+6] & 0x1f) << 8 | p[off+7]) || (p[off+6] & 0x20))
+    return NULL;
+
+  off  += ihl;
+  *dport = (p[off+2] << 8) | p[off+3];
+  ulen = ((p[off+4] << 8) | p[off+5]) - 8;
+  off  += 8;
+  if((ulen < 0) || (n < off + ulen))
+    return NULL;
+
+  *len = ulen;
+  return &p[off];
+}
+
+static int
+pcapRead(const char *fname, int interval, int duration)
+{
+  FILE *fp;
+  pcap_file_hdr fh;
+  pcap_rec_hdr rh;
+  uint8_t *buf;
+  const uint8_t *udp;
+  uint64_t t, t0 = 0, tlast = 0, tnext = 0, npkts = 0, nsync = 0;
+  int swap, nsec, len, dport;
+
+  fp = fopen(fname, "r");
+  if(fp == NULL)
+    {
+      printf("%s: ERROR: cannot open %s: %s\n", __func__, fname, strerror(errno));
+      return -1;
+    }
+
+  if(fread(&fh, sizeof(fh), 1, fp) != 1)
+    {
+      printf("%s: ERROR: %s: short file\n", __func__, fname);
+      fclose(fp);
+      return -1;
+    }
+
+  swap = (fh.magic == __builtin_bswap32(PCAP_MAGIC_US)) ||
+    (fh.magic == __builtin_bswap32(PCAP_MAGIC_NS));
+  nsec = (fh.magic == PCAP_MAGIC_NS) || (fh.magic == __builtin_bswap32(PCAP_MAGIC_NS));
+  if(!swap && (fh.magic != PCAP_MAGIC_US) && (fh.magic != PCAP_MAGIC_NS))
+    {
+      printf("%s: ERROR: %s: not a pcap file (magic 0x%08x; pcapng is not supported)\n",
+	     __func__, fname, fh.magic);
+      fclose(fp);
+      return -1;
+    }
+  if(swap)
+    fh.linktype = __builtin_bswap32(fh.linktype);
+  fh.linktype &= 0xffff;
+
+  printf("Reading %s (link type %u)\n", fname, fh.linktype);
+
+  buf = malloc(SKEW_PKT_MAX);
+  while(running && (fread(&rh, sizeof(rh), 1, fp) == 1))
+    {
+      if(swap)
+	{
+	  rh.ts_sec   = __builtin_bswap32(rh.ts_sec);
+	  rh.ts_frac  = __builtin_bswap32(rh.ts_frac);
+	  rh.incl_len = __builtin_bswap32(rh.incl_len);
+	}
+      if((rh.incl_len > SKEW_PKT_MAX) || (fread(buf, rh.incl_len, 1, fp) != 1))
+	{
+	  printf("%s: ERROR: %s: truncated record\n", __func__, fname);
+	  break;
+	}
+      npkts++;
+
+      t = (uint64_t)rh.ts_sec*1000000000ull + (nsec ? rh.ts_frac : rh.ts_frac*1000ull);
+      if(t0 == 0)
+	tnext = (t0 = t) + (uint64_t)interval*1000000000ull;
+
+      /* Reports on the capture clock */
+      while(t >= tnext)
+	{
+	  report(tnext, 0);
+	  tnext += (uint64_t)interval*1000000000ull;
+	}
+      if(duration && ((t - t0) >= (uint64_t)duration*1000000000ull))
+	break;
+      tlast = t;
+
+      udp = pcapUdp(fh.linktype, buf, rh.incl_len, &len, &dport);
+      if(udp == NULL)
+	continue;
+      if(syncPort && (dport != syncPort))
+	continue;
+      nsync++;
+      syncPacket(udp, len, t);
+    }
+
+  printf("\n%llu packets, %llu UDP on the sync port, %.3f s of capture\n",
+	 (unsigned long long)npkts, (unsigned long long)nsync,
+	 (double)(tlast - t0)*1.0e-9);
+  report(tlast, 1);
+
+  free(buf);
+  fclose(fp);
+  return 0;
+}
+
+static int
+liveRead(int interval, int duration)
+{
+  struct sockaddr_in addr, peer;
+  struct timeval tv;
+  socklen_t plen;
+  uint8_t *buf;
+  uint64_t t, t0, tnext;
+  int s, n, one = 1;
+
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(syncPort);
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      printf("%s: ERROR: bind port %d: %s\n", __func__, syncPort, strerror(errno));
+      close(s);
+      return -1;
+    }
+
+  tv.tv_sec  = 0;
+  tv.tv_usec = 100000;
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  printf("Listening for sync packets on port %d\n", syncPort);
+
+  buf = malloc(SKEW_PKT_MAX);
+  t0 = nowNs(CLOCK_REALTIME);
+  tnext = t0 + (uint64_t)interval*1000000000ull;
+  while(running)
+    {
+      plen = sizeof(peer);
+      n = recvfrom(s, buf, SKEW_PKT_MAX, 0, (struct sockaddr *)&peer, &plen);
+      t = nowNs(CLOCK_REALTIME);
+      if(n > 0)
+	{
+	  if(wfp)
+	    pcapWrite(&peer, syncPort, buf, n, t);
+	  syncPacket(buf, n, t);
+	}
+
+      if(t >= tnext)
+	{
+	  report(t, 0);
+	  tnext += (uint64_t)interval*1000000000ull;
+	}
+      if(duration && ((t - t0) >= (uint64_t)duration*1000000000ull))
+	running = 0;
+    }
+
+  printf("\n");
+  report(nowNs(CLOCK_REALTIME), 1);
+
+  free(buf);
+  close(s);
+  return 0;
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-p port | -r file] [-w file] [-f frame_ns] [-i interval]\n"
+	 "          [-d seconds] [-k skew_ns] [-D drift] [-W window]\n"
+	 "  -p port      sync port (VTP_SYNC_DEST); filters the capture with -r\n"
+	 "  -r file      read the sync packets from a pcap capture\n"
+	 "  -w file      record the live sync packets to a pcap file\n"
+	 "  -f frame_ns  frame length (VTP_STREAMING_FRAMELEN, default 65536)\n"
+	 "  -i interval  report interval in seconds (default 1)\n"
+	 "  -d seconds   run time / capture time to read (default: all)\n"
+	 "  -k skew_ns   skew alarm limit (default: one frame)\n"
+	 "  -D drift     drift alarm limit in ns/s (default 100)\n"
+	 "  -W window    drift fit time constant in seconds (default 60)\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int opt, interval = 1, duration = 0, rval;
+
+  while((opt = getopt(argc, argv, "p:r:w:f:i:d:k:D:W:h")) != -1)
+    {
+      switch(opt)
+	{
+	case 'p': syncPort    = atoi(optarg); break;
+	case 'r': readFile    = optarg; break;
+	case 'w': writeFile   = optarg; break;
+	case 'f': frameNs     = strtoul(optarg, NULL, 0); break;
+	case 'i': interval    = atoi(optarg); break;
+	case 'd': duration    = atoi(optarg); break;
+	case 'k': skewLimitNs = atof(optarg); break;
+	case 'D': driftLimit  = atof(optarg); break;
+	case 'W': windowS     = atof(optarg); break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+
+  if((!readFile && ((syncPort <= 0) || (syncPort > 65535))) ||
+     (readFile && writeFile) || (syncPort < 0) || (syncPort > 65535) ||
+     (interval < 1) || (frameNs == 0) || (windowS <= 0))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  if(skewLimitNs <= 0)
+    skewLimitNs = frameNs;
+  /* A source is lost when it misses two reports */
+  staleNs = 2ull*interval*1000000000ull;
+
+  signal(SIGINT, sigHandler);
+  signal(SIGTERM, sigHandler);
+
+  if(writeFile && (pcapOpenWrite(writeFile) < 0))
+    exit(1);
+
+  if(readFile)
+    rval = pcapRead(readFile, interval, duration);
+  else
+    rval = liveRead(interval, duration);
+
+  if(wfp)
+    fclose(wfp);
+
+  return (rval < 0) ? 1 : 0;
+}
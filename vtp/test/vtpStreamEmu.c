@@ -0,0 +1,729 @@
+/*
+ * File:
+ *    vtpStreamEmu.c
+ *
+ * Description:
+ *    Software emulator of the VTP FADC streaming output, for load testing
+ *    receivers (vtpStreamRecv, CODA EMU) and the EJFAT load balancer
+ *    without a crate.  Runs on any Linux host.
+ *
+ *    Takes the frame length, payload mask, stream count, ROC id, transport
+ *    and destination from a vtp_<rocname>.cnf file and sends, per stream:
+ *      - Prestart and Go control events (as vtpStreamingEvioWriteControl)
+ *      - one EVIO block per frame: ROC Time Slice Bank (tag rocid) with the
+ *        Stream Info Bank (frame number, timestamp), Aggregation Info
+ *        Segment and one bank of synthetic hits per enabled payload
+ *      - the End control event with the number of frames sent
+ *    with the headers selected the same way as the firmware:
+ *      TCP (VTP_NET_MODE 0)        cMsg header  (VTP_STREB_CMSG_HDR_EN)
+ *      UDP + VTP_ENABLE_EJFAT 1    LB + RE headers (VTP_STREB_EJFAT_EN)
+ *      UDP                         EVIO split into MTU sized datagrams
+ *    and optional LC sync packets to the VTP_SYNC_DEST / VTP_STATS_HOST
+ *    destinations.  With -M the UDP MTU is first probed against an echo
+ *    port at the destination (vtpStreamRecv -E), as vtpStreamingMtuTune()
+ *    does on the VTP, and the payload efficiency is reported at the end.
+ *
+ *    One thread per stream; frames are pre-built and only the frame
+ *    dependent words are patched, UDP packets are sent in sendmmsg()
+ *    batches so a single host can drive tens of Gb/s.
+ *
+ *    usage: vtpStreamEmu -c config [-h host] [-p port] [-b bytes] [-m mtu]
+ *                        [-g Gb/s | -x] [-d seconds] [-r run] [-C] [-S]
+ *                        [-M echoport]
+ *
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <endian.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include "vtpLib.h"
+
+#define EMU_MAX_PAYLOAD      16
+#define EMU_MAX_BATCH        64
+#define EMU_PKT_HDR_LEN      (VTP_EJFAT_LB_HDR_LEN + VTP_EJFAT_RE_HDR_LEN)
+
+#define EVIO_BLOCK_MAGIC     0xc0da0100
+
+/* Configuration (from the .cnf file and the command line) */
+static int      nstreams = 1, netMode = 1, ejfat = 1, rocid = 0;
+static uint32_t frameNs = 65536, payloadMask = 0;
+static char     destHost[256] = "";
+static int      destPort = 0;
+static int      nsync = 0, syncRate = 1;
+static char     syncHost[VTP_SYNC_MAX_DEST][256];
+static int      syncPort[VTP_SYNC_MAX_DEST], syncMask[VTP_SYNC_MAX_DEST];
+static char     statsHost[256] = "";
+static int      statsPort = 0, statsInst = 0;
+
+static int      payloadBytes = 1024, mtu = 9000, sendConnData = 0, sendSync = 0;
+static int      asFastAsPossible = 0, runNumber = 1, duration = 0, echoPort = 0;
+static double   gbps = 0.;
+
+static volatile int running = 1;
+
+typedef struct
+{
+  int      inst;
+  pthread_t thr;
+  int      sock;
+  struct sockaddr_in dest;
+  uint32_t *frame;               /* pre-built EVIO block, big endian */
+  uint32_t nwords;
+  volatile uint64_t frames, bytes, pkts;
+} emu_stream;
+
+static emu_stream streams[VTP_STREAMING_MAX_STREAMS];
+
+static uint64_t
+nowNs(clockid_t clk)
+{
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static void
+sleepUntil(uint64_t t)
+{
+  struct timespec ts;
+
+  ts.tv_sec  = t / 1000000000ull;
+  ts.tv_nsec = t % 1000000000ull;
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+}
+
+static void
+sigHandler(int sig)
+{
+  running = 0;
+}
+
+static int
+resolve(const char *host, int port, struct sockaddr_in *out)
+{
+  struct addrinfo hints, *res = NULL;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  if((getaddrinfo(host, NULL, &hints, &res) != 0) || (res == NULL))
+    {
+      printf("ERROR: Unable to resolve %s\n", host);
+      return -1;
+    }
+  memcpy(out, res->ai_addr, sizeof(struct sockaddr_in));
+  out->sin_port = htons(port);
+  freeaddrinfo(res);
+  return 0;
+}
+
+static void
+readConfig(const char *fname)
+{
+  char line[512], key[64], host[256];
+  int a[16], n, i;
+  FILE *f;
+
+  f = fopen(fname, "r");
+  if(f == NULL)
+    {
+      perror(fname);
+      exit(1);
+    }
+
+  while(fgets(line, sizeof(line), f))
+    {
+      if(sscanf(line, "%63s", key) != 1 || key[0] == '#')
+	continue;
+
+      if(!strcmp(key, "VTP_STREAMING_FRAMELEN"))
+	sscanf(line, "%*s %u", &frameNs);
+      else if(!strcmp(key, "VTP_STREAMING_NSTREAMS") || !strcmp(key, "VTP_NUM_CONNECTIONS"))
+	sscanf(line, "%*s %d", &nstreams);
+      else if(!strcmp(key, "VTP_STREAMING_ROCID"))
+	sscanf(line, "%*s %d", &rocid);
+      else if(!strcmp(key, "VTP_NET_MODE"))
+	sscanf(line, "%*s %d", &netMode);
+      else if(!strcmp(key, "VTP_ENABLE_EJFAT"))
+	sscanf(line, "%*s %d", &ejfat);
+      else if(!strcmp(key, "VTP_STREAMING_DESTIPPORT"))
+	sscanf(line, "%*s %d", &destPort);
+      else if(!strcmp(key, "VTP_STREAMING_DESTIP"))
+	{
+	  /* "a b c d" or dotted */
+	  if(sscanf(line, "%*s %d %d %d %d", &a[0], &a[1], &a[2], &a[3]) == 4)
+	    sprintf(destHost, "%d.%d.%d.%d", a[0], a[1], a[2], a[3]);
+	  else
+	    sscanf(line, "%*s %255s", destHost);
+	}
+      else if(!strcmp(key, "VTP_PAYLOAD_EN"))
+	{
+	  n = sscanf(line, "%*s %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
+		     &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &a[7],
+		     &a[8], &a[9], &a[10], &a[11], &a[12], &a[13], &a[14], &a[15]);
+	  payloadMask = 0;
+	  for(i=0; i<n; i++)
+	    if(a[i])
+	      payloadMask |= (1<<i);
+	}
+      else if(!strcmp(key, "VTP_SYNC_RATE"))
+	sscanf(line, "%*s %d", &syncRate);
+      else if(!strcmp(key, "VTP_SYNC_DEST") && (nsync < VTP_SYNC_MAX_DEST))
+	{
+	  syncMask[nsync] = 0x1;
+	  if(sscanf(line, "%*s %255s %d %i", host, &syncPort[nsync], &syncMask[nsync]) >= 2)
+	    {
+	      strcpy(syncHost[nsync], host);
+	      nsync++;
+	    }
+	}
+      else if(!strcmp(key, "VTP_STATS_HOST"))
+	sscanf(line, "%*s %255s", statsHost);
+      else if(!strcmp(key, "VTP_STATS_PORT"))
+	sscanf(line, "%*s %d", &statsPort);
+      else if(!strcmp(key, "VTP_STATS_INST"))
+	sscanf(line, "%*s %d", &statsInst);
+    }
+  fclose(f);
+
+  /* Same fallback as the ROL: single stats destination */
+  if((nsync == 0) && statsHost[0] && (statsPort > 0))
+    {
+      strcpy(syncHost[0], statsHost);
+      syncPort[0] = statsPort;
+      syncMask[0] = 1 << statsInst;
+      nsync = 1;
+    }
+}
+
+/* EVIO block header (8 words) */
+static void
+blockHeader(uint32_t *w, uint32_t nwords, uint32_t blknum, uint32_t bitinfo)
+{
+  w[0] = htonl(nwords);
+  w[1] = htonl(blknum);
+  w[2] = htonl(8);
+  w[3] = htonl(1);
+  w[4] = htonl(rocid);
+  w[5] = htonl(bitinfo);
+  w[6] = htonl(0);
+  w[7] = htonl(EVIO_BLOCK_MAGIC);
+}
+
+/* Build the frame template of a stream:
+    block header, ROC Time Slice Bank, Stream Info Bank (TSS + AIS),
+    one uint32 bank of synthetic hits per enabled payload.
+   Frame number and timestamp (words 13-15) are patched per frame. */
+static void
+buildFrame(emu_stream *st)
+{
+  uint32_t *w, hits = payloadBytes/4, npay = 0, ais, i, j, k, seed;
+
+  for(i=0; i<EMU_MAX_PAYLOAD; i++)
+    if(payloadMask & (1<<i))
+      npay++;
+  ais = (npay + 1)/2;
+
+  st->nwords = 8 + 2 + 2 + 4 + 1 + ais + npay*(2 + hits);
+  st->frame  = calloc(st->nwords, 4);
+  w = st->frame;
+
+  blockHeader(w, st->nwords, 1, 0x200|4);
+  w[8]  = htonl(st->nwords - 9);                         /* ROC Time Slice Bank */
+  w[9]  = htonl((rocid<<16) | (0x10<<8) | st->inst);
+  w[10] = htonl(1 + 4 + 1 + ais);                        /* Stream Info Bank */
+  w[11] = htonl((0xff30<<16) | (0x20<<8) | st->inst);
+  w[12] = htonl((0x31<<24) | (0x01<<16) | 3);            /* Time Slice Segment */
+  w[16] = htonl((0x41<<24) | (0x85<<16) | ais);          /* Aggregation Info Segment */
+
+  k = 17;
+  for(i=0, j=0; i<EMU_MAX_PAYLOAD; i++)
+    if(payloadMask & (1<<i))
+      {
+	if(j & 1)
+	  w[k + j/2] |= htonl(i+1);
+	else
+	  w[k + j/2]  = htonl((i+1) << 16);
+	j++;
+      }
+  k += ais;
+
+  seed = 12345 + st->inst;
+  for(i=0; i<EMU_MAX_PAYLOAD; i++)
+    {
+      if(!(payloadMask & (1<<i)))
+	continue;
+      w[k++] = htonl(hits + 1);                          /* payload bank */
+      w[k++] = htonl(((i+1)<<16) | (0x01<<8));
+      for(j=0; j<hits; j++)
+	{
+	  /* channel(29-26), charge(25-13), time(12-0) */
+	  seed = seed*1103515245 + 12345;
+	  w[k++] = htonl((((seed>>8)&0xF)<<26) | (((seed>>12)&0x1FFF)<<13) |
+			 ((j * (frameNs/4) / (hits ? hits : 1)) & 0x1FFF));
+	}
+    }
+}
+
+/* Send one EVIO block (nbytes) with the stream's header mode */
+static int
+sendBlock(emu_stream *st, uint32_t *blk, uint32_t nbytes, uint64_t tick, int cmsgType)
+{
+  struct mmsghdr msg[EMU_MAX_BATCH];
+  struct iovec iov[EMU_MAX_BATCH][2];
+  uint8_t hdr[EMU_MAX_BATCH][EMU_PKT_HDR_LEN];
+  VTP_EJFAT_LB_HDR lb;
+  VTP_EJFAT_RE_HDR re;
+  uint32_t cmsg[2], off = 0, plen, maxp;
+  int n, hlen, sent;
+
+  if(netMode == 0)      /* TCP: cMsg header */
+    {
+      cmsg[0] = htonl(cmsgType);
+      cmsg[1] = htonl(nbytes);
+      iov[0][0].iov_base = cmsg;
+      iov[0][0].iov_len  = 8;
+      iov[0][1].iov_base = blk;
+      iov[0][1].iov_len  = nbytes;
+      if(writev(st->sock, iov[0], 2) != (ssize_t)(nbytes + 8))
+	return -1;
+      st->pkts++;
+      st->bytes += nbytes + 8;
+      return 0;
+    }
+
+  hlen = ejfat ? EMU_PKT_HDR_LEN : 0;
+  maxp = mtu - 28 - hlen;           /* IPv4 + UDP headers */
+
+  memset(&lb, 0, sizeof(lb));
+  lb.magic[0] = VTP_EJFAT_LB_MAGIC_0;
+  lb.magic[1] = VTP_EJFAT_LB_MAGIC_1;
+  lb.version  = 2;
+  lb.protocol = 1;
+  lb.entropy  = htons(st->inst);
+  lb.tick     = htobe64(tick);
+
+  memset(&re, 0, sizeof(re));
+  re.version  = 1 << 4;
+  re.data_id  = htons(rocid + st->inst);
+  re.length   = htonl(nbytes);
+  re.tick     = htobe64(tick);
+
+  while(off < nbytes)
+    {
+      memset(msg, 0, sizeof(msg));
+      for(n=0; (n < EMU_MAX_BATCH) && (off < nbytes); n++)
+	{
+	  plen = nbytes - off;
+	  if(plen > maxp)
+	    plen = maxp;
+	  re.offset = htonl(off);
+	  memcpy(hdr[n], &lb, sizeof(lb));
+	  memcpy(hdr[n] + sizeof(lb), &re, sizeof(re));
+	  iov[n][0].iov_base = hdr[n];
+	  iov[n][0].iov_len  = hlen;
+	  iov[n][1].iov_base = (uint8_t *)blk + off;
+	  iov[n][1].iov_len  = plen;
+	  msg[n].msg_hdr.msg_iov    = hlen ? iov[n] : &iov[n][1];
+	  msg[n].msg_hdr.msg_iovlen = hlen ? 2 : 1;
+	  off += plen;
+	  st->bytes += plen + hlen;
+	}
+      sent = 0;
+      while(sent < n)
+	{
+	  int r = sendmmsg(st->sock, msg + sent, n - sent, 0);
+	  if(r < 0)
+	    {
+	      if((errno == ENOBUFS) || (errno == EAGAIN) || (errno == EINTR))
+		continue;
+	      return -1;
+	    }
+	  sent += r;
+	}
+      st->pkts += n;
+    }
+  return 0;
+}
+
+/* CODA control event, as vtpStreamingEvioWriteControl() */
+static int
+sendControl(emu_stream *st, uint32_t type, uint32_t val0, uint32_t val1, uint64_t tick)
+{
+  uint32_t w[13];
+
+  blockHeader(w, 13, 0xffffffff, 0x1400|0x200|4);
+  w[8]  = htonl(4);
+  w[9]  = htonl((type<<16) | (1<<8) | 0);
+  w[10] = htonl(1200);
+  w[11] = htonl(val0);
+  w[12] = htonl(val1);
+
+  return sendBlock(st, w, sizeof(w), tick, (type == 0xffd4) ? 3 : 1);
+}
+
+static void *
+streamThread(void *arg)
+{
+  emu_stream *st = arg;
+  /* EMU connection data (as emuData[] in the ROL) */
+  uint32_t conn[8] = {0x634d7367, 0x20697320, 0x636f6f6c, 6, 0, 4196352, 1, 0};
+  uint64_t frame = 0, t0, tnext, period, ts;
+  int i;
+
+  if(netMode == 0)
+    {
+      st->sock = socket(AF_INET, SOCK_STREAM, 0);
+      if(connect(st->sock, (struct sockaddr *)&st->dest, sizeof(st->dest)) < 0)
+	{
+	  printf("Stream %d: ERROR: connect: %s\n", st->inst, strerror(errno));
+	  running = 0;
+	  return NULL;
+	}
+      if(sendConnData)
+	{
+	  conn[4] = rocid;
+	  conn[6] = nstreams;
+	  for(i=0; i<8; i++)
+	    conn[i] = htonl(conn[i]);
+	  if(write(st->sock, conn, sizeof(conn)) != sizeof(conn))
+	    running = 0;
+	}
+    }
+  else
+    {
+      st->sock = socket(AF_INET, SOCK_DGRAM, 0);
+      i = 16*1024*1024;
+      setsockopt(st->sock, SOL_SOCKET, SO_SNDBUF, &i, sizeof(i));
+      if(connect(st->sock, (struct sockaddr *)&st->dest, sizeof(st->dest)) < 0)
+	{
+	  printf("Stream %d: ERROR: connect: %s\n", st->inst, strerror(errno));
+	  running = 0;
+	  return NULL;
+	}
+    }
+
+  sendControl(st, 0xffd1, runNumber, 0, 0);     /* Prestart */
+  sendControl(st, 0xffd2, 0, 0, 0);             /* Go */
+
+  /* Pacing: real frame rate, a target bandwidth, or none */
+  if(asFastAsPossible)
+    period = 0;
+  else if(gbps > 0.)
+    period = (uint64_t)((double)st->nwords * 32.0 * nstreams / gbps);
+  else
+    period = frameNs;
+
+  t0 = tnext = nowNs(CLOCK_MONOTONIC);
+  while(running)
+    {
+      ts = frame * frameNs;
+      st->frame[1]  = htonl((uint32_t)frame + 1);
+      st->frame[13] = htonl((uint32_t)frame);
+      st->frame[14] = htonl((uint32_t)ts);
+      st->frame[15] = htonl((uint32_t)(ts >> 32));
+
+      if(sendBlock(st, st->frame, st->nwords*4, frame, 1) < 0)
+	{
+	  printf("Stream %d: ERROR: send: %s\n", st->inst, strerror(errno));
+	  break;
+	}
+      frame++;
+      st->frames = frame;
+
+      /* Sleep only when at least 100 us ahead, to keep the send loop tight */
+      if(period)
+	{
+	  tnext += period;
+	  if(tnext > nowNs(CLOCK_MONOTONIC) + 100000)
+	    sleepUntil(tnext);
+	}
+    }
+
+  sendControl(st, 0xffd4, runNumber, (uint32_t)frame, frame);   /* End */
+  printf("Stream %d: %llu frames in %.1f s\n", st->inst, (unsigned long long)frame,
+	 (double)(nowNs(CLOCK_MONOTONIC) - t0)*1.0e-9);
+  close(st->sock);
+  return NULL;
+}
+
+/* Same packing as vtpStreamingSyncSetData() in vtpLib (not linked here) */
+static void
+emuSyncSetData(char *buffer, int version, uint32_t srcId,
+	       uint64_t evtNum, uint32_t evtRate, uint64_t nanos)
+{
+  VTP_SYNC_PKT pkt;
+
+  pkt.magic[0] = VTP_SYNC_MAGIC_0;
+  pkt.magic[1] = VTP_SYNC_MAGIC_1;
+  pkt.version  = (uint8_t)version;
+  pkt.reserved = 0;
+  pkt.src_id   = htonl(srcId);
+  pkt.evt_num  = htobe64(evtNum);
+  pkt.evt_rate = htonl(evtRate);
+  pkt.nanos    = htobe64(nanos);
+
+  memcpy(buffer, &pkt, sizeof(pkt));
+}
+
+/* LC sync packets: frames sent per stream, wall clock anchored */
+static void *
+syncThread(void *arg)
+{
+  struct sockaddr_in dst[VTP_SYNC_MAX_DEST];
+  uint64_t tnext, anchor, prev[VTP_STREAMING_MAX_STREAMS], f;
+  char buf[VTP_SYNC_PKT_LEN];
+  int s, d, i, nd = 0;
+
+  for(d=0; d<nsync; d++)
+    if(resolve(syncHost[d], syncPort[d], &dst[nd]) == 0)
+      syncMask[nd++] = syncMask[d];
+
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  anchor = nowNs(CLOCK_REALTIME);
+  memset(prev, 0, sizeof(prev));
+  tnext = nowNs(CLOCK_MONOTONIC);
+
+  while(running)
+    {
+      tnext += 1000000000ull / syncRate;
+      sleepUntil(tnext);
+      for(i=0; i<nstreams; i++)
+	{
+	  f = streams[i].frames;
+	  emuSyncSetData(buf, VTP_SYNC_VERSION, rocid + i, f,
+			 (uint32_t)((f - prev[i]) * syncRate), anchor + f*frameNs);
+	  prev[i] = f;
+	  for(d=0; d<nd; d++)
+	    if(syncMask[d] & (1<<i))
+	      sendto(s, buf, sizeof(buf), 0, (struct sockaddr *)&dst[d], sizeof(dst[d]));
+	}
+    }
+
+  close(s);
+  return NULL;
+}
+
+/* Path MTU probe - the search of vtpStreamingMtuProbe() in the library.
+   The emulator sends its streams through this host stack, so unlike on
+   the VTP a local send failure is a real limit of the stream here. */
+static int
+emuMtuTry(int sock, uint32_t seq, int size)
+{
+  static uint8_t buf[65536];
+  VTP_MTU_PROBE_HDR *hdr = (VTP_MTU_PROBE_HDR *)buf;
+  struct pollfd pfd = { sock, POLLIN, 0 };
+  int n;
+
+  memset(buf, 0, size - VTP_MTU_IPUDP_HDR);
+  hdr->magic = htonl(VTP_MTU_PROBE_MAGIC);
+  hdr->seq   = htonl(seq);
+  hdr->size  = htonl(size);
+  if(send(sock, buf, size - VTP_MTU_IPUDP_HDR, 0) < 0)
+    return -1;
+
+  while(poll(&pfd, 1, 100) > 0)
+    {
+      n = recv(sock, buf, sizeof(buf), 0);
+      if((n >= (int)sizeof(VTP_MTU_PROBE_HDR)) &&
+	 (ntohl(hdr->magic) == VTP_MTU_PROBE_MAGIC) && (ntohl(hdr->seq) == seq))
+	return 0;
+    }
+  return -1;
+}
+
+static int
+emuMtuProbe(struct sockaddr_in *dest, int port, int max_mtu)
+{
+  struct sockaddr_in addr = *dest;
+  uint32_t seq = 0;
+  int sock, lo = -1, hi = max_mtu + 1, mid = VTP_MTU_PROBE_MIN, ok, try, pmtu;
+  socklen_t len;
+
+  addr.sin_port = htons(port);
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      perror("connect");
+      close(sock);
+      return -1;
+    }
+  pmtu = IP_PMTUDISC_DO;
+  setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+
+  while(hi - lo > VTP_MTU_PROBE_STEP)
+    {
+      for(ok = 0, try = 0; !ok && (try < VTP_MTU_PROBE_TRIES); try++)
+	ok = (emuMtuTry(sock, ++seq, mid) == 0);
+
+      if(ok)
+	lo = mid;
+      else if(lo < 0)
+	break;
+      else
+	{
+	  hi = mid;
+	  len = sizeof(pmtu);
+	  if((getsockopt(sock, IPPROTO_IP, IP_MTU, &pmtu, &len) == 0) && (pmtu > lo) && (pmtu < hi))
+	    hi = pmtu + 1;
+	}
+      mid = (hi == max_mtu + 1) ? max_mtu : (lo + hi) / 2;
+    }
+  close(sock);
+
+  printf("MTU probe %s:%d: %d probes, path MTU %d\n", inet_ntoa(addr.sin_addr), port, seq, lo);
+  return lo;
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s -c config [-h host] [-p port] [-b bytes] [-m mtu]\n"
+	 "          [-g Gb/s | -x] [-d seconds] [-r run] [-C] [-S] [-M echoport]\n"
+	 "  -c config    vtp_<rocname>.cnf (frame length, payloads, streams, transport)\n"
+	 "  -h / -p      override VTP_STREAMING_DESTIP / VTP_STREAMING_DESTIPPORT\n"
+	 "  -b bytes     hit data per payload per frame (default 1024)\n"
+	 "  -m mtu       UDP MTU (default 9000)\n"
+	 "  -g Gb/s      total target rate (default: real frame rate)\n"
+	 "  -x           send as fast as possible\n"
+	 "  -d seconds   run time (default: until Ctrl-C)\n"
+	 "  -r run       run number in the Prestart event\n"
+	 "  -C           TCP: send the EMU connection data first\n"
+	 "  -S           send LC sync packets (VTP_SYNC_DEST / VTP_STATS_HOST)\n"
+	 "  -M echoport  UDP: probe the path MTU (up to -m) at this echo port first\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  pthread_t sthr;
+  uint64_t t0, tprev, t, bytes, prevBytes = 0;
+  char *cfg = NULL, *host = NULL;
+  int opt, i, port = 0;
+
+  while((opt = getopt(argc, argv, "c:h:p:b:m:g:xd:r:CSM:")) != -1)
+    {
+      switch(opt)
+	{
+	case 'c': cfg = optarg; break;
+	case 'h': host = optarg; break;
+	case 'p': port = atoi(optarg); break;
+	case 'b': payloadBytes = atoi(optarg); break;
+	case 'm': mtu = atoi(optarg); break;
+	case 'g': gbps = atof(optarg); break;
+	case 'x': asFastAsPossible = 1; break;
+	case 'd': duration = atoi(optarg); break;
+	case 'r': runNumber = atoi(optarg); break;
+	case 'C': sendConnData = 1; break;
+	case 'S': sendSync = 1; break;
+	case 'M': echoPort = atoi(optarg); break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+
+  if(cfg == NULL)
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+  readConfig(cfg);
+  if(host)
+    strcpy(destHost, host);
+  if(port)
+    destPort = port;
+
+  if((destHost[0] == 0) || (destPort <= 0) || (nstreams < 1) ||
+     (nstreams > VTP_STREAMING_MAX_STREAMS) || (payloadBytes < 0) ||
+     (mtu < 576) || (frameNs == 0) || (syncRate < VTP_SYNC_MIN_HZ) || (syncRate > VTP_SYNC_MAX_HZ))
+    {
+      printf("ERROR: Invalid configuration (dest %s:%d, %d streams, frame %u ns, mtu %d)\n",
+	     destHost, destPort, nstreams, frameNs, mtu);
+      exit(1);
+    }
+
+  signal(SIGINT, sigHandler);
+  signal(SIGTERM, sigHandler);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%d %s stream(s) to %s:%d, rocid %d, frame %u ns, payloads 0x%04x, %d bytes/payload\n",
+	 nstreams, (netMode == 0) ? "TCP/cMsg" : (ejfat ? "UDP/EJFAT" : "UDP"),
+	 destHost, destPort, rocid, frameNs, payloadMask, payloadBytes);
+
+  for(i=0; i<nstreams; i++)
+    {
+      streams[i].inst = i;
+      if(resolve(destHost, destPort, &streams[i].dest) != 0)
+	exit(1);
+      if((i == 0) && (netMode != 0) && (echoPort > 0))
+	{
+	  int pmtu = emuMtuProbe(&streams[0].dest, echoPort, mtu);
+	  if(pmtu < 0)
+	    {
+	      printf("ERROR: No MTU probe echo from %s:%d\n", destHost, echoPort);
+	      exit(1);
+	    }
+	  mtu = pmtu;
+	}
+      buildFrame(&streams[i]);
+      pthread_create(&streams[i].thr, NULL, streamThread, &streams[i]);
+    }
+
+  if(sendSync && nsync)
+    pthread_create(&sthr, NULL, syncThread, NULL);
+
+  t0 = tprev = nowNs(CLOCK_MONOTONIC);
+  while(running)
+    {
+      sleep(1);
+      t = nowNs(CLOCK_MONOTONIC);
+      bytes = 0;
+      for(i=0; i<nstreams; i++)
+	bytes += streams[i].bytes;
+      printf("%8.3f Gb/s", (double)(bytes - prevBytes)*8.0/(double)(t - tprev));
+      for(i=0; i<nstreams; i++)
+	printf("  [%d] %llu frames", i, (unsigned long long)streams[i].frames);
+      printf("\n");
+      prevBytes = bytes;
+      tprev = t;
+      if(duration && ((t - t0) >= (uint64_t)duration*1000000000ull))
+	running = 0;
+    }
+
+  for(i=0; i<nstreams; i++)
+    pthread_join(streams[i].thr, NULL);
+  if(sendSync && nsync)
+    pthread_join(sthr, NULL);
+
+  /* Same columns as vtpStreamingMtuPrint() */
+  if(netMode != 0)
+    {
+      printf("           MTU       packets        bytes  bytes/pkt   fill   wire\n");
+      for(i=0; i<nstreams; i++)
+	{
+	  double avg = streams[i].pkts ? (double)streams[i].bytes/streams[i].pkts : 0.;
+	  printf("  Port %d %6d %13llu %12llu %10.1f %5.1f%% %5.1f%%\n", i, mtu,
+		 (unsigned long long)streams[i].pkts, (unsigned long long)streams[i].bytes, avg,
+		 100.*avg/(mtu - VTP_MTU_IPUDP_HDR), 100.*avg/(avg + 38 + VTP_MTU_IPUDP_HDR));
+	}
+    }
+
+  exit(0);
+}
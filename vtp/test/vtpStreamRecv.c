@@ -0,0 +1,1059 @@
+/*
+ * File:
+ *    vtpStreamRecv.c
+ *
+ * Description:
+ *    Receiver / benchmark for the VTP streaming output.  Runs on a Linux
+ *    host (does not need the VTP library or hardware) and accepts the
+ *    TCP or UDP streams sent to VTP_STREAMING_DESTIPPORT.
+ *
+ *    - TCP: cMsg framed EVIO blocks, one connection (thread) per stream
+ *    - UDP: EVIO blocks, optionally with EJFAT LB/RE headers.  EJFAT
+ *           packets are reassembled into frames by tick (frame number),
+ *           plain UDP datagrams by the EVIO block length.
+ *           Several receive threads share the port (SO_REUSEPORT), each
+ *           stream (source address) always lands on the same thread.
+ *    - LC sync packets (vtpStreamingSyncSetData) are validated when they
+ *      arrive on the data port or on the -s port.
+ *    - MTU probes (vtpStreamingMtuProbe) are echoed on the -E port.  -M
+ *      drops probes larger than the given MTU, to test the probe against
+ *      a constrained path on loopback.
+ *
+ *    Reports per stream throughput, lost / reordered / incomplete frames,
+ *    and histograms of the frame latency (arrival vs. the frame time from
+ *    the LC sync packets - needs synchronized clocks) and of the spread
+ *    between the first and last packet of each frame.
+ *
+ *    usage: vtpStreamRecv [-t|-u] [-p port] [-c config] [-n threads]
+ *                         [-s syncport] [-f frame_ns] [-i interval] [-d seconds]
+ *                         [-P profile] [-E echoport] [-M mtu]
+ *
+ */
+
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <endian.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "vtpLib.h"
+
+#define RECV_MAX_STREAMS     16
+#define RECV_MAX_THREADS     16
+#define RECV_MAX_SYNC        16
+#define RECV_REASM_SLOTS     64
+#define RECV_MAX_FRAME       (16*1024*1024)
+#define RECV_HIST_BINS       32
+#define RECV_PKT_MAX         65536
+
+#define EVIO_BLOCK_MAGIC     0xc0da0100
+#define CMSG_MAGIC_INT1      0x634d7367
+
+typedef struct
+{
+  int      used;
+  uint64_t tick;
+  uint32_t length;
+  uint32_t received;
+  uint64_t t_first;
+  uint64_t t_last;
+  uint32_t cap;
+  uint8_t *buf;
+} recv_slot;
+
+typedef struct
+{
+  int      used;
+  int      id;
+  struct sockaddr_in peer;
+  int      tcp;
+  int      sock;                 /* TCP connection */
+  pthread_mutex_t lock;
+
+  uint32_t src_id;               /* RE data_id or EVIO rocid */
+  int      ejfat;                /* EJFAT headers seen */
+  uint64_t pkts, bytes, frames;
+  uint64_t lost, reordered, dup, incomplete, errors;
+  uint64_t ncontrol, nuser, nend;
+
+  int      have_tick;
+  uint64_t max_tick, tick_step;
+
+  uint64_t lat_hist[RECV_HIST_BINS], lat_neg;
+  uint64_t span_hist[RECV_HIST_BINS];
+
+  uint64_t rep_bytes, rep_frames;
+
+  recv_slot slot[RECV_REASM_SLOTS];
+  recv_slot blk;                 /* plain UDP: EVIO block being reassembled */
+} recv_stream;
+
+typedef struct
+{
+  int      used;
+  uint32_t src_id;
+  uint64_t npkts, nerrors, nbackwards;
+  uint64_t evt_num, nanos, t_recv;
+  uint32_t evt_rate;
+  double   rate_dev_max;         /* max |evt_rate - measured| / measured */
+  double   ts_dev_max_ns;        /* max |dnanos - devt*frame_ns| */
+  double   offset_ns;            /* last receive time - nanos */
+} recv_sync;
+
+static recv_stream streams[RECV_MAX_STREAMS];
+static pthread_mutex_t streamsLock = PTHREAD_MUTEX_INITIALIZER;
+static recv_sync syncs[RECV_MAX_SYNC];
+static pthread_mutex_t syncLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t payloadBytes[VTP_STREAMING_NPAYLOAD];
+static char *profileFile = NULL;
+
+static volatile int running = 1;
+static int useTcp = 1, dataPort = 0, syncPort = 0, nThreads = 4;
+static int echoPort = 0, echoMtu = 0;
+static uint32_t frameNs = 65536;
+
+static uint64_t
+nowNs(clockid_t clk)
+{
+  struct timespec ts;
+
+  clock_gettime(clk, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+static int
+histBin(uint64_t ns)
+{
+  uint64_t us = ns/1000;
+  int bin = 0;
+
+  while(us && (bin < RECV_HIST_BINS-1))
+    {
+      us >>= 1;
+      bin++;
+    }
+  return bin;
+}
+
+static void
+sigHandler(int sig)
+{
+  running = 0;
+}
+
+/* Stream table entry for a peer (UDP source address, or TCP connection) */
+static recv_stream *
+streamGet(struct sockaddr_in *peer, int tcp)
+{
+  recv_stream *st = NULL;
+  int i;
+
+  pthread_mutex_lock(&streamsLock);
+  for(i=0; i<RECV_MAX_STREAMS; i++)
+    {
+      if(streams[i].used && !tcp && !streams[i].tcp &&
+	 (streams[i].peer.sin_addr.s_addr == peer->sin_addr.s_addr) &&
+	 (streams[i].peer.sin_port == peer->sin_port))
+	{
+	  st = &streams[i];
+	  break;
+	}
+    }
+  if(st == NULL)
+    {
+      for(i=0; i<RECV_MAX_STREAMS; i++)
+	{
+	  if(!streams[i].used)
+	    {
+	      st = &streams[i];
+	      memset(st, 0, sizeof(recv_stream));
+	      pthread_mutex_init(&st->lock, NULL);
+	      st->id   = i;
+	      st->peer = *peer;
+	      st->tcp  = tcp;
+	      st->used = 1;
+	      printf("Stream %d: %s %s:%d\n", i, tcp ? "TCP" : "UDP",
+		     inet_ntoa(peer->sin_addr), ntohs(peer->sin_port));
+	      break;
+	    }
+	}
+    }
+  pthread_mutex_unlock(&streamsLock);
+
+  return st;
+}
+
+/* Validate an LC sync packet */
+static void
+syncPacket(const uint8_t *p, int n)
+{
+  VTP_SYNC_PKT pkt;
+  recv_sync *s = NULL;
+  uint64_t t = nowNs(CLOCK_REALTIME);
+  uint32_t src;
+  double dt, meas, dev;
+  int i, bad;
+
+  bad = (n < VTP_SYNC_PKT_LEN) ||
+    (p[0] != VTP_SYNC_MAGIC_0) || (p[1] != VTP_SYNC_MAGIC_1) || (p[2] != VTP_SYNC_VERSION);
+
+  memset(&pkt, 0, sizeof(pkt));
+  memcpy(&pkt, p, (n < (int)sizeof(pkt)) ? n : (int)sizeof(pkt));
+  src = ntohl(pkt.src_id);
+
+  pthread_mutex_lock(&syncLock);
+  for(i=0; i<RECV_MAX_SYNC; i++)
+    if(syncs[i].used && (syncs[i].src_id == src))
+      {
+	s = &syncs[i];
+	break;
+      }
+  if(s == NULL)
+    for(i=0; i<RECV_MAX_SYNC; i++)
+      if(!syncs[i].used)
+	{
+	  s = &syncs[i];
+	  memset(s, 0, sizeof(recv_sync));
+	  s->used   = 1;
+	  s->src_id = src;
+	  break;
+	}
+  if(s == NULL)
+    {
+      pthread_mutex_unlock(&syncLock);
+      return;
+    }
+
+  s->npkts++;
+  if(bad)
+    {
+      s->nerrors++;
+      pthread_mutex_unlock(&syncLock);
+      return;
+    }
+
+  pkt.evt_num  = be64toh(pkt.evt_num);
+  pkt.nanos    = be64toh(pkt.nanos);
+  pkt.evt_rate = ntohl(pkt.evt_rate);
+
+  if(s->npkts > 1)
+    {
+      if(pkt.evt_num < s->evt_num)
+	s->nbackwards++;
+      else if(pkt.evt_num > s->evt_num)
+	{
+	  dt   = (double)(t - s->t_recv) * 1.0e-9;
+	  meas = (double)(pkt.evt_num - s->evt_num) / dt;
+	  dev  = (meas > 0) ? ((double)pkt.evt_rate - meas) / meas : 0.;
+	  if(dev < 0) dev = -dev;
+	  if(dev > s->rate_dev_max)
+	    s->rate_dev_max = dev;
+
+	  dev = (double)(int64_t)(pkt.nanos - s->nanos) -
+	    (double)(pkt.evt_num - s->evt_num) * frameNs;
+	  if(dev < 0) dev = -dev;
+	  if(dev > s->ts_dev_max_ns)
+	    s->ts_dev_max_ns = dev;
+	}
+    }
+
+  s->evt_num   = pkt.evt_num;
+  s->nanos     = pkt.nanos;
+  s->evt_rate  = pkt.evt_rate;
+  s->t_recv    = t;
+  s->offset_ns = (double)(int64_t)(t - pkt.nanos);
+  pthread_mutex_unlock(&syncLock);
+}
+
+/* Wall clock time of a frame from the latest LC sync packet of its source
+   (or the only source).  Returns 0 if unknown. */
+static uint64_t
+syncFrameTime(uint32_t src_id, uint64_t frame)
+{
+  recv_sync *s = NULL;
+  uint64_t t = 0;
+  int i, n = 0;
+
+  pthread_mutex_lock(&syncLock);
+  for(i=0; i<RECV_MAX_SYNC; i++)
+    {
+      if(!syncs[i].used || (syncs[i].npkts == syncs[i].nerrors))
+	continue;
+      n++;
+      if(syncs[i].src_id == src_id)
+	s = &syncs[i];
+      else if((s == NULL) && (n == 1))
+	s = &syncs[i];
+    }
+  if(s && ((s->src_id == src_id) || (n == 1)))
+    t = s->nanos + (int64_t)(frame - s->evt_num) * frameNs;
+  pthread_mutex_unlock(&syncLock);
+
+  return t;
+}
+
+/* Frame bookkeeping: loss, reordering, latency. Called with st->lock held */
+static void
+frameDone(recv_stream *st, uint64_t frame, uint64_t t_first, uint64_t t_last)
+{
+  uint64_t gap, tframe, now;
+
+  st->frames++;
+  st->span_hist[histBin(t_last - t_first)]++;
+
+  tframe = syncFrameTime(st->src_id, frame);
+  if(tframe)
+    {
+      now = nowNs(CLOCK_REALTIME);
+      tframe += frameNs;        /* frame is complete at its end */
+      if(now >= tframe)
+	st->lat_hist[histBin(now - tframe)]++;
+      else
+	st->lat_neg++;
+    }
+
+  if(!st->have_tick)
+    {
+      st->have_tick = 1;
+      st->max_tick  = frame;
+      return;
+    }
+
+  if(frame > st->max_tick)
+    {
+      if(st->tick_step == 0)
+	st->tick_step = frame - st->max_tick;
+      gap = (frame - st->max_tick) / st->tick_step;
+      if(gap > 1)
+	st->lost += gap - 1;
+      st->max_tick = frame;
+    }
+  else if(frame < st->max_tick)
+    {
+      st->reordered++;
+      if(st->lost)        /* counted as lost when the gap was seen */
+	st->lost--;
+    }
+  else
+    st->dup++;
+}
+
+/* EVIO block header magic word (either byte order) at word 7 */
+static int
+evioMagic(const uint8_t *p, int n)
+{
+  uint32_t w;
+
+  if(n < 32)
+    return 0;
+  memcpy(&w, p + 28, 4);
+  return (w == EVIO_BLOCK_MAGIC) || (w == htonl(EVIO_BLOCK_MAGIC));
+}
+
+/* Look at an EVIO block: control / user events, frame number from the
+   Time Slice Segment of a ROC Time Slice Bank.
+   Returns 1 if a frame number was found, 0 if not, 2 for a control or
+   user event, -1 on a bad block. */
+static int
+evioBlock(recv_stream *st, const uint8_t *p, int n, uint64_t *frame)
+{
+  const uint32_t *w = (const uint32_t *)p;
+  uint32_t tag, type, swap, i, end;
+
+  if(n < 40)
+    return -1;
+
+  if(w[7] == htonl(EVIO_BLOCK_MAGIC))
+    swap = 1;
+  else if(w[7] == EVIO_BLOCK_MAGIC)
+    swap = 0;
+  else
+    return -1;
+
+#define EW(i) (swap ? ntohl(w[i]) : w[i])
+
+  if(!st->ejfat)
+    st->src_id = EW(4) & 0xFFFF;
+
+  tag  = EW(9) >> 16;
+  type = (EW(9) >> 8) & 0x3F;
+
+  if((tag >= 0xffd0) && (tag <= 0xffd4))   /* CODA control events */
+    {
+      st->ncontrol++;
+      if(tag == 0xffd4)
+	st->nend++;
+      return 2;
+    }
+
+  if(type != 0x10)                         /* not a ROC Time Slice Bank */
+    {
+      st->nuser++;
+      return 2;
+    }
+
+  /* Stream Info Bank, then Time Slice Segment: frame, timestamp */
+  if((n >= 64) && ((EW(11) >> 16) == 0xff30) && ((EW(12) >> 24) == 0x31))
+    {
+      *frame = EW(13);
+
+      /* Payload banks (tag = payload port) follow the Stream Info Bank */
+      end = 9 + EW(8);
+      if(end > (uint32_t)n/4)
+	end = n/4;
+      for(i = 11 + EW(10); i + 1 < end; i += EW(i) + 1)
+	{
+	  tag = EW(i+1) >> 16;
+	  if((tag >= 1) && (tag <= VTP_STREAMING_NPAYLOAD))
+	    __atomic_fetch_add(&payloadBytes[tag-1], (uint64_t)(EW(i) + 1)*4, __ATOMIC_RELAXED);
+	}
+      return 1;
+    }
+#undef EW
+
+  return 0;
+}
+
+/* EJFAT packet: collect the payload into the reassembly slot of its tick */
+static void
+ejfatPacket(recv_stream *st, const uint8_t *p, int n, uint64_t t)
+{
+  VTP_EJFAT_RE_HDR re;
+  recv_slot *sl;
+  uint64_t frame;
+  uint32_t off, len, plen;
+  int rval;
+
+  if(n < VTP_EJFAT_RE_HDR_LEN)
+    {
+      st->errors++;
+      return;
+    }
+  memcpy(&re, p, sizeof(re));
+  re.tick   = be64toh(re.tick);
+  off       = ntohl(re.offset);
+  len       = ntohl(re.length);
+  plen      = n - VTP_EJFAT_RE_HDR_LEN;
+  st->src_id = ntohs(re.data_id);
+  st->ejfat  = 1;
+
+  if((len == 0) || (len > RECV_MAX_FRAME) || (off + plen > len))
+    {
+      st->errors++;
+      return;
+    }
+
+  sl = &st->slot[re.tick % RECV_REASM_SLOTS];
+  if(sl->used && (sl->tick != re.tick))   /* older frame never completed */
+    {
+      st->incomplete++;
+      frameDone(st, sl->tick, sl->t_first, sl->t_last);
+      sl->used = 0;
+    }
+  if(!sl->used)
+    {
+      if(sl->cap < len)
+	{
+	  free(sl->buf);
+	  sl->buf = malloc(len);
+	  sl->cap = sl->buf ? len : 0;
+	  if(sl->buf == NULL)
+	    {
+	      st->errors++;
+	      return;
+	    }
+	}
+      sl->used     = 1;
+      sl->tick     = re.tick;
+      sl->length   = len;
+      sl->received = 0;
+      sl->t_first  = t;
+    }
+
+  memcpy(sl->buf + off, p + VTP_EJFAT_RE_HDR_LEN, plen);
+  sl->received += plen;
+  sl->t_last    = t;
+
+  if(sl->received >= sl->length)
+    {
+      rval = evioBlock(st, sl->buf, sl->length, &frame);
+      if(rval < 0)
+	st->errors++;
+      if(rval != 2)
+	frameDone(st, sl->tick, sl->t_first, sl->t_last);
+      sl->used = 0;
+    }
+}
+
+/* Plain UDP packet: a frame is split over datagrams without a header, in
+   order.  A datagram with an EVIO block header starts a block, the next
+   ones are appended until the length in the block header is reached. */
+static void
+plainPacket(recv_stream *st, const uint8_t *p, int n, uint64_t t)
+{
+  recv_slot *sl = &st->blk;
+  uint64_t frame;
+  uint32_t len, w0, w7;
+  int rval;
+
+  if(evioMagic(p, n))
+    {
+      if(sl->used)              /* rest of the previous block never came */
+	{
+	  st->incomplete++;
+	  sl->used = 0;
+	}
+
+      memcpy(&w0, p, 4);
+      memcpy(&w7, p + 28, 4);
+      len = ((w7 == EVIO_BLOCK_MAGIC) ? w0 : ntohl(w0)) * 4;
+      if((len < 40) || (len > RECV_MAX_FRAME) || ((uint32_t)n > len))
+	{
+	  st->errors++;
+	  return;
+	}
+      if(sl->cap < len)
+	{
+	  free(sl->buf);
+	  sl->buf = malloc(len);
+	  sl->cap = sl->buf ? len : 0;
+	  if(sl->buf == NULL)
+	    {
+	      st->errors++;
+	      return;
+	    }
+	}
+      sl->used     = 1;
+      sl->length   = len;
+      sl->received = 0;
+      sl->t_first  = t;
+    }
+  else if(!sl->used || (sl->received + n > sl->length))
+    {
+      st->errors++;             /* no block header, or past the block end */
+      sl->used = 0;
+      return;
+    }
+
+  memcpy(sl->buf + sl->received, p, n);
+  sl->received += n;
+  sl->t_last    = t;
+
+  if(sl->received == sl->length)
+    {
+      sl->used = 0;
+      rval = evioBlock(st, sl->buf, sl->length, &frame);
+      if(rval < 0)
+	st->errors++;
+      else if(rval == 1)
+	frameDone(st, frame, sl->t_first, sl->t_last);
+    }
+}
+
+static void
+udpPacket(recv_stream *st, const uint8_t *p, int n)
+{
+  uint64_t t = nowNs(CLOCK_MONOTONIC);
+
+  pthread_mutex_lock(&st->lock);
+  st->pkts++;
+  st->bytes += n;
+
+  if(st->blk.used)                 /* rest of a plain UDP block */
+    plainPacket(st, p, n, t);
+  else if((n >= VTP_EJFAT_LB_HDR_LEN) &&
+     (p[0] == VTP_EJFAT_LB_MAGIC_0) && (p[1] == VTP_EJFAT_LB_MAGIC_1))
+    ejfatPacket(st, p + VTP_EJFAT_LB_HDR_LEN, n - VTP_EJFAT_LB_HDR_LEN, t);
+  else if((n >= VTP_EJFAT_RE_HDR_LEN) && ((p[0] >> 4) == 1) && !evioMagic(p, n))
+    ejfatPacket(st, p, n, t);      /* RE only (LB header removed upstream) */
+  else
+    plainPacket(st, p, n, t);
+  pthread_mutex_unlock(&st->lock);
+}
+
+static void *
+udpThread(void *arg)
+{
+  struct sockaddr_in addr, peer;
+  socklen_t plen;
+  struct timeval tv = {0, 200000};
+  uint8_t *buf;
+  recv_stream *st;
+  int s, n, on = 1;
+
+  buf = malloc(RECV_PKT_MAX);
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  n = 64*1024*1024;
+  setsockopt(s, SOL_SOCKET, SO_RCVBUF, &n, sizeof(n));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons((long)arg);
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      perror("bind");
+      running = 0;
+      return NULL;
+    }
+
+  while(running)
+    {
+      plen = sizeof(peer);
+      n = recvfrom(s, buf, RECV_PKT_MAX, 0, (struct sockaddr *)&peer, &plen);
+      if(n <= 0)
+	continue;
+
+      if((n >= 2) && (buf[0] == VTP_SYNC_MAGIC_0) && (buf[1] == VTP_SYNC_MAGIC_1))
+	{
+	  syncPacket(buf, n);
+	  continue;
+	}
+
+      st = streamGet(&peer, 0);
+      if(st)
+	udpPacket(st, buf, n);
+    }
+
+  close(s);
+  free(buf);
+  return NULL;
+}
+
+/* Read exactly n bytes; 0 on close/stop */
+static int
+tcpRead(int s, void *buf, int n)
+{
+  int got = 0, r;
+
+  while(got < n)
+    {
+      r = recv(s, (uint8_t *)buf + got, n - got, 0);
+      if(r == 0)
+	return 0;
+      if(r < 0)
+	{
+	  if(((errno == EAGAIN) || (errno == EINTR)) && running)
+	    continue;
+	  return 0;
+	}
+      got += r;
+    }
+  return 1;
+}
+
+static void *
+tcpThread(void *arg)
+{
+  recv_stream *st = arg;
+  uint32_t hdr[8], type, len, cap = 0;
+  uint8_t *buf = NULL;
+  uint64_t t, frame;
+  int s = st->sock;
+  int rval, swap, have_hdr = 0;
+
+  /* Optional EMU connection data: 8 words, starting with the cMsg magic */
+  swap = 1;
+  if(tcpRead(s, hdr, 8))
+    {
+      if((hdr[0] == CMSG_MAGIC_INT1) || (hdr[0] == htonl(CMSG_MAGIC_INT1)))
+	{
+	  swap = (hdr[0] == htonl(CMSG_MAGIC_INT1)) ? 1 : 0;
+	  tcpRead(s, hdr, 24);
+	}
+      else
+	{
+	  /* No connection data: these are the first cMsg header words */
+	  swap = (ntohl(hdr[0]) <= 3) ? 1 : 0;
+	  have_hdr = 1;
+	}
+    }
+
+  while(running)
+    {
+      if(!have_hdr && !tcpRead(s, hdr, 8))
+	break;
+      have_hdr = 0;
+      type = swap ? ntohl(hdr[0]) : hdr[0];
+      len  = swap ? ntohl(hdr[1]) : hdr[1];
+
+      if((len == 0) || (len > RECV_MAX_FRAME))
+	{
+	  printf("Stream %d: ERROR: bad cMsg header (type %u, length %u)\n", st->id, type, len);
+	  break;
+	}
+      if(len > cap)
+	{
+	  free(buf);
+	  buf = malloc(len);
+	  cap = len;
+	}
+      if(!tcpRead(s, buf, len))
+	break;
+      t = nowNs(CLOCK_MONOTONIC);
+
+      pthread_mutex_lock(&st->lock);
+      st->pkts++;
+      st->bytes += len + 8;
+      rval = evioBlock(st, buf, len, &frame);
+      if(rval < 0)
+	st->errors++;
+      else if(rval == 1)
+	frameDone(st, frame, t, t);
+      pthread_mutex_unlock(&st->lock);
+    }
+
+  printf("Stream %d: connection closed\n", st->id);
+  close(s);
+  free(buf);
+  return NULL;
+}
+
+static void *
+tcpAcceptThread(void *arg)
+{
+  struct sockaddr_in addr, peer;
+  socklen_t plen;
+  struct timeval tv = {0, 200000};
+  recv_stream *st;
+  pthread_t thr;
+  int s, c, on = 1;
+
+  s = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(dataPort);
+  if((bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(s, RECV_MAX_STREAMS) < 0))
+    {
+      perror("bind/listen");
+      running = 0;
+      return NULL;
+    }
+
+  while(running)
+    {
+      plen = sizeof(peer);
+      c = accept(s, (struct sockaddr *)&peer, &plen);
+      if(c < 0)
+	continue;
+      setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      st = streamGet(&peer, 1);
+      if(st == NULL)
+	{
+	  close(c);
+	  continue;
+	}
+      st->sock = c;
+      pthread_create(&thr, NULL, tcpThread, st);
+      pthread_detach(thr);
+    }
+
+  close(s);
+  return NULL;
+}
+
+static void *
+syncThread(void *arg)
+{
+  struct sockaddr_in addr;
+  struct timeval tv = {0, 200000};
+  uint8_t buf[256];
+  int s, n;
+
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(syncPort);
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      perror("bind sync");
+      return NULL;
+    }
+
+  while(running)
+    {
+      n = recv(s, buf, sizeof(buf), 0);
+      if(n > 0)
+	syncPacket(buf, n);
+    }
+
+  close(s);
+  return NULL;
+}
+
+/* Return the header of every MTU probe that fits the (simulated) path MTU */
+static void *
+echoThread(void *arg)
+{
+  struct sockaddr_in addr, peer;
+  socklen_t plen;
+  struct timeval tv = {0, 200000};
+  static uint8_t buf[RECV_PKT_MAX];
+  VTP_MTU_PROBE_HDR *hdr = (VTP_MTU_PROBE_HDR *)buf;
+  int s, n;
+  uint64_t nprobe = 0, ndrop = 0;
+
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(echoPort);
+  if(bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      perror("bind echo");
+      return NULL;
+    }
+
+  while(running)
+    {
+      plen = sizeof(peer);
+      n = recvfrom(s, buf, sizeof(buf), 0, (struct sockaddr *)&peer, &plen);
+      if((n < (int)sizeof(VTP_MTU_PROBE_HDR)) || (ntohl(hdr->magic) != VTP_MTU_PROBE_MAGIC))
+	continue;
+
+      nprobe++;
+      if(echoMtu && ((n + VTP_MTU_IPUDP_HDR) > echoMtu))
+	{
+	  ndrop++;
+	  continue;
+	}
+      sendto(s, buf, sizeof(VTP_MTU_PROBE_HDR), 0, (struct sockaddr *)&peer, plen);
+    }
+
+  printf("MTU probes: %llu received, %llu dropped (MTU %d)\n",
+	 (unsigned long long)nprobe, (unsigned long long)ndrop, echoMtu);
+  close(s);
+  return NULL;
+}
+
+static void
+printHist(const char *name, uint64_t *h, uint64_t extra, const char *extraName)
+{
+  int i, last = -1;
+
+  for(i=0; i<RECV_HIST_BINS; i++)
+    if(h[i])
+      last = i;
+  if((last < 0) && (extra == 0))
+    return;
+
+  printf("  %s histogram (us):\n", name);
+  for(i=0; i<=last; i++)
+    printf("    %10llu - %-10llu %12llu\n",
+	   i ? (1ull<<(i-1)) : 0ull, (1ull<<i), (unsigned long long)h[i]);
+  if(extra)
+    printf("    %-23s %12llu\n", extraName, (unsigned long long)extra);
+}
+
+static void
+report(double dt, int final)
+{
+  recv_stream *st;
+  recv_sync *s;
+  int i;
+
+  for(i=0; i<RECV_MAX_STREAMS; i++)
+    {
+      st = &streams[i];
+      if(!st->used)
+	continue;
+
+      pthread_mutex_lock(&st->lock);
+      printf("Stream %d (src %u): %8.2f MB/s %9.0f frames/s | frames %llu lost %llu reord %llu "
+	     "dup %llu incompl %llu err %llu ctrl %llu user %llu\n",
+	     st->id, st->src_id,
+	     (double)(st->bytes - st->rep_bytes)/dt/1.0e6,
+	     (double)(st->frames - st->rep_frames)/dt,
+	     (unsigned long long)st->frames, (unsigned long long)st->lost,
+	     (unsigned long long)st->reordered, (unsigned long long)st->dup,
+	     (unsigned long long)st->incomplete, (unsigned long long)st->errors,
+	     (unsigned long long)st->ncontrol, (unsigned long long)st->nuser);
+      st->rep_bytes  = st->bytes;
+      st->rep_frames = st->frames;
+
+      if(final)
+	{
+	  printHist("Frame latency", st->lat_hist, st->lat_neg, "before frame end");
+	  printHist("Frame packet spread", st->span_hist, 0, NULL);
+	}
+      pthread_mutex_unlock(&st->lock);
+    }
+
+  pthread_mutex_lock(&syncLock);
+  for(i=0; i<RECV_MAX_SYNC; i++)
+    {
+      s = &syncs[i];
+      if(!s->used)
+	continue;
+      printf("Sync src %u: pkts %llu bad %llu backwards %llu | evt %llu rate %u Hz "
+	     "(max dev %.2f%%) ts max dev %.0f ns clock offset %.0f us\n",
+	     s->src_id, (unsigned long long)s->npkts, (unsigned long long)s->nerrors,
+	     (unsigned long long)s->nbackwards, (unsigned long long)s->evt_num,
+	     s->evt_rate, s->rate_dev_max*100., s->ts_dev_max_ns, s->offset_ns/1000.);
+    }
+  pthread_mutex_unlock(&syncLock);
+}
+
+/* Payload volume profile for vtpStreamingBalance() (PAYLOAD <port> <bytes/s>) */
+static void
+writeProfile(double dt)
+{
+  time_t t = time(NULL);
+  FILE *f;
+  int i;
+
+  f = fopen(profileFile, "w");
+  if(f == NULL)
+    {
+      perror(profileFile);
+      return;
+    }
+  fprintf(f, "# VTP streaming payload profile (bytes/s) from vtpStreamRecv  %s", ctime(&t));
+  for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+    if(payloadBytes[i])
+      fprintf(f, "PAYLOAD %2d %.0f\n", i+1, (double)payloadBytes[i]/dt);
+  fclose(f);
+  printf("Wrote payload profile %s\n", profileFile);
+}
+
+/* Take the data port and transport from a VTP config file */
+static void
+readConfig(const char *fname)
+{
+  char line[256], key[64];
+  FILE *f;
+  int val;
+
+  f = fopen(fname, "r");
+  if(f == NULL)
+    {
+      perror(fname);
+      exit(1);
+    }
+  while(fgets(line, sizeof(line), f))
+    {
+      if(sscanf(line, "%63s %d", key, &val) != 2)
+	continue;
+      if(!strcmp(key, "VTP_STREAMING_DESTIPPORT"))
+	dataPort = val;
+      else if(!strcmp(key, "VTP_NET_MODE"))
+	useTcp = (val == 0);
+    }
+  fclose(f);
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-t|-u] [-p port] [-c config] [-n threads] [-s syncport]\n"
+	 "          [-f frame_ns] [-i interval] [-d seconds] [-P profile]\n"
+	 "          [-E echoport] [-M mtu]\n"
+	 "  -t / -u      TCP (default) / UDP streams\n"
+	 "  -p port      data port (VTP_STREAMING_DESTIPPORT)\n"
+	 "  -c config    take port and transport (VTP_NET_MODE) from a VTP config file\n"
+	 "  -n threads   UDP receive threads (default 4)\n"
+	 "  -s syncport  also listen for LC sync packets on this port\n"
+	 "  -f frame_ns  frame length for the latency (default 65536)\n"
+	 "  -i interval  report interval in seconds (default 1)\n"
+	 "  -d seconds   run time (default: until Ctrl-C)\n"
+	 "  -P file      write the payload volume profile (VTP_STREAMING_PROFILE)\n"
+	 "  -E echoport  echo MTU probes (VTP_MTU_PROBE_PORT) on this port\n"
+	 "  -M mtu       drop MTU probes larger than this (simulated path MTU)\n", prog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  pthread_t thr[RECV_MAX_THREADS + 3];
+  int opt, i, nthr = 0, interval = 1, duration = 0;
+  uint64_t t0, tprev, t;
+
+  while((opt = getopt(argc, argv, "tup:c:n:s:f:i:d:P:E:M:h")) != -1)
+    {
+      switch(opt)
+	{
+	case 't': useTcp = 1; break;
+	case 'u': useTcp = 0; break;
+	case 'p': dataPort = atoi(optarg); break;
+	case 'c': readConfig(optarg); break;
+	case 'n': nThreads = atoi(optarg); break;
+	case 's': syncPort = atoi(optarg); break;
+	case 'f': frameNs  = strtoul(optarg, NULL, 0); break;
+	case 'i': interval = atoi(optarg); break;
+	case 'd': duration = atoi(optarg); break;
+	case 'P': profileFile = optarg; break;
+	case 'E': echoPort = atoi(optarg); break;
+	case 'M': echoMtu  = atoi(optarg); break;
+	default:
+	  usage(argv[0]);
+	  exit(1);
+	}
+    }
+
+  if((dataPort <= 0) || (dataPort > 65535) || (nThreads < 1) ||
+     (nThreads > RECV_MAX_THREADS) || (interval < 1) || (frameNs == 0))
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+
+  signal(SIGINT, sigHandler);
+  signal(SIGTERM, sigHandler);
+
+  printf("Receiving %s streams on port %d\n", useTcp ? "TCP" : "UDP", dataPort);
+
+  if(useTcp)
+    pthread_create(&thr[nthr++], NULL, tcpAcceptThread, NULL);
+  else
+    for(i=0; i<nThreads; i++)
+      pthread_create(&thr[nthr++], NULL, udpThread, (void *)(long)dataPort);
+
+  if(syncPort > 0)
+    pthread_create(&thr[nthr++], NULL, syncThread, NULL);
+
+  if(echoPort > 0)
+    pthread_create(&thr[nthr++], NULL, echoThread, NULL);
+
+  t0 = tprev = nowNs(CLOCK_MONOTONIC);
+  while(running)
+    {
+      sleep(interval);
+      t = nowNs(CLOCK_MONOTONIC);
+      report((double)(t - tprev)*1.0e-9, 0);
+      tprev = t;
+      if(duration && ((t - t0) >= (uint64_t)duration*1000000000ull))
+	running = 0;
+    }
+
+  for(i=0; i<nthr; i++)
+    pthread_join(thr[i], NULL);
+
+  t = nowNs(CLOCK_MONOTONIC);
+  printf("---------------------------------------\n");
+  printf("Totals after %.1f s\n", (double)(t - t0)*1.0e-9);
+  for(i=0; i<RECV_MAX_STREAMS; i++)
+    streams[i].rep_bytes = streams[i].rep_frames = 0;
+  report((double)(t - t0)*1.0e-9, 1);
+  if(profileFile)
+    writeProfile((double)(t - t0)*1.0e-9);
+
+  exit(0);
+}
@@ -0,0 +1,83 @@
+/*
+ * File:
+ *    vtpTelemetry.c
+ *
+ * Description:
+ *    Print the recent board history from the VTP shared memory telemetry
+ *    ring (published by vtpserver).  Does not touch the FPGA registers.
+ *
+ *    usage: vtpTelemetry [nrecords]
+ *
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "vtpLib.h"
+
+int
+main(int argc, char *argv[])
+{
+  VTP_TELEMETRY_RECORD rec[VTP_TELEMETRY_DEPTH];
+  VTP_STREAMING_PORT *p;
+  int i, j, n, max = 10;
+  time_t t;
+
+  if(argc > 1)
+    max = atoi(argv[1]);
+
+  if(vtpCreateLockShm() != OK)
+    exit(1);
+
+  n = vtpTelemetryHistory(rec, max);
+  if(n == 0)
+    {
+      printf("No telemetry available (is vtpserver running?)\n");
+      vtpKillLockShm(0);
+      exit(1);
+    }
+
+  for(i=n-1; i>=0; i--)
+    {
+      t = rec[i].timestamp_ns / 1000000000ull;
+      printf("#%llu  %.24s  FW V7 %d.%d (type %d)  Z7 type %d  Temp %.1fC\n",
+	     (unsigned long long)rec[i].index, ctime(&t),
+	     (rec[i].fw_version[0]>>16)&0xFFFF, rec[i].fw_version[0]&0xFFFF,
+	     rec[i].fw_type[0], rec[i].fw_type[1], rec[i].v7_temp);
+
+      for(j=0; j<rec[i].streaming.nstreams; j++)
+	{
+	  p = &rec[i].streaming.port[j];
+	  printf("   Port %d: link %s  frames %llu  pkts %llu  bytes %llu\n", j,
+		 p->link_up ? "up  " : "down",
+		 (unsigned long long)p->frames_sent,
+		 (unsigned long long)p->pkts_sent,
+		 (unsigned long long)p->bytes_sent);
+	}
+
+      if(rec[i].fw_type[1] == ZYNC_FW_TYPE_ZCODAROC)
+	printf("   ROC: triggers %u  acks %u  bytes %llu\n",
+	       rec[i].roc_trig_cnt, rec[i].roc_trig_ack,
+	       (unsigned long long)rec[i].roc_bytes_sent);
+
+      printf("   Serdes up:");
+      for(j=0; j<VTP_TELEMETRY_NSERDES; j++)
+	if(rec[i].serdes_status[j] & VTP_SERDES_STATUS_CHUP)
+	  printf((j<16) ? " PP%d" : " FB%d", (j<16) ? j+1 : j-15);
+      printf("\n");
+
+      if(rec[i].ltm_timestamp_ns)
+	{
+	  printf("   Rails:");
+	  for(j=0; j<VTP_TELEMETRY_NRAILS; j++)
+	    printf(" %.3fV/%.2fA", rec[i].ltm_vout[j], rec[i].ltm_iout[j]);
+	  printf("\n");
+	}
+    }
+
+  vtpKillLockShm(0);
+
+  exit(0);
+}
@@ -326,6 +326,26 @@ void ltm4676_print_status()
     }
 }
 
+/* Read output voltage, current, temperature and STATUS_WORD of all 8 rails
+   (same order as rail[]) */
+int ltm4676_read_rails(float vout[8], float iout[8], float temp[8], unsigned short status[8])
+{
+  int i, ch;
+
+  for(i = 0; i < 4; i++)
+    {
+      for(ch = 0; ch < 2; ch++)
+        {
+          vout[2*i+ch]   = get_vout_ch(i, ch);
+          iout[2*i+ch]   = get_iout_ch(i, ch);
+          temp[2*i+ch]   = get_temp_ch(i, ch);
+          status[2*i+ch] = ltm4676_read_word(LTM4676_ADDR[i], ch, LTM4674_CMD_STATUS_WORD);
+        }
+    }
+
+  return 0;
+}
+
 void ltm4676_setup()
 {
   int i, ch;
@@ -21,5 +21,6 @@
 
 
 void ltm4676_print_status();
+int  ltm4676_read_rails(float vout[8], float iout[8], float temp[8], unsigned short status[8]);
 
 #endif /* VTP_LTM_H */
@@ -5,6 +5,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
@@ -30,6 +35,62 @@ static int active;
 
 static VTP_CONF vtpConf;
 
+/*
+ * Parsed config cache, filled by vtpConfigLoad().  A file is identified by
+ * device, inode, size and mtime / ctime; when these change the content is
+ * hashed (64 bit FNV-1a) and only a different content is parsed again.
+ * vtpInitGlobals() and vtpReadConfigFile() invalidate it, as they change
+ * vtpConf behind its back.
+ */
+typedef struct
+{
+  int             valid;
+  char            fname[FNLEN];
+  dev_t           dev;
+  ino_t           ino;
+  off_t           size;
+  struct timespec mtime;
+  struct timespec ctime;
+  uint64_t        hash;
+  unsigned int    nload, nparse;
+  VTP_CONF        conf;
+} VTP_CONF_CACHE;
+
+static VTP_CONF_CACHE vtpConfCache;
+
+/* Config the getters read: the cached one, if any */
+#define VTP_CONF_CUR  (vtpConfCache.valid ? &vtpConfCache.conf : &vtpConf)
+
+/*
+ * Crate index of the last file vtpReadConfigFile() read through: offset
+ * and line of each VTP_CRATE line that activates this host (its name or
+ * "all").  Reading the same file again (same device, inode, size, mtime
+ * and ctime) seeks from one of these sections to the next instead of
+ * reading the sections of all other crates.
+ */
+typedef struct
+{
+  long off;
+  int  lineno;
+} VTP_CRATE_SECTION;
+
+typedef struct
+{
+  int                valid;
+  char               fname[FNLEN];
+  char               host[ROCLEN];
+  dev_t              dev;
+  ino_t              ino;
+  off_t              size;
+  struct timespec    mtime;
+  struct timespec    ctime;
+  int                nsect, maxsect;
+  VTP_CRATE_SECTION *sect;
+} VTP_CRATE_INDEX;
+
+static VTP_CRATE_INDEX vtpCrateIndex;      /* of the last file read */
+static VTP_CRATE_INDEX vtpCrateIndexNew;   /* being built */
+
 char *getenv();
 
 #define SCAN_MSK						\
@@ -110,6 +171,551 @@ char *getenv();
     ui1 |= (msk[jj]<<jj); \
   }
 
+/*
+ * Config file keywords.  vtpReadConfigFile() looks the keyword of each
+ * line up in a hash table (FNV-1a of the name) and dispatches on its id.
+ * Before the handler runs, the values are checked against 'types':
+ *   d  decimal integer          i  integer, any base (0x.., 0..)
+ *   x  hex integer              X  hex integer with a 0x prefix
+ *   f  floating point           s  string
+ *   a  dotted quad (a.b.c.d)    ?  the values that follow are optional
+ *   q  four octets, "a b c d" or the dotted "a.b.c.d" (must be the only type)
+ */
+enum
+{
+  VTP_KW_CRATE,
+  VTP_KW_W_WIDTH,
+  VTP_KW_W_OFFSET,
+  VTP_KW_FIRMWARE_V7,
+  VTP_KW_FIRMWARE_Z7,
+  VTP_KW_STATS_HOST,
+  VTP_KW_STATS_PORT,
+  VTP_KW_STATS_INST,
+  VTP_KW_SYNC_PKT_LEN,
+  VTP_KW_SYNC_RATE,
+  VTP_KW_SYNC_DEST,
+  VTP_KW_STREAMING_BALANCE,
+  VTP_KW_STREAMING_PROFILE,
+  VTP_KW_STREAMING_HOT_RECONFIG,
+  VTP_KW_LINK_SUPERVISOR,
+  VTP_KW_LINK_FAILOVER,
+  VTP_KW_LINK_STALL_MS,
+  VTP_KW_LINK_STANDBY,
+  VTP_KW_FRAMELEN_ADAPT,
+  VTP_KW_FRAMELEN_TARGET_BYTES,
+  VTP_KW_FRAMELEN_MAX_NS,
+  VTP_KW_FRAMELEN_STATE,
+  VTP_KW_MTU_PROBE_PORT,
+  VTP_KW_MTU_PROBE_TIMEOUT_MS,
+  VTP_KW_MTU_PROBE_MAX,
+  VTP_KW_DOWNLOAD_MODE,
+  VTP_KW_NUM_CONNECTIONS,
+  VTP_KW_NET_MODE,
+  VTP_KW_ENABLE_EJFAT,
+  VTP_KW_LOCAL_PORT,
+  VTP_KW_REFCLK,
+  VTP_KW_PAYLOAD_EN,
+  VTP_KW_FIBER_EN,
+  VTP_KW_EC_FADCSUM_CH,
+  VTP_KW_EC_INNER_HIT_EMIN,
+  VTP_KW_EC_INNER_HIT_DT,
+  VTP_KW_EC_INNER_HIT_DALITZ,
+  VTP_KW_EC_INNER_COSMIC_EMIN,
+  VTP_KW_EC_INNER_COSMIC_MULTMAX,
+  VTP_KW_EC_INNER_COSMIC_HITWIDTH,
+  VTP_KW_EC_INNER_COSMIC_EVALDELAY,
+  VTP_KW_EC_OUTER_HIT_EMIN,
+  VTP_KW_EC_OUTER_HIT_DT,
+  VTP_KW_EC_OUTER_HIT_DALITZ,
+  VTP_KW_EC_OUTER_COSMIC_EMIN,
+  VTP_KW_EC_OUTER_COSMIC_MULTMAX,
+  VTP_KW_EC_OUTER_COSMIC_HITWIDTH,
+  VTP_KW_EC_OUTER_COSMIC_EVALDELAY,
+  VTP_KW_PC_FADCSUM_CH,
+  VTP_KW_PC_COSMIC_EMIN,
+  VTP_KW_PC_COSMIC_MULTMAX,
+  VTP_KW_PC_COSMIC_HITWIDTH,
+  VTP_KW_PC_COSMIC_EVALDELAY,
+  VTP_KW_PC_COSMIC_PIXELEN,
+  VTP_KW_HTCC_THRESHOLDS,
+  VTP_KW_HTCC_NFRAMES,
+  VTP_KW_CTOF_THRESHOLDS,
+  VTP_KW_CTOF_NFRAMES,
+  VTP_KW_FTOF_THRESHOLDS,
+  VTP_KW_FTOF_NFRAMES,
+  VTP_KW_CND_THRESHOLDS,
+  VTP_KW_CND_NFRAMES,
+  VTP_KW_PCS_THRESHOLDS,
+  VTP_KW_PCS_NFRAMES,
+  VTP_KW_PCS_DIPFACTOR,
+  VTP_KW_PCS_NSTRIP,
+  VTP_KW_PCS_DALITZ,
+  VTP_KW_PCS_COSMIC_EMIN,
+  VTP_KW_PCS_COSMIC_MULTMAX,
+  VTP_KW_PCS_COSMIC_HITWIDTH,
+  VTP_KW_PCS_COSMIC_EVALDELAY,
+  VTP_KW_PCS_COSMIC_PIXELEN,
+  VTP_KW_PCU_THRESHOLDS,
+  VTP_KW_ECS_FADCSUM_CH,
+  VTP_KW_ECS_INNER_COSMIC_EMIN,
+  VTP_KW_ECS_INNER_COSMIC_MULTMAX,
+  VTP_KW_ECS_INNER_COSMIC_HITWIDTH,
+  VTP_KW_ECS_INNER_COSMIC_EVALDELAY,
+  VTP_KW_ECS_OUTER_COSMIC_EMIN,
+  VTP_KW_ECS_OUTER_COSMIC_MULTMAX,
+  VTP_KW_ECS_OUTER_COSMIC_HITWIDTH,
+  VTP_KW_ECS_OUTER_COSMIC_EVALDELAY,
+  VTP_KW_ECS_THRESHOLDS,
+  VTP_KW_ECS_NFRAMES,
+  VTP_KW_ECS_DIPFACTOR,
+  VTP_KW_ECS_NSTRIP,
+  VTP_KW_ECS_DALITZ,
+  VTP_KW_GT_LATENCY,
+  VTP_KW_GT_WIDTH,
+  VTP_KW_GT_TRG,
+  VTP_KW_GT_TRG_SSP_STRIGGER_MASK,
+  VTP_KW_GT_TRG_SSP_CTRIGGER_MASK,
+  VTP_KW_GT_TRG_SSP_SECTOR_MASK,
+  VTP_KW_GT_TRG_SSP_SECTOR_MULT_MIN,
+  VTP_KW_GT_TRG_SSP_SECTOR_WIDTH,
+  VTP_KW_GT_TRG_PULSER_FREQ,
+  VTP_KW_GT_TRG_DELAY,
+  VTP_KW_GT_TRG_PRESCALE,
+  VTP_KW_GT_TRGBIT,
+  VTP_KW_GT_TRGBIT2,
+  VTP_KW_DC_SEGTHR,
+  VTP_KW_HCAL_HIT_DT,
+  VTP_KW_HCAL_HIT_EMIN,
+  VTP_KW_FTCAL_FADCSUM_CH,
+  VTP_KW_FTCAL_SEED_EMIN,
+  VTP_KW_FTCAL_SEED_DT,
+  VTP_KW_FTCAL_HODO_DT,
+  VTP_KW_FTHODO_EMIN,
+  VTP_KW_FTCAL_CLUSTER_DEADTIME_EMIN,
+  VTP_KW_FTCAL_CLUSTER_DEADTIME,
+  VTP_KW_HPS_ECAL_TOP,
+  VTP_KW_HPS_ECAL_BOTTOM,
+  VTP_KW_HPS_ECAL_CLUSTER_HIT_DT,
+  VTP_KW_HPS_ECAL_CLUSTER_SEED_THR,
+  VTP_KW_HPS_HODOSCOPE_FADCHIT_THR,
+  VTP_KW_HPS_HODOSCOPE_HODO_THR,
+  VTP_KW_HPS_HODOSCOPE_HODO_DT,
+  VTP_KW_HPS_CALIB_HODOSCOPE_TOP_EN,
+  VTP_KW_HPS_CALIB_HODOSCOPE_BOT_EN,
+  VTP_KW_HPS_CALIB_COSMIC_DT,
+  VTP_KW_HPS_CALIB_COSMIC_TOP_EN,
+  VTP_KW_HPS_CALIB_COSMIC_BOT_EN,
+  VTP_KW_HPS_CALIB_PULSER_EN,
+  VTP_KW_HPS_CALIB_PULSER_FREQ,
+  VTP_KW_HPS_SINGLE_EMIN,
+  VTP_KW_HPS_SINGLE_EMAX,
+  VTP_KW_HPS_SINGLE_NMIN,
+  VTP_KW_HPS_SINGLE_XMIN,
+  VTP_KW_HPS_SINGLE_PDE,
+  VTP_KW_HPS_SINGLE_HODO,
+  VTP_KW_HPS_SINGLE_EN,
+  VTP_KW_HPS_PAIR_EMIN,
+  VTP_KW_HPS_PAIR_EMAX,
+  VTP_KW_HPS_PAIR_NMIN,
+  VTP_KW_HPS_PAIR_TIMECOINCIDENCE,
+  VTP_KW_HPS_PAIR_SUMMAX_MIN,
+  VTP_KW_HPS_PAIR_DIFFMAX,
+  VTP_KW_HPS_PAIR_ENERGYDIST,
+  VTP_KW_HPS_PAIR_COPLANARITY,
+  VTP_KW_HPS_PAIR_HODO,
+  VTP_KW_HPS_PAIR_EN,
+  VTP_KW_HPS_MULT_EMIN,
+  VTP_KW_HPS_MULT_EMAX,
+  VTP_KW_HPS_MULT_NMIN,
+  VTP_KW_HPS_MULT_MIN,
+  VTP_KW_HPS_MULT_DT,
+  VTP_KW_HPS_MULT_EN,
+  VTP_KW_HPS_FEE_EN,
+  VTP_KW_HPS_FEE_PRESCALE,
+  VTP_KW_HPS_FEE_EMIN,
+  VTP_KW_HPS_FEE_EMAX,
+  VTP_KW_HPS_FEE_NMIN,
+  VTP_KW_HPS_LATENCY,
+  VTP_KW_HPS_PRESCALE,
+  VTP_KW_STREAMING_ROCID,
+  VTP_KW_STREAMING_NFRAME_BUF,
+  VTP_KW_STREAMING_FRAMELEN,
+  VTP_KW_STREAMING,
+  VTP_KW_STREAMING_SLOT_EN,
+  VTP_KW_STREAMING_NSTREAMS,
+  VTP_KW_STREAMING_CONNECT,
+  VTP_KW_STREAMING_IPADDR,
+  VTP_KW_STREAMING_SUBNET,
+  VTP_KW_STREAMING_GATEWAY,
+  VTP_KW_STREAMING_MAC,
+  VTP_KW_STREAMING_DESTIP,
+  VTP_KW_STREAMING_DESTIPPORT,
+  VTP_KW_STREAMING_LOCALPORT,
+  VTP_KW_ROC_ROCID,
+  VTP_KW_ROC_DEST_IP,
+  VTP_KW_ROC_DEST_PORT,
+  VTP_KW_COMPTON_VETROC_WIDTH,
+  VTP_KW_COMPTON_LATENCY,
+  VTP_KW_COMPTON_WIDTH,
+  VTP_KW_COMPTON_FADC_THRESHOLD,
+  VTP_KW_COMPTON_FADC_EN_MASK,
+  VTP_KW_COMPTON_EPLANE_MULT_MIN,
+  VTP_KW_COMPTON_EPLANE_MASK,
+  VTP_KW_COMPTON_PRESCALE,
+  VTP_KW_COMPTON_SCALER_READOUT_EN,
+  VTP_KW_COMPTON_DELAY,
+  VTP_KW_COUNT
+};
+
+typedef struct
+{
+  const char *name;
+  int         id;
+  const char *types;
+} VTP_KEYWORD;
+
+static const VTP_KEYWORD vtpKeywords[VTP_KW_COUNT] =
+{
+  {"VTP_CRATE",                        VTP_KW_CRATE,                          "s"},
+  {"VTP_W_WIDTH",                      VTP_KW_W_WIDTH,                        "d"},
+  {"VTP_W_OFFSET",                     VTP_KW_W_OFFSET,                       "d"},
+  {"VTP_FIRMWARE_V7",                  VTP_KW_FIRMWARE_V7,                    "s"},
+  {"VTP_FIRMWARE_Z7",                  VTP_KW_FIRMWARE_Z7,                    "s"},
+  {"VTP_STATS_HOST",                   VTP_KW_STATS_HOST,                     "s"},
+  {"VTP_STATS_PORT",                   VTP_KW_STATS_PORT,                     "d"},
+  {"VTP_STATS_INST",                   VTP_KW_STATS_INST,                     "d"},
+  {"VTP_SYNC_PKT_LEN",                 VTP_KW_SYNC_PKT_LEN,                   "d"},
+  {"VTP_SYNC_RATE",                    VTP_KW_SYNC_RATE,                      "d"},
+  {"VTP_SYNC_DEST",                    VTP_KW_SYNC_DEST,                      "sd?i"},
+  {"VTP_STREAMING_BALANCE",            VTP_KW_STREAMING_BALANCE,              "d"},
+  {"VTP_STREAMING_PROFILE",            VTP_KW_STREAMING_PROFILE,              "s"},
+  {"VTP_STREAMING_HOT_RECONFIG",       VTP_KW_STREAMING_HOT_RECONFIG,         "d"},
+  {"VTP_LINK_SUPERVISOR",              VTP_KW_LINK_SUPERVISOR,                "d"},
+  {"VTP_LINK_FAILOVER",                VTP_KW_LINK_FAILOVER,                  "d"},
+  {"VTP_LINK_STALL_MS",                VTP_KW_LINK_STALL_MS,                  "d"},
+  {"VTP_LINK_STANDBY",                 VTP_KW_LINK_STANDBY,                   "dad"},
+  {"VTP_FRAMELEN_ADAPT",               VTP_KW_FRAMELEN_ADAPT,                 "d"},
+  {"VTP_FRAMELEN_TARGET_BYTES",        VTP_KW_FRAMELEN_TARGET_BYTES,          "d"},
+  {"VTP_FRAMELEN_MAX_NS",              VTP_KW_FRAMELEN_MAX_NS,                "d"},
+  {"VTP_FRAMELEN_STATE",               VTP_KW_FRAMELEN_STATE,                 "s"},
+  {"VTP_MTU_PROBE_PORT",               VTP_KW_MTU_PROBE_PORT,                 "d"},
+  {"VTP_MTU_PROBE_TIMEOUT_MS",         VTP_KW_MTU_PROBE_TIMEOUT_MS,           "d"},
+  {"VTP_MTU_PROBE_MAX",                VTP_KW_MTU_PROBE_MAX,                  "d"},
+  {"VTP_DOWNLOAD_MODE",                VTP_KW_DOWNLOAD_MODE,                  "d"},
+  {"VTP_NUM_CONNECTIONS",              VTP_KW_NUM_CONNECTIONS,                "d"},
+  {"VTP_NET_MODE",                     VTP_KW_NET_MODE,                       "d"},
+  {"VTP_ENABLE_EJFAT",                 VTP_KW_ENABLE_EJFAT,                   "d"},
+  {"VTP_LOCAL_PORT",                   VTP_KW_LOCAL_PORT,                     "d"},
+  {"VTP_REFCLK",                       VTP_KW_REFCLK,                         "d"},
+  {"VTP_PAYLOAD_EN",                   VTP_KW_PAYLOAD_EN,                     "dddddddddddddddd"},
+  {"VTP_FIBER_EN",                     VTP_KW_FIBER_EN,                       "dddd"},
+  {"VTP_EC_FADCSUM_CH",                VTP_KW_EC_FADCSUM_CH,                  "XXXXXXXXXXXXXXXX"},
+  {"VTP_EC_INNER_HIT_EMIN",            VTP_KW_EC_INNER_HIT_EMIN,              "d"},
+  {"VTP_EC_INNER_HIT_DT",              VTP_KW_EC_INNER_HIT_DT,                "d"},
+  {"VTP_EC_INNER_HIT_DALITZ",          VTP_KW_EC_INNER_HIT_DALITZ,            "dd"},
+  {"VTP_EC_INNER_COSMIC_EMIN",         VTP_KW_EC_INNER_COSMIC_EMIN,           "d"},
+  {"VTP_EC_INNER_COSMIC_MULTMAX",      VTP_KW_EC_INNER_COSMIC_MULTMAX,        "d"},
+  {"VTP_EC_INNER_COSMIC_HITWIDTH",     VTP_KW_EC_INNER_COSMIC_HITWIDTH,       "d"},
+  {"VTP_EC_INNER_COSMIC_EVALDELAY",    VTP_KW_EC_INNER_COSMIC_EVALDELAY,      "d"},
+  {"VTP_EC_OUTER_HIT_EMIN",            VTP_KW_EC_OUTER_HIT_EMIN,              "d"},
+  {"VTP_EC_OUTER_HIT_DT",              VTP_KW_EC_OUTER_HIT_DT,                "d"},
+  {"VTP_EC_OUTER_HIT_DALITZ",          VTP_KW_EC_OUTER_HIT_DALITZ,            "dd"},
+  {"VTP_EC_OUTER_COSMIC_EMIN",         VTP_KW_EC_OUTER_COSMIC_EMIN,           "d"},
+  {"VTP_EC_OUTER_COSMIC_MULTMAX",      VTP_KW_EC_OUTER_COSMIC_MULTMAX,        "d"},
+  {"VTP_EC_OUTER_COSMIC_HITWIDTH",     VTP_KW_EC_OUTER_COSMIC_HITWIDTH,       "d"},
+  {"VTP_EC_OUTER_COSMIC_EVALDELAY",    VTP_KW_EC_OUTER_COSMIC_EVALDELAY,      "d"},
+  {"VTP_PC_FADCSUM_CH",                VTP_KW_PC_FADCSUM_CH,                  "XXXXXXXXXXXXXXXX"},
+  {"VTP_PC_COSMIC_EMIN",               VTP_KW_PC_COSMIC_EMIN,                 "d"},
+  {"VTP_PC_COSMIC_MULTMAX",            VTP_KW_PC_COSMIC_MULTMAX,              "d"},
+  {"VTP_PC_COSMIC_HITWIDTH",           VTP_KW_PC_COSMIC_HITWIDTH,             "d"},
+  {"VTP_PC_COSMIC_EVALDELAY",          VTP_KW_PC_COSMIC_EVALDELAY,            "d"},
+  {"VTP_PC_COSMIC_PIXELEN",            VTP_KW_PC_COSMIC_PIXELEN,              "d"},
+  {"VTP_HTCC_THRESHOLDS",              VTP_KW_HTCC_THRESHOLDS,                "ddd"},
+  {"VTP_HTCC_NFRAMES",                 VTP_KW_HTCC_NFRAMES,                   "d"},
+  {"VTP_CTOF_THRESHOLDS",              VTP_KW_CTOF_THRESHOLDS,                "ddd"},
+  {"VTP_CTOF_NFRAMES",                 VTP_KW_CTOF_NFRAMES,                   "d"},
+  {"VTP_FTOF_THRESHOLDS",              VTP_KW_FTOF_THRESHOLDS,                "ddd"},
+  {"VTP_FTOF_NFRAMES",                 VTP_KW_FTOF_NFRAMES,                   "d"},
+  {"VTP_CND_THRESHOLDS",               VTP_KW_CND_THRESHOLDS,                 "ddd"},
+  {"VTP_CND_NFRAMES",                  VTP_KW_CND_NFRAMES,                    "d"},
+  {"VTP_PCS_THRESHOLDS",               VTP_KW_PCS_THRESHOLDS,                 "ddd"},
+  {"VTP_PCS_NFRAMES",                  VTP_KW_PCS_NFRAMES,                    "d"},
+  {"VTP_PCS_DIPFACTOR",                VTP_KW_PCS_DIPFACTOR,                  "d"},
+  {"VTP_PCS_NSTRIP",                   VTP_KW_PCS_NSTRIP,                     "dd"},
+  {"VTP_PCS_DALITZ",                   VTP_KW_PCS_DALITZ,                     "dd"},
+  {"VTP_PCS_COSMIC_EMIN",              VTP_KW_PCS_COSMIC_EMIN,                "d"},
+  {"VTP_PCS_COSMIC_MULTMAX",           VTP_KW_PCS_COSMIC_MULTMAX,             "d"},
+  {"VTP_PCS_COSMIC_HITWIDTH",          VTP_KW_PCS_COSMIC_HITWIDTH,            "d"},
+  {"VTP_PCS_COSMIC_EVALDELAY",         VTP_KW_PCS_COSMIC_EVALDELAY,           "d"},
+  {"VTP_PCS_COSMIC_PIXELEN",           VTP_KW_PCS_COSMIC_PIXELEN,             "d"},
+  {"VTP_PCU_THRESHOLDS",               VTP_KW_PCU_THRESHOLDS,                 "ddd"},
+  {"VTP_ECS_FADCSUM_CH",               VTP_KW_ECS_FADCSUM_CH,                 "XXXXXXXXXXXXXXXX"},
+  {"VTP_ECS_INNER_COSMIC_EMIN",        VTP_KW_ECS_INNER_COSMIC_EMIN,          "d"},
+  {"VTP_ECS_INNER_COSMIC_MULTMAX",     VTP_KW_ECS_INNER_COSMIC_MULTMAX,       "d"},
+  {"VTP_ECS_INNER_COSMIC_HITWIDTH",    VTP_KW_ECS_INNER_COSMIC_HITWIDTH,      "d"},
+  {"VTP_ECS_INNER_COSMIC_EVALDELAY",   VTP_KW_ECS_INNER_COSMIC_EVALDELAY,     "d"},
+  {"VTP_ECS_OUTER_COSMIC_EMIN",        VTP_KW_ECS_OUTER_COSMIC_EMIN,          "d"},
+  {"VTP_ECS_OUTER_COSMIC_MULTMAX",     VTP_KW_ECS_OUTER_COSMIC_MULTMAX,       "d"},
+  {"VTP_ECS_OUTER_COSMIC_HITWIDTH",    VTP_KW_ECS_OUTER_COSMIC_HITWIDTH,      "d"},
+  {"VTP_ECS_OUTER_COSMIC_EVALDELAY",   VTP_KW_ECS_OUTER_COSMIC_EVALDELAY,     "d"},
+  {"VTP_ECS_THRESHOLDS",               VTP_KW_ECS_THRESHOLDS,                 "ddd"},
+  {"VTP_ECS_NFRAMES",                  VTP_KW_ECS_NFRAMES,                    "d"},
+  {"VTP_ECS_DIPFACTOR",                VTP_KW_ECS_DIPFACTOR,                  "d"},
+  {"VTP_ECS_NSTRIP",                   VTP_KW_ECS_NSTRIP,                     "dd"},
+  {"VTP_ECS_DALITZ",                   VTP_KW_ECS_DALITZ,                     "dd"},
+  {"VTP_GT_LATENCY",                   VTP_KW_GT_LATENCY,                     "d"},
+  {"VTP_GT_WIDTH",                     VTP_KW_GT_WIDTH,                       "d"},
+  {"VTP_GT_TRG",                       VTP_KW_GT_TRG,                         "d"},
+  {"VTP_GT_TRG_SSP_STRIGGER_MASK",     VTP_KW_GT_TRG_SSP_STRIGGER_MASK,       "XX"},
+  {"VTP_GT_TRG_SSP_CTRIGGER_MASK",     VTP_KW_GT_TRG_SSP_CTRIGGER_MASK,       "X"},
+  {"VTP_GT_TRG_SSP_SECTOR_MASK",       VTP_KW_GT_TRG_SSP_SECTOR_MASK,         "XX"},
+  {"VTP_GT_TRG_SSP_SECTOR_MULT_MIN",   VTP_KW_GT_TRG_SSP_SECTOR_MULT_MIN,     "dd"},
+  {"VTP_GT_TRG_SSP_SECTOR_WIDTH",      VTP_KW_GT_TRG_SSP_SECTOR_WIDTH,        "d"},
+  {"VTP_GT_TRG_PULSER_FREQ",           VTP_KW_GT_TRG_PULSER_FREQ,             "f"},
+  {"VTP_GT_TRG_DELAY",                 VTP_KW_GT_TRG_DELAY,                   "d"},
+  {"VTP_GT_TRG_PRESCALE",              VTP_KW_GT_TRG_PRESCALE,                "d"},
+  {"VTP_GT_TRGBIT",                    VTP_KW_GT_TRGBIT,                      "dddddddd"},
+  {"VTP_GT_TRGBIT2",                   VTP_KW_GT_TRGBIT2,                     "ddddddddddd"},
+  {"VTP_DC_SEGTHR",                    VTP_KW_DC_SEGTHR,                      "dd"},
+  {"VTP_HCAL_HIT_DT",                  VTP_KW_HCAL_HIT_DT,                    "d"},
+  {"VTP_HCAL_HIT_EMIN",                VTP_KW_HCAL_HIT_EMIN,                  "d"},
+  {"VTP_FTCAL_FADCSUM_CH",             VTP_KW_FTCAL_FADCSUM_CH,               "XXXXXXXXXXXXXXXX"},
+  {"VTP_FTCAL_SEED_EMIN",              VTP_KW_FTCAL_SEED_EMIN,                "d"},
+  {"VTP_FTCAL_SEED_DT",                VTP_KW_FTCAL_SEED_DT,                  "d"},
+  {"VTP_FTCAL_HODO_DT",                VTP_KW_FTCAL_HODO_DT,                  "d"},
+  {"VTP_FTHODO_EMIN",                  VTP_KW_FTHODO_EMIN,                    "d"},
+  {"VTP_FTCAL_CLUSTER_DEADTIME_EMIN",  VTP_KW_FTCAL_CLUSTER_DEADTIME_EMIN,    "d"},
+  {"VTP_FTCAL_CLUSTER_DEADTIME",       VTP_KW_FTCAL_CLUSTER_DEADTIME,         "d"},
+  {"VTP_HPS_ECAL_TOP",                 VTP_KW_HPS_ECAL_TOP,                   ""},
+  {"VTP_HPS_ECAL_BOTTOM",              VTP_KW_HPS_ECAL_BOTTOM,                ""},
+  {"VTP_HPS_ECAL_CLUSTER_HIT_DT",      VTP_KW_HPS_ECAL_CLUSTER_HIT_DT,        "d"},
+  {"VTP_HPS_ECAL_CLUSTER_SEED_THR",    VTP_KW_HPS_ECAL_CLUSTER_SEED_THR,      "d"},
+  {"VTP_HPS_HODOSCOPE_FADCHIT_THR",    VTP_KW_HPS_HODOSCOPE_FADCHIT_THR,      "d"},
+  {"VTP_HPS_HODOSCOPE_HODO_THR",       VTP_KW_HPS_HODOSCOPE_HODO_THR,         "d"},
+  {"VTP_HPS_HODOSCOPE_HODO_DT",        VTP_KW_HPS_HODOSCOPE_HODO_DT,          "d"},
+  {"VTP_HPS_CALIB_HODOSCOPE_TOP_EN",   VTP_KW_HPS_CALIB_HODOSCOPE_TOP_EN,     "d"},
+  {"VTP_HPS_CALIB_HODOSCOPE_BOT_EN",   VTP_KW_HPS_CALIB_HODOSCOPE_BOT_EN,     "d"},
+  {"VTP_HPS_CALIB_COSMIC_DT",          VTP_KW_HPS_CALIB_COSMIC_DT,            "d"},
+  {"VTP_HPS_CALIB_COSMIC_TOP_EN",      VTP_KW_HPS_CALIB_COSMIC_TOP_EN,        "d"},
+  {"VTP_HPS_CALIB_COSMIC_BOT_EN",      VTP_KW_HPS_CALIB_COSMIC_BOT_EN,        "d"},
+  {"VTP_HPS_CALIB_PULSER_EN",          VTP_KW_HPS_CALIB_PULSER_EN,            "d"},
+  {"VTP_HPS_CALIB_PULSER_FREQ",        VTP_KW_HPS_CALIB_PULSER_FREQ,          "f"},
+  {"VTP_HPS_SINGLE_EMIN",              VTP_KW_HPS_SINGLE_EMIN,                "ddd"},
+  {"VTP_HPS_SINGLE_EMAX",              VTP_KW_HPS_SINGLE_EMAX,                "ddd"},
+  {"VTP_HPS_SINGLE_NMIN",              VTP_KW_HPS_SINGLE_NMIN,                "ddd"},
+  {"VTP_HPS_SINGLE_XMIN",              VTP_KW_HPS_SINGLE_XMIN,                "ddd"},
+  {"VTP_HPS_SINGLE_PDE",               VTP_KW_HPS_SINGLE_PDE,                 "dffffd"},
+  {"VTP_HPS_SINGLE_HODO",              VTP_KW_HPS_SINGLE_HODO,                "ddddd"},
+  {"VTP_HPS_SINGLE_EN",                VTP_KW_HPS_SINGLE_EN,                  "dd"},
+  {"VTP_HPS_PAIR_EMIN",                VTP_KW_HPS_PAIR_EMIN,                  "dd"},
+  {"VTP_HPS_PAIR_EMAX",                VTP_KW_HPS_PAIR_EMAX,                  "dd"},
+  {"VTP_HPS_PAIR_NMIN",                VTP_KW_HPS_PAIR_NMIN,                  "dd"},
+  {"VTP_HPS_PAIR_TIMECOINCIDENCE",     VTP_KW_HPS_PAIR_TIMECOINCIDENCE,       "dd"},
+  {"VTP_HPS_PAIR_SUMMAX_MIN",          VTP_KW_HPS_PAIR_SUMMAX_MIN,            "dddd"},
+  {"VTP_HPS_PAIR_DIFFMAX",             VTP_KW_HPS_PAIR_DIFFMAX,               "ddd"},
+  {"VTP_HPS_PAIR_ENERGYDIST",          VTP_KW_HPS_PAIR_ENERGYDIST,            "dfdd"},
+  {"VTP_HPS_PAIR_COPLANARITY",         VTP_KW_HPS_PAIR_COPLANARITY,           "ddd"},
+  {"VTP_HPS_PAIR_HODO",                VTP_KW_HPS_PAIR_HODO,                  "ddddd"},
+  {"VTP_HPS_PAIR_EN",                  VTP_KW_HPS_PAIR_EN,                    "dd"},
+  {"VTP_HPS_MULT_EMIN",                VTP_KW_HPS_MULT_EMIN,                  "dd"},
+  {"VTP_HPS_MULT_EMAX",                VTP_KW_HPS_MULT_EMAX,                  "dd"},
+  {"VTP_HPS_MULT_NMIN",                VTP_KW_HPS_MULT_NMIN,                  "dd"},
+  {"VTP_HPS_MULT_MIN",                 VTP_KW_HPS_MULT_MIN,                   "dddd"},
+  {"VTP_HPS_MULT_DT",                  VTP_KW_HPS_MULT_DT,                    "dd"},
+  {"VTP_HPS_MULT_EN",                  VTP_KW_HPS_MULT_EN,                    "dd"},
+  {"VTP_HPS_FEE_EN",                   VTP_KW_HPS_FEE_EN,                     "d"},
+  {"VTP_HPS_FEE_PRESCALE",             VTP_KW_HPS_FEE_PRESCALE,               "dddd"},
+  {"VTP_HPS_FEE_EMIN",                 VTP_KW_HPS_FEE_EMIN,                   "d"},
+  {"VTP_HPS_FEE_EMAX",                 VTP_KW_HPS_FEE_EMAX,                   "d"},
+  {"VTP_HPS_FEE_NMIN",                 VTP_KW_HPS_FEE_NMIN,                   "d"},
+  {"VTP_HPS_LATENCY",                  VTP_KW_HPS_LATENCY,                    "d"},
+  {"VTP_HPS_PRESCALE",                 VTP_KW_HPS_PRESCALE,                   "dd"},
+  {"VTP_STREAMING_ROCID",              VTP_KW_STREAMING_ROCID,                "d"},
+  {"VTP_STREAMING_NFRAME_BUF",         VTP_KW_STREAMING_NFRAME_BUF,           "d"},
+  {"VTP_STREAMING_FRAMELEN",           VTP_KW_STREAMING_FRAMELEN,             "d"},
+  {"VTP_STREAMING",                    VTP_KW_STREAMING,                      "d"},
+  {"VTP_STREAMING_SLOT_EN",            VTP_KW_STREAMING_SLOT_EN,              "dddddddd"},
+  {"VTP_STREAMING_NSTREAMS",           VTP_KW_STREAMING_NSTREAMS,             "d"},
+  {"VTP_STREAMING_CONNECT",            VTP_KW_STREAMING_CONNECT,              "d"},
+  {"VTP_STREAMING_IPADDR",             VTP_KW_STREAMING_IPADDR,               "q"},
+  {"VTP_STREAMING_SUBNET",             VTP_KW_STREAMING_SUBNET,               "q"},
+  {"VTP_STREAMING_GATEWAY",            VTP_KW_STREAMING_GATEWAY,              "q"},
+  {"VTP_STREAMING_MAC",                VTP_KW_STREAMING_MAC,                  "XXXXXX"},
+  {"VTP_STREAMING_DESTIP",             VTP_KW_STREAMING_DESTIP,               "q"},
+  {"VTP_STREAMING_DESTIPPORT",         VTP_KW_STREAMING_DESTIPPORT,           "d"},
+  {"VTP_STREAMING_LOCALPORT",          VTP_KW_STREAMING_LOCALPORT,            "d"},
+  {"VTP_ROC_ROCID",                    VTP_KW_ROC_ROCID,                      "d"},
+  {"VTP_ROC_DEST_IP",                  VTP_KW_ROC_DEST_IP,                    "x"},
+  {"VTP_ROC_DEST_PORT",                VTP_KW_ROC_DEST_PORT,                  "d"},
+  {"VTP_COMPTON_VETROC_WIDTH",         VTP_KW_COMPTON_VETROC_WIDTH,           "d"},
+  {"VTP_COMPTON_LATENCY",              VTP_KW_COMPTON_LATENCY,                "d"},
+  {"VTP_COMPTON_WIDTH",                VTP_KW_COMPTON_WIDTH,                  "d"},
+  {"VTP_COMPTON_FADC_THRESHOLD",       VTP_KW_COMPTON_FADC_THRESHOLD,         "dd"},
+  {"VTP_COMPTON_FADC_EN_MASK",         VTP_KW_COMPTON_FADC_EN_MASK,           "ddddddddddddddddd"},
+  {"VTP_COMPTON_EPLANE_MULT_MIN",      VTP_KW_COMPTON_EPLANE_MULT_MIN,        "dd"},
+  {"VTP_COMPTON_EPLANE_MASK",          VTP_KW_COMPTON_EPLANE_MASK,            "ddddd"},
+  {"VTP_COMPTON_PRESCALE",             VTP_KW_COMPTON_PRESCALE,               "dd"},
+  {"VTP_COMPTON_SCALER_READOUT_EN",    VTP_KW_COMPTON_SCALER_READOUT_EN,      "d"},
+  {"VTP_COMPTON_DELAY",                VTP_KW_COMPTON_DELAY,                  "dd"},
+};
+
+#define VTP_KW_FNV_OFFSET  2166136261u
+#define VTP_KW_FNV_PRIME   16777619u
+#define VTP_KW_HASH_SIZE   512         /* power of 2, > 2 x VTP_KW_COUNT */
+
+static short vtpKeywordHash[VTP_KW_HASH_SIZE];
+static int   vtpKeywordHashInit = 0;
+
+static unsigned int
+vtpKeywordHashString(const char *name)
+{
+  unsigned int hash = VTP_KW_FNV_OFFSET;
+
+  while(*name)
+    hash = (hash ^ (unsigned char)*name++) * VTP_KW_FNV_PRIME;
+  return hash;
+}
+
+/* Keyword table entry for keyword (hash = FNV-1a of keyword), NULL if unknown */
+static const VTP_KEYWORD *
+vtpKeywordFind(const char *keyword, unsigned int hash)
+{
+  unsigned int h;
+  int i;
+
+  if(!vtpKeywordHashInit)
+    {
+      for(h=0; h<VTP_KW_HASH_SIZE; h++)
+	vtpKeywordHash[h] = -1;
+      for(i=0; i<VTP_KW_COUNT; i++)
+	{
+	  h = vtpKeywordHashString(vtpKeywords[i].name) & (VTP_KW_HASH_SIZE - 1);
+	  while(vtpKeywordHash[h] >= 0)
+	    h = (h + 1) & (VTP_KW_HASH_SIZE - 1);
+	  vtpKeywordHash[h] = i;
+	}
+      vtpKeywordHashInit = 1;
+    }
+
+  for(h = hash & (VTP_KW_HASH_SIZE - 1); vtpKeywordHash[h] >= 0; h = (h + 1) & (VTP_KW_HASH_SIZE - 1))
+    if(strcmp(vtpKeywords[vtpKeywordHash[h]].name, keyword) == 0)
+      return &vtpKeywords[vtpKeywordHash[h]];
+
+  return NULL;
+}
+
+static const char *
+vtpKeywordTypeName(char type)
+{
+  switch(type)
+    {
+    case 'd': return "a decimal integer";
+    case 'i': return "an integer";
+    case 'x': return "a hex integer";
+    case 'X': return "a hex integer (0x..)";
+    case 'f': return "a number";
+    case 'a': return "an address a.b.c.d";
+    default:  return "a string";
+    }
+}
+
+/* Four octets of an address: "a b c d" or "a.b.c.d" */
+static void
+vtpConfigReadQuad(const char *line, int *argi)
+{
+  if(sscanf(line, "%*s %d.%d.%d.%d", &argi[0], &argi[1], &argi[2], &argi[3]) != 4)
+    sscanf(line, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
+}
+
+/*
+ * Check the values of a config line against the types of its keyword.
+ * Returns ERROR (line to be ignored) for a value of the wrong type; fewer
+ * values than required only warn, the handler then sees zeros as before.
+ */
+static int
+vtpKeywordCheck(const VTP_KEYWORD *kw, const char *line, const char *fname, int lineno)
+{
+  const char *p = line, *t, *types, *type;
+  char tok[STRLEN], *end;
+  int n = 0, nreq, len, ok, a[4];
+  char c;
+
+  while(*p && !isspace((unsigned char)*p))
+    p++;
+
+  types = kw->types;
+  if(*types == 'q')
+    {
+      for(t = p; *t && isspace((unsigned char)*t); t++) ;
+      types = (t[strcspn(t, " \t\r\n#.")] == '.') ? "a" : "dddd";
+    }
+  nreq = strcspn(types, "?");
+
+  for(type = types; *type; type++)
+    {
+      if(*type == '?')
+	continue;
+
+      while(*p && isspace((unsigned char)*p))
+	p++;
+      if((*p == '\0') || (*p == '#'))
+	break;
+
+      for(t = p; *p && !isspace((unsigned char)*p); p++) ;
+      len = ((p - t) < STRLEN) ? (p - t) : STRLEN - 1;
+      memcpy(tok, t, len);
+      tok[len] = '\0';
+
+      switch(*type)
+	{
+	case 'd':
+	  strtol(tok, &end, 10);
+	  ok = (end != tok) && (*end == '\0');
+	  break;
+	case 'i':
+	  strtol(tok, &end, 0);
+	  ok = (end != tok) && (*end == '\0');
+	  break;
+	case 'x':
+	  strtoul(tok, &end, 16);
+	  ok = (end != tok) && (*end == '\0');
+	  break;
+	case 'X':
+	  ok = (tok[0] == '0') && ((tok[1] == 'x') || (tok[1] == 'X'));
+	  if(ok)
+	    {
+	      strtoul(tok + 2, &end, 16);
+	      ok = (end != tok + 2) && (*end == '\0');
+	    }
+	  break;
+	case 'f':
+	  strtod(tok, &end);
+	  ok = (end != tok) && (*end == '\0');
+	  break;
+	case 'a':
+	  ok = (sscanf(tok, "%d.%d.%d.%d%c", &a[0], &a[1], &a[2], &a[3], &c) == 4);
+	  break;
+	default:
+	  ok = 1;
+	  break;
+	}
+
+      if(!ok)
+	{
+	  printf("vtpReadConfigFile: ERROR: %s:%d: %s value %d (%s) is not %s - line ignored\n",
+		 fname, lineno, kw->name, n + 1, tok, vtpKeywordTypeName(*type));
+	  return ERROR;
+	}
+      n++;
+    }
+
+  if(n < nreq)
+    printf("vtpReadConfigFile: WARNING: %s:%d: %s expects %d value%s, found %d\n",
+	   fname, lineno, kw->name, nreq, (nreq > 1) ? "s" : "", n);
+
+  return OK;
+}
+
 static char *expid = NULL;
 
 /* Routine prototype */
@@ -143,6 +749,168 @@ vtpConfig(char *fname)
   return(0);
 }
 
+/* 64 bit FNV-1a of the file content, ERROR if the file can't be read.
+   Generated files (vme_rol) start with a VTP_CONFIG_HASH_STAMP line of the
+   hash of the rest of the file: it is not part of the hash and is checked */
+static int
+vtpConfigFileHash(const char *fname, uint64_t *hash)
+{
+  unsigned char buf[16384];
+  uint64_t h = 14695981039346656037ull;
+  unsigned long long stamp = 0;
+  ssize_t n, i;
+  int fd, stamped = 0, first = 1;
+
+  fd = open(fname, O_RDONLY);
+  if(fd < 0)
+    return ERROR;
+
+  while((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+      i = 0;
+      if(first)
+	{
+	  first = 0;
+	  if((n > sizeof(VTP_CONFIG_HASH_STAMP)) &&
+	     (memcmp(buf, VTP_CONFIG_HASH_STAMP " ", sizeof(VTP_CONFIG_HASH_STAMP)) == 0) &&
+	     (memchr(buf, '\n', n) != NULL) &&
+	     (sscanf((char *)buf + sizeof(VTP_CONFIG_HASH_STAMP), "%16llx", &stamp) == 1))
+	    {
+	      stamped = 1;
+	      i = (unsigned char *)memchr(buf, '\n', n) - buf + 1;
+	    }
+	}
+      for(; i<n; i++)
+	h = (h ^ buf[i]) * 1099511628211ull;
+    }
+  close(fd);
+
+  if(n < 0)
+    return ERROR;
+
+  if(stamped && (stamp != h))
+    printf("%s: WARNING: %s was edited after it was generated (hash %016llx, stamp %016llx)\n",
+	   __func__, fname, (unsigned long long)h, stamp);
+
+  *hash = h;
+  return OK;
+}
+
+/*
+ * Path of config file 'filename' as vtpReadConfigFile() opens it: as given
+ * if it starts with '/' or './', else under $VTP_CONFIG_GET_ENV/vtp/ (./
+ * when not set).  The result starts with '/' or './', so it resolves to
+ * itself.  Returns ERROR if it does not fit FNLEN.
+ */
+static int
+vtpConfigFilePath(const char *filename, char *path)
+{
+  const char *envDir = NULL;
+  int n;
+
+#ifdef VTP_CONFIG_GET_ENV
+  envDir = getenv(VTP_CONFIG_GET_ENV);
+#endif
+  if(envDir == NULL)
+    envDir = ".";
+
+  if((filename[0] == '/') || ((filename[0] == '.') && (filename[1] == '/')))
+    n = snprintf(path, FNLEN, "%s", filename);
+  else if((envDir[0] == '/') || ((envDir[0] == '.') && (envDir[1] == '/')) ||
+	  (strcmp(envDir, ".") == 0))
+    n = snprintf(path, FNLEN, "%s/vtp/%s", envDir, filename);
+  else
+    n = snprintf(path, FNLEN, "./%s/vtp/%s", envDir, filename);
+
+  return ((n < 0) || (n >= FNLEN)) ? ERROR : OK;
+}
+
+/*
+ * Parse config file 'fname' (bare names under $VTP_PARAMS/vtp/, as for
+ * vtpReadConfigFile()) unless it is the file of the last call and did
+ * not change.  Returns the parsed config (also in the library state used
+ * by vtpDownloadAll() and the vtpGet* accessors), NULL if the file can't
+ * be read or parsed.
+ */
+const VTP_CONF *
+vtpConfigLoad(const char *fname_in)
+{
+  char fname[FNLEN];
+  struct stat st;
+  uint64_t hash;
+  int rval;
+
+  if((fname_in == NULL) || (fname_in[0] == '\0') ||
+     (vtpConfigFilePath(fname_in, fname) != OK))
+    {
+      printf("%s: ERROR: invalid config file name\n", __func__);
+      return NULL;
+    }
+
+  if(stat(fname, &st) != 0)
+    {
+      printf("%s: ERROR: can't stat %s\n", __func__, fname);
+      vtpConfCache.valid = 0;
+      return NULL;
+    }
+
+  vtpConfCache.nload++;
+  if(vtpConfCache.valid && (strcmp(fname, vtpConfCache.fname) == 0))
+    {
+      if((st.st_dev == vtpConfCache.dev) && (st.st_ino == vtpConfCache.ino) &&
+	 (st.st_size == vtpConfCache.size) &&
+	 (st.st_mtim.tv_sec == vtpConfCache.mtime.tv_sec) &&
+	 (st.st_mtim.tv_nsec == vtpConfCache.mtime.tv_nsec) &&
+	 (st.st_ctim.tv_sec == vtpConfCache.ctime.tv_sec) &&
+	 (st.st_ctim.tv_nsec == vtpConfCache.ctime.tv_nsec))
+	{
+	  printf("%s: %s unchanged, using the parsed config\n", __func__, fname);
+	  memcpy(&vtpConf, &vtpConfCache.conf, sizeof(VTP_CONF));
+	  return &vtpConfCache.conf;
+	}
+    }
+
+  if(vtpConfigFileHash(fname, &hash) != OK)
+    {
+      printf("%s: ERROR: can't read %s\n", __func__, fname);
+      vtpConfCache.valid = 0;
+      return NULL;
+    }
+
+  if(vtpConfCache.valid && (strcmp(fname, vtpConfCache.fname) == 0) &&
+     (hash == vtpConfCache.hash))
+    {
+      printf("%s: %s rewritten with the same content, using the parsed config\n",
+	     __func__, fname);
+    }
+  else
+    {
+      vtpInitGlobals();
+      rval = vtpReadConfigFile(fname);
+      if(rval < 0)
+	{
+	  printf("%s: ERROR: vtpReadConfigFile(%s) returned %d\n", __func__, fname, rval);
+	  return NULL;
+	}
+      vtpConfCache.nparse++;
+      memcpy(&vtpConfCache.conf, &vtpConf, sizeof(VTP_CONF));
+      strcpy(vtpConfCache.fname, fname);
+      vtpConfCache.hash = hash;
+      printf("%s: parsed %s, hash %016llx (%u parses in %u loads)\n", __func__, fname,
+	     (unsigned long long)hash, vtpConfCache.nparse, vtpConfCache.nload);
+    }
+
+  vtpConfCache.dev   = st.st_dev;
+  vtpConfCache.ino   = st.st_ino;
+  vtpConfCache.size  = st.st_size;
+  vtpConfCache.mtime = st.st_mtim;
+  vtpConfCache.ctime = st.st_ctim;
+  vtpConfCache.valid = 1;
+  memcpy(&vtpConf, &vtpConfCache.conf, sizeof(VTP_CONF));
+
+  return &vtpConfCache.conf;
+}
+
 void
 vtpInitGlobals()
 {
@@ -150,6 +918,8 @@ vtpInitGlobals()
 
   printf("vtpInitGlobals reached\n");
 
+  vtpConfCache.valid = 0;
+
   memset(vtpConf.fw_filename_v7, 0, sizeof(vtpConf.fw_filename_v7));
   memset(vtpConf.fw_filename_z7, 0, sizeof(vtpConf.fw_filename_z7));
 
@@ -164,6 +934,8 @@ vtpInitGlobals()
 
   vtpConf.refclk = 250;
 
+  vtpConf.download_mode = VTP_DOWNLOAD_FULL;
+
   vtpConf.payload_en = 0;
   vtpConf.fiber_en = 0;
 
@@ -496,10 +1268,26 @@ vtpInitGlobals()
   vtpConf.streaming.stats_port = 19531;
   vtpConf.streaming.stats_inst = 0;
   vtpConf.streaming.sync_pkt_len = 28;
+  vtpConf.streaming.sync_rate = 1;
+  vtpConf.streaming.nsync_dest = 0;
   vtpConf.streaming.num_connections = 1;
   vtpConf.streaming.net_mode = 1;       /* 1=UDP, 0=TCP */
   vtpConf.streaming.enable_ejfat = 1;
   vtpConf.streaming.local_port = 10001;
+  vtpConf.streaming.balance = 0;
+  vtpConf.streaming.profile[0] = '\0';
+  vtpConf.streaming.hot_reconfig = 0;
+  vtpConf.streaming.link_supervisor = 0;
+  vtpConf.streaming.link_failover = 0;
+  vtpConf.streaming.link_stall_ms = 500;
+  vtpConf.streaming.standby_mask = 0;
+  vtpConf.streaming.framelen_adapt = 0;
+  vtpConf.streaming.framelen_target = 8000;
+  vtpConf.streaming.framelen_max_ns = 65536;
+  vtpConf.streaming.framelen_state[0] = '\0';
+  vtpConf.streaming.mtu_probe_port = 0;
+  vtpConf.streaming.mtu_probe_timeout = 100;
+  vtpConf.streaming.mtu_probe_max = 0;
   /* Initialize payload enable array (all disabled by default) */
   for(i = 0; i < 16; i++) {
     vtpConf.streaming.payload_en_array[i] = 0;
@@ -507,6 +1295,97 @@ vtpInitGlobals()
 }
 
 
+/* Start an index of the file open as 'fd', see vtpCrateIndexCommit() */
+static void
+vtpCrateIndexStart(FILE *fd, const char *fname, const char *host)
+{
+  struct stat st;
+  VTP_CRATE_INDEX *ix = &vtpCrateIndexNew;
+
+  ix->valid = (fstat(fileno(fd), &st) == 0);
+  ix->nsect = 0;
+  strcpy(ix->fname, fname);
+  strcpy(ix->host, host);
+  ix->dev   = st.st_dev;
+  ix->ino   = st.st_ino;
+  ix->size  = st.st_size;
+  ix->mtime = st.st_mtim;
+  ix->ctime = st.st_ctim;
+}
+
+static void
+vtpCrateIndexAdd(long off, int lineno)
+{
+  VTP_CRATE_INDEX *ix = &vtpCrateIndexNew;
+  VTP_CRATE_SECTION *sect;
+
+  if(!ix->valid)
+    return;
+
+  if(ix->nsect == ix->maxsect)
+    {
+      sect = realloc(ix->sect, (ix->maxsect + 16)*sizeof(VTP_CRATE_SECTION));
+      if(sect == NULL)
+	{
+	  ix->valid = 0;
+	  return;
+	}
+      ix->sect = sect;
+      ix->maxsect += 16;
+    }
+
+  ix->sect[ix->nsect].off = off;
+  ix->sect[ix->nsect].lineno = lineno;
+  ix->nsect++;
+}
+
+/* The whole file was read: the new index replaces the old one */
+static void
+vtpCrateIndexCommit()
+{
+  VTP_CRATE_INDEX tmp;
+
+  tmp = vtpCrateIndex;
+  vtpCrateIndex = vtpCrateIndexNew;
+  vtpCrateIndexNew = tmp;
+  vtpCrateIndexNew.valid = 0;
+}
+
+/* The index is of the file open as 'fd' and its sections still start with
+   VTP_CRATE.  Leaves 'fd' at the start of the file */
+static int
+vtpCrateIndexMatch(FILE *fd, const char *fname, const char *host)
+{
+  struct stat st;
+  char line[STRLEN];
+  int is, match = 1;
+
+  if(!vtpCrateIndex.valid || strcmp(fname, vtpCrateIndex.fname) ||
+     strcmp(host, vtpCrateIndex.host) || (fstat(fileno(fd), &st) != 0))
+    return 0;
+
+  if((st.st_dev != vtpCrateIndex.dev) || (st.st_ino != vtpCrateIndex.ino) ||
+     (st.st_size != vtpCrateIndex.size) ||
+     (st.st_mtim.tv_sec != vtpCrateIndex.mtime.tv_sec) ||
+     (st.st_mtim.tv_nsec != vtpCrateIndex.mtime.tv_nsec) ||
+     (st.st_ctim.tv_sec != vtpCrateIndex.ctime.tv_sec) ||
+     (st.st_ctim.tv_nsec != vtpCrateIndex.ctime.tv_nsec))
+    match = 0;
+
+  for(is=0; match && (is<vtpCrateIndex.nsect); is++)
+    {
+      if((fseek(fd, vtpCrateIndex.sect[is].off, SEEK_SET) != 0) ||
+	 (fgets(line, STRLEN, fd) == NULL) || (strncmp(line, "VTP_CRATE", 9) != 0))
+	match = 0;
+    }
+  rewind(fd);
+
+  if(!match)
+    vtpCrateIndex.valid = 0;
+
+  return match;
+}
+
 /* reading and parsing config file */
 int
 vtpReadConfigFile(char *filename_in)
@@ -521,7 +1400,13 @@ vtpReadConfigFile(char *filename_in)
   float  argf[4];
   unsigned int  ui1;
   char *envDir;
-  int do_parsing;
+  int do_parsing, lineno, eol;
+  unsigned int hash;
+  const VTP_KEYWORD *kw;
+  long off, lineoff;
+  int indexed, isect;
+
+  vtpConfCache.valid = 0;
 
   gethostname(host,ROCLEN);  /* obtain our hostname - and drop any domain extension */
   for(jj=0; jj<strlen(host); jj++)
@@ -578,13 +1463,10 @@ vtpReadConfigFile(char *filename_in)
     {
       if(strlen(filename)!=0) /* filename specified */
 	{
-	  if ( filename[0]=='/' || (filename[0]=='.' && filename[1]=='/') )
-	    {
-	      sprintf(fname, "%s", filename);
-	    }
-	  else
+	  if(vtpConfigFilePath(filename, fname) != OK)
 	    {
-	      sprintf(fname, "%s/vtp/%s", envDir, filename);
+	      printf("\nReadConfigFile: Config file name too long >%s<\n",filename);
+	      return(-1);
 	    }
 
 	  if((fd=fopen(fname,"r")) == NULL)
@@ -618,78 +1500,152 @@ vtpReadConfigFile(char *filename_in)
 
       printf("\nReadConfigFile: Using configuration file >%s<\n",fname);
 
+      indexed = vtpCrateIndexMatch(fd, fname, host);
+      if(indexed)
+	printf("ReadConfigFile: %d crate section(s) for %s from the index\n",
+	       vtpCrateIndex.nsect, host);
+      else
+	vtpCrateIndexStart(fd, fname, host);
+
       /* Parsing of config file */
       active = 0; /* by default disable crate */
       do_parsing = 0; /* will parse only one file specified above, unless it changed during parsing */
-      while ((ch = getc(fd)) != EOF)
+      lineno = 0;
+      eol = 1;
+      off = 0;
+      isect = 0;
+      while(1)
 	{
+	  /* Outside of our crate: skip to the next of our sections */
+	  if(indexed && !active && eol)
+	    {
+	      while((isect < vtpCrateIndex.nsect) && (vtpCrateIndex.sect[isect].off < off))
+		isect++;
+	      if(isect == vtpCrateIndex.nsect)
+		break;
+	      off = vtpCrateIndex.sect[isect].off;
+	      lineno = vtpCrateIndex.sect[isect].lineno - 1;
+	      fseek(fd, off, SEEK_SET);
+	    }
+
+	  lineoff = off;
+	  if(fgets(str_tmp, STRLEN, fd) == NULL)
+	    break;
+	  off += strlen(str_tmp);
+
+	  /* Lines longer than STRLEN come in several chunks */
+	  if(eol)
+	    lineno++;
+	  eol = (strchr(str_tmp, '\n') != NULL);
+
+	  ch = str_tmp[0];
+	  if( ch == '#' || ch == ' ' || ch == '\t' )
+	    {
+	      while(!eol && (fgets(str_tmp, STRLEN, fd) != NULL))
+		{
+		  off += strlen(str_tmp);
+		  eol = (strchr(str_tmp, '\n') != NULL);
+		}
+	      continue;
+	    }
+	  else if( ch == '\n' )
+	    continue;
+
+	  /* Outside of our crate only the VTP_CRATE lines matter */
+	  if(!active && ((strncmp(str_tmp, "VTP_CRATE", 9) != 0) || !isspace((unsigned char)str_tmp[9])))
+	    continue;
+
 	  memset(argf, 0, sizeof(argf));
 	  memset(argi, 0, sizeof(argi));
-	  if ( ch == '#' || ch == ' ' || ch == '\t' )
+
+	  /* Keyword: first token, hashed while it is copied */
+	  hash = VTP_KW_FNV_OFFSET;
+	  for(jj=0; (jj < ROCLEN-1) && str_tmp[jj] && !isspace((unsigned char)str_tmp[jj]); jj++)
 	    {
-	      while ( getc(fd)!='\n' /*&& getc(fd)!=!= EOF*/ ) {} /*ERROR !!!*/
+	      keyword[jj] = str_tmp[jj];
+	      hash = (hash ^ (unsigned char)str_tmp[jj]) * VTP_KW_FNV_PRIME;
 	    }
-	  else if( ch == '\n' ) {}
-	  else
+	  keyword[jj] = '\0';
+	  if(jj == 0)
+	    continue;
+	  kw = vtpKeywordFind(keyword, hash);
+
+	  /* Start parsing real config inputs */
+	  if(kw && (kw->id == VTP_KW_CRATE))
 	    {
-	      ungetc(ch,fd);
-	      fgets(str_tmp, STRLEN, fd);
-	      sscanf (str_tmp, "%s %s", keyword, ROC_name);
-#ifdef DEBUG
-	      printf("\nfgets returns %s so keyword=%s\n\n",str_tmp,keyword);
-#endif
-	      /* Start parsing real config inputs */
-	      if(strcmp(keyword,"VTP_CRATE") == 0)
+	      ROC_name[0] = '\0';
+	      sscanf(str_tmp, "%*s %79s", ROC_name);
+	      if(strcmp(ROC_name,host) == 0)
 		{
-		  if(strcmp(ROC_name,host) == 0)
-		    {
-		      printf("\nReadConfigFile: crate = %s  host = %s - activated\n",ROC_name,host);
-		      active = 1;
-		    }
-		  else if(strcmp(ROC_name,"all") == 0)
-		    {
-		      printf("\nReadConfigFile: crate = %s  host = %s - activated\n",ROC_name,host);
-		      active = 1;
-		    }
-		  else
-		    {
-		      printf("\nReadConfigFile: crate = %s  host = %s - deactivated\n",ROC_name,host);
-		      active = 0;
-		    }
-		  continue;
+		  printf("\nReadConfigFile: crate = %s  host = %s - activated\n",ROC_name,host);
+		  active = 1;
+		  if(!indexed)
+		    vtpCrateIndexAdd(lineoff, lineno);
+		}
+	      else if(strcmp(ROC_name,"all") == 0)
+		{
+		  printf("\nReadConfigFile: crate = %s  host = %s - activated\n",ROC_name,host);
+		  active = 1;
+		  if(!indexed)
+		    vtpCrateIndexAdd(lineoff, lineno);
+		}
+	      else
+		{
+		  printf("\nReadConfigFile: crate = %s  host = %s - deactivated\n",ROC_name,host);
+		  active = 0;
 		}
+	      continue;
+	    }
 
-	      /* If the ROC_name does not match the hostname or the string "all" then do not parse
-                 any more of the file. Just read through to the end of the file */
-	      if(!active)
-		continue;
+	  /* If the ROC_name does not match the hostname or the string "all" then do not parse
+	     any more of the file. Just read through to the end of the file */
+	  if(!active)
+	    continue;
 
-	      else if(!strcmp(keyword,"VTP_W_WIDTH"))
+#ifdef DEBUG
+	  printf("\nfgets returns %s so keyword=%s\n\n",str_tmp,keyword);
+#endif
+	  if(kw == NULL)
+	    {
+	      printf("%s: WARNING: %s:%d: unknown keyword %s\n", __func__, fname, lineno, keyword);
+	      continue;
+	    }
+	  if(vtpKeywordCheck(kw, str_tmp, fname, lineno) != OK)
+	    continue;
+
+	  switch(kw->id)
+	    {
+	      case VTP_KW_W_WIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.window_width = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_W_OFFSET"))
+		break;
+	      case VTP_KW_W_OFFSET:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.window_offset = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FIRMWARE_V7"))
+		break;
+	      case VTP_KW_FIRMWARE_V7:
 		{
 		  sscanf(str_tmp, "%*s %250s", vtpConf.fw_filename_v7);
 		  printf("VTP_FIRMWARE = %s\n", vtpConf.fw_filename_v7);
 		}
-	      else if(!strcmp(keyword,"VTP_FIRMWARE_Z7"))
+		break;
+	      case VTP_KW_FIRMWARE_Z7:
 		{
 		  sscanf(str_tmp, "%*s %250s", vtpConf.fw_filename_z7);
 		  printf("VTP_FIRMWARE = %s\n", vtpConf.fw_filename_z7);
 		}
-	      else if(!strcmp(keyword,"VTP_STATS_HOST"))
+		break;
+	      case VTP_KW_STATS_HOST:
 		{
 		  sscanf(str_tmp, "%*s %250s", vtpConf.streaming.stats_host);
 		  printf("VTP_STATS_HOST = %s\n", vtpConf.streaming.stats_host);
 		}
-	      else if(!strcmp(keyword,"VTP_STATS_PORT"))
+		break;
+	      case VTP_KW_STATS_PORT:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] > 0 && argi[0] < 65536) {
@@ -700,7 +1656,8 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.stats_port);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_STATS_INST"))
+		break;
+	      case VTP_KW_STATS_INST:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] >= 0 && argi[0] < 4) {
@@ -711,18 +1668,226 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.stats_inst);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_SYNC_PKT_LEN"))
+		break;
+	      case VTP_KW_SYNC_PKT_LEN:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
-		  if(argi[0] > 0 && argi[0] < 1500) {
+		  if(argi[0] >= VTP_SYNC_PKT_LEN && argi[0] <= VTP_SYNC_MAX_PKT_LEN) {
 		    vtpConf.streaming.sync_pkt_len = argi[0];
 		    printf("VTP_SYNC_PKT_LEN = %d\n", argi[0]);
 		  } else {
-		    printf("WARNING: Invalid VTP_SYNC_PKT_LEN %d (must be 1-1499), using default %d\n",
-			   argi[0], vtpConf.streaming.sync_pkt_len);
+		    printf("WARNING: Invalid VTP_SYNC_PKT_LEN %d (must be %d-%d), using default %d\n",
+			   argi[0], VTP_SYNC_PKT_LEN, VTP_SYNC_MAX_PKT_LEN, vtpConf.streaming.sync_pkt_len);
+		  }
+		}
+		break;
+	      case VTP_KW_SYNC_RATE:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= VTP_SYNC_MIN_HZ && argi[0] <= VTP_SYNC_MAX_HZ) {
+		    vtpConf.streaming.sync_rate = argi[0];
+		    printf("VTP_SYNC_RATE = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_SYNC_RATE %d (must be %d-%d), using default %d\n",
+			   argi[0], VTP_SYNC_MIN_HZ, VTP_SYNC_MAX_HZ, vtpConf.streaming.sync_rate);
+		  }
+		}
+		break;
+	      case VTP_KW_SYNC_DEST:
+		{
+		  /* VTP_SYNC_DEST <host> <port> [stream mask, default 0x1] */
+		  jj = vtpConf.streaming.nsync_dest;
+		  argi[1] = 0x1;
+		  if(jj >= VTP_SYNC_MAX_DEST) {
+		    printf("WARNING: Too many VTP_SYNC_DEST entries (max %d), ignored\n", VTP_SYNC_MAX_DEST);
+		  } else if((sscanf(str_tmp, "%*s %250s %d %i", vtpConf.streaming.sync_dest[jj].host,
+				    &argi[0], &argi[1]) < 2) ||
+			    (argi[0] <= 0) || (argi[0] >= 65536) || ((argi[1] & 0xF) == 0)) {
+		    printf("WARNING: Invalid VTP_SYNC_DEST (must be <host> <port 1-65535> [mask 0x1-0xF]), ignored\n");
+		  } else {
+		    vtpConf.streaming.sync_dest[jj].port = argi[0];
+		    vtpConf.streaming.sync_dest[jj].mask = argi[1] & 0xF;
+		    vtpConf.streaming.nsync_dest++;
+		    printf("VTP_SYNC_DEST = %s %d 0x%x\n", vtpConf.streaming.sync_dest[jj].host,
+			   argi[0], argi[1] & 0xF);
+		  }
+		}
+		break;
+	      case VTP_KW_STREAMING_BALANCE:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 0 && argi[0] <= 2) {
+		    vtpConf.streaming.balance = argi[0];
+		    printf("VTP_STREAMING_BALANCE = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_STREAMING_BALANCE %d (must be 0-2), using default %d\n",
+			   argi[0], vtpConf.streaming.balance);
+		  }
+		}
+		break;
+	      case VTP_KW_STREAMING_PROFILE:
+		{
+		  sscanf(str_tmp, "%*s %250s", vtpConf.streaming.profile);
+		  printf("VTP_STREAMING_PROFILE = %s\n", vtpConf.streaming.profile);
+		}
+		break;
+	      case VTP_KW_STREAMING_HOT_RECONFIG:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] == 0 || argi[0] == 1) {
+		    vtpConf.streaming.hot_reconfig = argi[0];
+		    printf("VTP_STREAMING_HOT_RECONFIG = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_STREAMING_HOT_RECONFIG %d (must be 0 or 1), using default %d\n",
+			   argi[0], vtpConf.streaming.hot_reconfig);
+		  }
+		}
+		break;
+	      case VTP_KW_LINK_SUPERVISOR:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] == 0 || argi[0] == 1) {
+		    vtpConf.streaming.link_supervisor = argi[0];
+		    printf("VTP_LINK_SUPERVISOR = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_LINK_SUPERVISOR %d (must be 0 or 1), using default %d\n",
+			   argi[0], vtpConf.streaming.link_supervisor);
+		  }
+		}
+		break;
+	      case VTP_KW_LINK_FAILOVER:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 0 && argi[0] <= 2) {
+		    vtpConf.streaming.link_failover = argi[0];
+		    printf("VTP_LINK_FAILOVER = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_LINK_FAILOVER %d (must be 0-2), using default %d\n",
+			   argi[0], vtpConf.streaming.link_failover);
+		  }
+		}
+		break;
+	      case VTP_KW_LINK_STALL_MS:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 10 && argi[0] <= 60000) {
+		    vtpConf.streaming.link_stall_ms = argi[0];
+		    printf("VTP_LINK_STALL_MS = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_LINK_STALL_MS %d (must be 10-60000), using default %d\n",
+			   argi[0], vtpConf.streaming.link_stall_ms);
+		  }
+		}
+		break;
+	      case VTP_KW_LINK_STANDBY:
+		{
+		  int ip[4];
+		  if((sscanf(str_tmp, "%*s %d %d.%d.%d.%d %d", &argi[0],
+			     &ip[0], &ip[1], &ip[2], &ip[3], &argi[1]) == 6) &&
+		     (argi[0] >= 1) && (argi[0] <= 4) && (argi[1] > 0) && (argi[1] < 65536)) {
+		    for(jj = 0; jj < 4; jj++)
+		      vtpConf.streaming.standby_ip[argi[0]-1][jj] = ip[jj] & 0xFF;
+		    vtpConf.streaming.standby_port[argi[0]-1] = argi[1];
+		    vtpConf.streaming.standby_mask |= (1<<(argi[0]-1));
+		    printf("VTP_LINK_STANDBY = %d %d.%d.%d.%d %d\n", argi[0],
+			   ip[0], ip[1], ip[2], ip[3], argi[1]);
+		  } else {
+		    printf("WARNING: Invalid VTP_LINK_STANDBY (must be <stream 1-4> <a.b.c.d> <port>)\n");
+		  }
+		}
+		break;
+	      case VTP_KW_FRAMELEN_ADAPT:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] == 0 || argi[0] == 1) {
+		    vtpConf.streaming.framelen_adapt = argi[0];
+		    printf("VTP_FRAMELEN_ADAPT = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_FRAMELEN_ADAPT %d (must be 0 or 1), using default %d\n",
+			   argi[0], vtpConf.streaming.framelen_adapt);
+		  }
+		}
+		break;
+	      case VTP_KW_FRAMELEN_TARGET_BYTES:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 64 && argi[0] <= 1048576) {
+		    vtpConf.streaming.framelen_target = argi[0];
+		    printf("VTP_FRAMELEN_TARGET_BYTES = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_FRAMELEN_TARGET_BYTES %d (must be 64-1048576), using default %d\n",
+			   argi[0], vtpConf.streaming.framelen_target);
+		  }
+		}
+		break;
+	      case VTP_KW_FRAMELEN_MAX_NS:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 1056 && argi[0] <= 65536) {
+		    vtpConf.streaming.framelen_max_ns = argi[0];
+		    printf("VTP_FRAMELEN_MAX_NS = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_FRAMELEN_MAX_NS %d (must be 1056-65536), using default %d\n",
+			   argi[0], vtpConf.streaming.framelen_max_ns);
+		  }
+		}
+		break;
+	      case VTP_KW_FRAMELEN_STATE:
+		{
+		  sscanf(str_tmp, "%*s %250s", vtpConf.streaming.framelen_state);
+		  printf("VTP_FRAMELEN_STATE = %s\n", vtpConf.streaming.framelen_state);
+		}
+		break;
+	      case VTP_KW_MTU_PROBE_PORT:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 0 && argi[0] <= 65535) {
+		    vtpConf.streaming.mtu_probe_port = argi[0];
+		    printf("VTP_MTU_PROBE_PORT = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_MTU_PROBE_PORT %d (must be 0-65535), using default %d\n",
+			   argi[0], vtpConf.streaming.mtu_probe_port);
+		  }
+		}
+		break;
+	      case VTP_KW_MTU_PROBE_TIMEOUT_MS:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= 1 && argi[0] <= 5000) {
+		    vtpConf.streaming.mtu_probe_timeout = argi[0];
+		    printf("VTP_MTU_PROBE_TIMEOUT_MS = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_MTU_PROBE_TIMEOUT_MS %d (must be 1-5000), using default %d\n",
+			   argi[0], vtpConf.streaming.mtu_probe_timeout);
+		  }
+		}
+		break;
+	      case VTP_KW_MTU_PROBE_MAX:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if((argi[0] == 0) || (argi[0] >= VTP_MTU_PROBE_MIN && argi[0] <= VTP_TCPIP_MTU_JUMBO)) {
+		    vtpConf.streaming.mtu_probe_max = argi[0];
+		    printf("VTP_MTU_PROBE_MAX = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_MTU_PROBE_MAX %d (must be 0 or %d-%d), using default %d\n",
+			   argi[0], VTP_MTU_PROBE_MIN, VTP_TCPIP_MTU_JUMBO, vtpConf.streaming.mtu_probe_max);
+		  }
+		}
+		break;
+	      case VTP_KW_DOWNLOAD_MODE:
+		{
+		  sscanf(str_tmp, "%*s %d", &argi[0]);
+		  if(argi[0] >= VTP_DOWNLOAD_FULL &&
+		     argi[0] <= (VTP_DOWNLOAD_DIFF | VTP_DOWNLOAD_VERIFY)) {
+		    vtpConf.download_mode = argi[0];
+		    printf("VTP_DOWNLOAD_MODE = %d\n", argi[0]);
+		  } else {
+		    printf("WARNING: Invalid VTP_DOWNLOAD_MODE %d (must be 0-3), using default %d\n",
+			   argi[0], vtpConf.download_mode);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_NUM_CONNECTIONS"))
+		break;
+	      case VTP_KW_NUM_CONNECTIONS:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] >= 1 && argi[0] <= 4) {
@@ -733,7 +1898,8 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.num_connections);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_NET_MODE"))
+		break;
+	      case VTP_KW_NET_MODE:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] == 0 || argi[0] == 1) {
@@ -744,7 +1910,8 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.net_mode);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_ENABLE_EJFAT"))
+		break;
+	      case VTP_KW_ENABLE_EJFAT:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] == 0 || argi[0] == 1) {
@@ -755,7 +1922,8 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.enable_ejfat);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_LOCAL_PORT"))
+		break;
+	      case VTP_KW_LOCAL_PORT:
 		{
 		  sscanf(str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] > 0 && argi[0] < 65536) {
@@ -766,11 +1934,13 @@ vtpReadConfigFile(char *filename_in)
 			   argi[0], vtpConf.streaming.local_port);
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_REFCLK"))
+		break;
+	      case VTP_KW_REFCLK:
 		{
 		  sscanf(str_tmp, "%*s %d", &vtpConf.refclk);
 		}
-	      else if(!strcmp(keyword,"VTP_PAYLOAD_EN"))
+		break;
+	      case VTP_KW_PAYLOAD_EN:
 		{
 		  GET_READ_MSK;
 		  vtpConf.payload_en = ui1;
@@ -783,13 +1953,15 @@ vtpReadConfigFile(char *filename_in)
 		    printf("%d%s", vtpConf.streaming.payload_en_array[jj], (jj < 15) ? " " : "]\n");
 		  }
 		}
-	      else if(!strcmp(keyword,"VTP_FIBER_EN"))
+		break;
+	      case VTP_KW_FIBER_EN:
 		{
 		  GET_READ_MSK4;
 		  vtpConf.fiber_en = ui1;
 		  printf("vtpConf.fiber_en = 0x%08X\n", vtpConf.fiber_en);
 		}
-	      else if(!strcmp(keyword,"VTP_EC_FADCSUM_CH"))
+		break;
+	      case VTP_KW_EC_FADCSUM_CH:
 		{
 		  sscanf (str_tmp, "%*s 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X",
 			  &vtpConf.ec.fadcsum_ch_en[0],  &vtpConf.ec.fadcsum_ch_en[1],
@@ -802,79 +1974,94 @@ vtpReadConfigFile(char *filename_in)
 			  &vtpConf.ec.fadcsum_ch_en[14], &vtpConf.ec.fadcsum_ch_en[15]
 			  );
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_HIT_EMIN"))
+		break;
+	      case VTP_KW_EC_INNER_HIT_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.hit_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_HIT_DT"))
+		break;
+	      case VTP_KW_EC_INNER_HIT_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.hit_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_HIT_DALITZ"))
+		break;
+	      case VTP_KW_EC_INNER_HIT_DALITZ:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.ec.inner.dalitz_min = argi[0]*8;
 		  vtpConf.ec.inner.dalitz_max = argi[1]*8;
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_EC_INNER_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_EC_INNER_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_EC_INNER_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_INNER_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_EC_INNER_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.inner.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_HIT_EMIN"))
+		break;
+	      case VTP_KW_EC_OUTER_HIT_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.hit_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_HIT_DT"))
+		break;
+	      case VTP_KW_EC_OUTER_HIT_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.hit_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_HIT_DALITZ"))
+		break;
+	      case VTP_KW_EC_OUTER_HIT_DALITZ:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.ec.outer.dalitz_min = argi[0]*8;
 		  vtpConf.ec.outer.dalitz_max = argi[1]*8;
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_EC_OUTER_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_EC_OUTER_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_EC_OUTER_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_EC_OUTER_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_EC_OUTER_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ec.outer.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PC_FADCSUM_CH"))
+		break;
+	      case VTP_KW_PC_FADCSUM_CH:
 		{
 		  sscanf (str_tmp, "%*s 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X",
 			  &vtpConf.pc.fadcsum_ch_en[0],  &vtpConf.pc.fadcsum_ch_en[1],
@@ -887,149 +2074,166 @@ vtpReadConfigFile(char *filename_in)
 			  &vtpConf.pc.fadcsum_ch_en[14], &vtpConf.pc.fadcsum_ch_en[15]
 			  );
 		}
-	      else if(!strcmp(keyword,"VTP_PC_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_PC_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pc.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PC_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_PC_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pc.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PC_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_PC_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pc.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PC_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_PC_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pc.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PC_COSMIC_PIXELEN"))
+		break;
+	      case VTP_KW_PC_COSMIC_PIXELEN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pc.cosmic_pixelen = argi[0];
 		}
-
-	      else if(!strcmp(keyword,"VTP_HTCC_THRESHOLDS"))
+		break;
+	      case VTP_KW_HTCC_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.htcc.threshold[0] = argi[0];
 		  vtpConf.htcc.threshold[1] = argi[1];
 		  vtpConf.htcc.threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HTCC_NFRAMES"))
+		break;
+	      case VTP_KW_HTCC_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.htcc.nframes = argi[0];
 		}
-
-	      else if(!strcmp(keyword,"VTP_CTOF_THRESHOLDS"))
+		break;
+	      case VTP_KW_CTOF_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.htcc.ctof_threshold[0] = argi[0];
 		  vtpConf.htcc.ctof_threshold[1] = argi[1];
 		  vtpConf.htcc.ctof_threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_CTOF_NFRAMES"))
+		break;
+	      case VTP_KW_CTOF_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.htcc.ctof_nframes = argi[0];
 		}
-
-	      else if(!strcmp(keyword,"VTP_FTOF_THRESHOLDS"))
+		break;
+	      case VTP_KW_FTOF_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.ftof.threshold[0] = argi[0];
 		  vtpConf.ftof.threshold[1] = argi[1];
 		  vtpConf.ftof.threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_FTOF_NFRAMES"))
+		break;
+	      case VTP_KW_FTOF_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftof.nframes = argi[0];
 		}
-
-	      else if(!strcmp(keyword,"VTP_CND_THRESHOLDS"))
+		break;
+	      case VTP_KW_CND_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.cnd.threshold[0] = argi[0];
 		  vtpConf.cnd.threshold[1] = argi[1];
 		  vtpConf.cnd.threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_CND_NFRAMES"))
+		break;
+	      case VTP_KW_CND_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.cnd.nframes = argi[0];
 		}
-
-	      else if(!strcmp(keyword,"VTP_PCS_THRESHOLDS"))
+		break;
+	      case VTP_KW_PCS_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.pcs.threshold[0] = argi[0];
 		  vtpConf.pcs.threshold[1] = argi[1];
 		  vtpConf.pcs.threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_NFRAMES"))
+		break;
+	      case VTP_KW_PCS_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.nframes = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_DIPFACTOR"))
+		break;
+	      case VTP_KW_PCS_DIPFACTOR:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.dipfactor = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_NSTRIP"))
+		break;
+	      case VTP_KW_PCS_NSTRIP:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.pcs.nstrip_min = argi[0];
 		  vtpConf.pcs.nstrip_max = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_DALITZ"))
+		break;
+	      case VTP_KW_PCS_DALITZ:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.pcs.dalitz_min = argi[0];
 		  vtpConf.pcs.dalitz_max = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_PCS_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_PCS_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_PCS_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_PCS_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCS_COSMIC_PIXELEN"))
+		break;
+	      case VTP_KW_PCS_COSMIC_PIXELEN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.pcs.cosmic_pixelen = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_PCU_THRESHOLDS"))
+		break;
+	      case VTP_KW_PCU_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.pcs.pcu_threshold[0] = argi[0];
 		  vtpConf.pcs.pcu_threshold[1] = argi[1];
 		  vtpConf.pcs.pcu_threshold[2] = argi[2];
 		}
-
-
-
-	      else if(!strcmp(keyword,"VTP_ECS_FADCSUM_CH"))
+		break;
+	      case VTP_KW_ECS_FADCSUM_CH:
 		{
 		  sscanf (str_tmp, "%*s 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X",
 			  &vtpConf.ecs.fadcsum_ch_en[0],  &vtpConf.ecs.fadcsum_ch_en[1],
@@ -1042,89 +2246,102 @@ vtpReadConfigFile(char *filename_in)
 			  &vtpConf.ecs.fadcsum_ch_en[14], &vtpConf.ecs.fadcsum_ch_en[15]
 			  );
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_INNER_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_ECS_INNER_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.inner.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_INNER_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_ECS_INNER_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.inner.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_INNER_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_ECS_INNER_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.inner.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_INNER_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_ECS_INNER_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.inner.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_OUTER_COSMIC_EMIN"))
+		break;
+	      case VTP_KW_ECS_OUTER_COSMIC_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.outer.cosmic_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_OUTER_COSMIC_MULTMAX"))
+		break;
+	      case VTP_KW_ECS_OUTER_COSMIC_MULTMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.outer.cosmic_multmax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_OUTER_COSMIC_HITWIDTH"))
+		break;
+	      case VTP_KW_ECS_OUTER_COSMIC_HITWIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.outer.cosmic_hitwidth = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_OUTER_COSMIC_EVALDELAY"))
+		break;
+	      case VTP_KW_ECS_OUTER_COSMIC_EVALDELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.outer.cosmic_evaldelay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_THRESHOLDS"))
+		break;
+	      case VTP_KW_ECS_THRESHOLDS:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  vtpConf.ecs.threshold[0] = argi[0];
 		  vtpConf.ecs.threshold[1] = argi[1];
 		  vtpConf.ecs.threshold[2] = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_NFRAMES"))
+		break;
+	      case VTP_KW_ECS_NFRAMES:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.nframes = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_DIPFACTOR"))
+		break;
+	      case VTP_KW_ECS_DIPFACTOR:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ecs.dipfactor = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_NSTRIP"))
+		break;
+	      case VTP_KW_ECS_NSTRIP:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.ecs.nstrip_min = argi[0];
 		  vtpConf.ecs.nstrip_max = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_ECS_DALITZ"))
+		break;
+	      case VTP_KW_ECS_DALITZ:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  vtpConf.ecs.dalitz_min = argi[0];
 		  vtpConf.ecs.dalitz_max = argi[1];
 		}
-
-
-
-	      else if(!strcmp(keyword,"VTP_GT_LATENCY"))
+		break;
+	      case VTP_KW_GT_LATENCY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.gt.trig_latency = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_WIDTH"))
+		break;
+	      case VTP_KW_GT_WIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.gt.trig_width = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG"))
+		break;
+	      case VTP_KW_GT_TRG:
 		{
 		  sscanf (str_tmp, "%*s %d", &trg_bit);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1133,7 +2350,8 @@ vtpReadConfigFile(char *filename_in)
 		      return(-4);
 		    }
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_SSP_STRIGGER_MASK"))
+		break;
+	      case VTP_KW_GT_TRG_SSP_STRIGGER_MASK:
 		{
 		  argc = sscanf (str_tmp, "%*s 0x%X 0x%X",&argi[0],&argi[1]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1144,7 +2362,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.gt.trgbits[trg_bit].ssp_strigger_bit_mask[0] = argi[0];
 		  if(argc>=2) vtpConf.gt.trgbits[trg_bit].ssp_strigger_bit_mask[1] = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_SSP_CTRIGGER_MASK"))
+		break;
+	      case VTP_KW_GT_TRG_SSP_CTRIGGER_MASK:
 		{
 		  sscanf (str_tmp, "%*s 0x%X", &argi[0]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1154,7 +2373,8 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.gt.trgbits[trg_bit].ssp_ctrigger_bit_mask = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_SSP_SECTOR_MASK"))
+		break;
+	      case VTP_KW_GT_TRG_SSP_SECTOR_MASK:
 		{
 		  argc = sscanf (str_tmp, "%*s 0x%X 0x%X",&argi[0],&argi[1]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1165,7 +2385,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.gt.trgbits[trg_bit].ssp_sector_mask[0] = argi[0];
 		  if(argc>=2) vtpConf.gt.trgbits[trg_bit].ssp_sector_mask[1] = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_SSP_SECTOR_MULT_MIN"))
+		break;
+	      case VTP_KW_GT_TRG_SSP_SECTOR_MULT_MIN:
 		{
 		  argc = sscanf (str_tmp, "%*s %d %d", &argi[0],&argi[1]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1176,7 +2397,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.gt.trgbits[trg_bit].sector_mult_min[0] = argi[0];
 		  if(argc>=2) vtpConf.gt.trgbits[trg_bit].sector_mult_min[1] = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_SSP_SECTOR_WIDTH"))
+		break;
+	      case VTP_KW_GT_TRG_SSP_SECTOR_WIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1186,7 +2408,8 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.gt.trgbits[trg_bit].sector_coin_width = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_PULSER_FREQ"))
+		break;
+	      case VTP_KW_GT_TRG_PULSER_FREQ:
 		{
 		  sscanf (str_tmp, "%*s %f", &argf[0]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1196,7 +2419,8 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.gt.trgbits[trg_bit].pulser_freq = argf[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_DELAY"))
+		break;
+	      case VTP_KW_GT_TRG_DELAY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1206,7 +2430,8 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.gt.trgbits[trg_bit].delay = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRG_PRESCALE"))
+		break;
+	      case VTP_KW_GT_TRG_PRESCALE:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  if(trg_bit<0 || trg_bit>=32)
@@ -1216,7 +2441,8 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.gt.trgbits[trg_bit].prescale = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRGBIT"))
+		break;
+	      case VTP_KW_GT_TRGBIT:
 		{
 		  argc = sscanf (str_tmp, "%*s %d %d %d %d %d %d %d %d",&argi[0],&argi[1],&argi[2],&argi[3],&argi[4],&argi[5],&argi[6],&argi[7]);
 		  if(argi[0]<0 || argi[0]>=32)
@@ -1235,7 +2461,8 @@ vtpReadConfigFile(char *filename_in)
 		  if(argc>=7) vtpConf.gt.trgbits[argi[0]].delay = argi[6];
 		  if(argc>=8) vtpConf.gt.trgbits[argi[0]].prescale = argi[7];
 		}
-	      else if(!strcmp(keyword,"VTP_GT_TRGBIT2"))
+		break;
+	      case VTP_KW_GT_TRGBIT2:
 		{
 		  argc = sscanf (str_tmp, "%*s %d %d %d %d %d %d %d %d %d %d %d",&argi[0],&argi[1],&argi[2],&argi[3],&argi[4],&argi[5],&argi[6],&argi[7],&argi[8],&argi[9],&argi[10]);
 		  if(argi[0]<0 || argi[0]>=32)
@@ -1254,8 +2481,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.gt.trgbits[argi[0]].delay = argi[9];
 		  vtpConf.gt.trgbits[argi[0]].prescale = argi[10];
 		}
-
-	      else if(!strcmp(keyword,"VTP_DC_SEGTHR"))
+		break;
+	      case VTP_KW_DC_SEGTHR:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0] < 0 || argi[0] > 2)
@@ -1265,19 +2492,20 @@ vtpReadConfigFile(char *filename_in)
 		    }
 		  vtpConf.dc.dcsegfind_threshold[argi[0]] = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HCAL_HIT_DT"))
+		break;
+	      case VTP_KW_HCAL_HIT_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hcal.hit_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HCAL_HIT_EMIN"))
+		break;
+	      case VTP_KW_HCAL_HIT_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hcal.cluster_emin = argi[0];
 		}
-
-
-	      else if(!strcmp(keyword,"VTP_FTCAL_FADCSUM_CH"))
+		break;
+	      case VTP_KW_FTCAL_FADCSUM_CH:
 		{
 		  sscanf (str_tmp, "%*s 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X",
 			  &vtpConf.ftcal.fadcsum_ch_en[0],  &vtpConf.ftcal.fadcsum_ch_en[1],
@@ -1290,105 +2518,126 @@ vtpReadConfigFile(char *filename_in)
 			  &vtpConf.ftcal.fadcsum_ch_en[14], &vtpConf.ftcal.fadcsum_ch_en[15]
 			  );
 		}
-	      else if(!strcmp(keyword,"VTP_FTCAL_SEED_EMIN"))
+		break;
+	      case VTP_KW_FTCAL_SEED_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftcal.seed_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FTCAL_SEED_DT"))
+		break;
+	      case VTP_KW_FTCAL_SEED_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftcal.seed_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FTCAL_HODO_DT"))
+		break;
+	      case VTP_KW_FTCAL_HODO_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftcal.hodo_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FTHODO_EMIN"))
+		break;
+	      case VTP_KW_FTHODO_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.fthodo.hit_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FTCAL_CLUSTER_DEADTIME_EMIN"))
+		break;
+	      case VTP_KW_FTCAL_CLUSTER_DEADTIME_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftcal.deadtime_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_FTCAL_CLUSTER_DEADTIME"))
+		break;
+	      case VTP_KW_FTCAL_CLUSTER_DEADTIME:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.ftcal.deadtime = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_ECAL_TOP"))
+		break;
+	      case VTP_KW_HPS_ECAL_TOP:
 		{
 		  vtpConf.hps.cluster.top_nbottom = 1;
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_ECAL_BOTTOM"))
+		break;
+	      case VTP_KW_HPS_ECAL_BOTTOM:
 		{
 		  vtpConf.hps.cluster.top_nbottom = 0;
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_ECAL_CLUSTER_HIT_DT"))
+		break;
+	      case VTP_KW_HPS_ECAL_CLUSTER_HIT_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.cluster.hit_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_ECAL_CLUSTER_SEED_THR"))
+		break;
+	      case VTP_KW_HPS_ECAL_CLUSTER_SEED_THR:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.cluster.seed_thr = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_HODOSCOPE_FADCHIT_THR"))
+		break;
+	      case VTP_KW_HPS_HODOSCOPE_FADCHIT_THR:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.hodoscope.fadchit_thr = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_HODOSCOPE_HODO_THR"))
+		break;
+	      case VTP_KW_HPS_HODOSCOPE_HODO_THR:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.hodoscope.hodo_thr = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_HODOSCOPE_HODO_DT"))
+		break;
+	      case VTP_KW_HPS_HODOSCOPE_HODO_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.hodoscope.hit_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_HODOSCOPE_TOP_EN"))
+		break;
+	      case VTP_KW_HPS_CALIB_HODOSCOPE_TOP_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.hodoscope_top_en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_HODOSCOPE_BOT_EN"))
+		break;
+	      case VTP_KW_HPS_CALIB_HODOSCOPE_BOT_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.hodoscope_bot_en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_COSMIC_DT"))
+		break;
+	      case VTP_KW_HPS_CALIB_COSMIC_DT:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.cosmic_dt = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_COSMIC_TOP_EN"))
+		break;
+	      case VTP_KW_HPS_CALIB_COSMIC_TOP_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.cosmic_top_en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_COSMIC_BOT_EN"))
+		break;
+	      case VTP_KW_HPS_CALIB_COSMIC_BOT_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.cosmic_bot_en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_PULSER_EN"))
+		break;
+	      case VTP_KW_HPS_CALIB_PULSER_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.calib.pulser_en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_CALIB_PULSER_FREQ"))
+		break;
+	      case VTP_KW_HPS_CALIB_PULSER_FREQ:
 		{
 		  sscanf (str_tmp, "%*s %f", &argf[0]);
 		  vtpConf.hps.calib.pulser_freq = argf[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_EMIN"))
+		break;
+	      case VTP_KW_HPS_SINGLE_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1400,7 +2649,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].cluster_emin = argi[1];
 		  vtpConf.hps.single_trig[argi[0]].cluster_emin_en = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_EMAX"))
+		break;
+	      case VTP_KW_HPS_SINGLE_EMAX:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1412,7 +2662,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].cluster_emax = argi[1];
 		  vtpConf.hps.single_trig[argi[0]].cluster_emax_en = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_NMIN"))
+		break;
+	      case VTP_KW_HPS_SINGLE_NMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1424,7 +2675,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].cluster_nmin = argi[1];
 		  vtpConf.hps.single_trig[argi[0]].cluster_nmin_en = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_XMIN"))
+		break;
+	      case VTP_KW_HPS_SINGLE_XMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1436,7 +2688,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].cluster_xmin = argi[1];
 		  vtpConf.hps.single_trig[argi[0]].cluster_xmin_en = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_PDE"))
+		break;
+	      case VTP_KW_HPS_SINGLE_PDE:
 		{
 		  sscanf (str_tmp, "%*s %d %f %f %f %f %d", &argi[0], &argf[0], &argf[1], &argf[2], &argf[3], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1451,7 +2704,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].pde_c[3] = argf[3];
 		  vtpConf.hps.single_trig[argi[0]].pde_en   = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_HODO"))
+		break;
+	      case VTP_KW_HPS_SINGLE_HODO:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3], &argi[4]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1465,7 +2719,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.single_trig[argi[0]].hodo_l1l2_geom_en = argi[3];
 		  vtpConf.hps.single_trig[argi[0]].hodo_l1l2x_geom_en = argi[4];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_SINGLE_EN"))
+		break;
+	      case VTP_KW_HPS_SINGLE_EN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1476,7 +2731,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.single_trig[argi[0]].en = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_EMIN"))
+		break;
+	      case VTP_KW_HPS_PAIR_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1487,7 +2743,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.pair_trig[argi[0]].cluster_emin = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_EMAX"))
+		break;
+	      case VTP_KW_HPS_PAIR_EMAX:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1498,7 +2755,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.pair_trig[argi[0]].cluster_emax = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_NMIN"))
+		break;
+	      case VTP_KW_HPS_PAIR_NMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1509,7 +2767,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.pair_trig[argi[0]].cluster_nmin = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_TIMECOINCIDENCE"))
+		break;
+	      case VTP_KW_HPS_PAIR_TIMECOINCIDENCE:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1520,7 +2779,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.pair_trig[argi[0]].pair_dt = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_SUMMAX_MIN"))
+		break;
+	      case VTP_KW_HPS_PAIR_SUMMAX_MIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1533,7 +2793,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.pair_trig[argi[0]].pair_esum_min = argi[2];
 		  vtpConf.hps.pair_trig[argi[0]].pair_esum_en  = argi[3];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_DIFFMAX"))
+		break;
+	      case VTP_KW_HPS_PAIR_DIFFMAX:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1545,7 +2806,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.pair_trig[argi[0]].pair_ediff_max = argi[1];
 		  vtpConf.hps.pair_trig[argi[0]].pair_ediff_en  = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_ENERGYDIST"))
+		break;
+	      case VTP_KW_HPS_PAIR_ENERGYDIST:
 		{
 		  sscanf (str_tmp, "%*s %d %f %d %d", &argi[0], &argf[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1558,7 +2820,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.pair_trig[argi[0]].pair_ed_thr = argi[1];
 		  vtpConf.hps.pair_trig[argi[0]].pair_ed_en  = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_COPLANARITY"))
+		break;
+	      case VTP_KW_HPS_PAIR_COPLANARITY:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d", &argi[0], &argi[1], &argi[2]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1570,7 +2833,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.pair_trig[argi[0]].pair_coplanarity_tol = argi[1];
 		  vtpConf.hps.pair_trig[argi[0]].pair_coplanarity_en  = argi[2];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_HODO"))
+		break;
+	      case VTP_KW_HPS_PAIR_HODO:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3], &argi[4]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1584,7 +2848,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.pair_trig[argi[0]].hodo_l1l2_geom_en = argi[3];
 		  vtpConf.hps.pair_trig[argi[0]].hodo_l1l2x_geom_en = argi[4];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PAIR_EN"))
+		break;
+	      case VTP_KW_HPS_PAIR_EN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=4)
@@ -1595,7 +2860,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.pair_trig[argi[0]].en = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_EMIN"))
+		break;
+	      case VTP_KW_HPS_MULT_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1606,7 +2872,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.mult_trig[argi[0]].cluster_emin = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_EMAX"))
+		break;
+	      case VTP_KW_HPS_MULT_EMAX:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1617,7 +2884,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.mult_trig[argi[0]].cluster_emax = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_NMIN"))
+		break;
+	      case VTP_KW_HPS_MULT_NMIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1628,7 +2896,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.mult_trig[argi[0]].cluster_nmin = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_MIN"))
+		break;
+	      case VTP_KW_HPS_MULT_MIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1641,7 +2910,8 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.mult_trig[argi[0]].mult_bot_min = argi[2];
 		  vtpConf.hps.mult_trig[argi[0]].mult_tot_min = argi[3];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_DT"))
+		break;
+	      case VTP_KW_HPS_MULT_DT:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1652,7 +2922,8 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.mult_trig[argi[0]].mult_dt = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_MULT_EN"))
+		break;
+	      case VTP_KW_HPS_MULT_EN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=2)
@@ -1663,12 +2934,14 @@ vtpReadConfigFile(char *filename_in)
 
 		  vtpConf.hps.mult_trig[argi[0]].en = argi[1];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_FEE_EN"))
+		break;
+	      case VTP_KW_HPS_FEE_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.fee_trig.en = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_FEE_PRESCALE"))
+		break;
+	      case VTP_KW_HPS_FEE_PRESCALE:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
 		  if(argi[0]<0 || argi[0]>6)
@@ -1680,27 +2953,32 @@ vtpReadConfigFile(char *filename_in)
 		  vtpConf.hps.fee_trig.prescale_xmax[argi[0]] = argi[2];
 		  vtpConf.hps.fee_trig.prescale[argi[0]]      = argi[3];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_FEE_EMIN"))
+		break;
+	      case VTP_KW_HPS_FEE_EMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.fee_trig.cluster_emin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_FEE_EMAX"))
+		break;
+	      case VTP_KW_HPS_FEE_EMAX:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.fee_trig.cluster_emax = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_FEE_NMIN"))
+		break;
+	      case VTP_KW_HPS_FEE_NMIN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.fee_trig.cluster_nmin = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_LATENCY"))
+		break;
+	      case VTP_KW_HPS_LATENCY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.hps.trig.latency = argi[0];
 		}
-	      else if(!strcmp(keyword,"VTP_HPS_PRESCALE"))
+		break;
+	      case VTP_KW_HPS_PRESCALE:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=32)
@@ -1714,22 +2992,26 @@ vtpReadConfigFile(char *filename_in)
 
 
 	      // FADC STREAMING PARAMETERS
-        else if(!strcmp(keyword,"VTP_STREAMING_ROCID"))
+		break;
+        case VTP_KW_STREAMING_ROCID:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.roc_id = argi[0];
 	}
-        else if(!strcmp(keyword,"VTP_STREAMING_NFRAME_BUF"))
+        break;
+        case VTP_KW_STREAMING_NFRAME_BUF:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.nframe_buf = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_FRAMELEN"))
+        break;
+        case VTP_KW_STREAMING_FRAMELEN:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.frame_len = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING"))
+        break;
+        case VTP_KW_STREAMING:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           if(argi[0]<0 || argi[0]>1)
@@ -1739,17 +3021,20 @@ vtpReadConfigFile(char *filename_in)
           }
           streaming_eb = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_SLOT_EN"))
+        break;
+        case VTP_KW_STREAMING_SLOT_EN:
         {
           GET_READ_MSK8;
           vtpConf.fadc_streaming.eb[streaming_eb].mask_en = ui1;
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_NSTREAMS"))
+        break;
+        case VTP_KW_STREAMING_NSTREAMS:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.eb[streaming_eb].nstreams = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_CONNECT"))
+        break;
+        case VTP_KW_STREAMING_CONNECT:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           if(argi[0] > 0)
@@ -1757,31 +3042,35 @@ vtpReadConfigFile(char *filename_in)
           else
             vtpConf.fadc_streaming.eb[streaming_eb].connect = 1;
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_IPADDR"))
+        break;
+        case VTP_KW_STREAMING_IPADDR:
         {
-          sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
+          vtpConfigReadQuad(str_tmp, argi);
           vtpConf.fadc_streaming.eb[streaming_eb].ipaddr[0] = argi[0];
           vtpConf.fadc_streaming.eb[streaming_eb].ipaddr[1] = argi[1];
           vtpConf.fadc_streaming.eb[streaming_eb].ipaddr[2] = argi[2];
           vtpConf.fadc_streaming.eb[streaming_eb].ipaddr[3] = argi[3];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_SUBNET"))
+        break;
+        case VTP_KW_STREAMING_SUBNET:
         {
-          sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
+          vtpConfigReadQuad(str_tmp, argi);
           vtpConf.fadc_streaming.eb[streaming_eb].subnet[0] = argi[0];
           vtpConf.fadc_streaming.eb[streaming_eb].subnet[1] = argi[1];
           vtpConf.fadc_streaming.eb[streaming_eb].subnet[2] = argi[2];
           vtpConf.fadc_streaming.eb[streaming_eb].subnet[3] = argi[3];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_GATEWAY"))
+        break;
+        case VTP_KW_STREAMING_GATEWAY:
         {
-          sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
+          vtpConfigReadQuad(str_tmp, argi);
           vtpConf.fadc_streaming.eb[streaming_eb].gateway[0] = argi[0];
           vtpConf.fadc_streaming.eb[streaming_eb].gateway[1] = argi[1];
           vtpConf.fadc_streaming.eb[streaming_eb].gateway[2] = argi[2];
           vtpConf.fadc_streaming.eb[streaming_eb].gateway[3] = argi[3];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_MAC"))
+        break;
+        case VTP_KW_STREAMING_MAC:
         {
           sscanf (str_tmp, "%*s 0x%X 0x%X 0x%X 0x%X 0x%X 0x%X", &argi[0], &argi[1], &argi[2], &argi[3], &argi[4], &argi[5]);
           vtpConf.fadc_streaming.eb[streaming_eb].mac[0] = argi[0];
@@ -1791,37 +3080,43 @@ vtpReadConfigFile(char *filename_in)
           vtpConf.fadc_streaming.eb[streaming_eb].mac[4] = argi[4];
           vtpConf.fadc_streaming.eb[streaming_eb].mac[5] = argi[5];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_DESTIP"))
+        break;
+        case VTP_KW_STREAMING_DESTIP:
         {
-          sscanf (str_tmp, "%*s %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3]);
+          vtpConfigReadQuad(str_tmp, argi);
           vtpConf.fadc_streaming.eb[streaming_eb].destip[0] = argi[0];
           vtpConf.fadc_streaming.eb[streaming_eb].destip[1] = argi[1];
           vtpConf.fadc_streaming.eb[streaming_eb].destip[2] = argi[2];
           vtpConf.fadc_streaming.eb[streaming_eb].destip[3] = argi[3];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_DESTIPPORT"))
+        break;
+        case VTP_KW_STREAMING_DESTIPPORT:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.eb[streaming_eb].destipport = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_STREAMING_LOCALPORT"))
+        break;
+        case VTP_KW_STREAMING_LOCALPORT:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.fadc_streaming.eb[streaming_eb].localport = argi[0];
         }
 
 	      // VTP ROC CONFIG PARAMETERS
-        else if(!strcmp(keyword,"VTP_ROC_ROCID"))
+        break;
+        case VTP_KW_ROC_ROCID:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.vtp_roc.roc_id = argi[0];
 	}
-        else if(!strcmp(keyword,"VTP_ROC_DEST_IP"))
+        break;
+        case VTP_KW_ROC_DEST_IP:
         {
           sscanf (str_tmp, "%*s %x", &argi[0]);
           vtpConf.vtp_roc.destip = argi[0];
         }
-        else if(!strcmp(keyword,"VTP_ROC_DEST_PORT"))
+        break;
+        case VTP_KW_ROC_DEST_PORT:
         {
           sscanf (str_tmp, "%*s %d", &argi[0]);
           vtpConf.vtp_roc.destipport = argi[0];
@@ -1829,23 +3124,26 @@ vtpReadConfigFile(char *filename_in)
 
 
 	      // COMPTON CONFIG PARAMETERS
-        else if(!strcmp(keyword,"VTP_COMPTON_VETROC_WIDTH"))
+        break;
+        case VTP_KW_COMPTON_VETROC_WIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.compton.vetroc_width = argi[0];
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_LATENCY"))
+		break;
+        case VTP_KW_COMPTON_LATENCY:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.compton.trig.latency = argi[0];
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_WIDTH"))
+		break;
+        case VTP_KW_COMPTON_WIDTH:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  vtpConf.compton.trig.width = argi[0];
 		}
-
-        else if(!strcmp(keyword,"VTP_COMPTON_FADC_THRESHOLD"))
+		break;
+        case VTP_KW_COMPTON_FADC_THRESHOLD:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=5)
@@ -1856,7 +3154,8 @@ vtpReadConfigFile(char *filename_in)
 printf("Set FADC_THRESHOLD: %d %d\n", argi[0], argi[1]);
 		  vtpConf.compton.fadc_threshold[argi[0]] = argi[1];
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_FADC_EN_MASK"))
+		break;
+        case VTP_KW_COMPTON_FADC_EN_MASK:
 		{
 		  args = sscanf (str_tmp, "%*s %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d %d",
 			  &argi[0],
@@ -1883,7 +3182,8 @@ printf("Set FADC_THRESHOLD: %d %d\n", argi[0], argi[1]);
 		  vtpConf.compton.fadc_mask[argi[0]] = ui1;
 printf("Set FADC_MASK: %d %04X\n", argi[0], vtpConf.compton.fadc_mask[argi[0]]);
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_EPLANE_MULT_MIN"))
+		break;
+        case VTP_KW_COMPTON_EPLANE_MULT_MIN:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=5)
@@ -1894,7 +3194,8 @@ printf("Set FADC_MASK: %d %04X\n", argi[0], vtpConf.compton.fadc_mask[argi[0]]);
 printf("Set EPLANE_MULT_MIN: %d %d\n", argi[0], argi[1]);
           vtpConf.compton.eplane_mult_min[argi[0]] = argi[1];
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_EPLANE_MASK"))
+		break;
+        case VTP_KW_COMPTON_EPLANE_MASK:
 		{
 		  sscanf (str_tmp, "%*s %d %d %d %d %d", &argi[0], &argi[1], &argi[2], &argi[3], &argi[4]);
 		  if(argi[0]<0 || argi[0]>=5)
@@ -1909,7 +3210,8 @@ printf("Set EPLANE_MULT_MIN: %d %d\n", argi[0], argi[1]);
 		  if(argi[4]==1) vtpConf.compton.eplane_mask[argi[0]] |= 0x8;
 printf("Set EPLANE_MASK: %d %d\n", argi[0], vtpConf.compton.eplane_mask[argi[0]]);
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_PRESCALE"))
+		break;
+        case VTP_KW_COMPTON_PRESCALE:
 		{
 		  sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 		  if(argi[0]<0 || argi[0]>=32)
@@ -1920,7 +3222,8 @@ printf("Set EPLANE_MASK: %d %d\n", argi[0], vtpConf.compton.eplane_mask[argi[0]]
 printf("Set PRESCALE: %d %d\n", argi[0], argi[1]);
 		  vtpConf.compton.trig.prescale[argi[0]] = argi[1];
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_SCALER_READOUT_EN"))
+		break;
+        case VTP_KW_COMPTON_SCALER_READOUT_EN:
 		{
 		  sscanf (str_tmp, "%*s %d", &argi[0]);
 		  if(argi[0] > 0)
@@ -1928,7 +3231,8 @@ printf("Set PRESCALE: %d %d\n", argi[0], argi[1]);
 		  else
 		    vtpConf.compton.enable_scaler_readout = 0;
 		}
-        else if(!strcmp(keyword,"VTP_COMPTON_DELAY"))
+		break;
+        case VTP_KW_COMPTON_DELAY:
 	  {
 	    sscanf (str_tmp, "%*s %d %d", &argi[0], &argi[1]);
 	    if(argi[0]<0 || argi[0]>=32)
@@ -1939,12 +3243,13 @@ printf("Set PRESCALE: %d %d\n", argi[0], argi[1]);
 	    printf("Set DELAY: %d %d\n", argi[0], argi[1]);
 	    vtpConf.compton.trig.delay[argi[0]] = argi[1];
 	  }
-        else
-	  {
-	    printf("Error: VTP unknown line: fgets returns %s so keyword=%s\n\n",str_tmp,keyword);
-	  }
+	  break;
+	      default:
+		break;
 	    }
 	}
+      if(!indexed)
+	vtpCrateIndexCommit();
       fclose(fd);
     }
 
@@ -1961,11 +3266,217 @@ vtpUploadAllPrint()
   return 0;
 }
 
+/*
+ * Download shadow.  vtpDownloadAll() writes the settings in groups (one
+ * group per vtpSet* call or trigger type).  In VTP_DOWNLOAD_DIFF mode a
+ * group is written only if it differs from the last download, which is
+ * dropped when the hardware was reset or reloaded since
+ * (vtpGetHwGeneration()) or the firmware type changed.
+ * VTP_DOWNLOAD_VERIFY reads the settings back (vtpUploadAll) before the
+ * download and compares them with the read back after the last download:
+ * groups changed behind our back are reported and written again.
+ */
+enum
+{
+  VTP_DL_WINDOW,
+  VTP_DL_PAYLOAD_EN,
+  VTP_DL_FIBER_EN,
+  VTP_DL_EC,
+  VTP_DL_PC,
+  VTP_DL_HTCC,
+  VTP_DL_FTOF,
+  VTP_DL_CND,
+  VTP_DL_PCS,
+  VTP_DL_ECS,
+  VTP_DL_GT,
+  VTP_DL_DC,
+  VTP_DL_HCAL,
+  VTP_DL_FTCAL,
+  VTP_DL_FTHODO,
+  VTP_DL_HPS,
+  VTP_DL_COMPTON,
+  VTP_DL_FADC_STREAMING,
+  VTP_DL_NGROUP
+};
+
+#define VTP_DL_FIELD(f)         offsetof(VTP_CONF, f), sizeof(((VTP_CONF *)0)->f)
+
+static const struct
+{
+  const char *name;
+  size_t      off, len;
+} vtpDlGroups[VTP_DL_NGROUP] =
+  {
+    {"window",         offsetof(VTP_CONF, window_width), 2*sizeof(int)},
+    {"payload_en",     VTP_DL_FIELD(payload_en)},
+    {"fiber_en",       VTP_DL_FIELD(fiber_en)},
+    {"ec",             VTP_DL_FIELD(ec)},
+    {"pc",             VTP_DL_FIELD(pc)},
+    {"htcc",           VTP_DL_FIELD(htcc)},
+    {"ftof",           VTP_DL_FIELD(ftof)},
+    {"cnd",            VTP_DL_FIELD(cnd)},
+    {"pcs",            VTP_DL_FIELD(pcs)},
+    {"ecs",            VTP_DL_FIELD(ecs)},
+    {"gt",             VTP_DL_FIELD(gt)},
+    {"dc",             VTP_DL_FIELD(dc)},
+    {"hcal",           VTP_DL_FIELD(hcal)},
+    {"ftcal",          VTP_DL_FIELD(ftcal)},
+    {"fthodo",         VTP_DL_FIELD(fthodo)},
+    {"hps",            VTP_DL_FIELD(hps)},
+    {"compton",        VTP_DL_FIELD(compton)},
+    {"fadc_streaming", VTP_DL_FIELD(fadc_streaming)}
+  };
+
+static VTP_CONF     vtpDlShadow;          /* settings of the last download */
+static VTP_CONF     vtpDlReadback;        /* read back after the last download */
+static VTP_CONF     vtpDlNow;             /* read back before this download */
+static VTP_CONF     vtpDlWant;            /* settings of this download */
+static int          vtpDlShadowValid = 0, vtpDlReadbackValid = 0;
+static unsigned int vtpDlHwGen = 0;
+static int          vtpDlModeOverride = -1;
+static int          vtpDlFull, vtpDlNowValid;
+static int          vtpDlConfValid = 0;   /* downloaded the config of vtpConfigLoad() */
+static uint64_t     vtpDlConfHash;
+static unsigned int vtpDlDrift, vtpDlChecked, vtpDlWritten;
+static char         vtpDlStr[16001];
+
+/* VTP_DOWNLOAD_* mode of vtpDownloadAll(), -1: VTP_DOWNLOAD_MODE of the config */
+int
+vtpSetDownloadMode(int mode)
+{
+  if((mode < -1) || (mode > (VTP_DOWNLOAD_DIFF | VTP_DOWNLOAD_VERIFY)))
+    {
+      printf("%s: ERROR: invalid mode %d\n", __func__, mode);
+      return ERROR;
+    }
+
+  vtpDlModeOverride = mode;
+  return OK;
+}
+
+/* Make the next vtpDownloadAll() write everything */
+void
+vtpDownloadShadowClear()
+{
+  vtpDlShadowValid = 0;
+  vtpDlReadbackValid = 0;
+}
+
+/* The config of vtpConfigLoad() (same content hash) is the one of the last
+   vtpDownloadAll() and the hardware was not reset or reloaded since: the
+   download can be skipped.  Never in VTP_DOWNLOAD_VERIFY mode, that has to
+   read back */
+int
+vtpConfigDownloaded()
+{
+  int mode = (vtpDlModeOverride >= 0) ? vtpDlModeOverride : vtpConf.download_mode;
+
+  return vtpConfCache.valid && vtpDlShadowValid && vtpDlConfValid &&
+    (vtpDlConfHash == vtpConfCache.hash) && (vtpDlHwGen == vtpGetHwGeneration()) &&
+    !(mode & VTP_DOWNLOAD_VERIFY);
+}
+
+/* Read the settings back without losing the ones to download.  Settings
+   vtpUploadAll() does not read keep the values of the last download */
+static void
+vtpDlReadBack(VTP_CONF *rb)
+{
+  memcpy(&vtpConf, &vtpDlShadow, sizeof(VTP_CONF));
+  vtpUploadAll(vtpDlStr, sizeof(vtpDlStr) - 1);
+  memcpy(rb, &vtpConf, sizeof(VTP_CONF));
+  memcpy(&vtpConf, &vtpDlWant, sizeof(VTP_CONF));
+}
+
+/* Settings group 'ig' has to be written */
+static int
+vtpDlNeeded(int ig)
+{
+  vtpDlChecked |= (1 << ig);
+
+  if(vtpDlFull || (vtpDlDrift & (1 << ig)) ||
+     memcmp((char *)&vtpConf + vtpDlGroups[ig].off,
+	    (char *)&vtpDlShadow + vtpDlGroups[ig].off, vtpDlGroups[ig].len))
+    {
+      vtpDlWritten |= (1 << ig);
+      return 1;
+    }
+
+  return 0;
+}
+
+static void
+vtpDlStart(int mode)
+{
+  int ig, same;
+
+  memcpy(&vtpDlWant, &vtpConf, sizeof(VTP_CONF));
+  vtpDlDrift = vtpDlChecked = vtpDlWritten = 0;
+  vtpDlNowValid = 0;
+
+  same = vtpDlShadowValid && (vtpDlHwGen == vtpGetHwGeneration()) &&
+    (vtpConf.fw_type[0] == vtpDlShadow.fw_type[0]) &&
+    (vtpConf.fw_type[1] == vtpDlShadow.fw_type[1]);
+  vtpDlFull = !(mode & VTP_DOWNLOAD_DIFF) || !same;
+
+  if(!(mode & VTP_DOWNLOAD_VERIFY) || !same || !vtpDlReadbackValid)
+    return;
+
+  vtpDlReadBack(&vtpDlNow);
+  vtpDlNowValid = 1;
+  for(ig=0; ig<VTP_DL_NGROUP; ig++)
+    {
+      if(memcmp((char *)&vtpDlNow + vtpDlGroups[ig].off,
+		(char *)&vtpDlReadback + vtpDlGroups[ig].off, vtpDlGroups[ig].len))
+	{
+	  printf("vtpDownloadAll: WARNING: %s settings changed since the last download\n",
+		 vtpDlGroups[ig].name);
+	  vtpDlDrift |= (1 << ig);
+	}
+    }
+}
+
+static void
+vtpDlEnd(int mode)
+{
+  int ig, nchecked = 0, nwritten = 0;
+
+  memcpy(&vtpDlShadow, &vtpDlWant, sizeof(VTP_CONF));
+  vtpDlShadowValid = 1;
+  vtpDlHwGen = vtpGetHwGeneration();
+  vtpDlConfValid = vtpConfCache.valid;
+  vtpDlConfHash = vtpConfCache.hash;
+
+  if(mode & VTP_DOWNLOAD_VERIFY)
+    {
+      /* Reference for the next verify, unless nothing was written
+	 since the read back of vtpDlStart() */
+      if(vtpDlWritten || !vtpDlNowValid)
+	vtpDlReadBack(&vtpDlReadback);
+      vtpDlReadbackValid = 1;
+    }
+  else
+    vtpDlReadbackValid = 0;
+
+  if(mode == VTP_DOWNLOAD_FULL)
+    return;
+
+  for(ig=0; ig<VTP_DL_NGROUP; ig++)
+    {
+      nchecked += (vtpDlChecked >> ig) & 1;
+      nwritten += (vtpDlWritten >> ig) & 1;
+    }
+  printf("vtpDownloadAll: %s download, %d of %d setting groups written",
+	 vtpDlFull ? "full" : "diff", nwritten, nchecked);
+  if(vtpDlDrift)
+    printf(" (%d drifted)", __builtin_popcount(vtpDlDrift));
+  printf("\n");
+}
+
 /* download setting into VTP */
 int
 vtpDownloadAll()
 {
-  int enable_flags;
+  int enable_flags, mode;
   int ii, inst;
 
 #ifdef VTPDOWNLOADALL_FIRMWARE_LOAD
@@ -2022,13 +3533,19 @@ vtpDownloadAll()
 	 __func__, vtpConf.fw_type[1]);
 
 
+  mode = (vtpDlModeOverride >= 0) ? vtpDlModeOverride : vtpConf.download_mode;
+  vtpDlStart(mode);
+
   // Set parameters based on firmware type
-  vtpSetWindow(vtpConf.window_offset, vtpConf.window_width);
+  if(vtpDlNeeded(VTP_DL_WINDOW))
+    vtpSetWindow(vtpConf.window_offset, vtpConf.window_width);
 
-  vtpEnableTriggerPayloadMask(vtpConf.payload_en);
-  vtpEnableTriggerFiberMask(vtpConf.fiber_en);
+  if(vtpDlNeeded(VTP_DL_PAYLOAD_EN))
+    vtpEnableTriggerPayloadMask(vtpConf.payload_en);
+  if(vtpDlNeeded(VTP_DL_FIBER_EN))
+    vtpEnableTriggerFiberMask(vtpConf.fiber_en);
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_EC)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_EC) && vtpDlNeeded(VTP_DL_EC))
     {
       // EC configuration
       vtpSetFadcSum_MaskEn(vtpConf.ec.fadcsum_ch_en);
@@ -2050,7 +3567,7 @@ vtpDownloadAll()
       vtpSetECcosmic_delay(1, vtpConf.ec.outer.cosmic_evaldelay);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_PC)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_PC) && vtpDlNeeded(VTP_DL_PC))
     {
       // PC configuration
       vtpSetFadcSum_MaskEn(vtpConf.pc.fadcsum_ch_en);
@@ -2062,7 +3579,7 @@ vtpDownloadAll()
       vtpSetPCcosmic_pixel(vtpConf.pc.cosmic_pixelen);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_HTCC)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_HTCC) && vtpDlNeeded(VTP_DL_HTCC))
     {
       // HTCC configuration
       vtpSetHTCC_thresholds(vtpConf.htcc.threshold[0], vtpConf.htcc.threshold[1], vtpConf.htcc.threshold[2]);
@@ -2072,21 +3589,21 @@ vtpDownloadAll()
       vtpSetCTOF_nframes(vtpConf.htcc.ctof_nframes);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_FTOF)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_FTOF) && vtpDlNeeded(VTP_DL_FTOF))
     {
       // FTOF configuration
       vtpSetFTOF_thresholds(vtpConf.ftof.threshold[0], vtpConf.ftof.threshold[1], vtpConf.ftof.threshold[2]);
       vtpSetFTOF_nframes(vtpConf.ftof.nframes);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_CND)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_CND) && vtpDlNeeded(VTP_DL_CND))
     {
       // CND configuration
       vtpSetCND_thresholds(vtpConf.cnd.threshold[0], vtpConf.cnd.threshold[1], vtpConf.cnd.threshold[2]);
       vtpSetCND_nframes(vtpConf.cnd.nframes);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_PCS)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_PCS) && vtpDlNeeded(VTP_DL_PCS))
     {
       // PCS configuration
       vtpSetPCS_thresholds(vtpConf.pcs.threshold[0], vtpConf.pcs.threshold[1], vtpConf.pcs.threshold[2]);
@@ -2102,7 +3619,7 @@ vtpDownloadAll()
       vtpSetPCcosmic_pixel(vtpConf.pcs.cosmic_pixelen);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_ECS)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_ECS) && vtpDlNeeded(VTP_DL_ECS))
     {
       // ECS configuration
       vtpSetFadcSum_MaskEn(vtpConf.ecs.fadcsum_ch_en);
@@ -2125,7 +3642,7 @@ vtpDownloadAll()
       vtpSetECcosmic_delay(1, vtpConf.ecs.outer.cosmic_evaldelay);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_GT)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_GT) && vtpDlNeeded(VTP_DL_GT))
     {
       // GT configuration
       vtpSetGt_latency(vtpConf.gt.trig_latency);
@@ -2149,19 +3666,19 @@ vtpDownloadAll()
 	}
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_DC)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_DC) && vtpDlNeeded(VTP_DL_DC))
     {
       vtpSetDc_SegmentThresholdMin(0, vtpConf.dc.dcsegfind_threshold[0]);
       vtpSetDc_SegmentThresholdMin(1, vtpConf.dc.dcsegfind_threshold[1]);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_HCAL)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_HCAL) && vtpDlNeeded(VTP_DL_HCAL))
     {
       vtpSetHcal_ClusterCoincidence(vtpConf.hcal.hit_dt);
       vtpSetHcal_ClusterThreshold(vtpConf.hcal.cluster_emin);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_FTCAL)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_FTCAL) && vtpDlNeeded(VTP_DL_FTCAL))
     {
       vtpSetFadcSum_MaskEn(vtpConf.ftcal.fadcsum_ch_en);
       vtpSetFTCALseed_emin(vtpConf.ftcal.seed_emin);
@@ -2171,12 +3688,12 @@ vtpDownloadAll()
       vtpSetFTCALcluster_deadtime_emin(vtpConf.ftcal.deadtime_emin);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_FTHODO)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_FTHODO) && vtpDlNeeded(VTP_DL_FTHODO))
     {
       vtpSetFTHODOemin(vtpConf.fthodo.hit_emin);
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_HPS)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_HPS) && vtpDlNeeded(VTP_DL_HPS))
     {
       vtpSetHPS_Cluster(vtpConf.hps.cluster.top_nbottom, vtpConf.hps.cluster.hit_dt, vtpConf.hps.cluster.seed_thr);
       vtpSetHPS_Hodoscope(vtpConf.hps.hodoscope.hit_dt, vtpConf.hps.hodoscope.fadchit_thr, vtpConf.hps.hodoscope.hodo_thr);
@@ -2297,7 +3814,7 @@ vtpDownloadAll()
         );
     }
 
-  if(vtpConf.fw_type[0] == VTP_FW_TYPE_COMPTON)
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_COMPTON) && vtpDlNeeded(VTP_DL_COMPTON))
   {
     for(ii=0;ii<5;ii++)
     {
@@ -2312,7 +3829,8 @@ vtpDownloadAll()
     vtpSetGt_width(vtpConf.compton.trig.width);
   }
 
-  if((vtpConf.fw_type[0] == VTP_FW_TYPE_FADCSTREAM))
+  if((vtpConf.fw_type[0] == VTP_FW_TYPE_FADCSTREAM) &&
+     (vtpDlNeeded(VTP_DL_FADC_STREAMING) | vtpDlNeeded(VTP_DL_PAYLOAD_EN)))
   {
     for(inst=0;inst<1;inst++)
     {
@@ -2361,7 +3879,9 @@ vtpDownloadAll()
     printf("vtpDownloadAll: Payload port enable mask = 0x%04x\n",vtpConf.payload_en);
   }
 
-  vtpUploadAllPrint();
+  if(mode == VTP_DOWNLOAD_FULL)
+    vtpUploadAllPrint();
+  vtpDlEnd(mode);
 
   return(0);
 }
@@ -3096,6 +4616,546 @@ vtpUploadAll(char *string, int length)
   return(0);
 }
 
+/*
+ * Binary configuration bank (VTP_CFGBANK_*, vtpConfig.h).  The settings
+ * vtpUploadAll() reports, as records of 32 bit words: built once at
+ * Prestart and copied into the first event, decoded by
+ * vtpConfigBankDecode() without any text parsing.  A record holds the
+ * fields of its table below in order: int / float members one word each,
+ * unsigned short one word each, bytes four per word (first byte in bits
+ * 31:24).  Fields are only ever appended to a record; the decoder takes
+ * what is there and skips unknown records.
+ */
+#define VTP_CB_WORD   0
+#define VTP_CB_SHORT  1
+#define VTP_CB_BYTE   2
+
+#define VTP_CB_WORDS(s, f)   {offsetof(s, f), VTP_CB_WORD,  sizeof(((s *)0)->f)/4}
+#define VTP_CB_SHORTS(s, f)  {offsetof(s, f), VTP_CB_SHORT, sizeof(((s *)0)->f)/2}
+#define VTP_CB_BYTES(s, f)   {offsetof(s, f), VTP_CB_BYTE,  sizeof(((s *)0)->f)}
+
+typedef struct
+{
+  size_t off;                   /* from the record base */
+  int    type;
+  int    count;
+} VTP_CB_FIELD;
+
+static const VTP_CB_FIELD vtpCbFw[]      = {VTP_CB_WORDS(VTP_CONF, fw_rev),
+					    VTP_CB_WORDS(VTP_CONF, fw_type), {0}};
+static const VTP_CB_FIELD vtpCbWindow[]  = {VTP_CB_WORDS(VTP_CONF, window_width),
+					    VTP_CB_WORDS(VTP_CONF, window_offset), {0}};
+static const VTP_CB_FIELD vtpCbPayload[] = {VTP_CB_WORDS(VTP_CONF, payload_en), {0}};
+static const VTP_CB_FIELD vtpCbFiber[]   = {VTP_CB_WORDS(VTP_CONF, fiber_en), {0}};
+static const VTP_CB_FIELD vtpCbEc[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, ec.fadcsum_ch_en),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.hit_emin),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.hit_dt),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.dalitz_min),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.dalitz_max),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, ec.inner.cosmic_evaldelay),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.hit_emin),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.hit_dt),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.dalitz_min),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.dalitz_max),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, ec.outer.cosmic_evaldelay),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbPc[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, pc.fadcsum_ch_en),
+    VTP_CB_WORDS(VTP_CONF, pc.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, pc.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, pc.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, pc.cosmic_evaldelay),
+    VTP_CB_WORDS(VTP_CONF, pc.cosmic_pixelen),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbHtcc[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, htcc.threshold),
+    VTP_CB_WORDS(VTP_CONF, htcc.nframes),
+    VTP_CB_WORDS(VTP_CONF, htcc.ctof_threshold),
+    VTP_CB_WORDS(VTP_CONF, htcc.ctof_nframes),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbFtof[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, ftof.threshold),
+    VTP_CB_WORDS(VTP_CONF, ftof.nframes),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbCnd[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, cnd.threshold),
+    VTP_CB_WORDS(VTP_CONF, cnd.nframes),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbPcs[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, pcs.threshold),
+    VTP_CB_WORDS(VTP_CONF, pcs.nframes),
+    VTP_CB_WORDS(VTP_CONF, pcs.dipfactor),
+    VTP_CB_WORDS(VTP_CONF, pcs.dalitz_min),
+    VTP_CB_WORDS(VTP_CONF, pcs.dalitz_max),
+    VTP_CB_WORDS(VTP_CONF, pcs.nstrip_min),
+    VTP_CB_WORDS(VTP_CONF, pcs.nstrip_max),
+    VTP_CB_WORDS(VTP_CONF, pcs.pcu_threshold),
+    VTP_CB_WORDS(VTP_CONF, pcs.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, pcs.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, pcs.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, pcs.cosmic_evaldelay),
+    VTP_CB_WORDS(VTP_CONF, pcs.cosmic_pixelen),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbEcs[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, ecs.fadcsum_ch_en),
+    VTP_CB_WORDS(VTP_CONF, ecs.threshold),
+    VTP_CB_WORDS(VTP_CONF, ecs.nframes),
+    VTP_CB_WORDS(VTP_CONF, ecs.dipfactor),
+    VTP_CB_WORDS(VTP_CONF, ecs.dalitz_min),
+    VTP_CB_WORDS(VTP_CONF, ecs.dalitz_max),
+    VTP_CB_WORDS(VTP_CONF, ecs.nstrip_min),
+    VTP_CB_WORDS(VTP_CONF, ecs.nstrip_max),
+    VTP_CB_WORDS(VTP_CONF, ecs.inner.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, ecs.inner.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, ecs.inner.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, ecs.inner.cosmic_evaldelay),
+    VTP_CB_WORDS(VTP_CONF, ecs.outer.cosmic_emin),
+    VTP_CB_WORDS(VTP_CONF, ecs.outer.cosmic_multmax),
+    VTP_CB_WORDS(VTP_CONF, ecs.outer.cosmic_hitwidth),
+    VTP_CB_WORDS(VTP_CONF, ecs.outer.cosmic_evaldelay),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbGt[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, gt.trig_latency),
+    VTP_CB_WORDS(VTP_CONF, gt.trig_width),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbGtTrgbit[] =
+  {
+    VTP_CB_WORDS(trgbit, ssp_strigger_bit_mask),
+    VTP_CB_WORDS(trgbit, ssp_sector_mask),
+    VTP_CB_WORDS(trgbit, sector_mult_min),
+    VTP_CB_WORDS(trgbit, sector_coin_width),
+    VTP_CB_WORDS(trgbit, ssp_ctrigger_bit_mask),
+    VTP_CB_WORDS(trgbit, delay),
+    VTP_CB_WORDS(trgbit, pulser_freq),
+    VTP_CB_WORDS(trgbit, prescale),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbDc[]      = {VTP_CB_WORDS(VTP_CONF, dc.dcsegfind_threshold),
+					    VTP_CB_BYTES(VTP_CONF, dc.roadid), {0}};
+static const VTP_CB_FIELD vtpCbHcal[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, hcal.hit_dt),
+    VTP_CB_WORDS(VTP_CONF, hcal.cluster_emin),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbFtcal[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, ftcal.fadcsum_ch_en),
+    VTP_CB_WORDS(VTP_CONF, ftcal.seed_emin),
+    VTP_CB_WORDS(VTP_CONF, ftcal.seed_dt),
+    VTP_CB_WORDS(VTP_CONF, ftcal.hodo_dt),
+    VTP_CB_WORDS(VTP_CONF, ftcal.deadtime),
+    VTP_CB_WORDS(VTP_CONF, ftcal.deadtime_emin),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbFthodo[]  = {VTP_CB_WORDS(VTP_CONF, fthodo.hit_emin), {0}};
+static const VTP_CB_FIELD vtpCbHps[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, hps.cluster.top_nbottom),
+    VTP_CB_WORDS(VTP_CONF, hps.cluster.hit_dt),
+    VTP_CB_WORDS(VTP_CONF, hps.cluster.seed_thr),
+    VTP_CB_WORDS(VTP_CONF, hps.hodoscope.hit_dt),
+    VTP_CB_WORDS(VTP_CONF, hps.hodoscope.fadchit_thr),
+    VTP_CB_WORDS(VTP_CONF, hps.hodoscope.hodo_thr),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.hodoscope_top_en),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.hodoscope_bot_en),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.cosmic_dt),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.cosmic_top_en),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.cosmic_bot_en),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.pulser_freq),
+    VTP_CB_WORDS(VTP_CONF, hps.calib.pulser_en),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.cluster_emin),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.cluster_emax),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.cluster_nmin),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.prescale_xmin),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.prescale_xmax),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.prescale),
+    VTP_CB_WORDS(VTP_CONF, hps.fee_trig.en),
+    VTP_CB_WORDS(VTP_CONF, hps.trig.latency),
+    VTP_CB_WORDS(VTP_CONF, hps.trig.prescale),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbHpsSingle[] =
+  {
+    VTP_CB_WORDS(hps_single_trig, cluster_emin),
+    VTP_CB_WORDS(hps_single_trig, cluster_emax),
+    VTP_CB_WORDS(hps_single_trig, cluster_nmin),
+    VTP_CB_WORDS(hps_single_trig, cluster_xmin),
+    VTP_CB_WORDS(hps_single_trig, pde_c),
+    VTP_CB_WORDS(hps_single_trig, cluster_emin_en),
+    VTP_CB_WORDS(hps_single_trig, cluster_emax_en),
+    VTP_CB_WORDS(hps_single_trig, cluster_nmin_en),
+    VTP_CB_WORDS(hps_single_trig, cluster_xmin_en),
+    VTP_CB_WORDS(hps_single_trig, pde_en),
+    VTP_CB_WORDS(hps_single_trig, hodo_l1_en),
+    VTP_CB_WORDS(hps_single_trig, hodo_l2_en),
+    VTP_CB_WORDS(hps_single_trig, hodo_l1l2_geom_en),
+    VTP_CB_WORDS(hps_single_trig, hodo_l1l2x_geom_en),
+    VTP_CB_WORDS(hps_single_trig, en),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbHpsPair[] =
+  {
+    VTP_CB_WORDS(hps_pair_trig, cluster_emin),
+    VTP_CB_WORDS(hps_pair_trig, cluster_emax),
+    VTP_CB_WORDS(hps_pair_trig, cluster_nmin),
+    VTP_CB_WORDS(hps_pair_trig, pair_dt),
+    VTP_CB_WORDS(hps_pair_trig, pair_esum_min),
+    VTP_CB_WORDS(hps_pair_trig, pair_esum_max),
+    VTP_CB_WORDS(hps_pair_trig, pair_ediff_max),
+    VTP_CB_WORDS(hps_pair_trig, pair_ed_factor),
+    VTP_CB_WORDS(hps_pair_trig, pair_ed_thr),
+    VTP_CB_WORDS(hps_pair_trig, pair_coplanarity_tol),
+    VTP_CB_WORDS(hps_pair_trig, pair_esum_en),
+    VTP_CB_WORDS(hps_pair_trig, pair_ediff_en),
+    VTP_CB_WORDS(hps_pair_trig, pair_ed_en),
+    VTP_CB_WORDS(hps_pair_trig, pair_coplanarity_en),
+    VTP_CB_WORDS(hps_pair_trig, hodo_l1_en),
+    VTP_CB_WORDS(hps_pair_trig, hodo_l2_en),
+    VTP_CB_WORDS(hps_pair_trig, hodo_l1l2_geom_en),
+    VTP_CB_WORDS(hps_pair_trig, hodo_l1l2x_geom_en),
+    VTP_CB_WORDS(hps_pair_trig, en),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbHpsMult[] =
+  {
+    VTP_CB_WORDS(hps_mult_trig, cluster_emin),
+    VTP_CB_WORDS(hps_mult_trig, cluster_emax),
+    VTP_CB_WORDS(hps_mult_trig, cluster_nmin),
+    VTP_CB_WORDS(hps_mult_trig, mult_dt),
+    VTP_CB_WORDS(hps_mult_trig, mult_top_min),
+    VTP_CB_WORDS(hps_mult_trig, mult_bot_min),
+    VTP_CB_WORDS(hps_mult_trig, mult_tot_min),
+    VTP_CB_WORDS(hps_mult_trig, en),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbCompton[] =
+  {
+    VTP_CB_WORDS(VTP_CONF, compton.enable_scaler_readout),
+    VTP_CB_WORDS(VTP_CONF, compton.vetroc_width),
+    VTP_CB_WORDS(VTP_CONF, compton.fadc_threshold),
+    VTP_CB_WORDS(VTP_CONF, compton.eplane_mult_min),
+    VTP_CB_WORDS(VTP_CONF, compton.eplane_mask),
+    VTP_CB_WORDS(VTP_CONF, compton.fadc_mask),
+    VTP_CB_WORDS(VTP_CONF, compton.trig.latency),
+    VTP_CB_WORDS(VTP_CONF, compton.trig.width),
+    VTP_CB_WORDS(VTP_CONF, compton.trig.prescale),
+    VTP_CB_WORDS(VTP_CONF, compton.trig.delay),
+    {0}
+  };
+static const VTP_CB_FIELD vtpCbStream[]  = {VTP_CB_WORDS(VTP_CONF, fadc_streaming.roc_id),
+					    VTP_CB_WORDS(VTP_CONF, fadc_streaming.nframe_buf),
+					    VTP_CB_WORDS(VTP_CONF, fadc_streaming.frame_len), {0}};
+static const VTP_CB_FIELD vtpCbStreamEb[] =
+  {
+    VTP_CB_WORDS(streaming_eb_cfg, mask_en),
+    VTP_CB_WORDS(streaming_eb_cfg, nstreams),
+    VTP_CB_WORDS(streaming_eb_cfg, connect),
+    VTP_CB_BYTES(streaming_eb_cfg, ipaddr),
+    VTP_CB_BYTES(streaming_eb_cfg, subnet),
+    VTP_CB_BYTES(streaming_eb_cfg, gateway),
+    VTP_CB_BYTES(streaming_eb_cfg, mac),
+    VTP_CB_BYTES(streaming_eb_cfg, destip),
+    VTP_CB_SHORTS(streaming_eb_cfg, destipport),
+    VTP_CB_SHORTS(streaming_eb_cfg, localport),
+    {0}
+  };
+
+/* Records in bank order; fw_type -1: written for every firmware type */
+static const struct
+{
+  int                 tag;
+  const char         *name;
+  int                 fw_type;
+  size_t              base, stride;
+  int                 ninst;
+  const VTP_CB_FIELD *field;
+} vtpCbRecords[] =
+  {
+    {VTP_CFGBANK_FW,           "fw",             -1,                      0, 0, 1, vtpCbFw},
+    {VTP_CFGBANK_WINDOW,       "window",         -1,                      0, 0, 1, vtpCbWindow},
+    {VTP_CFGBANK_PAYLOAD_EN,   "payload_en",     -1,                      0, 0, 1, vtpCbPayload},
+    {VTP_CFGBANK_FIBER_EN,     "fiber_en",       -1,                      0, 0, 1, vtpCbFiber},
+    {VTP_CFGBANK_EC,           "ec",             VTP_FW_TYPE_EC,          0, 0, 1, vtpCbEc},
+    {VTP_CFGBANK_PC,           "pc",             VTP_FW_TYPE_PC,          0, 0, 1, vtpCbPc},
+    {VTP_CFGBANK_HTCC,         "htcc",           VTP_FW_TYPE_HTCC,        0, 0, 1, vtpCbHtcc},
+    {VTP_CFGBANK_FTOF,         "ftof",           VTP_FW_TYPE_FTOF,        0, 0, 1, vtpCbFtof},
+    {VTP_CFGBANK_CND,          "cnd",            VTP_FW_TYPE_CND,         0, 0, 1, vtpCbCnd},
+    {VTP_CFGBANK_PCS,          "pcs",            VTP_FW_TYPE_PCS,         0, 0, 1, vtpCbPcs},
+    {VTP_CFGBANK_ECS,          "ecs",            VTP_FW_TYPE_ECS,         0, 0, 1, vtpCbEcs},
+    {VTP_CFGBANK_GT,           "gt",             VTP_FW_TYPE_GT,          0, 0, 1, vtpCbGt},
+    {VTP_CFGBANK_DC,           "dc",             VTP_FW_TYPE_DC,          0, 0, 1, vtpCbDc},
+    {VTP_CFGBANK_HCAL,         "hcal",           VTP_FW_TYPE_HCAL,        0, 0, 1, vtpCbHcal},
+    {VTP_CFGBANK_FTCAL,        "ftcal",          VTP_FW_TYPE_FTCAL,       0, 0, 1, vtpCbFtcal},
+    {VTP_CFGBANK_FTHODO,       "fthodo",         VTP_FW_TYPE_FTHODO,      0, 0, 1, vtpCbFthodo},
+    {VTP_CFGBANK_HPS,          "hps",            VTP_FW_TYPE_HPS,         0, 0, 1, vtpCbHps},
+    {VTP_CFGBANK_COMPTON,      "compton",        VTP_FW_TYPE_COMPTON,     0, 0, 1, vtpCbCompton},
+    {VTP_CFGBANK_STREAMING,    "streaming",      VTP_FW_TYPE_FADCSTREAM,  0, 0, 1, vtpCbStream},
+    {VTP_CFGBANK_STREAMING_EB, "streaming_eb",   VTP_FW_TYPE_FADCSTREAM,
+     offsetof(VTP_CONF, fadc_streaming.eb), sizeof(streaming_eb_cfg), 2, vtpCbStreamEb},
+    {VTP_CFGBANK_GT_TRGBIT,    "gt_trgbit",      VTP_FW_TYPE_GT,
+     offsetof(VTP_CONF, gt.trgbits), sizeof(trgbit), 32, vtpCbGtTrgbit},
+    {VTP_CFGBANK_HPS_SINGLE,   "hps_single",     VTP_FW_TYPE_HPS,
+     offsetof(VTP_CONF, hps.single_trig), sizeof(hps_single_trig), 4, vtpCbHpsSingle},
+    {VTP_CFGBANK_HPS_PAIR,     "hps_pair",       VTP_FW_TYPE_HPS,
+     offsetof(VTP_CONF, hps.pair_trig), sizeof(hps_pair_trig), 4, vtpCbHpsPair},
+    {VTP_CFGBANK_HPS_MULT,     "hps_mult",       VTP_FW_TYPE_HPS,
+     offsetof(VTP_CONF, hps.mult_trig), sizeof(hps_mult_trig), 2, vtpCbHpsMult}
+  };
+
+#define VTP_CB_NRECORD  (int)(sizeof(vtpCbRecords)/sizeof(vtpCbRecords[0]))
+
+static int
+vtpCbFieldWords(const VTP_CB_FIELD *f)
+{
+  return (f->type == VTP_CB_BYTE) ? (f->count + 3)/4 : f->count;
+}
+
+static int
+vtpCbFind(int tag)
+{
+  int ir;
+
+  for(ir=0; ir<VTP_CB_NRECORD; ir++)
+    if(vtpCbRecords[ir].tag == tag)
+      return ir;
+
+  return -1;
+}
+
+/* Encode 'conf' into 'buf', returns the number of words or ERROR */
+int
+vtpConfigBankEncode(const VTP_CONF *conf, uint32_t *buf, int maxwords)
+{
+  const VTP_CB_FIELD *f;
+  const unsigned char *src;
+  uint32_t *p = buf + VTP_CFGBANK_HDR_WORDS;
+  int ir, inst, i, n;
+
+  if((buf == NULL) || (maxwords < VTP_CFGBANK_HDR_WORDS))
+    {
+      printf("%s: ERROR: buffer too small (%d words)\n", __func__, maxwords);
+      return ERROR;
+    }
+
+  for(ir=0; ir<VTP_CB_NRECORD; ir++)
+    {
+      if((vtpCbRecords[ir].fw_type != -1) && (vtpCbRecords[ir].fw_type != conf->fw_type[0]))
+	continue;
+
+      for(inst=0; inst<vtpCbRecords[ir].ninst; inst++)
+	{
+	  for(n=0, f=vtpCbRecords[ir].field; f->count; f++)
+	    n += vtpCbFieldWords(f);
+	  if((p - buf) + 1 + n > maxwords)
+	    {
+	      printf("%s: ERROR: %s does not fit %d words\n", __func__,
+		     vtpCbRecords[ir].name, maxwords);
+	      return ERROR;
+	    }
+
+	  *p++ = VTP_CFGBANK_REC(vtpCbRecords[ir].tag, inst, n);
+	  for(f=vtpCbRecords[ir].field; f->count; f++)
+	    {
+	      src = (const unsigned char *)conf + vtpCbRecords[ir].base +
+		inst*vtpCbRecords[ir].stride + f->off;
+	      switch(f->type)
+		{
+		case VTP_CB_WORD:
+		  memcpy(p, src, 4*f->count);
+		  break;
+		case VTP_CB_SHORT:
+		  for(i=0; i<f->count; i++)
+		    p[i] = ((const unsigned short *)src)[i];
+		  break;
+		case VTP_CB_BYTE:
+		  memset(p, 0, 4*vtpCbFieldWords(f));
+		  for(i=0; i<f->count; i++)
+		    p[i/4] |= ((uint32_t)src[i]) << (24 - 8*(i & 3));
+		  break;
+		}
+	      p += vtpCbFieldWords(f);
+	    }
+	}
+    }
+
+  buf[0] = VTP_CFGBANK_MAGIC;
+  buf[1] = (VTP_CFGBANK_VERSION << 16) | VTP_CFGBANK_HDR_WORDS;
+  buf[2] = p - buf;
+
+  return p - buf;
+}
+
+/* Read the settings back (as vtpUploadAll() does) and encode them */
+int
+vtpConfigBankBuild(uint32_t *buf, int maxwords)
+{
+  static VTP_CONF save;
+  int rval;
+
+  memcpy(&save, &vtpConf, sizeof(VTP_CONF));
+  vtpUploadAll(NULL, 0);
+  rval = vtpConfigBankEncode(&vtpConf, buf, maxwords);
+  memcpy(&vtpConf, &save, sizeof(VTP_CONF));
+
+  return rval;
+}
+
+/* Word 'i' of a bank, 'swap': written on a host of the other byte order */
+#define VTP_CB_GET(buf, i, swap)  ((swap) ? __builtin_bswap32((buf)[i]) : (buf)[i])
+
+/* Bank header check, returns the bank words or ERROR */
+static int
+vtpCbHeader(const uint32_t *buf, int nwords, int *swap)
+{
+  int nw;
+
+  if((buf == NULL) || (nwords < VTP_CFGBANK_HDR_WORDS))
+    return ERROR;
+
+  if(buf[0] == VTP_CFGBANK_MAGIC)
+    *swap = 0;
+  else if(buf[0] == __builtin_bswap32(VTP_CFGBANK_MAGIC))
+    *swap = 1;
+  else
+    {
+      printf("%s: ERROR: not a VTP config bank (0x%08x)\n", __func__, buf[0]);
+      return ERROR;
+    }
+
+  if((VTP_CB_GET(buf, 1, *swap) >> 16) != VTP_CFGBANK_VERSION)
+    {
+      printf("%s: ERROR: bank version %d, expected %d\n", __func__,
+	     VTP_CB_GET(buf, 1, *swap) >> 16, VTP_CFGBANK_VERSION);
+      return ERROR;
+    }
+
+  nw = VTP_CB_GET(buf, 2, *swap);
+  if((nw > nwords) || ((int)(VTP_CB_GET(buf, 1, *swap) & 0xFFFF) > nw))
+    {
+      printf("%s: ERROR: bank of %d words in a buffer of %d\n", __func__, nw, nwords);
+      return ERROR;
+    }
+
+  return nw;
+}
+
+/* Decode a bank into 'conf'.  Only the settings in the bank are changed,
+   returns the number of records decoded or ERROR */
+int
+vtpConfigBankDecode(const uint32_t *buf, int nwords, VTP_CONF *conf)
+{
+  const VTP_CB_FIELD *f;
+  unsigned char *dst;
+  uint32_t w;
+  int nw, swap, pos, n, ir, inst, i, k, nrec = 0;
+
+  nw = vtpCbHeader(buf, nwords, &swap);
+  if(nw == ERROR)
+    return ERROR;
+
+  pos = VTP_CB_GET(buf, 1, swap) & 0xFFFF;
+  while(pos < nw)
+    {
+      w = VTP_CB_GET(buf, pos, swap);
+      n = VTP_CFGBANK_REC_NWORDS(w);
+      if(pos + 1 + n > nw)
+	{
+	  printf("%s: ERROR: record 0x%08x overruns the bank\n", __func__, w);
+	  return ERROR;
+	}
+
+      ir   = vtpCbFind(VTP_CFGBANK_REC_TAG(w));
+      inst = VTP_CFGBANK_REC_INST(w);
+      if((ir >= 0) && (inst < vtpCbRecords[ir].ninst))
+	{
+	  k = pos + 1;
+	  for(f=vtpCbRecords[ir].field; f->count && (k + vtpCbFieldWords(f) <= pos + 1 + n); f++)
+	    {
+	      dst = (unsigned char *)conf + vtpCbRecords[ir].base +
+		inst*vtpCbRecords[ir].stride + f->off;
+	      for(i=0; i<f->count; i++)
+		{
+		  switch(f->type)
+		    {
+		    case VTP_CB_WORD:
+		      ((uint32_t *)dst)[i] = VTP_CB_GET(buf, k + i, swap);
+		      break;
+		    case VTP_CB_SHORT:
+		      ((unsigned short *)dst)[i] = VTP_CB_GET(buf, k + i, swap);
+		      break;
+		    case VTP_CB_BYTE:
+		      dst[i] = VTP_CB_GET(buf, k + i/4, swap) >> (24 - 8*(i & 3));
+		      break;
+		    }
+		}
+	      k += vtpCbFieldWords(f);
+	    }
+	  nrec++;
+	}
+
+      pos += 1 + n;
+    }
+
+  return nrec;
+}
+
+/* Print the records of a bank */
+void
+vtpConfigBankPrint(const uint32_t *buf, int nwords)
+{
+  uint32_t w;
+  int nw, swap, pos, n, ir, i;
+
+  nw = vtpCbHeader(buf, nwords, &swap);
+  if(nw == ERROR)
+    return;
+
+  printf("VTP config bank: version %d, %d words%s\n",
+	 VTP_CB_GET(buf, 1, swap) >> 16, nw, swap ? " (swapped)" : "");
+
+  pos = VTP_CB_GET(buf, 1, swap) & 0xFFFF;
+  while(pos < nw)
+    {
+      w = VTP_CB_GET(buf, pos, swap);
+      n = VTP_CFGBANK_REC_NWORDS(w);
+      if(pos + 1 + n > nw)
+	break;
+
+      ir = vtpCbFind(VTP_CFGBANK_REC_TAG(w));
+      printf("  %-14s %d: %d words", (ir >= 0) ? vtpCbRecords[ir].name : "unknown",
+	     VTP_CFGBANK_REC_INST(w), n);
+      for(i=0; i<n; i++)
+	printf("%s0x%08x", (i % 8) ? " " : "\n    ", VTP_CB_GET(buf, pos + 1 + i, swap));
+      printf("\n");
+
+      pos += 1 + n;
+    }
+}
+
 void
 vtpMon()
 {
@@ -3105,55 +5165,168 @@ vtpMon()
 /* Accessor functions for streaming config values */
 const char* vtpGetStatsHost(void)
 {
-  return vtpConf.streaming.stats_host;
+  return VTP_CONF_CUR->streaming.stats_host;
 }
 
 int vtpGetStatsPort(void)
 {
-  return vtpConf.streaming.stats_port;
+  return VTP_CONF_CUR->streaming.stats_port;
 }
 
 int vtpGetStatsInst(void)
 {
-  return vtpConf.streaming.stats_inst;
+  return VTP_CONF_CUR->streaming.stats_inst;
 }
 
 int vtpGetSyncPktLen(void)
 {
-  return vtpConf.streaming.sync_pkt_len;
+  return VTP_CONF_CUR->streaming.sync_pkt_len;
+}
+
+int vtpGetSyncRate(void)
+{
+  return VTP_CONF_CUR->streaming.sync_rate;
+}
+
+int vtpGetSyncDestCount(void)
+{
+  return VTP_CONF_CUR->streaming.nsync_dest;
+}
+
+int vtpGetSyncDest(int idest, const char **host, int *port, int *mask)
+{
+  const VTP_CONF *conf = VTP_CONF_CUR;
+
+  if(idest < 0 || idest >= conf->streaming.nsync_dest)
+    return ERROR;
+
+  if(host) *host = conf->streaming.sync_dest[idest].host;
+  if(port) *port = conf->streaming.sync_dest[idest].port;
+  if(mask) *mask = conf->streaming.sync_dest[idest].mask;
+
+  return OK;
 }
 
 int vtpGetNumConnections(void)
 {
-  return vtpConf.streaming.num_connections;
+  return VTP_CONF_CUR->streaming.num_connections;
+}
+
+int vtpGetStreamingBalance(void)
+{
+  return VTP_CONF_CUR->streaming.balance;
+}
+
+const char* vtpGetStreamingProfile(void)
+{
+  return VTP_CONF_CUR->streaming.profile;
+}
+
+int vtpGetStreamingHotReconfig(void)
+{
+  return VTP_CONF_CUR->streaming.hot_reconfig;
+}
+
+int vtpGetLinkSupervisor(void)
+{
+  return VTP_CONF_CUR->streaming.link_supervisor;
+}
+
+int vtpGetLinkFailover(void)
+{
+  return VTP_CONF_CUR->streaming.link_failover;
+}
+
+int vtpGetLinkStallMs(void)
+{
+  return VTP_CONF_CUR->streaming.link_stall_ms;
+}
+
+int vtpGetFrameLenAdapt(void)
+{
+  return VTP_CONF_CUR->streaming.framelen_adapt;
+}
+
+int vtpGetFrameLenTarget(void)
+{
+  return VTP_CONF_CUR->streaming.framelen_target;
+}
+
+int vtpGetFrameLenMaxNs(void)
+{
+  return VTP_CONF_CUR->streaming.framelen_max_ns;
+}
+
+const char* vtpGetFrameLenState(void)
+{
+  return VTP_CONF_CUR->streaming.framelen_state;
+}
+
+int vtpGetMtuProbePort(void)
+{
+  return VTP_CONF_CUR->streaming.mtu_probe_port;
+}
+
+int vtpGetMtuProbeTimeout(void)
+{
+  return VTP_CONF_CUR->streaming.mtu_probe_timeout;
+}
+
+int vtpGetMtuProbeMax(void)
+{
+  return VTP_CONF_CUR->streaming.mtu_probe_max;
+}
+
+/* Standby destination of stream (0-3). Returns ERROR if none is configured */
+int vtpGetLinkStandby(int stream, unsigned char ip[4], int *port)
+{
+  const VTP_CONF *conf = VTP_CONF_CUR;
+
+  if((stream < 0) || (stream > 3) || !(conf->streaming.standby_mask & (1<<stream)))
+    return ERROR;
+
+  memcpy(ip, conf->streaming.standby_ip[stream], 4);
+  *port = conf->streaming.standby_port[stream];
+
+  return OK;
 }
 
 int vtpGetNetMode(void)
 {
-  return vtpConf.streaming.net_mode;
+  return VTP_CONF_CUR->streaming.net_mode;
 }
 
 int vtpGetEnableEjfat(void)
 {
-  return vtpConf.streaming.enable_ejfat;
+  return VTP_CONF_CUR->streaming.enable_ejfat;
 }
 
 int vtpGetLocalPort(void)
 {
-  return vtpConf.streaming.local_port;
+  return VTP_CONF_CUR->streaming.local_port;
 }
 
 const char* vtpGetFirmwareZ7(void)
 {
-  return vtpConf.fw_filename_z7;
+  return VTP_CONF_CUR->fw_filename_z7;
 }
 
 const char* vtpGetFirmwareV7(void)
 {
-  return vtpConf.fw_filename_v7;
+  return VTP_CONF_CUR->fw_filename_v7;
 }
 
 const int* vtpGetPayloadEnableArray(void)
 {
-  return vtpConf.streaming.payload_en_array;
+  return VTP_CONF_CUR->streaming.payload_en_array;
+}
+
+/* Copy of the parsed config, e.g. to compare two parses */
+int vtpGetConf(VTP_CONF *conf)
+{
+  if(conf == NULL)
+    return ERROR;
+
+  memcpy(conf, VTP_CONF_CUR, sizeof(VTP_CONF));
+  return OK;
 }
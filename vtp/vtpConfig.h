@@ -15,6 +15,58 @@
 #define STRLEN    250       /* length of str_tmp */
 #define ROCLEN     80       /* length of ROC_name */
 
+/* vtpDownloadAll() modes (VTP_DOWNLOAD_MODE, vtpSetDownloadMode()) */
+#define VTP_DOWNLOAD_FULL    0  /* write every setting */
+#define VTP_DOWNLOAD_DIFF    1  /* write the settings changed since the last download */
+#define VTP_DOWNLOAD_VERIFY  2  /* read back first, rewrite what drifted */
+
+/* First line of generated config files: stamp and 64 bit FNV-1a (16 hex
+   digits) of the rest of the file */
+#define VTP_CONFIG_HASH_STAMP  "# CONFIG_HASH fnv1a64"
+
+/* Binary configuration bank (vtpConfigBankBuild()), 32 bit words:
+     magic, version<<16 | header words, total words, then records of
+     VTP_CFGBANK_REC() + data words.  Unknown records are skipped, so
+     newer banks decode with older tools */
+#define VTP_CFGBANK_MAGIC      0x56434647   /* "VCFG" */
+#define VTP_CFGBANK_VERSION    2
+#define VTP_CFGBANK_HDR_WORDS  3
+#define VTP_CFGBANK_MAXWORDS   1024
+#define VTP_CFGBANK_REC(tag, inst, nwords)  (((tag)<<24) | (((inst)&0xFF)<<16) | ((nwords)&0xFFFF))
+#define VTP_CFGBANK_REC_TAG(w)     (((w)>>24) & 0xFF)
+#define VTP_CFGBANK_REC_INST(w)    (((w)>>16) & 0xFF)
+#define VTP_CFGBANK_REC_NWORDS(w)  ((w) & 0xFFFF)
+
+enum
+{
+  VTP_CFGBANK_FW = 1,        /* fw_rev[2], fw_type[2] */
+  VTP_CFGBANK_WINDOW,        /* window_width, window_offset */
+  VTP_CFGBANK_PAYLOAD_EN,
+  VTP_CFGBANK_FIBER_EN,
+  VTP_CFGBANK_EC,            /* trigger types: the members of the VTP_CONF struct in order,
+				arrays of structs in their own records */
+  VTP_CFGBANK_PC,
+  VTP_CFGBANK_HTCC,
+  VTP_CFGBANK_FTOF,
+  VTP_CFGBANK_CND,
+  VTP_CFGBANK_PCS,
+  VTP_CFGBANK_ECS,
+  VTP_CFGBANK_GT,
+  VTP_CFGBANK_DC,            /* dcsegfind_threshold[2], roadid (bytes) */
+  VTP_CFGBANK_HCAL,
+  VTP_CFGBANK_FTCAL,
+  VTP_CFGBANK_FTHODO,
+  VTP_CFGBANK_HPS,
+  VTP_CFGBANK_COMPTON,
+  VTP_CFGBANK_STREAMING,     /* roc_id, nframe_buf, frame_len */
+  VTP_CFGBANK_STREAMING_EB,  /* inst = EB: mask_en, nstreams, connect, ipaddr, subnet,
+				gateway, mac (2 words), destip, destipport, localport */
+  VTP_CFGBANK_GT_TRGBIT,     /* inst = trigger bit: gt.trgbits[] */
+  VTP_CFGBANK_HPS_SINGLE,    /* inst = trigger: hps.single_trig[] */
+  VTP_CFGBANK_HPS_PAIR,      /* inst = trigger: hps.pair_trig[] */
+  VTP_CFGBANK_HPS_MULT       /* inst = trigger: hps.mult_trig[] */
+};
+
 typedef struct
 {
   int ssp_strigger_bit_mask[2];
@@ -123,6 +175,8 @@ typedef struct {
   int payload_en;
   int fiber_en;
 
+  int download_mode;   /* VTP_DOWNLOAD_FULL, VTP_DOWNLOAD_DIFF (| VTP_DOWNLOAD_VERIFY) */
+
   struct
   {
     int roc_id;
@@ -148,11 +202,35 @@ typedef struct {
     int stats_port;           /* UDP stats destination port (1-65535) */
     int stats_inst;           /* Stream instance to sample (0-3) */
     int sync_pkt_len;         /* Sync packet length in bytes */
+    int sync_rate;            /* Sync packet rate (1-1000 Hz) */
+    int nsync_dest;           /* Number of VTP_SYNC_DEST entries (0: use stats_host) */
+    struct
+    {
+      char host[FNLEN];
+      int port;
+      int mask;               /* Streams reported to this destination */
+    } sync_dest[VTP_SYNC_MAX_DEST];
     int num_connections;      /* Number of VTP network streams (1-4) */
     int net_mode;             /* Network mode: 0=TCP, 1=UDP */
     int enable_ejfat;         /* Enable EJFAT headers: 0=off, 1=on */
     int local_port;           /* Local port base (0-65535) */
     int payload_en_array[16]; /* Payload enable array (payload 1-16): 0=disabled, 1=enabled */
+    int balance;              /* Payload to stream balancing: 0=off, 1=on, 2=on, profile fixed */
+    char profile[FNLEN];      /* Payload volume profile file for balancing */
+    int hot_reconfig;         /* Prestart only reconfigures changed streams: 0=off, 1=on */
+    int link_supervisor;      /* Link supervisor during the run: 0=off, 1=on */
+    int link_failover;        /* 0=alarm only, 1=remap payloads, 2=standby destination */
+    int link_stall_ms;        /* No frames sent for this long = stalled link */
+    int standby_mask;         /* Streams with a standby destination */
+    unsigned char standby_ip[4][4];
+    int standby_port[4];
+    int framelen_adapt;       /* Select the frame length at Prestart: 0=off, 1=on */
+    int framelen_target;      /* Target bytes per stream and frame */
+    int framelen_max_ns;      /* Latency bound for the frame length */
+    char framelen_state[FNLEN]; /* Rates of the last run for the frame length selection */
+    int mtu_probe_port;       /* Echo port for the path MTU probe: 0=off */
+    int mtu_probe_timeout;    /* ms to wait for each probe echo */
+    int mtu_probe_max;        /* Largest MTU probed: 0=firmware MTU (8000 UDP, 1500 TCP) */
   } streaming;
 
   struct
@@ -368,8 +446,16 @@ void vtpSetExpid(char *string);
 void vtpInitGlobals();
 int vtpReadConfigFile(char *filename);
 int vtpDownloadAll();
+int vtpSetDownloadMode(int mode);
+void vtpDownloadShadowClear();
+int vtpConfigDownloaded();
 int vtpUploadAll(char *string, int length);
+int vtpConfigBankEncode(const VTP_CONF *conf, uint32_t *buf, int maxwords);
+int vtpConfigBankBuild(uint32_t *buf, int maxwords);
+int vtpConfigBankDecode(const uint32_t *buf, int nwords, VTP_CONF *conf);
+void vtpConfigBankPrint(const uint32_t *buf, int nwords);
 int vtpConfig(char *fname);
+const VTP_CONF *vtpConfigLoad(const char *fname);
 void vtpMon();
 
 /* Accessor functions for streaming config values */
@@ -377,12 +463,30 @@ const char* vtpGetStatsHost(void);
 int vtpGetStatsPort(void);
 int vtpGetStatsInst(void);
 int vtpGetSyncPktLen(void);
+int vtpGetSyncRate(void);
+int vtpGetSyncDestCount(void);
+int vtpGetSyncDest(int idest, const char **host, int *port, int *mask);
 int vtpGetNumConnections(void);
+int vtpGetStreamingBalance(void);
+const char* vtpGetStreamingProfile(void);
+int vtpGetStreamingHotReconfig(void);
+int vtpGetLinkSupervisor(void);
+int vtpGetLinkFailover(void);
+int vtpGetLinkStallMs(void);
+int vtpGetLinkStandby(int stream, unsigned char ip[4], int *port);
+int vtpGetFrameLenAdapt(void);
+int vtpGetFrameLenTarget(void);
+int vtpGetFrameLenMaxNs(void);
+const char* vtpGetFrameLenState(void);
+int vtpGetMtuProbePort(void);
+int vtpGetMtuProbeTimeout(void);
+int vtpGetMtuProbeMax(void);
 int vtpGetNetMode(void);
 int vtpGetEnableEjfat(void);
 int vtpGetLocalPort(void);
 const char* vtpGetFirmwareZ7(void);
 const char* vtpGetFirmwareV7(void);
 const int* vtpGetPayloadEnableArray(void);
+int vtpGetConf(VTP_CONF *conf);
 
 #endif
@@ -31,7 +31,13 @@
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <time.h>
+#include <math.h>
+#include <signal.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
 #ifdef IPC
 #include "ipc.h"
 #endif
@@ -56,6 +62,7 @@ struct shared_memory_struct
   pthread_mutexattr_t m_attr;
   VTPSHMDATA vtp;
   uint32_t shmSize;
+  VTP_TELEMETRY_RING telemetry;
 };
 struct shared_memory_struct *p_sync=NULL;
 /* mmap'd address of shared memory mutex */
@@ -80,6 +87,12 @@ pthread_mutex_t   vtpMutex = PTHREAD_MUTEX_INITIALIZER;
 #define VLOCK     if(pthread_mutex_lock(&vtpMutex)<0) perror("pthread_mutex_lock");
 #define VUNLOCK   if(pthread_mutex_unlock(&vtpMutex)<0) perror("pthread_mutex_unlock");
 
+/* Mutex to keep the events written to the streaming EB async FIFO whole.
+   Held for a whole event, taken before VLOCK */
+pthread_mutex_t   vtpAsyncMutex = PTHREAD_MUTEX_INITIALIZER;
+#define ALOCK     if(pthread_mutex_lock(&vtpAsyncMutex)<0) perror("pthread_mutex_lock");
+#define AUNLOCK   if(pthread_mutex_unlock(&vtpAsyncMutex)<0) perror("pthread_mutex_unlock");
+
 #define CHECKINIT {						\
     if(vtp == NULL) {						\
       printf("%s: ERROR: VTP not initialized\n",__func__);	\
@@ -371,19 +384,19 @@ vtpStatus(int pflag)
 int
 vtpStats()
 {
-  int status, fw_version, fw_type, timestamp, temp, mig[2][2], i, rtime;
+  int status, fw_version, fw_type, timestamp, temp, i, rtime;
   float t, pNum;
-  unsigned int ebiorx[2][2];
-  unsigned int pSent[4][2], fSent[4][2], bSent[4][2];     // counts out each network port
-  unsigned int tcp_ctrl,tcp_state, tcp_mtu, tcp_status, tcp_ipstatus;
-  unsigned int ppmask, ppcfg[16], fcnt[4];
-  int ebstatus, ebctrl[3];
-  int mig_cnts[2][4];
+  unsigned int ppmask=0, ppcfg[16];
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_PORT *p;
 
   CHECKINIT;
 
   rtime = time(NULL);
-  
+
+  /* Counters and link state are read lock free */
+  vtpStreamingSnapshot(&snap);
+
   VLOCK;
   status     = vtp->v7.clk.Status;
   fw_version = vtp->v7.clk.FW_Version;
@@ -391,58 +404,9 @@ vtpStats()
   timestamp  = vtp->v7.clk.Timestamp;
   temp       = vtp->v7.clk.Temp;
 
-  tcp_ctrl   = vtp->tcpClient[0].Ctrl;
-  tcp_status = vtp->tcpClient[0].Status;
-  tcp_mtu    = vtp->tcpClient[0].MTU;
-  tcp_state  = vtp->tcpClient[0].IP4_TCPStateStatus;
-  tcp_ipstatus = vtp->tcpClient[0].IP4_TCPStatus;
-
-  for(i=0;i<2;i++) {
-    mig[i][0]        = vtp->v7.mig[i].Ctrl;
-    mig[i][1]        = vtp->v7.mig[i].Status;
-    mig_cnts[i][0]   = vtp->v7.mig[i].WriteCnt;
-    mig_cnts[i][1]   = vtp->v7.mig[i].ReadCnt;
-    mig_cnts[i][2]   = vtp->v7.mig[i].WriteDataCnt;
-    mig_cnts[i][3]   = vtp->v7.mig[i].ReadDataCnt;
-
-    ebiorx[i][0]     = vtp->ebiorx[i].Ctrl;
-    ebiorx[i][1]     = vtp->ebiorx[i].Status;
-  }
-
-  // Collect data counters for each Network output port (from Ebiorx registers)
-  for(i=0;i<4;i++) {
-
-    /* Get EB frame counters.*/
-    fcnt[i] = vtp->v7.streamingEb.FrameCnt[i];
-
-    if((i==0)||(i==1)) {
-      pSent[i][0]    = vtp->ebiorx[0].pkts_sent[i][0];
-      pSent[i][1]    = vtp->ebiorx[0].pkts_sent[i][1];
-      fSent[i][0]    = vtp->ebiorx[0].frames_sent[i][0];
-      fSent[i][1]    = vtp->ebiorx[0].frames_sent[i][1];
-      bSent[i][0]    = vtp->ebiorx[0].bytes_sent[i][0];
-      bSent[i][1]    = vtp->ebiorx[0].bytes_sent[i][1];
-    }else{
-      pSent[i][0]    = vtp->ebiorx[1].pkts_sent[i-2][0];
-      pSent[i][1]    = vtp->ebiorx[1].pkts_sent[i-2][1];
-      fSent[i][0]    = vtp->ebiorx[1].frames_sent[i-2][0];
-      fSent[i][1]    = vtp->ebiorx[1].frames_sent[i-2][1];
-      bSent[i][0]    = vtp->ebiorx[1].bytes_sent[i-2][0];
-      bSent[i][1]    = vtp->ebiorx[1].bytes_sent[i-2][1];
-    }
-
-  }
-
-
-
   if(VTP_FW_Type[0] == VTP_FW_TYPE_FADCSTREAM)
     {
-      ebctrl[0]  = vtp->v7.streamingEb.Ctrl;
-      ppmask = ebctrl[0]&0xffff;
-      ebstatus   = vtp->v7.streamingEb.Status;
-      ebctrl[1]  = vtp->v7.streamingEb.rocid;
-      ebctrl[2]  = vtp->v7.streamingEb.Ctrl3;
-
+      ppmask = snap.eb_ctrl&0xffff;
       for(i=0;i<16;i++) {
 	ppcfg[i] = vtp->v7.streamingEb.pp_cfg[i];
       }
@@ -473,31 +437,32 @@ vtpStats()
         ((rtime>>12)&0x1f), ((rtime>>6)&0x3f), ((rtime>>0)&0x3f)
       );
 
+    p = &snap.port[0];
     printf("\n");
     printf("TCP LINK 0 Status:\n");
-    printf("    Ctrl            = %08x  (MTU=%d)\n",tcp_ctrl,tcp_mtu);
-    if(tcp_status&0x80000000)
-      printf("    Status          = %08x  (Client Mode)\n",tcp_status);
+    printf("    Ctrl            = %08x  (MTU=%d)\n",p->tcp_ctrl,p->tcp_mtu);
+    if(p->tcp_status&0x80000000)
+      printf("    Status          = %08x  (Client Mode)\n",p->tcp_status);
     else
-      printf("    Status          = %08x  (Server Mode)\n",tcp_status);
-    printf("    State           = %08x\n",tcp_state);
-    if(tcp_ipstatus)
-      printf("    Status          = %08x  (Connected)\n",tcp_ipstatus);
+      printf("    Status          = %08x  (Server Mode)\n",p->tcp_status);
+    printf("    State           = %08x\n",p->tcp_state);
+    if(p->tcp_ipstatus)
+      printf("    Status          = %08x  (Connected)\n",p->tcp_ipstatus);
     else
-      printf("    Status          = %08x  (No connection)\n",tcp_ipstatus);
+      printf("    Status          = %08x  (No connection)\n",p->tcp_ipstatus);
 
     printf("\n");
     printf("Event Building:\n");
-    printf("    MIG  Control            : %08X %08x\n", mig[0][0], mig[1][0]);
-    printf("    MIG calibration complete: %8d %8d\n", mig[0][1], mig[1][1]);
-    printf("    EBIORX Control          : %08X %08X\n",ebiorx[0][0], ebiorx[1][0]);
+    printf("    MIG  Control            : %08X %08x\n", snap.mig_ctrl[0], snap.mig_ctrl[1]);
+    printf("    MIG calibration complete: %8d %8d\n", snap.mig_status[0], snap.mig_status[1]);
+    printf("    EBIORX Control          : %08X %08X\n",snap.ebiorx_ctrl[0], snap.ebiorx_ctrl[1]);
 
     if(VTP_FW_Type[0] == VTP_FW_TYPE_FADCSTREAM) {
-      printf("    EB Control : 0x%08X\n", ebctrl[0]);
-      printf("    EB Control2: 0x%08X\n", ebctrl[1]);
-      printf("    EB Control3: 0x%08X\n", ebctrl[2]);
-      printf("    EB Status  : 0x%08X\n", ebstatus);
-      printf("    EB FrameCnt: 0x%08X\n", fcnt[0]);
+      printf("    EB Control : 0x%08X\n", snap.eb_ctrl);
+      printf("    EB Control2: 0x%08X\n", snap.eb_rocid);
+      printf("    EB Control3: 0x%08X\n", snap.eb_ctrl3);
+      printf("    EB Status  : 0x%08X\n", snap.eb_status);
+      printf("    EB FrameCnt: 0x%08X\n", snap.port[0].frame_cnt);
 
       for(i=0;i<16;i++) {
 	if(ppmask&(1<<i))
@@ -505,25 +470,26 @@ vtpStats()
       }   
 
       printf("\n");
-      for(i=0;i<(ebctrl[2]&0x7);i++) {
-	pNum = (float)pSent[i][0]/(float)fSent[i][0];
-	printf("    NET Output Port %d   Frames : %u (%u)\n",i,fSent[i][0],fcnt[i]);
-	printf("    NET Output Port %d   Packets: %u (%6.2f pkts/frame)\n",i,pSent[i][0],pNum);
-	printf("    NET Output Port %d   Bytes  : 0x%08x%08x \n",i,bSent[i][1],bSent[i][0]);
+      for(i=0;i<snap.nstreams;i++) {
+	p = &snap.port[i];
+	pNum = (p->frames_sent) ? (float)p->pkts_sent/(float)p->frames_sent : 0.0;
+	printf("    NET Output Port %d   Frames : %llu (%u)\n",i,
+	       (unsigned long long)p->frames_sent,p->frame_cnt);
+	printf("    NET Output Port %d   Packets: %llu (%6.2f pkts/frame)\n",i,
+	       (unsigned long long)p->pkts_sent,pNum);
+	printf("    NET Output Port %d   Bytes  : 0x%012llx \n",i,
+	       (unsigned long long)p->bytes_sent);
 	printf("\n");
       }
     }
 
-    printf("    MIG0 WriteCnt: %u\n",     mig_cnts[0][0]);
-    printf("    MIG0 ReadCnt: %u\n",      mig_cnts[0][1]);
-    printf("    MIG0 WriteDataCnt: %u\n", mig_cnts[0][2]);
-    printf("    MIG0 ReadDataCnt: %u\n",  mig_cnts[0][3]);
-    printf("\n");
-    printf("    MIG1 WriteCnt: %u\n",     mig_cnts[1][0]);
-    printf("    MIG1 ReadCnt: %u\n",      mig_cnts[1][1]);
-    printf("    MIG1 WriteDataCnt: %u\n", mig_cnts[1][2]);
-    printf("    MIG1 ReadDataCnt: %u\n",  mig_cnts[1][3]);
-    printf("\n");
+    for(i=0;i<2;i++) {
+      printf("    MIG%d WriteCnt: %u\n",     i, snap.mig_write_cnt[i]);
+      printf("    MIG%d ReadCnt: %u\n",      i, snap.mig_read_cnt[i]);
+      printf("    MIG%d WriteDataCnt: %u\n", i, snap.mig_write_data_cnt[i]);
+      printf("    MIG%d ReadDataCnt: %u\n",  i, snap.mig_read_data_cnt[i]);
+      printf("\n");
+    }
 
   return(OK);
 }
@@ -534,147 +500,83 @@ vtpStats()
 int
 vtpNetStats()
 {
-  int mig[2][2], i, j;
+  int i, nstreams=1;
   float pNum;
-  unsigned int netmode[2], ebiorx[2][2];
-  unsigned int pSent[4][2], fSent[4][2], bSent[4][2];     // counts out each network port
-  unsigned int tcp_ctrl[4],tcp_state[4], tcp_mtu[4], tcp_status[4], tcp_ipstatus[4];
-  unsigned int mac_status [4][4], pcs_status[4], phy_status[4], linkUp[4];
-  int ebstatus, ebctrl[3], nstreams=1;
-  int mig_cnts[2][4];
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_PORT *p;
 
   CHECKINIT;
 
-  
-  VLOCK;
-
-  for(i=0;i<4;i++) {
-    tcp_ctrl[i]     = vtp->tcpClient[i].Ctrl;
-    tcp_status[i]   = vtp->tcpClient[i].Status;
-    tcp_mtu[i]      = vtp->tcpClient[i].MTU;
-    tcp_state[i]    = vtp->tcpClient[i].IP4_TCPStateStatus;
-    tcp_ipstatus[i] = vtp->tcpClient[i].IP4_TCPStatus;
-    pcs_status[i]   = vtp->tcpClient[i].PCS_STATUS;
-    phy_status[i]   = vtp->tcpClient[i].PHY_STATUS;
-    linkUp[i] = pcs_status[i]&0x00000001;  /* Network Link status */
-    for(j=0;j<4;j++) {
-      mac_status[i][j] = vtp->tcpClient[i].MAC_STATUS[j];
-    }
-  }
-
-  for(i=0;i<2;i++) {
-    mig[i][0]        = vtp->v7.mig[i].Ctrl;
-    mig[i][1]        = vtp->v7.mig[i].Status;
-    mig_cnts[i][0]   = vtp->v7.mig[i].WriteCnt;
-    mig_cnts[i][1]   = vtp->v7.mig[i].ReadCnt;
-    mig_cnts[i][2]   = vtp->v7.mig[i].WriteDataCnt;
-    mig_cnts[i][3]   = vtp->v7.mig[i].ReadDataCnt;
-
-    ebiorx[i][0]     = vtp->ebiorx[i].Ctrl;
-    ebiorx[i][1]     = vtp->ebiorx[i].Status;
-    if((ebiorx[i][0])&0x100)
-      netmode[i] = 1;     /* netmode>0  UDP */
-    else
-      netmode[i] = 0;     // TCP
-  }
-
-  // Collect data counters for each Network output port (from Ebiorx registers)
-  for(i=0;i<4;i++) {
-
-    if((i==0)||(i==1)) {
-      pSent[i][0]    = vtp->ebiorx[0].pkts_sent[i][0];
-      pSent[i][1]    = vtp->ebiorx[0].pkts_sent[i][1];
-      fSent[i][0]    = vtp->ebiorx[0].frames_sent[i][0];
-      fSent[i][1]    = vtp->ebiorx[0].frames_sent[i][1];
-      bSent[i][0]    = vtp->ebiorx[0].bytes_sent[i][0];
-      bSent[i][1]    = vtp->ebiorx[0].bytes_sent[i][1];
-    }else{
-      pSent[i][0]    = vtp->ebiorx[1].pkts_sent[i-2][0];
-      pSent[i][1]    = vtp->ebiorx[1].pkts_sent[i-2][1];
-      fSent[i][0]    = vtp->ebiorx[1].frames_sent[i-2][0];
-      fSent[i][1]    = vtp->ebiorx[1].frames_sent[i-2][1];
-      bSent[i][0]    = vtp->ebiorx[1].bytes_sent[i-2][0];
-      bSent[i][1]    = vtp->ebiorx[1].bytes_sent[i-2][1];
-
-    }
-
-  }
-
+  vtpStreamingSnapshot(&snap);
   if(VTP_FW_Type[0] == VTP_FW_TYPE_FADCSTREAM)
     {
-      ebctrl[0]  = vtp->v7.streamingEb.Ctrl;
-      ebstatus   = vtp->v7.streamingEb.Status;
-      ebctrl[1]  = vtp->v7.streamingEb.rocid;
-      ebctrl[2]  = vtp->v7.streamingEb.Ctrl3;
-      nstreams = ebctrl[2]&0x7;
+      nstreams = snap.nstreams;
     }
 
-  VUNLOCK;
-
     printf("---------------------------------------\n");
     printf("--VTP NETWORK Statistics             --\n");
     printf("---------------------------------------\n");
 
 
     for(i=0;i<nstreams;i++) {
+      p = &snap.port[i];
       printf("\n");
       printf("NETWORK LINK %d Status:\n",i);
-      printf("    Ctrl            = %08x  (MTU=%d)\n",tcp_ctrl[i], tcp_mtu[i]);
-      if(tcp_status[i]&0x80000000)
-	printf("    Status          = %08x  (Client Mode)\n",tcp_status[i]);
+      printf("    Ctrl            = %08x  (MTU=%d)\n",p->tcp_ctrl, p->tcp_mtu);
+      if(p->tcp_status&0x80000000)
+	printf("    Status          = %08x  (Client Mode)\n",p->tcp_status);
       else
-	printf("    Status          = %08x  (Server Mode)\n",tcp_status[i]);
-      printf("    State           = %08x\n",tcp_state[i]);
-      if(tcp_ipstatus[i])
-	printf("    Status          = %08x  (Connected)\n",tcp_ipstatus[i]);
+	printf("    Status          = %08x  (Server Mode)\n",p->tcp_status);
+      printf("    State           = %08x\n",p->tcp_state);
+      if(p->tcp_ipstatus)
+	printf("    Status          = %08x  (Connected)\n",p->tcp_ipstatus);
       else
-	printf("    Status          = %08x  (No connection)\n",tcp_ipstatus[i]);
+	printf("    Status          = %08x  (No connection)\n",p->tcp_ipstatus);
       printf("    MAC Status      = 0x%x 0x%x 0x%x 0x%x\n",
-	     mac_status[i][0],mac_status[i][1],mac_status[i][2],mac_status[i][3]);
-      if(linkUp[i])
-	printf("    PCS Status      = 0x%08x (Link Up)\n",pcs_status[i]);
+	     p->mac_status[0],p->mac_status[1],p->mac_status[2],p->mac_status[3]);
+      if(p->link_up)
+	printf("    PCS Status      = 0x%08x (Link Up)\n",p->pcs_status);
       else
-	printf("    PCS Status      = 0x%08x (No link)\n",pcs_status[i]);
+	printf("    PCS Status      = 0x%08x (No link)\n",p->pcs_status);
 	
-      printf("    PHY Status      = 0x%08x\n",phy_status[i]);
+      printf("    PHY Status      = 0x%08x\n",p->phy_status);
     }
 
       
     printf("\n");
     printf("Event Building:\n");
-    printf("    MIG  Control            : %08X %08x\n", mig[0][0], mig[1][0]);
-    printf("    MIG calibration complete: %8d %8d\n", mig[0][1], mig[1][1]);
-    if(netmode[0])
-      printf("    EBIORX Control          : %08X %08X (UDP)\n",ebiorx[0][0], ebiorx[1][0]);
+    printf("    MIG  Control            : %08X %08x\n", snap.mig_ctrl[0], snap.mig_ctrl[1]);
+    printf("    MIG calibration complete: %8d %8d\n", snap.mig_status[0], snap.mig_status[1]);
+    if(snap.port[0].udp)
+      printf("    EBIORX Control          : %08X %08X (UDP)\n",snap.ebiorx_ctrl[0], snap.ebiorx_ctrl[1]);
     else
-      printf("    EBIORX Control          : %08X %08X (TCP)\n",ebiorx[0][0], ebiorx[1][0]);
+      printf("    EBIORX Control          : %08X %08X (TCP)\n",snap.ebiorx_ctrl[0], snap.ebiorx_ctrl[1]);
 
     if(VTP_FW_Type[0] == VTP_FW_TYPE_FADCSTREAM) {
-      printf("    EB Control : 0x%08X\n", ebctrl[0]);
-      printf("    EB Control2: 0x%08X\n", ebctrl[1]);
-      printf("    EB Control3: 0x%08X\n", ebctrl[2]);
-      printf("    EB Status  : 0x%08X\n", ebstatus);
+      printf("    EB Control : 0x%08X\n", snap.eb_ctrl);
+      printf("    EB Control2: 0x%08X\n", snap.eb_rocid);
+      printf("    EB Control3: 0x%08X\n", snap.eb_ctrl3);
+      printf("    EB Status  : 0x%08X\n", snap.eb_status);
 
       printf("\n");
       for(i=0;i<nstreams;i++) {
-	pNum = (float)pSent[i][0]/(float)fSent[i][0];
-	printf("    NET Output Port %d   Frames : %u \n",i,fSent[i][0]);
-	printf("    NET Output Port %d   Packets: %u (%6.2f pkts/frame)\n",i,pSent[i][0],pNum);
-	printf("    NET Output Port %d   Bytes  : 0x%08x%08x \n",i,bSent[i][1],bSent[i][0]);
+	p = &snap.port[i];
+	pNum = (p->frames_sent) ? (float)p->pkts_sent/(float)p->frames_sent : 0.0;
+	printf("    NET Output Port %d   Frames : %llu \n",i,(unsigned long long)p->frames_sent);
+	printf("    NET Output Port %d   Packets: %llu (%6.2f pkts/frame)\n",i,
+	       (unsigned long long)p->pkts_sent,pNum);
+	printf("    NET Output Port %d   Bytes  : 0x%012llx \n",i,(unsigned long long)p->bytes_sent);
 	printf("\n");
       }
     }
 
-    printf("    MIG0 WriteCnt: %u\n",     mig_cnts[0][0]);
-    printf("    MIG0 ReadCnt: %u\n",      mig_cnts[0][1]);
-    printf("    MIG0 WriteDataCnt: %u\n", mig_cnts[0][2]);
-    printf("    MIG0 ReadDataCnt: %u\n",  mig_cnts[0][3]);
-    printf("\n");
-    printf("    MIG1 WriteCnt: %u\n",     mig_cnts[1][0]);
-    printf("    MIG1 ReadCnt: %u\n",      mig_cnts[1][1]);
-    printf("    MIG1 WriteDataCnt: %u\n", mig_cnts[1][2]);
-    printf("    MIG1 ReadDataCnt: %u\n",  mig_cnts[1][3]);
-    printf("\n");
+    for(i=0;i<2;i++) {
+      printf("    MIG%d WriteCnt: %u\n",     i, snap.mig_write_cnt[i]);
+      printf("    MIG%d ReadCnt: %u\n",      i, snap.mig_read_cnt[i]);
+      printf("    MIG%d WriteDataCnt: %u\n", i, snap.mig_write_data_cnt[i]);
+      printf("    MIG%d ReadDataCnt: %u\n",  i, snap.mig_read_data_cnt[i]);
+      printf("\n");
+    }
 
   return(OK);
 
@@ -1047,21 +949,11 @@ vtpSerdesCheckLinks()
   return chmask;
 }
 
-int
-vtpSerdesStatus(int type, uint16_t dev, int pflag, int data[NSERDES])
+/* Payload port / fiber enable mask of the loaded V7 firmware
+   (VXS in bits 0-15, QSFP in bits 16-19) */
+static uint32_t
+vtpSerdesEnableMask()
 {
-  volatile SERDES_REGS *sdev;
-  uint32_t status = 0, ctrl = 0, ctrl2, latency = 0;
-  uint32_t chmask = 0;
-  int index;
-  CHECKINIT;
-  CHECKTYPEDEV;
-
-
-  VLOCK;
-  ctrl2 = sdev->Ctrl;
-  status = sdev->Status;
-  latency = sdev->Latency;
   switch(VTP_FW_Type[0])
     {
     case VTP_FW_TYPE_ECS:
@@ -1074,24 +966,76 @@ vtpSerdesStatus(int type, uint16_t dev, int pflag, int data[NSERDES])
     case VTP_FW_TYPE_FTHODO:
     case VTP_FW_TYPE_HPS:
     case VTP_FW_TYPE_COMPTON:
-      ctrl = vtp->v7.fadcDec.Ctrl;
-      break;
+      return vtp->v7.fadcDec.Ctrl;
     case VTP_FW_TYPE_GT:
-      ctrl = vtp->v7.sspDec.Ctrl;
-      break;
+      return vtp->v7.sspDec.Ctrl;
     case VTP_FW_TYPE_DC:
-      ctrl = vtp->v7.dcrbDec.Ctrl;
-      break;
+      return vtp->v7.dcrbDec.Ctrl;
     case VTP_FW_TYPE_HCAL:
-      ctrl = vtp->v7.hcal.Ctrl;
-      break;
+      return vtp->v7.hcal.Ctrl;
     case VTP_FW_TYPE_FTCAL:
-      ctrl = vtp->v7.ftcalDec.Ctrl;
-      break;
+      return vtp->v7.ftcalDec.Ctrl;
     case VTP_FW_TYPE_VCODAROC:   /* Check all 16 payload ports */
     case VTP_FW_TYPE_FADCSTREAM:
-      ctrl = 0xffff;
+      return 0xffff;
     }
+
+  return 0;
+}
+
+/* Status words of one serdes, as sent to EPICS */
+static void
+vtpSerdesData(int type, uint16_t dev, uint32_t status, uint32_t ctrl2,
+	      uint32_t latency, uint32_t ctrl, int data[NSERDES])
+{
+  int index = 0;
+
+  data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(0)) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(1)) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(2)) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(3)) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = (status & VTP_SERDES_STATUS_CHUP) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = (status & VTP_SERDES_STATUS_SOFT_ERR_CNT_MASK)>>24;
+  if(index>NSERDES) return;
+
+  data[index++] = (ctrl2 & VTP_SERDES_CTRL_GT_RESET) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  if(type == VTP_SERDES_VXS) data[index++] = (ctrl & (1<<dev)) ? 1 : 0;
+  else                       data[index++] = (ctrl & (1<<(dev+16))) ? 1 : 0;
+  if(index>NSERDES) return;
+
+  data[index++] = ((latency>>16)&0xFFFF)*4;
+  if(index>NSERDES) return;
+
+  data[index++] = ((latency>>0)&0xFFFF)*4;
+}
+
+int
+vtpSerdesStatus(int type, uint16_t dev, int pflag, int data[NSERDES])
+{
+  volatile SERDES_REGS *sdev;
+  uint32_t status = 0, ctrl = 0, ctrl2, latency = 0;
+  uint32_t chmask = 0;
+  CHECKINIT;
+  CHECKTYPEDEV;
+
+
+  VLOCK;
+  ctrl2 = sdev->Ctrl;
+  status = sdev->Status;
+  latency = sdev->Latency;
+  ctrl = vtpSerdesEnableMask();
   VUNLOCK;
 
   if(type == VTP_SERDES_VXS)
@@ -1143,38 +1087,7 @@ vtpSerdesStatus(int type, uint16_t dev, int pflag, int data[NSERDES])
     }
   else /* send */
     {
-      index = 0;
-
-      data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(0)) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(1)) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(2)) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (status & VTP_SERDES_STATUS_LANE_UP(3)) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (status & VTP_SERDES_STATUS_CHUP) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (status & VTP_SERDES_STATUS_SOFT_ERR_CNT_MASK)>>24;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = (ctrl2 & VTP_SERDES_CTRL_GT_RESET) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      if(type == VTP_SERDES_VXS) data[index++] = (ctrl & (1<<dev)) ? 1 : 0;
-      else                       data[index++] = (ctrl & (1<<(dev+16))) ? 1 : 0;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = ((latency>>16)&0xFFFF)*4;
-      if(index>NSERDES) return(OK);
-
-      data[index++] = ((latency>>0)&0xFFFF)*4;
-      if(index>NSERDES) return(OK);
+      vtpSerdesData(type, dev, status, ctrl2, latency, ctrl, data);
     }
 
   return OK;
@@ -1436,12 +1349,23 @@ vtpGetFW_Type(int chip)
 
 static unsigned int CfgCtrl_Shadow = 0x1F;
 
+/* Bumped whenever the register settings may have been lost (V7 reset,
+   firmware load).  vtpDownloadAll() drops its shadow when it changed. */
+static volatile unsigned int vtpHwGeneration = 1;
+
+unsigned int
+vtpGetHwGeneration()
+{
+  return vtpHwGeneration;
+}
+
 int
 vtpV7CtrlInit()
 {
   CHECKINIT;
 
   VLOCK;
+  vtpHwGeneration++;
   CfgCtrl_Shadow = 0x1F;
 
   vtp->v7.Ctrl = CfgCtrl_Shadow;
@@ -1457,7 +1381,10 @@ vtpV7SetReset(int val)
 
   VLOCK;
   if(val)
-    CfgCtrl_Shadow |= VTP_V7BRIDGE_CTRL_RESET;
+    {
+      CfgCtrl_Shadow |= VTP_V7BRIDGE_CTRL_RESET;
+      vtpHwGeneration++;
+    }
   else
     CfgCtrl_Shadow &= ~VTP_V7BRIDGE_CTRL_RESET;
 
@@ -1586,6 +1513,8 @@ int
 vtpV7CfgStart()
 {
   int i, result;
+
+  vtpHwGeneration++;
   vtpV7SetCSI_B(1);
   vtpV7SetProgram_B(1);
   vtpV7SetRDWR_B(0);	// Write Mode
@@ -1728,6 +1657,7 @@ vtpZ7CfgLoad(char *filename)
   fread(pBits, 1, len, f);
   fclose(f);
 
+  vtpHwGeneration++;
   fd = open("/dev/xdevcfg", O_WRONLY);
   if(fd < 1)
   {
@@ -1828,6 +1758,8 @@ vtpSendSerdes()
   char name[100];
   int data[NSERDES+1];
   int vxs_2_vmeslot[16] = {10,13,9,14,8,15,7,16,6,17,5,18,4,19,3,20};
+  VTP_TELEMETRY_RECORD rec;
+  struct timespec now;
   CHECKINIT;
 
   gethostname(host,sizeof(host));
@@ -1840,6 +1772,32 @@ vtpSendSerdes()
     }
   }
 
+  /* Take the serdes status from the telemetry ring while it is being
+     published (vtpserver), otherwise poll the registers */
+  clock_gettime(CLOCK_REALTIME, &now);
+  if((vtpTelemetryRead(&rec, 0) == OK) &&
+     ((((uint64_t)now.tv_sec)*1000000000ull + now.tv_nsec - rec.timestamp_ns) <
+      3ull*p_sync->telemetry.period_ms*1000000ull))
+    {
+      for(i = 0; i < 16; i++)
+	{
+	  sprintf(name, "%s_VTP_SERDES_SLOT%d", host, vxs_2_vmeslot[i]);
+	  vtpSerdesData(VTP_SERDES_VXS, i, rec.serdes_status[i], rec.serdes_ctrl[i],
+			rec.serdes_latency[i], rec.serdes_enable, data);
+	  epics_json_msg_send(name, "int", NSERDES, data);
+	}
+
+      for(i = 0; i < 4; i++)
+	{
+	  sprintf(name, "%s_VTP_SERDES_QSFP%d", host, i);
+	  vtpSerdesData(VTP_SERDES_QSFP, i, rec.serdes_status[16+i], rec.serdes_ctrl[16+i],
+			rec.serdes_latency[16+i], rec.serdes_enable, data);
+	  epics_json_msg_send(name, "int", NSERDES, data);
+	}
+
+      return r;
+    }
+
   vtpLock();
 
   for(i = 0; i < 16; i++)
@@ -2179,6 +2137,9 @@ vtpStreamingSetEbCfg(int mask, int nstreams, int frame_len, int roc_id, PP_CONF
 
   VUNLOCK;
 
+  /* Frame counters restart with the EB reset - restart the 64 bit frame clock too */
+  vtpStreamingFrameClockInit();
+
   return OK;
 }
 
@@ -2212,8 +2173,8 @@ vtpStreamingGetEbCfg(int *mask, int *nstreams, int *frame_len, int *roc_id)
 
   VLOCK;
   val = vtp->v7.streamingEb.Ctrl;
-  *mask = (val>>0) & 0xFF;
-  *frame_len = ((val>>16) & 0x3FFF)*4+4;
+  *mask = (val>>0) & 0xFFFF;
+  *frame_len = (((val>>16) & 0x3FFF)+1)*32;  /* ns, same units as vtpStreamingSetEbCfg */
 
   *nstreams = (vtp->v7.streamingEb.Ctrl3)&0x7;
 
@@ -2345,6 +2306,22 @@ vtpStreamingSetTcpCfg(
   return OK;
 }
 
+/* Path MTU of each stream lowered by vtpStreamingMtuTune(), 0: not tuned.
+   Kept across runs, so the hot reconfiguration compares and rewrites the
+   tuned value and not the default one. */
+static uint32_t vtpStreamingTunedMtu[VTP_STREAMING_MAX_STREAMS];
+
+static uint32_t
+vtpStreamingNetMtu(int inst, int mode)
+{
+  uint32_t mtu = mode ? VTP_TCPIP_MTU_JUMBO : VTP_TCPIP_MTU_DEFAULT;
+
+  if(vtpStreamingTunedMtu[inst] && (vtpStreamingTunedMtu[inst] < mtu))
+    mtu = vtpStreamingTunedMtu[inst];
+
+  return mtu;
+}
+
 /* Generic function to support both TCP and UDP transport */
 int
 vtpStreamingSetNetCfg(
@@ -2383,7 +2360,7 @@ vtpStreamingSetNetCfg(
 
 
   if(mode) {  /* We are doing UDP transport */
-    vtp->tcpClient[inst].MTU = VTP_TCPIP_MTU_JUMBO;
+    vtp->tcpClient[inst].MTU = vtpStreamingNetMtu(inst, mode);
     vtp->tcpClient[inst].TCP_DEST_ADDR[0] = 0;
     vtp->tcpClient[inst].TCP_PORT[0] = (localport)<<16;
     vtp->tcpClient[inst].UDP_DEST_ADDR = (destipaddr[0]<<24) | (destipaddr[1]<<16) | (destipaddr[2]<<8) | (destipaddr[3]<<0);
@@ -2391,7 +2368,7 @@ vtpStreamingSetNetCfg(
 	   destipaddr[0],destipaddr[1],destipaddr[2],destipaddr[3]);
     vtp->tcpClient[inst].UDP_PORT      = ( (localport+1)<<16 | destipport );
   }else{
-    vtp->tcpClient[inst].MTU = VTP_TCPIP_MTU_DEFAULT;
+    vtp->tcpClient[inst].MTU = vtpStreamingNetMtu(inst, mode);
     vtp->tcpClient[inst].UDP_DEST_ADDR = 0;
     vtp->tcpClient[inst].UDP_PORT = (localport+1)<<16;
     vtp->tcpClient[inst].TCP_DEST_ADDR[0] = (destipaddr[0]<<24) | (destipaddr[1]<<16) | (destipaddr[2]<<8) | (destipaddr[3]<<0);
@@ -2743,6 +2720,7 @@ vtpStreamingTcpConnect(int inst, int connect, unsigned int *cdata, int dlen)
   printf("%s(%d,%d,cdata,dlen)\n", __func__, inst, connect);
 
 
+  ALOCK;
   VLOCK;
   if(connect>0)
     {
@@ -2808,6 +2786,7 @@ vtpStreamingTcpConnect(int inst, int connect, unsigned int *cdata, int dlen)
       usleep(500000);
     }
   VUNLOCK;
+  AUNLOCK;
 
 
 
@@ -2831,6 +2810,7 @@ vtpStreamingEvioWriteControl(int inst, unsigned int type, unsigned int val0, uns
   }
 
 
+  ALOCK;
   VLOCK;
   rocid = vtp->v7.streamingEb.rocid;
   temp =  (vtp->v7.streamingEb.Ctrl3)&~VTP_STREB_AFIFO_MASK;
@@ -2869,6 +2849,7 @@ vtpStreamingEvioWriteControl(int inst, unsigned int type, unsigned int val0, uns
   else
     vtp->v7.streamingEb.CpuAsyncEventInfo = 15;
   VUNLOCK;
+  AUNLOCK;
 
   return OK;
 }
@@ -2877,7 +2858,9 @@ vtpStreamingEvioWriteControl(int inst, unsigned int type, unsigned int val0, uns
 void
 vtpStreamingAsyncInfoWrite(int val)
 {
+  ALOCK;
   vtp->v7.streamingEb.CpuAsyncEventInfo = val;
+  AUNLOCK;
 }
 
 
@@ -2927,10 +2910,42 @@ vtpStreamingTcpReset(int inst)
 }
 
 
+/* Read one of the 48 bit EBIORX counters ([0]=32L, [1]=16H).
+    The high word is read before and after the low word and the read is
+    repeated if a carry happened in between, so the result never tears. */
+static uint64_t
+vtpStreamingRead48(volatile uint32_t *cnt)
+{
+  uint32_t hi, lo, hi2;
+  int tries=0;
+
+  hi = cnt[1];
+  do
+    {
+      lo  = cnt[0];
+      hi2 = cnt[1];
+      if(hi2 == hi)
+	break;
+      hi = hi2;
+    }
+  while(++tries < 4);
+
+  return (((uint64_t)(hi & 0xFFFF))<<32) | lo;
+}
+
+/* Return a pointer to the EBIORX counters for a given network port (0-3) */
+static volatile EBIORX_REGS *
+vtpStreamingEbiorx(int inst, int *port)
+{
+  *port = inst&1;
+  return &vtp->ebiorx[(inst>>1)&1];
+}
+
 unsigned int
 vtpStreamingFramesSent(int inst)
 {
-  unsigned int totalFrames;
+  volatile EBIORX_REGS *rx;
+  int port;
 
   CHECKINIT;
   CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
@@ -2939,22 +2954,17 @@ vtpStreamingFramesSent(int inst)
       return 0xFFFFFFFF;
     }
 
-  if((inst==0)||(inst==1)) {
-    totalFrames = vtp->ebiorx[0].frames_sent[inst][0];
-  }else{
-    totalFrames = vtp->ebiorx[1].frames_sent[inst][0];
-  }
+  rx = vtpStreamingEbiorx(inst, &port);
 
-      
-    return totalFrames;
+  return rx->frames_sent[port][0];
 }
 
 
 unsigned long long
 vtpStreamingBytesSent(int inst)
 {
-  unsigned int bytes[2];
-  unsigned long long totalBytes;
+  volatile EBIORX_REGS *rx;
+  int port;
 
   CHECKINIT;
   CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
@@ -2963,22 +2973,9 @@ vtpStreamingBytesSent(int inst)
       return 0xFFFFFFFF;
     }
 
-  VLOCK;
-  if((inst==0)||(inst==1)) {
-    bytes[0] = vtp->ebiorx[0].bytes_sent[inst][0];
-    bytes[1] = vtp->ebiorx[0].bytes_sent[inst][0];
-  }else{
-    bytes[0] = vtp->ebiorx[1].bytes_sent[inst-2][0];
-    bytes[1] = vtp->ebiorx[1].bytes_sent[inst-2][0];
-  }
-  VUNLOCK
+  rx = vtpStreamingEbiorx(inst, &port);
 
-  totalBytes  =  (bytes[1])&0x00000000FFFFFFFF;
-  totalBytes  = (totalBytes<<(32ll))&0xFFFFFFFF00000000;
-  totalBytes += bytes[0];
-
-      
-    return totalBytes;
+  return vtpStreamingRead48(rx->bytes_sent[port]);
 }
 
 
@@ -2987,6 +2984,9 @@ vtpStreamingBytesSent(int inst)
 /* Include some VTP CODA ROC Functions */
 #include "vtpRocLib.c"
 
+/* Include the VTP Streaming services (snapshots, timing, flow control) */
+#include "vtpStreamingLib.c"
+
 
 
 
@@ -8010,6 +8010,8 @@ vtpClose(int dev_mask)
 	}
     }
 
+  /* Telemetry writer publishes into the shared memory - stop it before unmapping */
+  vtpTelemetryStop();
   vtpKillLockShm(0);
 
   return vtpDevOpenMASK;
@@ -8131,6 +8133,9 @@ vtpCreateLockShm()
 	  printf("\t File = %d  Library = %d\n",
 		 p_sync->shmSize, (int)sizeof(struct shared_memory_struct));
 	  printf("\t Possible version mismatch!\n");
+	  munmap(addr_shm, sizeof(struct shared_memory_struct));
+	  addr_shm = NULL;
+	  p_sync = NULL;
 	  return ERROR;
 	}
     }
@@ -8517,6 +8522,290 @@ vtpCheckMutexHealth(int time_seconds)
   return rval;
 }
 
+/* Telemetry ring
+    One process (normally vtpserver) runs the writer thread, which takes a
+    lock free snapshot of the board every period_ms and publishes it into
+    p_sync->telemetry.  Every other process reads the ring instead of
+    polling the registers itself.
+*/
+static pthread_t vtpTelemetryThread;
+static volatile int vtpTelemetryRun = 0;
+
+/* Read a 64 bit [0]=low,[1]=high register pair without tearing */
+static uint64_t
+vtpRead64(volatile uint32_t *reg)
+{
+  uint32_t hi, lo;
+
+  do
+    {
+      hi = reg[1];
+      lo = reg[0];
+    }
+  while(hi != reg[1]);
+
+  return (((uint64_t)hi)<<32) | lo;
+}
+
+static void
+vtpTelemetryFill(VTP_TELEMETRY_RECORD *rec, int flags, uint64_t *ltm_last)
+{
+  struct timespec ts;
+  int i;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  rec->timestamp_ns = ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+  rec->flags        = flags;
+
+  rec->fw_type[0]    = VTP_FW_Type[0];
+  rec->fw_type[1]    = VTP_FW_Type[1];
+  rec->fw_version[0] = vtp->v7.clk.FW_Version;
+  rec->fw_version[1] = vtp->clk.FW_Version;
+  rec->v7_temp       = (float)vtp->v7.clk.Temp * 503.975 / 4096.0 - 273.15;
+
+  vtpStreamingSnapshot(&rec->streaming);
+
+  if(VTP_FW_Type[1] == ZYNC_FW_TYPE_ZCODAROC)
+    {
+      rec->roc_state      = vtp->roc.State;
+      rec->roc_trig_cnt   = vtp->roc.TiTriggerCnt;
+      rec->roc_trig_ack   = vtp->roc.TiTriggerAck;
+      rec->roc_bytes_sent = vtpRead64(vtp->roc.BytesSent);
+    }
+
+  rec->serdes_enable = vtpSerdesEnableMask();
+  for(i=0; i<16; i++)
+    {
+      rec->serdes_status[i]  = vtp->v7.vxs[i].Status;
+      rec->serdes_ctrl[i]    = vtp->v7.vxs[i].Ctrl;
+      rec->serdes_latency[i] = vtp->v7.vxs[i].Latency;
+    }
+  for(i=0; i<4; i++)
+    {
+      rec->serdes_status[16+i]  = vtp->v7.qsfp[i].Status;
+      rec->serdes_ctrl[16+i]    = vtp->v7.qsfp[i].Ctrl;
+      rec->serdes_latency[16+i] = vtp->v7.qsfp[i].Latency;
+    }
+
+  /* Rails are carried forward between I2C samples */
+  if((flags & VTP_TELEMETRY_LTM) && (vtpDevOpenMASK & VTP_I2C_OPEN) &&
+     ((rec->timestamp_ns - *ltm_last) >= VTP_TELEMETRY_LTM_PERIOD_MS*1000000ull))
+    {
+      ltm4676_read_rails(rec->ltm_vout, rec->ltm_iout, rec->ltm_temp, rec->ltm_status);
+      rec->ltm_timestamp_ns = rec->timestamp_ns;
+      *ltm_last = rec->timestamp_ns;
+    }
+}
+
+static void
+vtpTelemetryPublish(VTP_TELEMETRY_RING *ring, VTP_TELEMETRY_RECORD *rec)
+{
+  VTP_TELEMETRY_RECORD *slot;
+  uint64_t head;
+  uint32_t seq;
+
+  head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  slot = &ring->rec[head % VTP_TELEMETRY_DEPTH];
+
+  seq = slot->seq;
+  __atomic_store_n(&slot->seq, seq+1, __ATOMIC_RELAXED);  /* odd: write in progress */
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  rec->index = head;
+  memcpy(((char *)slot) + sizeof(uint32_t), ((char *)rec) + sizeof(uint32_t),
+	 sizeof(VTP_TELEMETRY_RECORD) - sizeof(uint32_t));
+
+  __atomic_store_n(&slot->seq, seq+2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, head+1, __ATOMIC_RELEASE);
+}
+
+static void *
+vtpTelemetryThreadMain(void *arg)
+{
+  VTP_TELEMETRY_RING *ring = &p_sync->telemetry;
+  VTP_TELEMETRY_RECORD rec;
+  struct timespec next;
+  uint64_t ltm_last = 0;
+  int flags = ring->flags;
+
+  memset(&rec, 0, sizeof(rec));
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while(vtpTelemetryRun)
+    {
+      vtpTelemetryFill(&rec, flags, &ltm_last);
+      vtpTelemetryPublish(ring, &rec);
+
+      next.tv_nsec += (ring->period_ms % 1000) * 1000000;
+      next.tv_sec  += ring->period_ms / 1000 + next.tv_nsec / 1000000000;
+      next.tv_nsec %= 1000000000;
+      while((clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+	    && vtpTelemetryRun);
+    }
+
+  return NULL;
+}
+
+/*!
+  Start publishing board telemetry into the shared memory ring.
+  Only one process may be the writer.  A claim left behind by a process
+  that no longer exists is taken over.
+
+  @param period_ms  Time between records (10 - 60000 ms)
+  @param flags      VTP_TELEMETRY_LTM to include the LTM4676 rails
+
+  @return OK, if successful. ERROR, otherwise.
+*/
+int
+vtpTelemetryStart(int period_ms, int flags)
+{
+  VTP_TELEMETRY_RING *ring;
+  int32_t pid = getpid(), owner;
+  int rval;
+
+  CHECKINIT;
+
+  if(p_sync == NULL)
+    {
+      printf("%s: ERROR: VTP shared memory not mapped\n", __func__);
+      return ERROR;
+    }
+
+  if((period_ms < 10) || (period_ms > 60000))
+    {
+      printf("%s: ERROR: Invalid period (%d ms). Must be 10-60000\n", __func__, period_ms);
+      return ERROR;
+    }
+
+  if(vtpTelemetryRun)
+    return OK;
+
+  ring  = &p_sync->telemetry;
+  owner = __atomic_load_n(&ring->writer_pid, __ATOMIC_ACQUIRE);
+  if((owner != 0) && (owner != pid) && ((kill(owner, 0) == 0) || (errno != ESRCH)))
+    {
+      printf("%s: ERROR: Telemetry already published by pid %d\n", __func__, owner);
+      return ERROR;
+    }
+  if(!__atomic_compare_exchange_n(&ring->writer_pid, &owner, pid, 0,
+				  __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+    {
+      printf("%s: ERROR: Telemetry claimed by pid %d\n", __func__, owner);
+      return ERROR;
+    }
+
+  ring->depth       = VTP_TELEMETRY_DEPTH;
+  ring->record_size = sizeof(VTP_TELEMETRY_RECORD);
+  ring->period_ms   = period_ms;
+  ring->flags       = flags;
+  __atomic_store_n(&ring->version, VTP_TELEMETRY_VERSION, __ATOMIC_RELEASE);
+
+  vtpTelemetryRun = 1;
+  rval = pthread_create(&vtpTelemetryThread, NULL, vtpTelemetryThreadMain, NULL);
+  if(rval != 0)
+    {
+      vtpTelemetryRun = 0;
+      __atomic_store_n(&ring->writer_pid, 0, __ATOMIC_RELEASE);
+      printf("%s: ERROR: pthread_create failed: %s\n", __func__, strerror(rval));
+      return ERROR;
+    }
+
+  printf("%s: Publishing telemetry every %d ms\n", __func__, period_ms);
+
+  return OK;
+}
+
+int
+vtpTelemetryStop()
+{
+  int32_t pid = getpid();
+
+  if(!vtpTelemetryRun)
+    return OK;
+
+  vtpTelemetryRun = 0;
+  pthread_join(vtpTelemetryThread, NULL);
+
+  if(p_sync != NULL)
+    __atomic_compare_exchange_n(&p_sync->telemetry.writer_pid, &pid, 0, 0,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+
+  return OK;
+}
+
+/*!
+  Copy a record from the telemetry ring.  Lock free - only needs the
+  shared memory (vtpCreateLockShm), not the FPGA map.
+
+  @param rec  Where to copy the record
+  @param age  0 for the newest record, 1 for the one before, ...
+
+  @return OK, if successful. ERROR, if no such record is available.
+*/
+int
+vtpTelemetryRead(VTP_TELEMETRY_RECORD *rec, int age)
+{
+  VTP_TELEMETRY_RING *ring;
+  VTP_TELEMETRY_RECORD *slot;
+  uint64_t head, index;
+  uint32_t seq0, seq1;
+  int tries;
+
+  if((p_sync == NULL) || (rec == NULL) ||
+     (p_sync->shmSize != sizeof(struct shared_memory_struct)))
+    return ERROR;
+
+  ring = &p_sync->telemetry;
+  if((__atomic_load_n(&ring->version, __ATOMIC_ACQUIRE) != VTP_TELEMETRY_VERSION) ||
+     (ring->record_size != sizeof(VTP_TELEMETRY_RECORD)))
+    return ERROR;
+
+  if((age < 0) || (age >= VTP_TELEMETRY_DEPTH - 1))
+    return ERROR;
+
+  for(tries=0; tries<100; tries++)
+    {
+      head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      if(head <= (uint64_t)age)
+	return ERROR;
+
+      index = head - 1 - age;
+      slot  = &ring->rec[index % VTP_TELEMETRY_DEPTH];
+
+      seq0 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      if(seq0 & 1)
+	continue;
+
+      memcpy(rec, slot, sizeof(VTP_TELEMETRY_RECORD));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+      seq1 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+      if((seq0 == seq1) && (rec->index == index))
+	return OK;
+    }
+
+  return ERROR;
+}
+
+/*!
+  Copy up to max of the most recent records, newest first.
+
+  @return Number of records copied.
+*/
+int
+vtpTelemetryHistory(VTP_TELEMETRY_RECORD *rec, int max)
+{
+  int n=0;
+
+  if(max > VTP_TELEMETRY_DEPTH - 1)
+    max = VTP_TELEMETRY_DEPTH - 1;
+
+  while((n < max) && (vtpTelemetryRead(&rec[n], n) == OK))
+    n++;
+
+  return n;
+}
+
 #define MEMALLOC_BUFFER_MAX_NUMBER 16
 
 #define MEMALLOC_IOCTL_BASE 1
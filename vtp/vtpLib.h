@@ -986,6 +986,301 @@ typedef struct
 } EBIORX_REGS;
 
 
+/* Software copy of all streaming counters and link state, captured in one
+   pass by vtpStreamingSnapshot() without taking the library mutex.
+   48 bit EBIORX counters are extended to 64 bits (no tearing). */
+#define VTP_STREAMING_NPAYLOAD     16
+#define VTP_STREAMING_MAX_STREAMS   4
+
+typedef struct
+{
+  uint32_t frame_cnt;        /* Streaming EB frame counter */
+  uint64_t pkts_sent;        /* EBIORX network port counters */
+  uint64_t frames_sent;
+  uint64_t bytes_sent;
+  uint32_t tcp_ctrl;
+  uint32_t tcp_status;
+  uint32_t tcp_mtu;
+  uint32_t tcp_state;        /* IP4_TCPStateStatus */
+  uint32_t tcp_ipstatus;     /* IP4_TCPStatus */
+  uint32_t pcs_status;
+  uint32_t phy_status;
+  uint32_t mac_status[4];
+  uint8_t  link_up;          /* PCS link status */
+  uint8_t  connected;        /* TCP socket established */
+  uint8_t  udp;              /* EBIORX in UDP mode */
+} VTP_STREAMING_PORT;
+
+typedef struct
+{
+  uint64_t timestamp_ns;     /* CLOCK_MONOTONIC at time of capture */
+  uint32_t fw_type;
+  uint32_t eb_ctrl;
+  uint32_t eb_status;
+  uint32_t eb_rocid;
+  uint32_t eb_ctrl3;
+  int      nstreams;
+  uint32_t ebiorx_ctrl[2];
+  uint32_t ebiorx_status[2];
+  uint32_t mig_ctrl[2];
+  uint32_t mig_status[2];
+  uint32_t mig_write_cnt[2];
+  uint32_t mig_read_cnt[2];
+  uint32_t mig_write_data_cnt[2];
+  uint32_t mig_read_data_cnt[2];
+  VTP_STREAMING_PORT port[VTP_STREAMING_MAX_STREAMS];
+} VTP_STREAMING_SNAPSHOT;
+
+/* Rate engine (vtpStreamingRateUpdate) - per metric statistics */
+#define VTP_STREAMING_RATE_WINDOW_MAX  256
+
+typedef struct
+{
+  double cur;                /* value from the last update interval */
+  double avg;                /* exponentially weighted moving average */
+  double min;                /* min/max over the last 'window' updates */
+  double max;
+} VTP_STREAMING_RATE;
+
+typedef struct
+{
+  VTP_STREAMING_RATE frames;          /* frames/s (EBIORX frames sent) */
+  VTP_STREAMING_RATE pkts;            /* packets/s */
+  VTP_STREAMING_RATE bytes;           /* bytes/s */
+  VTP_STREAMING_RATE pkts_per_frame;
+} VTP_STREAMING_PORT_RATES;
+
+typedef struct
+{
+  uint64_t timestamp_ns;     /* CLOCK_MONOTONIC of the last update */
+  uint32_t nupdates;         /* number of intervals accumulated */
+  VTP_STREAMING_PORT_RATES port[VTP_STREAMING_MAX_STREAMS];
+  VTP_STREAMING_RATE mig_backlog[2];  /* MIG WriteDataCnt - ReadDataCnt */
+} VTP_STREAMING_RATES;
+
+/* EJFAT load balancer sync packet ("LC"), all fields big endian */
+#define VTP_SYNC_MAGIC_0       'L'
+#define VTP_SYNC_MAGIC_1       'C'
+#define VTP_SYNC_VERSION       1
+#define VTP_SYNC_PKT_LEN       28
+#define VTP_SYNC_MAX_PKT_LEN   1472      /* UDP payload of a 1500 byte MTU */
+#define VTP_SYNC_MAX_DEST      8
+#define VTP_SYNC_MIN_HZ        1
+#define VTP_SYNC_MAX_HZ        1000
+
+typedef struct __attribute__((packed))
+{
+  uint8_t  magic[2];         /* 'L','C' */
+  uint8_t  version;
+  uint8_t  reserved;
+  uint32_t src_id;           /* data source (stream) id */
+  uint64_t evt_num;          /* last frame sent */
+  uint32_t evt_rate;         /* frames/s */
+  uint64_t nanos;            /* wall clock time of evt_num (ns since epoch) */
+} VTP_SYNC_PKT;
+
+/* EJFAT load balancer (LB) and reassembly (RE) headers, all fields big endian */
+#define VTP_EJFAT_LB_MAGIC_0   'L'
+#define VTP_EJFAT_LB_MAGIC_1   'B'
+#define VTP_EJFAT_LB_HDR_LEN   16
+#define VTP_EJFAT_RE_HDR_LEN   20
+
+typedef struct __attribute__((packed))
+{
+  uint8_t  magic[2];         /* 'L','B' */
+  uint8_t  version;
+  uint8_t  protocol;
+  uint16_t reserved;
+  uint16_t entropy;
+  uint64_t tick;             /* event (frame) number */
+} VTP_EJFAT_LB_HDR;
+
+typedef struct __attribute__((packed))
+{
+  uint8_t  version;          /* version(7-4) */
+  uint8_t  reserved;
+  uint16_t data_id;          /* source id */
+  uint32_t offset;           /* payload offset of this packet in the buffer */
+  uint32_t length;           /* total buffer length */
+  uint64_t tick;             /* event (frame) number */
+} VTP_EJFAT_RE_HDR;
+
+/* Path MTU probe (vtpStreamingMtuProbe).  Probes are UDP datagrams with the
+   don't-fragment bit set, padded to the tested IP packet size.  The echo
+   receiver (vtpStreamRecv -E) returns only the header, fields big endian. */
+#define VTP_MTU_PROBE_MAGIC    0x4D545550   /* 'MTUP' */
+#define VTP_MTU_IPUDP_HDR      28           /* IPv4 + UDP header bytes */
+#define VTP_MTU_PROBE_MIN      576
+#define VTP_MTU_PROBE_TRIES    2
+#define VTP_MTU_PROBE_STEP     8            /* search resolution (bytes) */
+
+typedef struct __attribute__((packed))
+{
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t size;             /* IP packet size of the probe */
+} VTP_MTU_PROBE_HDR;
+
+/* Sync sender statistics (vtpStreamingSyncGetStats) */
+typedef struct
+{
+  uint32_t rate_hz;
+  uint32_t ndest;
+  uint64_t ncycles;          /* send cycles */
+  uint64_t npkts;            /* packets sent */
+  uint64_t nerrors;          /* sendto() failures */
+  uint64_t nlate;            /* cycles skipped, woke more than a period late */
+  int64_t  jitter_min_ns;    /* wakeup time - scheduled time */
+  int64_t  jitter_max_ns;
+  double   jitter_avg_ns;
+  double   jitter_rms_ns;
+} VTP_STREAMING_SYNC_STATS;
+
+/* Bytes of a control event (EVIO block header + event) without the cMsg
+   header, as written by vtpStreamingEvioWriteControl() */
+#define VTP_STREAMING_CONTROL_EVENT_BYTES  (13*4)
+
+/* Result of vtpStreamingDrain() / vtpStreamingDrainSent() */
+typedef struct
+{
+  int      drained;          /* 1: MIG backlog empty (DrainSent: output quiet) for 5 ms */
+  int      sent;             /* DrainSent: every stream sent at least min_bytes */
+  uint32_t drain_us;         /* time until the drain condition was met */
+  uint64_t frames_sent[VTP_STREAMING_MAX_STREAMS];  /* counters when done */
+  uint64_t bytes_sent[VTP_STREAMING_MAX_STREAMS];
+  uint64_t bytes_drained[VTP_STREAMING_MAX_STREAMS]; /* sent during the drain */
+  int32_t  mig_backlog[2];   /* residual MIG WriteDataCnt - ReadDataCnt */
+} VTP_STREAMING_DRAIN;
+
+/* Requested network configuration of one stream for vtpStreamingReconfigure() */
+typedef struct
+{
+  unsigned char  ipaddr[4];
+  unsigned char  subnet[4];
+  unsigned char  gateway[4];
+  unsigned char  mac[6];
+  unsigned char  destip[4];
+  unsigned short destport;
+  unsigned short localport;
+} VTP_STREAMING_NETCFG;
+
+/* Link supervisor (vtpStreamingSupervisorStart)
+    failover actions */
+#define VTP_FAILOVER_NONE     0   /* detect and raise the alarm only */
+#define VTP_FAILOVER_REMAP    1   /* move the stream's payloads to the surviving streams */
+#define VTP_FAILOVER_STANDBY  2   /* reconnect the stream to its standby destination */
+
+/* failure reasons (mask) */
+#define VTP_LINK_FAIL_PCS     (1<<0)  /* PCS/PHY link down */
+#define VTP_LINK_FAIL_TCP     (1<<1)  /* TCP connection lost */
+#define VTP_LINK_FAIL_STALL   (1<<2)  /* EB builds frames but none are sent */
+
+#define VTP_STREAMING_ALARM_TAG  0x13 /* User Event bank tag of link alarms */
+
+typedef struct
+{
+  int      state;            /* 0 healthy, 1 failed, 2 switched (REMAP), 3 recovering */
+  int      reason;           /* VTP_LINK_FAIL_* of the last failure */
+  int      action;           /* VTP_FAILOVER_* applied */
+  int      target;           /* REMAP: mask of the streams that took the payloads */
+  uint32_t nfail;            /* failures detected */
+  uint32_t switch_ms;        /* last good sample to recovery (or remap) */
+  uint64_t lost_frames;      /* frames built but never sent during the switch */
+  uint64_t lost_bytes;       /* estimated from the stream's bytes/frame */
+} VTP_STREAMING_LINK_HEALTH;
+
+typedef struct
+{
+  int      running;
+  int      streamMask;
+  int      failover;
+  int      stall_ms;
+  uint32_t nalarm;
+  VTP_STREAMING_LINK_HEALTH link[VTP_STREAMING_MAX_STREAMS];
+} VTP_STREAMING_SUPERVISOR;
+
+typedef void (*VTP_STREAMING_ALARM_FUNC)(int stream, int reason, int action, void *arg);
+
+/* Adaptive frame length (vtpStreamingFrameLenSelect) */
+#define VTP_FRAMELEN_MIN_NS      1056   /* range vtpStreamingSetEbCfg() accepts */
+#define VTP_FRAMELEN_MAX_NS      65536
+#define VTP_FRAMELEN_MAX_STEP    4      /* max change factor from one run to the next */
+#define VTP_FRAMELEN_HYSTERESIS  0.10   /* keep the length within 10% of the target */
+#define VTP_STREAMING_FRAMELEN_TAG 0x14 /* User Event bank tag of the frame length record */
+
+/* reason for the selected frame length */
+#define VTP_FRAMELEN_DEFAULT     0      /* no measurement - use the default length */
+#define VTP_FRAMELEN_RATE        1      /* from the measured rate */
+#define VTP_FRAMELEN_MIN         2      /* limited by VTP_FRAMELEN_MIN_NS */
+#define VTP_FRAMELEN_LATENCY     3      /* limited by the latency bound */
+#define VTP_FRAMELEN_STEP        4      /* limited to VTP_FRAMELEN_MAX_STEP */
+#define VTP_FRAMELEN_UNCHANGED   5      /* within the hysteresis */
+
+typedef struct
+{
+  uint32_t frame_ns;         /* selected frame length */
+  uint32_t prev_ns;          /* frame length of the measurement (0: none) */
+  uint32_t target_bytes;     /* target data per stream and frame */
+  uint32_t max_latency_ns;   /* latency bound */
+  int      reason;           /* VTP_FRAMELEN_* */
+  int      stream;           /* busiest stream of the measurement */
+  double   bytes_per_s;      /* its rate */
+  double   pkts_per_frame;   /* and packets per frame */
+} VTP_STREAMING_FRAMELEN;
+
+
+/* Telemetry ring in the /vtp shared memory segment.
+    A single writer process (vtpTelemetryStart) publishes timestamped board
+    records; readers (vtpTelemetryRead) only need the shared memory mapped
+    and never take a lock.  Each slot is guarded by a sequence counter
+    (odd while the writer is updating it). */
+#define VTP_TELEMETRY_VERSION        2
+#define VTP_TELEMETRY_DEPTH          64
+#define VTP_TELEMETRY_NSERDES        20      /* 16 VXS payload ports + 4 QSFP */
+#define VTP_TELEMETRY_NRAILS         8       /* 4 LTM4676 x 2 channels */
+#define VTP_TELEMETRY_LTM_PERIOD_MS  10000   /* I2C is slow - sample rails less often */
+
+/* vtpTelemetryStart flags */
+#define VTP_TELEMETRY_LTM            (1<<0)  /* include LTM4676 rails (needs VTP_I2C_OPEN) */
+
+typedef struct
+{
+  uint32_t seq;
+  uint32_t flags;
+  uint64_t index;                 /* record number */
+  uint64_t timestamp_ns;          /* CLOCK_REALTIME */
+  uint32_t fw_type[2];            /* V7, Z7 */
+  uint32_t fw_version[2];
+  float    v7_temp;               /* degrees C */
+  VTP_STREAMING_SNAPSHOT streaming;
+  uint32_t roc_state;             /* CODA ROC firmware only */
+  uint32_t roc_trig_cnt;
+  uint32_t roc_trig_ack;
+  uint64_t roc_bytes_sent;
+  uint32_t serdes_enable;         /* firmware payload port / fiber enable mask */
+  uint32_t serdes_status[VTP_TELEMETRY_NSERDES];
+  uint32_t serdes_ctrl[VTP_TELEMETRY_NSERDES];
+  uint32_t serdes_latency[VTP_TELEMETRY_NSERDES];
+  uint64_t ltm_timestamp_ns;      /* 0 if rails were never sampled */
+  float    ltm_vout[VTP_TELEMETRY_NRAILS];
+  float    ltm_iout[VTP_TELEMETRY_NRAILS];
+  float    ltm_temp[VTP_TELEMETRY_NRAILS];
+  uint16_t ltm_status[VTP_TELEMETRY_NRAILS];
+} VTP_TELEMETRY_RECORD;
+
+typedef struct
+{
+  uint32_t version;               /* VTP_TELEMETRY_VERSION, 0 if never written */
+  uint32_t depth;
+  uint32_t record_size;
+  uint32_t period_ms;
+  int32_t  writer_pid;            /* single writer claim, 0 if none */
+  uint32_t flags;
+  uint64_t head;                  /* number of records published */
+  VTP_TELEMETRY_RECORD rec[VTP_TELEMETRY_DEPTH];
+} VTP_TELEMETRY_RING;
+
+
 #define VTP_V7BRIDGE_STATUS_INIT_B (1<<1)
 #define VTP_V7BRIDGE_STATUS_DONE   (1<<0)
 
@@ -1086,6 +1381,7 @@ int  vtpV7PllLocked();
 int  vtpV7CtrlInit();
 int  vtpV7SetReset(int val);
 int  vtpV7SetResetSoft(int val);
+unsigned int vtpGetHwGeneration();
 void vtpV7SoftReset();
 int  vtpV7GetDone();
 int  vtpV7GetInit_B();
@@ -1357,6 +1653,56 @@ int vtpStreamingTcpAccept(int inst);
 int vtpStreamingTcpReset(int inst);
 unsigned int vtpStreamingFramesSent(int inst);
 unsigned long long vtpStreamingBytesSent(int inst);
+int vtpStreamingSnapshot(VTP_STREAMING_SNAPSHOT *snap);
+int vtpStreamingFrameClockInit();
+uint32_t vtpStreamingGetFrameNs();
+uint64_t vtpStreamingGetFrameCnt64(int stream);
+uint64_t vtpStreamingGetFrameCnt64Cached(int stream);
+uint64_t vtpStreamingGetFrameTime(int stream);
+uint64_t vtpStreamingGetFrameTimeCached(int stream);
+int vtpStreamingRateConfig(float alpha, int window);
+int vtpStreamingRateReset();
+int vtpStreamingRateUpdate();
+int vtpStreamingRateStart(int period_ms);
+int vtpStreamingRateStop();
+int vtpStreamingGetRates(VTP_STREAMING_RATES *rates);
+int vtpStreamingRatePrint();
+int vtpStreamingSetAsyncLarge(int enable);
+int vtpStreamingEvioWriteUserEvent(int streamMask, unsigned int *buf);
+int vtpStreamingConnectAll(int streamMask, int connect, unsigned int *cdata, int dlen, int timeout_ms);
+int vtpStreamingDrain(int streamMask, int timeout_ms, VTP_STREAMING_DRAIN *result);
+int vtpStreamingDrainSent(int streamMask, const VTP_STREAMING_SNAPSHOT *before, uint32_t min_bytes,
+			  int timeout_ms, VTP_STREAMING_DRAIN *result);
+int vtpStreamingReconfigure(int nstreams, int mode, VTP_STREAMING_NETCFG cfg[],
+			    unsigned int *cdata, int dlen, int timeout_ms);
+void vtpStreamingSyncSetData(char *buffer, int version, uint32_t srcId,
+			     uint64_t evtNum, uint32_t evtRate, uint64_t nanos);
+int vtpStreamingSyncAddDest(const char *host, int port, int streamMask);
+int vtpStreamingSyncClearDest();
+int vtpStreamingSyncSetSrcId(int stream, uint32_t srcId);
+int vtpStreamingSyncSetPktLen(int len);
+int vtpStreamingSyncStart(int rate_hz);
+int vtpStreamingSyncStop();
+int vtpStreamingSyncGetStats(VTP_STREAMING_SYNC_STATS *stats);
+int vtpStreamingSyncPrintStats();
+int vtpStreamingProfileLoad(const char *fname, float weight[VTP_STREAMING_NPAYLOAD]);
+int vtpStreamingProfileSave(const char *fname, const float weight[VTP_STREAMING_NPAYLOAD]);
+int vtpStreamingBalance(int mask, int nstreams, const float weight[VTP_STREAMING_NPAYLOAD], PP_CONF *ppInfo);
+int vtpStreamingBalanceStart();
+int vtpStreamingBalanceEnd(float weight[VTP_STREAMING_NPAYLOAD]);
+int vtpStreamingSupervisorSetStandby(int stream, unsigned char destip[4], unsigned short destport);
+int vtpStreamingSupervisorSetAlarm(VTP_STREAMING_ALARM_FUNC func, void *arg);
+int vtpStreamingSupervisorStart(int streamMask, int failover, int stall_ms, PP_CONF *ppInfo);
+int vtpStreamingSupervisorStop();
+int vtpStreamingSupervisorGetStatus(VTP_STREAMING_SUPERVISOR *status);
+int vtpStreamingSupervisorPrint();
+int vtpStreamingFrameLenSave(const char *fname);
+int vtpStreamingFrameLenSelect(const char *fname, int target_bytes, int max_latency_ns,
+			       int default_ns, VTP_STREAMING_FRAMELEN *result);
+int vtpStreamingFrameLenRecord(int streamMask, VTP_STREAMING_FRAMELEN *result);
+int vtpStreamingMtuProbe(const char *host, int port, int min_mtu, int max_mtu, int timeout_ms);
+int vtpStreamingMtuTune(int streamMask, int echo_port, int max_mtu, int timeout_ms);
+int vtpStreamingMtuPrint(int streamMask);
 
 // VTP ROC functions
 int vtpRocStatus(int flag);
@@ -1405,6 +1751,11 @@ int  vtpTimedLock(int time_seconds);
 int  vtpUnlock();
 int  vtpCheckMutexHealth(int time_seconds);
 
+int  vtpTelemetryStart(int period_ms, int flags);
+int  vtpTelemetryStop();
+int  vtpTelemetryRead(VTP_TELEMETRY_RECORD *rec, int age);
+int  vtpTelemetryHistory(VTP_TELEMETRY_RECORD *rec, int max);
+
 int  vtpDmaMemOpen(int nbuffers, int size);
 int  vtpDmaMemClose();
 unsigned long vtpDmaMemGetPhysAddress(int buffer_id);
@@ -0,0 +1,2881 @@
+/* Routines associated with the FADC Streaming firmware release for the VTP
+    - services built on top of the basic vtpStreaming register functions
+      in vtpLib.c (monitoring, timing, flow control).  */
+
+
+static uint64_t
+vtpStreamingNowNs()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+}
+
+
+/* Capture all streaming counters (EB frame counters, EBIORX packet/frame/byte
+   counters, MIG counters) and network link state in one pass.
+
+   The library mutex is NOT taken - these are read only registers and the
+   48 bit counters are read with vtpStreamingRead48() - so monitoring threads
+   can poll this at any rate without stalling the readout or transition code.
+
+   Returns OK, or ERROR if the library is not initialized.
+*/
+int
+vtpStreamingSnapshot(VTP_STREAMING_SNAPSHOT *snap)
+{
+  volatile EBIORX_REGS *rx;
+  VTP_STREAMING_PORT *p;
+  int i, j, port;
+
+  CHECKINIT;
+
+  if(snap == NULL)
+    {
+      printf("%s: ERROR: NULL snapshot pointer\n", __func__);
+      return ERROR;
+    }
+
+  memset(snap, 0, sizeof(VTP_STREAMING_SNAPSHOT));
+  snap->timestamp_ns = vtpStreamingNowNs();
+  snap->fw_type      = VTP_FW_Type[0];
+
+  /* Counters first, so they are as close together in time as possible */
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      p  = &snap->port[i];
+      rx = vtpStreamingEbiorx(i, &port);
+
+      p->pkts_sent   = vtpStreamingRead48(rx->pkts_sent[port]);
+      p->frames_sent = vtpStreamingRead48(rx->frames_sent[port]);
+      p->bytes_sent  = vtpStreamingRead48(rx->bytes_sent[port]);
+
+      if(snap->fw_type == VTP_FW_TYPE_FADCSTREAM)
+	p->frame_cnt = vtp->v7.streamingEb.FrameCnt[i];
+    }
+
+  for(i=0; i<2; i++)
+    {
+      snap->mig_write_cnt[i]      = vtp->v7.mig[i].WriteCnt;
+      snap->mig_read_cnt[i]       = vtp->v7.mig[i].ReadCnt;
+      snap->mig_write_data_cnt[i] = vtp->v7.mig[i].WriteDataCnt;
+      snap->mig_read_data_cnt[i]  = vtp->v7.mig[i].ReadDataCnt;
+      snap->mig_ctrl[i]           = vtp->v7.mig[i].Ctrl;
+      snap->mig_status[i]         = vtp->v7.mig[i].Status;
+
+      snap->ebiorx_ctrl[i]        = vtp->ebiorx[i].Ctrl;
+      snap->ebiorx_status[i]      = vtp->ebiorx[i].Status;
+    }
+
+  if(snap->fw_type == VTP_FW_TYPE_FADCSTREAM)
+    {
+      snap->eb_ctrl   = vtp->v7.streamingEb.Ctrl;
+      snap->eb_status = vtp->v7.streamingEb.Status;
+      snap->eb_rocid  = vtp->v7.streamingEb.rocid;
+      snap->eb_ctrl3  = vtp->v7.streamingEb.Ctrl3;
+      snap->nstreams  = snap->eb_ctrl3 & VTP_STREB_STREAM_MASK;
+    }
+
+  /* Network link state */
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      p = &snap->port[i];
+
+      p->tcp_ctrl     = vtp->tcpClient[i].Ctrl;
+      p->tcp_status   = vtp->tcpClient[i].Status;
+      p->tcp_mtu      = vtp->tcpClient[i].MTU;
+      p->tcp_state    = vtp->tcpClient[i].IP4_TCPStateStatus;
+      p->tcp_ipstatus = vtp->tcpClient[i].IP4_TCPStatus;
+      p->pcs_status   = vtp->tcpClient[i].PCS_STATUS;
+      p->phy_status   = vtp->tcpClient[i].PHY_STATUS;
+      for(j=0; j<4; j++)
+	p->mac_status[j] = vtp->tcpClient[i].MAC_STATUS[j];
+
+      p->link_up   = (p->pcs_status & 0x1) ? 1 : 0;
+      p->connected = (p->tcp_ipstatus & 0xFF) ? 1 : 0;
+      p->udp       = (snap->ebiorx_ctrl[i>>1] & 0x100) ? 1 : 0;
+    }
+
+  return OK;
+}
+
+
+
+/* Frame clock
+    The streaming EB frame counters are only 32 bits.  Each stream keeps a
+    64 bit software extension that is advanced with the (signed) 32 bit
+    difference to the latest register value, so it is wrap safe as long as
+    someone reads it at least once every 2^31 frames (~39 hours at 65us).
+    Updates are a single 64 bit compare-and-swap, no mutex is needed.
+*/
+static uint64_t vtpFrameClock[VTP_STREAMING_MAX_STREAMS];
+static uint32_t vtpFrameClockNs = 0;
+
+/* Advance the 64 bit frame count for a stream with a new 32 bit register value */
+static uint64_t
+vtpStreamingFrameClockUpdate(int stream, uint32_t raw)
+{
+  uint64_t old, new;
+  int32_t diff;
+
+  old = __atomic_load_n(&vtpFrameClock[stream], __ATOMIC_ACQUIRE);
+  do
+    {
+      diff = (int32_t)(raw - (uint32_t)old);
+      if(diff <= 0) /* Another reader already got here (or a newer value) */
+	return old + diff;
+      new = old + diff;
+    }
+  while(!__atomic_compare_exchange_n(&vtpFrameClock[stream], &old, new, 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  return new;
+}
+
+/* Initialize the frame clock for all streams.
+    The frame duration is taken from the EB frame length register
+     (Ctrl bits 29-16, in units of 32ns clocks - 1).
+    The 64 bit counts restart from the current register values, so this
+    should be called whenever the EB is (re)configured. */
+int
+vtpStreamingFrameClockInit()
+{
+  uint32_t ctrl;
+  int i;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+
+  ctrl = vtp->v7.streamingEb.Ctrl;
+  __atomic_store_n(&vtpFrameClockNs, (((ctrl>>16) & 0x3FFF)+1)*32, __ATOMIC_RELEASE);
+
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    __atomic_store_n(&vtpFrameClock[i], (uint64_t)vtp->v7.streamingEb.FrameCnt[i],
+		     __ATOMIC_RELEASE);
+
+  return OK;
+}
+
+/* Frame duration in ns (0 if the frame clock is not initialized) */
+uint32_t
+vtpStreamingGetFrameNs()
+{
+  return __atomic_load_n(&vtpFrameClockNs, __ATOMIC_ACQUIRE);
+}
+
+/* Read the EB frame counter for a stream and return it extended to 64 bits.
+    One register read, no mutex. */
+uint64_t
+vtpStreamingGetFrameCnt64(int stream)
+{
+  if((vtp == NULL) || (stream<0) || (stream>=VTP_STREAMING_MAX_STREAMS))
+    return 0;
+
+  if((vtpStreamingGetFrameNs() == 0) && (VTP_FW_Type[0] == VTP_FW_TYPE_FADCSTREAM))
+    vtpStreamingFrameClockInit();
+
+  return vtpStreamingFrameClockUpdate(stream, vtp->v7.streamingEb.FrameCnt[stream]);
+}
+
+/* Last 64 bit frame count seen by any reader (no register access) */
+uint64_t
+vtpStreamingGetFrameCnt64Cached(int stream)
+{
+  if((stream<0) || (stream>=VTP_STREAMING_MAX_STREAMS))
+    return 0;
+
+  return __atomic_load_n(&vtpFrameClock[stream], __ATOMIC_ACQUIRE);
+}
+
+/* Time in ns since the start of frame 0 for a stream.  Monotonic. */
+uint64_t
+vtpStreamingGetFrameTime(int stream)
+{
+  uint64_t frame = vtpStreamingGetFrameCnt64(stream);
+
+  return frame * vtpStreamingGetFrameNs();
+}
+
+/* Same as vtpStreamingGetFrameTime(), but from the cached frame count */
+uint64_t
+vtpStreamingGetFrameTimeCached(int stream)
+{
+  return vtpStreamingGetFrameCnt64Cached(stream) * vtpStreamingGetFrameNs();
+}
+
+
+
+/* Rate engine
+    Rates are computed from the deltas between two consecutive snapshots.
+    Each metric keeps the last interval value, an exponentially weighted
+    moving average (alpha) and the min/max over the last 'window' intervals.
+    State is protected by its own mutex, never by the library mutex.
+*/
+#define VTP_STREAMING_RATE_NMETRIC  (4*VTP_STREAMING_MAX_STREAMS + 2)
+
+static pthread_mutex_t vtpRateMutex = PTHREAD_MUTEX_INITIALIZER;
+static VTP_STREAMING_SNAPSHOT vtpRatePrev;
+static int    vtpRatePrevValid = 0;
+static VTP_STREAMING_RATES vtpRates;
+static float  vtpRateAlpha  = 0.2;
+static int    vtpRateWindow = 60;
+static int    vtpRateHistIndex = 0;
+static double vtpRateHist[VTP_STREAMING_RATE_NMETRIC][VTP_STREAMING_RATE_WINDOW_MAX];
+
+static pthread_t vtpRateThread;
+static volatile int vtpRateThreadRun = 0;
+static int vtpRatePeriodMs = 1000;
+
+/* Set the EWMA weight of the newest interval (0 < alpha <= 1) and the
+   number of intervals used for the windowed min/max */
+int
+vtpStreamingRateConfig(float alpha, int window)
+{
+  if((alpha <= 0.0) || (alpha > 1.0))
+    {
+      printf("%s: ERROR: Invalid alpha (%f)\n", __func__, alpha);
+      return ERROR;
+    }
+  if((window < 1) || (window > VTP_STREAMING_RATE_WINDOW_MAX))
+    {
+      printf("%s: ERROR: Invalid window (%d). Must be 1-%d\n", __func__,
+	     window, VTP_STREAMING_RATE_WINDOW_MAX);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpRateMutex);
+  vtpRateAlpha  = alpha;
+  vtpRateWindow = window;
+  pthread_mutex_unlock(&vtpRateMutex);
+
+  return vtpStreamingRateReset();
+}
+
+/* Clear all accumulated statistics. The next update only sets the reference. */
+int
+vtpStreamingRateReset()
+{
+  pthread_mutex_lock(&vtpRateMutex);
+  memset(&vtpRates, 0, sizeof(vtpRates));
+  vtpRatePrevValid = 0;
+  vtpRateHistIndex = 0;
+  pthread_mutex_unlock(&vtpRateMutex);
+
+  return OK;
+}
+
+static void
+vtpStreamingRateAccumulate(VTP_STREAMING_RATE *r, double *hist, double val)
+{
+  int i, n;
+
+  hist[vtpRateHistIndex % vtpRateWindow] = val;
+
+  r->cur = val;
+  if(vtpRates.nupdates == 0)
+    r->avg = val;
+  else
+    r->avg += vtpRateAlpha * (val - r->avg);
+
+  n = (vtpRates.nupdates+1 < vtpRateWindow) ? vtpRates.nupdates+1 : vtpRateWindow;
+  r->min = r->max = hist[0];
+  for(i=1; i<n; i++)
+    {
+      if(hist[i] < r->min) r->min = hist[i];
+      if(hist[i] > r->max) r->max = hist[i];
+    }
+}
+
+#define VTP_DELTA48(a,b)  (((a) - (b)) & 0xFFFFFFFFFFFFull)
+
+/* Take a snapshot and fold the interval since the previous one into the
+   rate statistics.  Call periodically, or use vtpStreamingRateStart(). */
+int
+vtpStreamingRateUpdate()
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_PORT *p, *pp;
+  VTP_STREAMING_PORT_RATES *r;
+  double dt, dframes, dpkts, ppf;
+  int i, m=0;
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  pthread_mutex_lock(&vtpRateMutex);
+
+  if(!vtpRatePrevValid || (snap.timestamp_ns <= vtpRatePrev.timestamp_ns))
+    {
+      vtpRatePrev = snap;
+      vtpRatePrevValid = 1;
+      pthread_mutex_unlock(&vtpRateMutex);
+      return OK;
+    }
+
+  dt = (double)(snap.timestamp_ns - vtpRatePrev.timestamp_ns) * 1.0e-9;
+
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      p  = &snap.port[i];
+      pp = &vtpRatePrev.port[i];
+      r  = &vtpRates.port[i];
+
+      dframes = (double)VTP_DELTA48(p->frames_sent, pp->frames_sent);
+      dpkts   = (double)VTP_DELTA48(p->pkts_sent, pp->pkts_sent);
+
+      vtpStreamingRateAccumulate(&r->frames, vtpRateHist[m++], dframes/dt);
+      vtpStreamingRateAccumulate(&r->pkts,   vtpRateHist[m++], dpkts/dt);
+      vtpStreamingRateAccumulate(&r->bytes,  vtpRateHist[m++],
+				 (double)VTP_DELTA48(p->bytes_sent, pp->bytes_sent)/dt);
+
+      /* No frames in this interval: carry the previous packets/frame */
+      ppf = (dframes > 0) ? dpkts/dframes : r->pkts_per_frame.cur;
+      vtpStreamingRateAccumulate(&r->pkts_per_frame, vtpRateHist[m++], ppf);
+    }
+
+  for(i=0; i<2; i++)
+    vtpStreamingRateAccumulate(&vtpRates.mig_backlog[i], vtpRateHist[m++],
+			       (double)(int32_t)(snap.mig_write_data_cnt[i] -
+						 snap.mig_read_data_cnt[i]));
+
+  vtpRateHistIndex++;
+  vtpRates.nupdates++;
+  vtpRates.timestamp_ns = snap.timestamp_ns;
+  vtpRatePrev = snap;
+
+  pthread_mutex_unlock(&vtpRateMutex);
+
+  return OK;
+}
+
+/* Copy the current rate statistics. Returns ERROR if no interval has been measured yet. */
+int
+vtpStreamingGetRates(VTP_STREAMING_RATES *rates)
+{
+  int rval;
+
+  if(rates == NULL)
+    {
+      printf("%s: ERROR: NULL rates pointer\n", __func__);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpRateMutex);
+  *rates = vtpRates;
+  rval = (vtpRates.nupdates > 0) ? OK : ERROR;
+  pthread_mutex_unlock(&vtpRateMutex);
+
+  return rval;
+}
+
+static void *
+vtpStreamingRateThreadMain(void *arg)
+{
+  struct timespec req;
+
+  while(vtpRateThreadRun)
+    {
+      vtpStreamingRateUpdate();
+
+      req.tv_sec  = vtpRatePeriodMs / 1000;
+      req.tv_nsec = (vtpRatePeriodMs % 1000) * 1000000;
+      while((nanosleep(&req, &req) != 0) && (errno == EINTR) && vtpRateThreadRun);
+    }
+
+  return NULL;
+}
+
+/* Start a thread that calls vtpStreamingRateUpdate() every period_ms */
+int
+vtpStreamingRateStart(int period_ms)
+{
+  int rval;
+
+  CHECKINIT;
+
+  if((period_ms < 10) || (period_ms > 60000))
+    {
+      printf("%s: ERROR: Invalid period (%d ms). Must be 10-60000\n", __func__, period_ms);
+      return ERROR;
+    }
+
+  if(vtpRateThreadRun)
+    {
+      vtpRatePeriodMs = period_ms;
+      return OK;
+    }
+
+  vtpStreamingRateReset();
+  vtpRatePeriodMs  = period_ms;
+  vtpRateThreadRun = 1;
+
+  rval = pthread_create(&vtpRateThread, NULL, vtpStreamingRateThreadMain, NULL);
+  if(rval != 0)
+    {
+      vtpRateThreadRun = 0;
+      printf("%s: ERROR: pthread_create failed: %s\n", __func__, strerror(rval));
+      return ERROR;
+    }
+
+  return OK;
+}
+
+int
+vtpStreamingRateStop()
+{
+  if(!vtpRateThreadRun)
+    return OK;
+
+  vtpRateThreadRun = 0;
+  pthread_join(vtpRateThread, NULL);
+
+  return OK;
+}
+
+int
+vtpStreamingRatePrint()
+{
+  VTP_STREAMING_RATES r;
+  VTP_STREAMING_PORT_RATES *p;
+  int i;
+
+  if(vtpStreamingGetRates(&r) != OK)
+    {
+      printf("%s: No rates measured yet\n", __func__);
+      return ERROR;
+    }
+
+  printf("---------------------------------------\n");
+  printf("--VTP Streaming Rates (%u intervals)  \n", r.nupdates);
+  printf("---------------------------------------\n");
+  printf("                       current      average      minimum      maximum\n");
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      p = &r.port[i];
+      if(p->frames.max == 0)
+	continue;
+
+      printf("  Port %d  frames/s  %12.1f %12.1f %12.1f %12.1f\n", i,
+	     p->frames.cur, p->frames.avg, p->frames.min, p->frames.max);
+      printf("          pkts/s    %12.1f %12.1f %12.1f %12.1f\n",
+	     p->pkts.cur, p->pkts.avg, p->pkts.min, p->pkts.max);
+      printf("          MB/s      %12.3f %12.3f %12.3f %12.3f\n",
+	     p->bytes.cur*1e-6, p->bytes.avg*1e-6, p->bytes.min*1e-6, p->bytes.max*1e-6);
+      printf("          pkts/frame%12.2f %12.2f %12.2f %12.2f\n",
+	     p->pkts_per_frame.cur, p->pkts_per_frame.avg,
+	     p->pkts_per_frame.min, p->pkts_per_frame.max);
+    }
+  for(i=0; i<2; i++)
+    printf("  MIG%d backlog      %12.0f %12.0f %12.0f %12.0f\n", i,
+	   r.mig_backlog[i].cur, r.mig_backlog[i].avg,
+	   r.mig_backlog[i].min, r.mig_backlog[i].max);
+
+  return OK;
+}
+
+
+
+/* Async event FIFO of the streaming EB
+    The streaming EB does not expose a FIFO fill level.  Small events are
+    written completely and then committed with their length (as done by
+    vtpStreamingEvioWriteControl).
+
+    Larger events are only sent when enabled with vtpStreamingSetAsyncLarge(),
+    as this has not been verified on the streaming firmware yet: they
+    announce their length first (as the ROC firmware does) and are written
+    in bursts, with the fill level estimated from the words written minus
+    the bytes the EBIORX has sent for that network port.  Every writer of
+    the FIFO holds ALOCK for its whole event, so a burst is not interleaved
+    with other events. */
+#define VTP_STREB_ASYNC_FIFO_DEPTH    512   /* 32 bit words */
+#define VTP_STREB_ASYNC_FIFO_MARGIN   64    /* room left for unaccounted data */
+#define VTP_STREB_ASYNC_TIMEOUT_US    1000000
+
+static int vtpStreamingAsyncLarge = 0;
+
+int
+vtpStreamingSetAsyncLarge(int enable)
+{
+  vtpStreamingAsyncLarge = enable ? 1 : 0;
+
+  return OK;
+}
+
+/* Called with ALOCK and VLOCK held.  While waiting for the FIFO to drain
+   VLOCK is released, and ctrl3 (network port select) is restored when it
+   is taken again.  ALOCK is kept, so no other event gets into the FIFO. */
+static int
+vtpStreamingAsyncBurst(int inst, uint32_t ctrl3, unsigned int *data, int nwords)
+{
+  volatile EBIORX_REGS *rx;
+  uint64_t sent0, sent;
+  int port, ii, written=0, avail, idle=0;
+
+  if(nwords <= (VTP_STREB_ASYNC_FIFO_DEPTH - VTP_STREB_ASYNC_FIFO_MARGIN))
+    {
+      for(ii=0; ii<nwords; ii++)
+	vtp->v7.streamingEb.CpuAsyncEventData = data[ii];
+      vtp->v7.streamingEb.CpuAsyncEventInfo = nwords;
+      return OK;
+    }
+
+  if(!vtpStreamingAsyncLarge)
+    {
+      printf("%s: ERROR: Event of %d words does not fit the async FIFO (%d words).\n",
+	     __func__, nwords, VTP_STREB_ASYNC_FIFO_DEPTH - VTP_STREB_ASYNC_FIFO_MARGIN);
+      printf("%s: Larger events need vtpStreamingSetAsyncLarge(1) (untested)\n", __func__);
+      return ERROR;
+    }
+
+  rx    = vtpStreamingEbiorx(inst, &port);
+  sent0 = vtpStreamingRead48(rx->bytes_sent[port]);
+
+  vtp->v7.streamingEb.CpuAsyncEventInfo = nwords;
+
+  while(written < nwords)
+    {
+      sent  = VTP_DELTA48(vtpStreamingRead48(rx->bytes_sent[port]), sent0) >> 2;
+      avail = (VTP_STREB_ASYNC_FIFO_DEPTH - VTP_STREB_ASYNC_FIFO_MARGIN)
+	- (written - (int)((sent < (uint64_t)written) ? sent : (uint64_t)written));
+      if(avail > (nwords - written))
+	avail = nwords - written;
+
+      if(avail <= 0)
+	{
+	  if(++idle > VTP_STREB_ASYNC_TIMEOUT_US/10)
+	    {
+	      printf("%s: ERROR: Async FIFO for stream %d not draining (%d of %d words written)\n",
+		     __func__, inst, written, nwords);
+	      return ERROR;
+	    }
+	  VUNLOCK;
+	  usleep(10);
+	  VLOCK;
+	  vtp->v7.streamingEb.Ctrl3 = ctrl3;
+	  continue;
+	}
+
+      idle = 0;
+      for(ii=0; ii<avail; ii++)
+	vtp->v7.streamingEb.CpuAsyncEventData = data[written+ii];
+      written += avail;
+    }
+
+  return OK;
+}
+
+/* Send a CODA User Event to every stream in streamMask (bit0 = stream 0).
+
+    buf holds a single EVIO bank (buf[0] = length-1, buf[1] = tag/type/num),
+    e.g. as created by vtpRocFile2Event().  The cMsg header (TCP only) and
+    EVIO block header are built once and the whole event is burst into the
+    async FIFO of each selected stream.  The Streaming EB must have the
+    AsyncFifo enabled (vtpStreamingEbEnable(VTP_STREB_ASYNC_FIFO_EN)).
+*/
+int
+vtpStreamingEvioWriteUserEvent(int streamMask, unsigned int *buf)
+{
+  unsigned int blen, tag, dt, num, totalLen, rocid, temp, *evt;
+  int inst, hdr, rval=OK;
+  static unsigned int maxwds = 1024*1024;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+
+  if(buf == NULL)
+    {
+      printf("%s: ERROR: NULL buffer\n",__func__);
+      return ERROR;
+    }
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  if(streamMask == 0)
+    {
+      printf("%s: ERROR: No streams selected\n",__func__);
+      return ERROR;
+    }
+
+  /* Same checks as vtpRocEvioWriteUserEvent */
+  blen = buf[0] + 1;
+  tag  = (buf[1]&0xffff0000)>>16;
+  dt   = (buf[1]&0xff00)>>8;
+  num  =  buf[1]&0xff;
+
+  if(blen>maxwds) {
+    printf("%s: ERROR: buffer length (%d words) is too long for a User Event\n",__func__,blen);
+    return ERROR;
+  }
+  if(tag>=0xff00) {
+    printf("%s: ERROR: Illegal User Bank Tag (0x%04x)\n",__func__,tag);
+    return ERROR;
+  }
+  if(((dt&0x3f)>0x10)&&((dt&0x3f)!=0x20)) {
+    printf("%s: ERROR: Illegal Bank Data Type (%d) for User Event\n",__func__,dt);
+    return ERROR;
+  }
+  if(num>0) {
+    printf("%s: ERROR: Num field must be zero for User Events (num=%d)\n",__func__,num);
+    return ERROR;
+  }
+
+  totalLen = blen + 8;
+  evt = (unsigned int *)malloc((totalLen+2)*sizeof(unsigned int));
+  if(evt == NULL)
+    {
+      printf("%s: ERROR: Unable to allocate %d words\n",__func__,totalLen+2);
+      return ERROR;
+    }
+
+  ALOCK;
+  VLOCK;
+  rocid = vtp->v7.streamingEb.rocid;
+  hdr   = ((vtp->ebiorx[0].Ctrl)&0x100) ? 2 : 0;  /* cMsg Header only for TCP */
+
+  /* cMsg Header */
+  evt[0] = 1;
+  evt[1] = (totalLen<<2);
+
+  /* EVIO Block header */
+  evt[2] = totalLen;
+  evt[3] = 0xffffffff;
+  evt[4] = 8;
+  evt[5] = 1;
+  evt[6] = rocid;
+  evt[7] = (0x1000|0x200|4); /* User Event, Last block, evio version */
+  evt[8] = 0;
+  evt[9] = 0xc0da0100;
+
+  memcpy(&evt[10], buf, blen*sizeof(unsigned int));
+
+  temp = (vtp->v7.streamingEb.Ctrl3)&~VTP_STREB_AFIFO_MASK;
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      if(!(streamMask & (1<<inst)))
+	continue;
+
+      vtp->v7.streamingEb.Ctrl3 = (inst<<4)|temp;  /* set the network port being used */
+
+      if(vtpStreamingAsyncBurst(inst, (inst<<4)|temp, &evt[hdr], totalLen+2-hdr) != OK)
+	rval = ERROR;
+    }
+  VUNLOCK;
+  AUNLOCK;
+
+  free(evt);
+
+  return rval;
+}
+
+
+
+/* Connection manager
+    Brings up (or closes) all requested network links together.  Each link
+    moves through its states as soon as the hardware reports it ready:
+      reset released -> PCS link up -> socket opened -> TCP established
+    instead of waiting fixed times for each link in turn.  The library
+    mutex is only held for register writes, never while waiting.
+*/
+#define VTP_CONNECT_POLL_US   1000
+
+enum
+  {
+    VTP_CONNECT_LINK_WAIT=0,
+    VTP_CONNECT_SOCKET_WAIT,
+    VTP_CONNECT_DONE
+  };
+
+/* Bring up the network links in streamMask and open their sockets.
+    Links in resetMask get the full phy/qsfp/tcp reset first; the others
+    keep their (already up) network link and only reopen the socket.
+    Returns the mask of streams that are ready.
+*/
+static int
+vtpStreamingLinkWait(int streamMask, int resetMask, int connect, int timeout_ms)
+{
+  int inst, state[VTP_STREAMING_MAX_STREAMS], pending, ready=0;
+  uint64_t t0, t, tready[VTP_STREAMING_MAX_STREAMS];
+
+  t = t0 = vtpStreamingNowNs();
+  resetMask &= streamMask;
+
+  if(resetMask)
+    {
+      VLOCK;
+      for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+	{
+	  if(!(resetMask & (1<<inst)))
+	    continue;
+	  vtp->tcpClient[inst].IP4_StateRequest = 0;  // tcp: disconnect socket
+	  vtp->tcpClient[inst].Ctrl = 0x03C5;         // tcp: reset: phy, qsfp, tcp
+	}
+      VUNLOCK;
+      usleep(10000);
+
+      VLOCK;
+      for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+	if(resetMask & (1<<inst))
+	  vtp->tcpClient[inst].Ctrl = 0x03C0;         // tcp: reset: qsfp
+      VUNLOCK;
+      usleep(10000);
+    }
+
+  VLOCK;
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      state[inst] = VTP_CONNECT_DONE;
+      if(!(streamMask & (1<<inst)))
+	continue;
+      if(resetMask & (1<<inst))
+	vtp->tcpClient[inst].Ctrl = 0x13C0;         // tcp: reset: none
+      else
+	vtp->tcpClient[inst].IP4_StateRequest = 0;  // tcp: disconnect socket
+      state[inst] = VTP_CONNECT_LINK_WAIT;
+    }
+  VUNLOCK;
+
+  /* Advance every link as soon as its status allows */
+  do
+    {
+      pending = 0;
+      for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+	{
+	  switch(state[inst])
+	    {
+	    case VTP_CONNECT_LINK_WAIT:
+	      if(vtp->tcpClient[inst].PCS_STATUS & 0x1)
+		{
+		  VLOCK;
+		  vtp->tcpClient[inst].IP4_StateRequest = 1;  // tcp: connect to first socket
+		  VUNLOCK;
+		  state[inst] = (connect==1) ? VTP_CONNECT_SOCKET_WAIT : VTP_CONNECT_DONE;
+		}
+	      break;
+
+	    case VTP_CONNECT_SOCKET_WAIT:
+	      if(vtp->tcpClient[inst].IP4_TCPStatus & 0xff)
+		state[inst] = VTP_CONNECT_DONE;
+	      break;
+	    }
+
+	  if(state[inst] != VTP_CONNECT_DONE)
+	    pending |= (1<<inst);
+	  else if((streamMask & (1<<inst)) && !(ready & (1<<inst)))
+	    {
+	      ready |= (1<<inst);
+	      tready[inst] = vtpStreamingNowNs() - t0;
+	    }
+	}
+
+      if(pending == 0)
+	break;
+
+      usleep(VTP_CONNECT_POLL_US);
+      t = vtpStreamingNowNs();
+    }
+  while((t - t0) < (uint64_t)timeout_ms*1000000ull);
+
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      if(ready & (1<<inst))
+	printf("%s: Stream %d %s ready after %llu ms\n", __func__, inst+1,
+	       (connect==1) ? "TCP Connection" : "UDP Socket",
+	       (unsigned long long)(tready[inst]/1000000));
+      else if(pending & (1<<inst))
+	printf("%s: **WARNING**: Stream %d %s after %d ms\n", __func__, inst+1,
+	       (state[inst]==VTP_CONNECT_LINK_WAIT) ? "network link not up" : "TCP Connection not complete",
+	       timeout_ms);
+    }
+
+  return ready;
+}
+
+/* Send optional Data required to complete connection to the CODA EMU (EB) */
+static void
+vtpStreamingConnectData(int readyMask, unsigned int *cdata, int dlen)
+{
+  int inst, jj;
+  unsigned int temp;
+
+  if((cdata==0) || (dlen==0) || (readyMask==0))
+    return;
+
+  ALOCK;
+  VLOCK;
+  temp = (vtp->v7.streamingEb.Ctrl3)&~VTP_STREB_AFIFO_MASK;
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      if(!(readyMask & (1<<inst)))
+	continue;
+      vtp->v7.streamingEb.Ctrl3 = (inst<<4)|temp;  // set the network port being used
+      for(jj=0; jj<dlen; jj++)
+	vtp->v7.streamingEb.CpuAsyncEventData = cdata[jj];
+      vtp->v7.streamingEb.CpuAsyncEventInfo = dlen;
+    }
+  VUNLOCK;
+  AUNLOCK;
+}
+
+/* connect = 0   Close the sockets
+   connect = 1   TCP: open sockets and wait for the connections
+   connect = 2   UDP: open sockets once the network links are up
+
+   cdata/dlen:   optional connection data sent to each connected stream
+   timeout_ms:   max time to wait for all links
+
+   Returns a mask of the streams that are ready, or ERROR.
+*/
+int
+vtpStreamingConnectAll(int streamMask, int connect, unsigned int *cdata, int dlen, int timeout_ms)
+{
+  int inst, pending, ready;
+  uint64_t t0;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  if(streamMask == 0)
+    {
+      printf("%s: ERROR: No streams selected\n",__func__);
+      return ERROR;
+    }
+  if((connect<0) || (connect>2))
+    {
+      printf("%s: ERROR: Invalid connect mode (%d)\n",__func__,connect);
+      return ERROR;
+    }
+
+  t0 = vtpStreamingNowNs();
+
+  if(connect == 0)  /* disconnect the sockets */
+    {
+      VLOCK;
+      vtp->v7.streamingEb.Ctrl = 0x80000000;      /* Disable stream building */
+      for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+	if(streamMask & (1<<inst))
+	  vtp->tcpClient[inst].IP4_StateRequest = 0;
+      VUNLOCK;
+
+      /* Wait for TCP connections to report closed (UDP reports 0 already) */
+      do
+	{
+	  pending = 0;
+	  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+	    if((streamMask & (1<<inst)) && (vtp->tcpClient[inst].IP4_TCPStatus & 0xff))
+	      pending |= (1<<inst);
+	  if(pending == 0)
+	    break;
+	  usleep(VTP_CONNECT_POLL_US);
+	}
+      while((vtpStreamingNowNs() - t0) < (uint64_t)timeout_ms*1000000ull);
+
+      if(pending)
+	printf("%s: WARNING: Streams 0x%x still connected after %d ms\n",
+	       __func__, pending, timeout_ms);
+
+      return streamMask & ~pending;
+    }
+
+  printf("%s(0x%x, %s)\n", __func__, streamMask, (connect==1) ? "TCP" : "UDP");
+
+  VLOCK;
+  vtp->v7.streamingEb.Ctrl |= 0x80000000;       // streaming_eb: RESET=1
+  vtp->v7.streamingEb.Ctrl &= 0x7FFFFFFF;       // streaming_eb: RESET=0
+  VUNLOCK;
+
+  /* EB reset restarted the frame counters */
+  vtpStreamingFrameClockInit();
+
+  /* Reset all requested links at once */
+  ready = vtpStreamingLinkWait(streamMask, streamMask, connect, timeout_ms);
+
+  vtpStreamingConnectData(ready, cdata, dlen);
+
+  return ready;
+}
+
+
+/* Hot reconfiguration
+    Moves the streams to a new network configuration between runs without
+    a full Prestart.  The requested configuration is compared with the
+    live tcpClient registers and only the streams that differ (or whose
+    socket is not open) are touched:
+      - network link still up: close the socket, rewrite the registers,
+        reopen the socket (no phy reset)
+      - network link down: full link reset as in vtpStreamingConnectAll
+    Streams at or above nstreams are closed.  The Streaming EB is reset so
+    the frame counters restart, as they do at Prestart.
+
+    mode:    0 = TCP, 1 = UDP.  The EBIORX transport mode is set by
+             vtpStreamingEbioReset() and cannot change here.
+    cfg:     nstreams entries, in the vtpStreamingSetNetCfg() format
+
+    Returns a mask of the streams that are ready, or ERROR.
+*/
+#define VTP_RECONFIG_NREG  10
+
+static void
+vtpStreamingNetCfgRegs(int inst, int mode, VTP_STREAMING_NETCFG *c, uint32_t *reg)
+{
+  unsigned int localport = (c->localport==0) ? 10001 : c->localport;
+  uint32_t dest = (c->destip[0]<<24) | (c->destip[1]<<16) | (c->destip[2]<<8) | (c->destip[3]<<0);
+
+  /* Same values as vtpStreamingSetNetCfg() writes */
+  reg[0] = (c->ipaddr[0]<<24) | (c->ipaddr[1]<<16) | (c->ipaddr[2]<<8) | (c->ipaddr[3]<<0);
+  reg[1] = (c->subnet[0]<<24) | (c->subnet[1]<<16) | (c->subnet[2]<<8) | (c->subnet[3]<<0);
+  reg[2] = (c->gateway[0]<<24) | (c->gateway[1]<<16) | (c->gateway[2]<<8) | (c->gateway[3]<<0);
+  reg[3] = (c->mac[0]<<8) | (c->mac[1]<<0);
+  reg[4] = (c->mac[2]<<24) | (c->mac[3]<<16) | (c->mac[4]<<8) | (c->mac[5]<<0);
+  if(mode)
+    {
+      reg[5] = vtpStreamingNetMtu(inst, mode);
+      reg[6] = 0;
+      reg[7] = localport<<16;
+      reg[8] = dest;
+      reg[9] = ((localport+1)<<16) | c->destport;
+    }
+  else
+    {
+      reg[5] = vtpStreamingNetMtu(inst, mode);
+      reg[6] = dest;
+      reg[7] = (localport<<16) | c->destport;
+      reg[8] = 0;
+      reg[9] = (localport+1)<<16;
+    }
+}
+
+int
+vtpStreamingReconfigure(int nstreams, int mode, VTP_STREAMING_NETCFG cfg[],
+			unsigned int *cdata, int dlen, int timeout_ms)
+{
+  int inst, ii, up, open, oldn;
+  int changed=0, resetMask=0, closeMask=0, ready=0, allMask;
+  uint32_t want[VTP_RECONFIG_NREG], live[VTP_RECONFIG_NREG];
+  uint64_t t0;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+  CHECKRANGE_INT(nstreams, 1, VTP_STREAMING_MAX_STREAMS);
+
+  if((mode!=0) && (mode!=1))
+    {
+      printf("%s: ERROR: Invalid mode (%d)\n",__func__,mode);
+      return ERROR;
+    }
+  if(cfg == NULL)
+    {
+      printf("%s: ERROR: cfg is NULL\n",__func__);
+      return ERROR;
+    }
+
+  t0 = vtpStreamingNowNs();
+  allMask = (1<<nstreams)-1;
+
+  VLOCK;
+  if(((vtp->ebiorx[0].Ctrl & 0x100) ? 1 : 0) != mode)
+    {
+      VUNLOCK;
+      printf("%s: ERROR: Transport mode changed to %s - a full Prestart is required\n",
+	     __func__, mode ? "UDP" : "TCP");
+      return ERROR;
+    }
+
+  oldn = vtp->v7.streamingEb.Ctrl3 & 0x7;
+
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      if(inst >= nstreams)
+	{
+	  if(vtp->tcpClient[inst].IP4_StateRequest)
+	    closeMask |= (1<<inst);
+	  continue;
+	}
+
+      /* A tuned MTU belongs to the path of the old destination */
+      vtpStreamingNetCfgRegs(inst, mode, &cfg[inst], want);
+      if((want[6] != vtp->tcpClient[inst].TCP_DEST_ADDR[0]) ||
+	 (want[8] != vtp->tcpClient[inst].UDP_DEST_ADDR))
+	{
+	  vtpStreamingTunedMtu[inst] = 0;
+	  vtpStreamingNetCfgRegs(inst, mode, &cfg[inst], want);
+	}
+      live[0] = vtp->tcpClient[inst].IP4_Addr;
+      live[1] = vtp->tcpClient[inst].IP4_SubnetMask;
+      live[2] = vtp->tcpClient[inst].IP4_GatewayAddr;
+      live[3] = vtp->tcpClient[inst].MAC_ADDR[1] & 0xFFFF;
+      live[4] = vtp->tcpClient[inst].MAC_ADDR[0];
+      live[5] = vtp->tcpClient[inst].MTU;
+      live[6] = vtp->tcpClient[inst].TCP_DEST_ADDR[0];
+      live[7] = vtp->tcpClient[inst].TCP_PORT[0];
+      live[8] = vtp->tcpClient[inst].UDP_DEST_ADDR;
+      live[9] = vtp->tcpClient[inst].UDP_PORT;
+
+      up   = vtp->tcpClient[inst].PCS_STATUS & 0x1;
+      open = (vtp->tcpClient[inst].IP4_StateRequest != 0) &&
+	(mode || (vtp->tcpClient[inst].IP4_TCPStatus & 0xff));
+
+      for(ii=0; ii<VTP_RECONFIG_NREG; ii++)
+	if(want[ii] != live[ii])
+	  break;
+
+      if((ii < VTP_RECONFIG_NREG) || !open || !up)
+	changed |= (1<<inst);
+      if(!up)
+	resetMask |= (1<<inst);
+    }
+
+  /* Close the streams that are no longer used */
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    if(closeMask & (1<<inst))
+      vtp->tcpClient[inst].IP4_StateRequest = 0;
+
+  vtp->v7.streamingEb.Ctrl3 = (vtp->v7.streamingEb.Ctrl3 & ~0x7) | nstreams;
+  vtp->v7.streamingEb.Ctrl |= 0x80000000;       // streaming_eb: RESET=1
+  vtp->v7.streamingEb.Ctrl &= 0x7FFFFFFF;       // streaming_eb: RESET=0
+  VUNLOCK;
+
+  /* EB reset restarted the frame counters */
+  vtpStreamingFrameClockInit();
+
+  for(inst=0; inst<nstreams; inst++)
+    {
+      if(!(changed & (1<<inst)))
+	continue;
+      if(vtpStreamingSetNetCfg(inst, mode, cfg[inst].ipaddr, cfg[inst].subnet,
+			       cfg[inst].gateway, cfg[inst].mac, cfg[inst].destip,
+			       cfg[inst].destport, cfg[inst].localport) != OK)
+	changed &= ~(1<<inst);
+    }
+
+  if(changed)
+    {
+      ready = vtpStreamingLinkWait(changed, resetMask, mode+1, timeout_ms);
+      vtpStreamingConnectData(ready, cdata, dlen);
+    }
+
+  printf("%s: nstreams %d -> %d: reconfigured 0x%x (link reset 0x%x), unchanged 0x%x, closed 0x%x in %llu ms\n",
+	 __func__, oldn, nstreams, changed, resetMask, allMask & ~changed, closeMask,
+	 (unsigned long long)((vtpStreamingNowNs() - t0)/1000000));
+
+  return (allMask & ~changed) | ready;
+}
+
+
+
+/* End of run drain
+    Wait for the streaming output to finish: both MIG DDR buffers must
+    stay empty (WriteDataCnt == ReadDataCnt) for VTP_DRAIN_QUIET_US.  The
+    frame and byte counters of the selected streams are only reported -
+    with the stream builder still enabled it keeps sending (empty) frames,
+    so they never stop changing.  Polls with vtpStreamingSnapshot(), so
+    the library mutex is not held.
+
+    result (optional): drain time, final counters and residual backlog.
+
+    Returns OK if the output drained within timeout_ms, otherwise ERROR.
+*/
+#define VTP_DRAIN_POLL_US    500
+#define VTP_DRAIN_QUIET_US   5000
+
+int
+vtpStreamingDrain(int streamMask, int timeout_ms, VTP_STREAMING_DRAIN *result)
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_DRAIN r;
+  uint64_t t0, tquiet, frames[VTP_STREAMING_MAX_STREAMS], bytes[VTP_STREAMING_MAX_STREAMS];
+  uint64_t bytes0[VTP_STREAMING_MAX_STREAMS];
+  int i, backlog;
+
+  CHECKINIT;
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  memset(&r, 0, sizeof(r));
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  t0 = tquiet = snap.timestamp_ns;
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      frames[i] = snap.port[i].frames_sent;
+      bytes[i]  = bytes0[i] = snap.port[i].bytes_sent;
+    }
+
+  while(1)
+    {
+      usleep(VTP_DRAIN_POLL_US);
+      vtpStreamingSnapshot(&snap);
+
+      for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+	{
+	  if(!(streamMask & (1<<i)))
+	    continue;
+	  frames[i] = snap.port[i].frames_sent;
+	  bytes[i]  = snap.port[i].bytes_sent;
+	}
+
+      backlog = 0;
+      for(i=0; i<2; i++)
+	{
+	  r.mig_backlog[i] = (int32_t)(snap.mig_write_data_cnt[i] - snap.mig_read_data_cnt[i]);
+	  if(r.mig_backlog[i])
+	    backlog = 1;
+	}
+
+      if(backlog)
+	tquiet = snap.timestamp_ns;
+      else if((snap.timestamp_ns - tquiet) >= VTP_DRAIN_QUIET_US*1000ull)
+	{
+	  r.drained = 1;
+	  break;
+	}
+
+      if((snap.timestamp_ns - t0) >= (uint64_t)timeout_ms*1000000ull)
+	break;
+    }
+
+  r.drain_us = (uint32_t)((tquiet - t0)/1000);
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      r.frames_sent[i]   = frames[i];
+      r.bytes_sent[i]    = bytes[i];
+      r.bytes_drained[i] = VTP_DELTA48(bytes[i], bytes0[i]);
+    }
+
+  if(!r.drained)
+    printf("%s: ERROR: Output not drained after %d ms (MIG backlog %d, %d)\n",
+	   __func__, timeout_ms, r.mig_backlog[0], r.mig_backlog[1]);
+
+  if(result)
+    memcpy(result, &r, sizeof(r));
+
+  return r.drained ? OK : ERROR;
+}
+
+/* Wait for events written to the async FIFO (e.g. End) to leave.  They do
+    not go through the MIG, so the output is checked instead: the EBIORX
+    byte counter of every selected stream must have advanced by at least
+    min_bytes since 'before' (vtpStreamingSnapshot() taken before the
+    events were written), and then stay unchanged for VTP_DRAIN_QUIET_US.
+
+    Returns OK if that happened within timeout_ms, otherwise ERROR
+    (result->sent tells whether the bytes at least left).
+*/
+int
+vtpStreamingDrainSent(int streamMask, const VTP_STREAMING_SNAPSHOT *before, uint32_t min_bytes,
+		      int timeout_ms, VTP_STREAMING_DRAIN *result)
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_DRAIN r;
+  uint64_t t0, tquiet, bytes[VTP_STREAMING_MAX_STREAMS];
+  int i, changed, sent;
+
+  CHECKINIT;
+
+  if(before == NULL)
+    {
+      printf("%s: ERROR: NULL snapshot\n", __func__);
+      return ERROR;
+    }
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  memset(&r, 0, sizeof(r));
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  t0 = tquiet = snap.timestamp_ns;
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    bytes[i] = snap.port[i].bytes_sent;
+
+  while(1)
+    {
+      sent = 1;
+      changed = 0;
+      for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+	{
+	  if(!(streamMask & (1<<i)))
+	    continue;
+	  if(VTP_DELTA48(snap.port[i].bytes_sent, before->port[i].bytes_sent) < min_bytes)
+	    sent = 0;
+	  if(snap.port[i].bytes_sent != bytes[i])
+	    changed = 1;
+	  bytes[i] = snap.port[i].bytes_sent;
+	}
+      r.sent = sent;
+
+      if(!sent || changed)
+	tquiet = snap.timestamp_ns;
+      else if((snap.timestamp_ns - tquiet) >= VTP_DRAIN_QUIET_US*1000ull)
+	{
+	  r.drained = 1;
+	  break;
+	}
+
+      if((snap.timestamp_ns - t0) >= (uint64_t)timeout_ms*1000000ull)
+	break;
+
+      usleep(VTP_DRAIN_POLL_US);
+      vtpStreamingSnapshot(&snap);
+    }
+
+  r.drain_us = (uint32_t)((tquiet - t0)/1000);
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      r.frames_sent[i]   = snap.port[i].frames_sent;
+      r.bytes_sent[i]    = snap.port[i].bytes_sent;
+      r.bytes_drained[i] = VTP_DELTA48(snap.port[i].bytes_sent, before->port[i].bytes_sent);
+    }
+  for(i=0; i<2; i++)
+    r.mig_backlog[i] = (int32_t)(snap.mig_write_data_cnt[i] - snap.mig_read_data_cnt[i]);
+
+  if(!r.drained)
+    printf("%s: ERROR: Output not %s after %d ms\n", __func__,
+	   r.sent ? "quiet" : "sent", timeout_ms);
+
+  if(result)
+    memcpy(result, &r, sizeof(r));
+
+  return r.drained ? OK : ERROR;
+}
+
+
+
+/* Load balancer sync sender
+    Sends an "LC" sync packet for each selected stream to every destination,
+    at 1-1000 Hz.  Cycles are scheduled on absolute CLOCK_MONOTONIC times, so
+    the rate does not drift with the time spent sending; the wakeup jitter is
+    accumulated in the statistics.
+
+    Timestamps are wall clock: at Start the frame clock of each stream is
+    anchored to CLOCK_REALTIME, and frame N is stamped
+      anchor_ns + (N - anchor_frame) * frame_ns
+*/
+#define VTP_SYNC_RATE_WINDOW_NS   100000000ull  /* min. window for evt_rate */
+
+typedef struct
+{
+  char host[64];
+  int port;
+  int mask;                               /* streams reported */
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+} vtpSyncDest_t;
+
+static pthread_mutex_t vtpSyncMutex = PTHREAD_MUTEX_INITIALIZER;
+static vtpSyncDest_t vtpSyncDest[VTP_SYNC_MAX_DEST];
+static int vtpSyncNDest = 0;
+static uint32_t vtpSyncSrcId[VTP_STREAMING_MAX_STREAMS];
+static int vtpSyncSrcIdMask = 0;          /* streams with a user srcId */
+static int vtpSyncSock = -1;
+static volatile int vtpSyncRateHz = 1;
+static int vtpSyncPktLen = VTP_SYNC_PKT_LEN;
+static VTP_STREAMING_SYNC_STATS vtpSyncStats;
+static double vtpSyncJitterSum = 0., vtpSyncJitterSum2 = 0.;
+
+static pthread_t vtpSyncThread;
+static volatile int vtpSyncThreadRun = 0;
+
+/**
+ * Set sync packet data in the specified format for load balancer.
+ *
+ * @param buffer   Buffer (VTP_SYNC_PKT_LEN bytes) in which to write the data.
+ * @param version  Software version.
+ * @param srcId    Identifier for this data source.
+ * @param evtNum   64-bit event (frame) number - the most recent frame this
+ *                 source has already sent.
+ * @param evtRate  Event (frame) rate in Hz (0 if unknown).
+ * @param nanos    Unix timestamp in nanoseconds of evtNum (0 if unknown).
+ *
+ * evt_num and nanos are true big endian (most significant byte first).
+ * The sender this replaced (ROL htonll) sent the low 32 bit word first.
+ */
+void
+vtpStreamingSyncSetData(char *buffer, int version, uint32_t srcId,
+			uint64_t evtNum, uint32_t evtRate, uint64_t nanos)
+{
+  VTP_SYNC_PKT pkt;
+
+  pkt.magic[0] = VTP_SYNC_MAGIC_0;
+  pkt.magic[1] = VTP_SYNC_MAGIC_1;
+  pkt.version  = (uint8_t)version;
+  pkt.reserved = 0;
+  pkt.src_id   = htonl(srcId);
+  pkt.evt_num  = ((uint64_t)htonl((uint32_t)evtNum) << 32) | htonl((uint32_t)(evtNum >> 32));
+  pkt.evt_rate = htonl(evtRate);
+  pkt.nanos    = ((uint64_t)htonl((uint32_t)nanos) << 32) | htonl((uint32_t)(nanos >> 32));
+
+  memcpy(buffer, &pkt, sizeof(pkt));
+}
+
+/* Add a destination (host or dotted IP, UDP port) receiving the sync
+   packets of the streams in streamMask */
+int
+vtpStreamingSyncAddDest(const char *host, int port, int streamMask)
+{
+  struct addrinfo hints, *res = NULL;
+  char port_str[16];
+  vtpSyncDest_t *d;
+  int rval;
+
+  if((host == NULL) || (*host == 0) || (strlen(host) >= sizeof(d->host)))
+    {
+      printf("%s: ERROR: Invalid host\n", __func__);
+      return ERROR;
+    }
+  if((port <= 0) || (port > 65535))
+    {
+      printf("%s: ERROR: Invalid port (%d)\n", __func__, port);
+      return ERROR;
+    }
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  if(streamMask == 0)
+    {
+      printf("%s: ERROR: No streams selected\n", __func__);
+      return ERROR;
+    }
+
+  snprintf(port_str, sizeof(port_str), "%d", port);
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+  rval = getaddrinfo(host, port_str, &hints, &res);
+  if((rval != 0) || (res == NULL) || (res->ai_addrlen > sizeof(struct sockaddr_storage)))
+    {
+      printf("%s: ERROR: Unable to resolve %s:%d (%s)\n", __func__, host, port,
+	     (rval != 0) ? gai_strerror(rval) : "bad address");
+      if(res)
+	freeaddrinfo(res);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpSyncMutex);
+  if(vtpSyncNDest >= VTP_SYNC_MAX_DEST)
+    {
+      pthread_mutex_unlock(&vtpSyncMutex);
+      freeaddrinfo(res);
+      printf("%s: ERROR: Too many destinations (max %d)\n", __func__, VTP_SYNC_MAX_DEST);
+      return ERROR;
+    }
+
+  d = &vtpSyncDest[vtpSyncNDest++];
+  strcpy(d->host, host);
+  d->port    = port;
+  d->mask    = streamMask;
+  memcpy(&d->addr, res->ai_addr, res->ai_addrlen);
+  d->addrlen = res->ai_addrlen;
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  freeaddrinfo(res);
+
+  return OK;
+}
+
+int
+vtpStreamingSyncClearDest()
+{
+  pthread_mutex_lock(&vtpSyncMutex);
+  vtpSyncNDest = 0;
+  memset(vtpSyncDest, 0, sizeof(vtpSyncDest));
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  return OK;
+}
+
+/* Source id reported for a stream.  Default is ROCID + stream. */
+int
+vtpStreamingSyncSetSrcId(int stream, uint32_t srcId)
+{
+  if((stream < 0) || (stream >= VTP_STREAMING_MAX_STREAMS))
+    {
+      printf("%s: ERROR: Invalid stream (%d)\n", __func__, stream);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpSyncMutex);
+  vtpSyncSrcId[stream] = srcId;
+  vtpSyncSrcIdMask |= (1<<stream);
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  return OK;
+}
+
+/* Length of the sync packets sent.  Bytes past the LC packet
+   (VTP_SYNC_PKT_LEN) are zero. */
+int
+vtpStreamingSyncSetPktLen(int len)
+{
+  if((len < VTP_SYNC_PKT_LEN) || (len > VTP_SYNC_MAX_PKT_LEN))
+    {
+      printf("%s: ERROR: Invalid length (%d). Must be %d-%d\n", __func__,
+	     len, VTP_SYNC_PKT_LEN, VTP_SYNC_MAX_PKT_LEN);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpSyncMutex);
+  vtpSyncPktLen = len;
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  return OK;
+}
+
+static void *
+vtpStreamingSyncThreadMain(void *arg)
+{
+  uint64_t anchor_frame[VTP_STREAMING_MAX_STREAMS], anchor_ns[VTP_STREAMING_MAX_STREAMS];
+  uint64_t rate_frame[VTP_STREAMING_MAX_STREAMS], rate_t[VTP_STREAMING_MAX_STREAMS];
+  uint32_t rate[VTP_STREAMING_MAX_STREAMS], frame_ns;
+  uint64_t period, t_next, t_now, frame, nskip;
+  struct timespec ts;
+  int64_t jitter;
+  char buf[VTP_SYNC_MAX_PKT_LEN];
+  int i, d, mask;
+
+  memset(buf, 0, sizeof(buf));
+  frame_ns = vtpStreamingGetFrameNs();
+
+  /* Anchor each stream's frame clock to the wall clock */
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      frame = vtpStreamingGetFrameCnt64(i);
+      clock_gettime(CLOCK_REALTIME, &ts);
+      anchor_frame[i] = vtpStreamingGetFrameCnt64(i);  /* newest frame at the wall time */
+      anchor_ns[i]    = ((uint64_t)ts.tv_sec)*1000000000ull + ts.tv_nsec;
+      if(anchor_frame[i] != frame)  /* frame boundary between the reads */
+	anchor_ns[i] += frame_ns/2;
+
+      rate_frame[i] = anchor_frame[i];
+      rate_t[i]     = vtpStreamingNowNs();
+      rate[i]       = 0;
+    }
+
+  t_next = vtpStreamingNowNs();
+
+  while(vtpSyncThreadRun)
+    {
+      period = 1000000000ull / vtpSyncRateHz;
+      t_next += period;
+
+      ts.tv_sec  = t_next / 1000000000ull;
+      ts.tv_nsec = t_next % 1000000000ull;
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+	;
+      if(!vtpSyncThreadRun)
+	break;
+
+      t_now  = vtpStreamingNowNs();
+      jitter = (int64_t)(t_now - t_next);
+
+      pthread_mutex_lock(&vtpSyncMutex);
+      vtpSyncStats.ncycles++;
+      if(jitter < vtpSyncStats.jitter_min_ns || vtpSyncStats.ncycles == 1)
+	vtpSyncStats.jitter_min_ns = jitter;
+      if(jitter > vtpSyncStats.jitter_max_ns || vtpSyncStats.ncycles == 1)
+	vtpSyncStats.jitter_max_ns = jitter;
+      vtpSyncJitterSum  += (double)jitter;
+      vtpSyncJitterSum2 += (double)jitter*(double)jitter;
+
+      /* Woke more than a period late: skip the missed cycles */
+      if(jitter > (int64_t)period)
+	{
+	  nskip = (uint64_t)jitter / period;
+	  vtpSyncStats.nlate += nskip;
+	  t_next += nskip*period;
+	}
+
+      mask = 0;
+      for(d=0; d<vtpSyncNDest; d++)
+	mask |= vtpSyncDest[d].mask;
+
+      for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+	{
+	  if(!(mask & (1<<i)))
+	    continue;
+
+	  frame = vtpStreamingGetFrameCnt64(i);
+
+	  /* Frame rate over at least VTP_SYNC_RATE_WINDOW_NS */
+	  if((t_now - rate_t[i]) >= VTP_SYNC_RATE_WINDOW_NS)
+	    {
+	      rate[i] = (uint32_t)(((double)(frame - rate_frame[i]))*1.0e9 /
+				   (double)(t_now - rate_t[i]) + 0.5);
+	      rate_frame[i] = frame;
+	      rate_t[i]     = t_now;
+	    }
+
+	  vtpStreamingSyncSetData(buf, VTP_SYNC_VERSION, vtpSyncSrcId[i], frame, rate[i],
+				  anchor_ns[i] + (frame - anchor_frame[i])*frame_ns);
+
+	  for(d=0; d<vtpSyncNDest; d++)
+	    {
+	      if(!(vtpSyncDest[d].mask & (1<<i)))
+		continue;
+	      if(sendto(vtpSyncSock, buf, vtpSyncPktLen, 0,
+			(struct sockaddr *)&vtpSyncDest[d].addr, vtpSyncDest[d].addrlen) < 0)
+		vtpSyncStats.nerrors++;
+	      else
+		vtpSyncStats.npkts++;
+	    }
+	}
+      pthread_mutex_unlock(&vtpSyncMutex);
+    }
+
+  return NULL;
+}
+
+/* Start sending sync packets at rate_hz (1-1000) to the destinations
+   added with vtpStreamingSyncAddDest().  If already running, only the
+   rate is changed. */
+int
+vtpStreamingSyncStart(int rate_hz)
+{
+  int i, rval, rocid;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+
+  if((rate_hz < VTP_SYNC_MIN_HZ) || (rate_hz > VTP_SYNC_MAX_HZ))
+    {
+      printf("%s: ERROR: Invalid rate (%d Hz). Must be %d-%d\n", __func__,
+	     rate_hz, VTP_SYNC_MIN_HZ, VTP_SYNC_MAX_HZ);
+      return ERROR;
+    }
+
+  vtpSyncRateHz = rate_hz;
+  if(vtpSyncThreadRun)
+    return OK;
+
+  if(vtpSyncNDest == 0)
+    {
+      printf("%s: ERROR: No destinations\n", __func__);
+      return ERROR;
+    }
+
+  vtpSyncSock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if(vtpSyncSock < 0)
+    {
+      printf("%s: ERROR: socket failed: %s\n", __func__, strerror(errno));
+      return ERROR;
+    }
+
+  rocid = vtp->v7.streamingEb.rocid & 0xFFFF;
+
+  pthread_mutex_lock(&vtpSyncMutex);
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    if(!(vtpSyncSrcIdMask & (1<<i)))
+      vtpSyncSrcId[i] = rocid + i;
+
+  memset(&vtpSyncStats, 0, sizeof(vtpSyncStats));
+  vtpSyncJitterSum = vtpSyncJitterSum2 = 0.;
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  vtpSyncThreadRun = 1;
+  rval = pthread_create(&vtpSyncThread, NULL, vtpStreamingSyncThreadMain, NULL);
+  if(rval != 0)
+    {
+      vtpSyncThreadRun = 0;
+      close(vtpSyncSock);
+      vtpSyncSock = -1;
+      printf("%s: ERROR: pthread_create failed: %s\n", __func__, strerror(rval));
+      return ERROR;
+    }
+
+  for(i=0; i<vtpSyncNDest; i++)
+    printf("%s: %d Hz to %s:%d (streams 0x%x)\n", __func__, rate_hz,
+	   vtpSyncDest[i].host, vtpSyncDest[i].port, vtpSyncDest[i].mask);
+
+  return OK;
+}
+
+int
+vtpStreamingSyncStop()
+{
+  if(!vtpSyncThreadRun)
+    return OK;
+
+  vtpSyncThreadRun = 0;
+  pthread_join(vtpSyncThread, NULL);
+
+  close(vtpSyncSock);
+  vtpSyncSock = -1;
+
+  return OK;
+}
+
+int
+vtpStreamingSyncGetStats(VTP_STREAMING_SYNC_STATS *stats)
+{
+  double n, avg;
+
+  if(stats == NULL)
+    {
+      printf("%s: ERROR: NULL stats pointer\n", __func__);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpSyncMutex);
+  memcpy(stats, &vtpSyncStats, sizeof(VTP_STREAMING_SYNC_STATS));
+  stats->rate_hz = vtpSyncRateHz;
+  stats->ndest   = vtpSyncNDest;
+  n = (double)vtpSyncStats.ncycles;
+  if(n > 0)
+    {
+      avg = vtpSyncJitterSum / n;
+      stats->jitter_avg_ns = avg;
+      stats->jitter_rms_ns = sqrt(fmax(vtpSyncJitterSum2/n - avg*avg, 0.));
+    }
+  pthread_mutex_unlock(&vtpSyncMutex);
+
+  return OK;
+}
+
+int
+vtpStreamingSyncPrintStats()
+{
+  VTP_STREAMING_SYNC_STATS s;
+
+  vtpStreamingSyncGetStats(&s);
+
+  printf("---------------------------------------\n");
+  printf("--VTP Sync Sender (%u Hz, %u destinations)\n", s.rate_hz, s.ndest);
+  printf("  Cycles  %llu  (skipped %llu)\n",
+	 (unsigned long long)s.ncycles, (unsigned long long)s.nlate);
+  printf("  Packets %llu  (errors %llu)\n",
+	 (unsigned long long)s.npkts, (unsigned long long)s.nerrors);
+  printf("  Jitter  min %lld  max %lld  avg %.0f  rms %.0f ns\n",
+	 (long long)s.jitter_min_ns, (long long)s.jitter_max_ns,
+	 s.jitter_avg_ns, s.jitter_rms_ns);
+  printf("---------------------------------------\n");
+
+  return OK;
+}
+
+
+
+/* Payload to stream balancing
+    Payloads are assigned to the network streams from a profile of their
+    data volume (bytes/s per payload port), largest first to the least
+    loaded stream (LPT).  Ties go to the lowest payload / stream number, so
+    the same profile always gives the same assignment.
+
+    Profile file:   # comment
+                    PAYLOAD <port 1-16> <bytes/s>
+
+    The profile is measured by vtpStreamRecv (-P).  The board only sees the
+    bytes sent per stream, so vtpStreamingBalanceEnd() measures a payload
+    only when it is the single payload on its stream; the volume of payloads
+    sharing a stream is not known on the board and is never estimated.
+*/
+static int   vtpBalanceMask = 0, vtpBalanceNstreams = 0;
+static int   vtpBalanceStream[VTP_STREAMING_NPAYLOAD];
+static float vtpBalanceWeight[VTP_STREAMING_NPAYLOAD];
+static float vtpBalancePredicted[VTP_STREAMING_MAX_STREAMS];
+static VTP_STREAMING_SNAPSHOT vtpBalanceStartSnap;
+static int   vtpBalanceStarted = 0;
+static int   vtpBalanceRemapped = 0;     /* payloads moved by the link supervisor */
+
+int
+vtpStreamingProfileLoad(const char *fname, float weight[VTP_STREAMING_NPAYLOAD])
+{
+  char line[256];
+  FILE *f;
+  int port, n = 0;
+  float w;
+
+  if((fname == NULL) || (weight == NULL))
+    return ERROR;
+
+  f = fopen(fname, "r");
+  if(f == NULL)
+    {
+      printf("%s: ERROR: Unable to open %s: %s\n", __func__, fname, strerror(errno));
+      return ERROR;
+    }
+
+  memset(weight, 0, VTP_STREAMING_NPAYLOAD*sizeof(float));
+  while(fgets(line, sizeof(line), f))
+    {
+      if(sscanf(line, "PAYLOAD %d %f", &port, &w) != 2)
+	continue;
+      if((port < 1) || (port > VTP_STREAMING_NPAYLOAD) || (w < 0))
+	{
+	  printf("%s: WARNING: Ignoring invalid line in %s: %s", __func__, fname, line);
+	  continue;
+	}
+      weight[port-1] = w;
+      n++;
+    }
+  fclose(f);
+
+  return n;
+}
+
+int
+vtpStreamingProfileSave(const char *fname, const float weight[VTP_STREAMING_NPAYLOAD])
+{
+  char tmp[512];
+  time_t t = time(NULL);
+  FILE *f;
+  int i;
+
+  if((fname == NULL) || (weight == NULL) || (strlen(fname) > sizeof(tmp)-8))
+    return ERROR;
+
+  /* Write a new file and rename, so readers never see a partial profile */
+  sprintf(tmp, "%s.tmp", fname);
+  f = fopen(tmp, "w");
+  if(f == NULL)
+    {
+      printf("%s: ERROR: Unable to open %s: %s\n", __func__, tmp, strerror(errno));
+      return ERROR;
+    }
+
+  fprintf(f, "# VTP streaming payload profile (bytes/s)  %s", ctime(&t));
+  for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+    if(weight[i] > 0)
+      fprintf(f, "PAYLOAD %2d %.0f\n", i+1, weight[i]);
+  fclose(f);
+
+  if(rename(tmp, fname) != 0)
+    {
+      printf("%s: ERROR: rename %s: %s\n", __func__, fname, strerror(errno));
+      return ERROR;
+    }
+
+  return OK;
+}
+
+/* Assign the payloads in mask to nstreams streams (sets ppInfo[].streamInfo).
+   weight: per payload data volume, NULL or all 0: same weight for all. */
+int
+vtpStreamingBalance(int mask, int nstreams, const float weight[VTP_STREAMING_NPAYLOAD], PP_CONF *ppInfo)
+{
+  float w[VTP_STREAMING_NPAYLOAD], load[VTP_STREAMING_MAX_STREAMS], total = 0, max = 0;
+  int order[VTP_STREAMING_NPAYLOAD], n = 0, i, j, k, s, equal = 1;
+
+  if(ppInfo == NULL)
+    return ERROR;
+  CHECKRANGE_INT(nstreams, 1, VTP_STREAMING_MAX_STREAMS);
+
+  mask &= (1<<VTP_STREAMING_NPAYLOAD)-1;
+  for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+    {
+      w[i] = (weight && (mask & (1<<i))) ? weight[i] : 0;
+      if(w[i] > 0)
+	equal = 0;
+    }
+
+  /* Payloads of the mask, largest weight first (stable: lower port first) */
+  for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+    {
+      if(!(mask & (1<<i)))
+	continue;
+      if(equal)
+	w[i] = 1;
+      for(j=n; (j>0) && (w[order[j-1]] < w[i]); j--)
+	order[j] = order[j-1];
+      order[j] = i;
+      n++;
+    }
+
+  memset(load, 0, sizeof(load));
+  for(k=0; k<n; k++)
+    {
+      i = order[k];
+      for(s=0, j=1; j<nstreams; j++)
+	if(load[j] < load[s])
+	  s = j;
+      load[s] += w[i];
+      ppInfo[i].streamInfo = s+1;
+      vtpBalanceStream[i]  = s;
+      total += w[i];
+    }
+
+  vtpBalanceMask     = mask;
+  vtpBalanceNstreams = nstreams;
+  vtpBalanceRemapped = 0;
+  memcpy(vtpBalanceWeight, w, sizeof(w));
+  memcpy(vtpBalancePredicted, load, sizeof(load));
+
+  printf("%s: %d payloads on %d streams (%s)\n", __func__, n, nstreams,
+	 equal ? "no profile, equal weights" : "from profile");
+  for(s=0; s<nstreams; s++)
+    {
+      printf("  Stream %d: payloads", s+1);
+      for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+	if((mask & (1<<i)) && (vtpBalanceStream[i] == s))
+	  printf(" %d", i+1);
+      printf("   predicted %5.1f%%\n", total > 0 ? 100.*load[s]/total : 0.);
+      if(load[s] > max)
+	max = load[s];
+    }
+  if(total > 0)
+    printf("  Predicted imbalance (max/mean): %.3f\n", max*nstreams/total);
+
+  return OK;
+}
+
+/* Start measuring the achieved balance (call at Go) */
+int
+vtpStreamingBalanceStart()
+{
+  if(vtpStreamingSnapshot(&vtpBalanceStartSnap) != OK)
+    return ERROR;
+  vtpBalanceStarted = 1;
+
+  return OK;
+}
+
+/* Report the achieved balance since vtpStreamingBalanceStart() and return
+   the measured per payload volume (bytes/s) in weight: set only for the
+   payloads alone on their stream, 0 for the others. */
+int
+vtpStreamingBalanceEnd(float weight[VTP_STREAMING_NPAYLOAD])
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  double bytes[VTP_STREAMING_MAX_STREAMS], total = 0, dt, max = 0;
+  float predTotal = 0;
+  int i, s, n, last = 0, nmeas = 0;
+
+  if(!vtpBalanceStarted || (vtpBalanceNstreams == 0))
+    {
+      printf("%s: ERROR: No balanced assignment measured\n", __func__);
+      return ERROR;
+    }
+  vtpBalanceStarted = 0;
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  dt = (double)(snap.timestamp_ns - vtpBalanceStartSnap.timestamp_ns) * 1.0e-9;
+  if(dt <= 0)
+    return ERROR;
+
+  for(s=0; s<vtpBalanceNstreams; s++)
+    {
+      bytes[s] = (double)VTP_DELTA48(snap.port[s].bytes_sent,
+				     vtpBalanceStartSnap.port[s].bytes_sent);
+      total     += bytes[s];
+      predTotal += vtpBalancePredicted[s];
+      if(bytes[s] > max)
+	max = bytes[s];
+    }
+
+  printf("%s: %.1f s, %.0f MB\n", __func__, dt, total*1.0e-6);
+  for(s=0; s<vtpBalanceNstreams; s++)
+    printf("  Stream %d: predicted %5.1f%%  achieved %5.1f%%  (%.1f MB/s)\n", s+1,
+	   predTotal > 0 ? 100.*vtpBalancePredicted[s]/predTotal : 0.,
+	   total > 0 ? 100.*bytes[s]/total : 0., bytes[s]/dt*1.0e-6);
+  if(total > 0)
+    printf("  Achieved imbalance (max/mean): %.3f\n", max*vtpBalanceNstreams/total);
+
+  if(weight == NULL)
+    return OK;
+
+  memset(weight, 0, VTP_STREAMING_NPAYLOAD*sizeof(float));
+  if(vtpBalanceRemapped)
+    {
+      printf("  Payloads remapped during the run, none measured\n");
+      return OK;
+    }
+
+  /* A stream's rate is a payload volume only if the stream carries one payload */
+  for(s=0; s<vtpBalanceNstreams; s++)
+    {
+      n = 0;
+      for(i=0; i<VTP_STREAMING_NPAYLOAD; i++)
+	if((vtpBalanceMask & (1<<i)) && (vtpBalanceStream[i] == s))
+	  {
+	    n++;
+	    last = i;
+	  }
+      if(n == 1)
+	{
+	  weight[last] = (float)(bytes[s]/dt);
+	  nmeas++;
+	}
+    }
+  printf("  Payloads measured: %d\n", nmeas);
+
+  return OK;
+}
+
+
+
+/* Link supervisor
+    A thread polls the supervised streams with vtpStreamingSnapshot() (the
+    library mutex is not held while polling) and declares a link failed when
+      - the PCS link goes down,
+      - an established TCP connection is lost, or
+      - the EB keeps building frames for the stream but none are sent for
+        stall_ms (the link or its receiver stopped, data backs up in MIG).
+    Each failure raises an alarm: a User Event (tag VTP_STREAMING_ALARM_TAG)
+    on the healthy streams and the optional alarm callback.  Then, with
+      VTP_FAILOVER_REMAP    the payloads of the stream are moved to the
+                            healthy streams (pp_cfg) - the stream keeps no
+                            payloads for the rest of the run.  The move is
+                            written back to the caller's ppInfo, so a
+                            restart after Pause/Go starts from the remapped
+                            assignment, and the run's payload volumes are
+                            not measured (vtpStreamingBalanceEnd)
+      VTP_FAILOVER_STANDBY  the socket is moved to the standby destination
+                            (vtpStreamingSupervisorSetStandby)
+    otherwise the supervisor waits for the link to come back by itself.
+
+    Frames the EB built for the stream but that were not sent between the
+    last good sample and the recovery (or remap) are counted as lost; the
+    lost bytes are estimated with the stream's average bytes per frame.
+    A second alarm reports the recovery (callback reason 0) with these
+    numbers.
+*/
+#define VTP_SUPERVISOR_POLL_MS      10
+#define VTP_SUPERVISOR_STANDBY_MS   2000
+
+enum
+  {
+    VTP_LINK_OK=0,
+    VTP_LINK_FAILED,
+    VTP_LINK_SWITCHED,
+    VTP_LINK_RECOVERING
+  };
+
+typedef struct
+{
+  uint32_t frame_cnt;        /* at the last good sample */
+  uint64_t frames_sent;
+  uint64_t bytes_sent;
+  uint64_t good_ns;
+  uint64_t recover_ns;       /* link back since */
+  int      connected;
+  uint64_t frames_sent0;     /* at start, for the bytes/frame average */
+  uint64_t bytes_sent0;
+} vtpSupLink_t;
+
+static pthread_mutex_t vtpSupMutex = PTHREAD_MUTEX_INITIALIZER;
+static VTP_STREAMING_SUPERVISOR vtpSup;
+static vtpSupLink_t vtpSupLink[VTP_STREAMING_MAX_STREAMS];
+static PP_CONF vtpSupPP[VTP_STREAMING_NPAYLOAD];
+static PP_CONF *vtpSupPPUser = NULL;   /* caller's ppInfo, remaps are written back */
+static int vtpSupPPMask = 0;
+static unsigned char  vtpSupStandbyIp[VTP_STREAMING_MAX_STREAMS][4];
+static unsigned short vtpSupStandbyPort[VTP_STREAMING_MAX_STREAMS];
+static int vtpSupStandbyMask = 0;
+static VTP_STREAMING_ALARM_FUNC vtpSupAlarmFunc = NULL;
+static void *vtpSupAlarmArg = NULL;
+
+static pthread_t vtpSupThread;
+static volatile int vtpSupThreadRun = 0;
+
+/* Standby destination of a stream for VTP_FAILOVER_STANDBY */
+int
+vtpStreamingSupervisorSetStandby(int stream, unsigned char destip[4], unsigned short destport)
+{
+  CHECKRANGE_INT(stream, 0, VTP_STREAMING_MAX_STREAMS-1);
+
+  pthread_mutex_lock(&vtpSupMutex);
+  if(destip == NULL)
+    vtpSupStandbyMask &= ~(1<<stream);
+  else
+    {
+      memcpy(vtpSupStandbyIp[stream], destip, 4);
+      vtpSupStandbyPort[stream] = destport;
+      vtpSupStandbyMask |= (1<<stream);
+    }
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  return OK;
+}
+
+/* Called from the supervisor thread for every alarm.
+    reason = VTP_LINK_FAIL_* when the link fails, 0 when it recovered */
+int
+vtpStreamingSupervisorSetAlarm(VTP_STREAMING_ALARM_FUNC func, void *arg)
+{
+  pthread_mutex_lock(&vtpSupMutex);
+  vtpSupAlarmFunc = func;
+  vtpSupAlarmArg  = arg;
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  return OK;
+}
+
+static int
+vtpSupHealthyMask()
+{
+  int i, mask=0;
+
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    if((vtpSup.streamMask & (1<<i)) && (vtpSup.link[i].state == VTP_LINK_OK))
+      mask |= (1<<i);
+
+  return mask;
+}
+
+/* Alarm User Event: stream, reason, action, target, switch_ms,
+   lost frames (lo,hi), lost bytes (lo,hi) */
+static void
+vtpSupAlarm(int stream, int reason)
+{
+  VTP_STREAMING_LINK_HEALTH h;
+  VTP_STREAMING_ALARM_FUNC func;
+  void *arg;
+  unsigned int ev[11];
+  int mask;
+
+  pthread_mutex_lock(&vtpSupMutex);
+  h     = vtpSup.link[stream];
+  mask  = vtpSupHealthyMask();
+  func  = vtpSupAlarmFunc;
+  arg   = vtpSupAlarmArg;
+  vtpSup.nalarm++;
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  if(reason)
+    printf("%s: **ALARM** Stream %d failed:%s%s%s (failover %d)\n", __func__, stream+1,
+	   (reason & VTP_LINK_FAIL_PCS) ? " PCS link down" : "",
+	   (reason & VTP_LINK_FAIL_TCP) ? " TCP connection lost" : "",
+	   (reason & VTP_LINK_FAIL_STALL) ? " output stalled" : "",
+	   h.action);
+  else
+    printf("%s: Stream %d %s after %u ms: %llu frames (~%llu bytes) lost\n", __func__, stream+1,
+	   (h.state == VTP_LINK_SWITCHED) ? "payloads remapped" : "recovered",
+	   h.switch_ms, (unsigned long long)h.lost_frames, (unsigned long long)h.lost_bytes);
+
+  ev[0]  = 10;
+  ev[1]  = (VTP_STREAMING_ALARM_TAG<<16) | (0x1<<8);
+  ev[2]  = stream;
+  ev[3]  = reason;
+  ev[4]  = h.action;
+  ev[5]  = h.target;
+  ev[6]  = h.switch_ms;
+  ev[7]  = (unsigned int)(h.lost_frames & 0xFFFFFFFF);
+  ev[8]  = (unsigned int)(h.lost_frames >> 32);
+  ev[9]  = (unsigned int)(h.lost_bytes & 0xFFFFFFFF);
+  ev[10] = (unsigned int)(h.lost_bytes >> 32);
+
+  if(mask && (vtp->v7.streamingEb.Ctrl3 & VTP_STREB_ASYNC_FIFO_EN))
+    vtpStreamingEvioWriteUserEvent(mask, ev);
+
+  if(func)
+    (*func)(stream, reason, h.action, arg);
+}
+
+/* Frames built for the stream since the last good sample but not sent */
+static void
+vtpSupLost(int stream, VTP_STREAMING_PORT *p, uint64_t now_ns)
+{
+  vtpSupLink_t *L = &vtpSupLink[stream];
+  VTP_STREAMING_LINK_HEALTH *h = &vtpSup.link[stream];
+  uint64_t built, sent, nf;
+
+  built = (uint32_t)(p->frame_cnt - L->frame_cnt);
+  sent  = VTP_DELTA48(p->frames_sent, L->frames_sent);
+  nf    = VTP_DELTA48(L->frames_sent, L->frames_sent0);
+
+  h->lost_frames = (built > sent) ? built - sent : 0;
+  h->lost_bytes  = nf ? h->lost_frames * VTP_DELTA48(L->bytes_sent, L->bytes_sent0) / nf : 0;
+  h->switch_ms   = (uint32_t)((now_ns - L->good_ns)/1000000);
+}
+
+/* Move the payloads of a failed stream to the healthy stream with the
+   fewest payloads, in pp_cfg, the caller's ppInfo and the balance
+   assignment.  Returns the mask of streams that took payloads (0 if the
+   stream carries none), ERROR if there is no healthy stream. */
+static int
+vtpSupRemap(int stream, int healthy)
+{
+  int ii, s, best, n[VTP_STREAMING_MAX_STREAMS], target=0;
+
+  if(healthy == 0)
+    return ERROR;
+
+  memset(n, 0, sizeof(n));
+  for(ii=0; ii<VTP_STREAMING_NPAYLOAD; ii++)
+    if((vtpSupPPMask & (1<<ii)) && (vtpSupPP[ii].streamInfo >= 1))
+      n[(vtpSupPP[ii].streamInfo-1) & 0x3]++;
+
+  VLOCK;
+  for(ii=0; ii<VTP_STREAMING_NPAYLOAD; ii++)
+    {
+      if(!(vtpSupPPMask & (1<<ii)) || (vtpSupPP[ii].streamInfo != (unsigned int)(stream+1)))
+	continue;
+
+      best = -1;
+      for(s=0; s<VTP_STREAMING_MAX_STREAMS; s++)
+	if((healthy & (1<<s)) && ((best < 0) || (n[s] < n[best])))
+	  best = s;
+
+      vtpSupPP[ii].streamInfo = best+1;
+      vtpSupPPUser[ii].streamInfo = best+1;
+      vtpBalanceStream[ii] = best;
+      vtpBalanceRemapped = 1;
+      n[best]++;
+      vtp->v7.streamingEb.pp_cfg[ii] = best<<30;
+      target |= (1<<best);
+      printf("%s: Payload %d: stream %d -> %d\n", __func__, ii+1, stream+1, best+1);
+    }
+  VUNLOCK;
+
+  return target;
+}
+
+/* Move the socket of a failed stream to its standby destination */
+static int
+vtpSupStandby(int stream, int udp, int link_up)
+{
+  uint32_t dest;
+  int ready;
+
+  dest = (vtpSupStandbyIp[stream][0]<<24) | (vtpSupStandbyIp[stream][1]<<16) |
+    (vtpSupStandbyIp[stream][2]<<8) | (vtpSupStandbyIp[stream][3]<<0);
+
+  printf("%s: Stream %d -> %d.%d.%d.%d:%d\n", __func__, stream+1,
+	 vtpSupStandbyIp[stream][0], vtpSupStandbyIp[stream][1],
+	 vtpSupStandbyIp[stream][2], vtpSupStandbyIp[stream][3],
+	 vtpSupStandbyPort[stream]);
+
+  VLOCK;
+  vtp->tcpClient[stream].IP4_StateRequest = 0;
+  if(udp)
+    {
+      vtp->tcpClient[stream].UDP_DEST_ADDR = dest;
+      vtp->tcpClient[stream].UDP_PORT =
+	(vtp->tcpClient[stream].UDP_PORT & 0xFFFF0000) | vtpSupStandbyPort[stream];
+    }
+  else
+    {
+      vtp->tcpClient[stream].TCP_DEST_ADDR[0] = dest;
+      vtp->tcpClient[stream].TCP_PORT[0] =
+	(vtp->tcpClient[stream].TCP_PORT[0] & 0xFFFF0000) | vtpSupStandbyPort[stream];
+    }
+  VUNLOCK;
+
+  ready = vtpStreamingLinkWait(1<<stream, link_up ? 0 : (1<<stream),
+			       udp ? 2 : 1, VTP_SUPERVISOR_STANDBY_MS);
+
+  return (ready & (1<<stream)) ? OK : ERROR;
+}
+
+static void
+vtpSupGood(int stream, VTP_STREAMING_PORT *p, uint64_t now_ns)
+{
+  vtpSupLink_t *L = &vtpSupLink[stream];
+
+  L->frame_cnt   = p->frame_cnt;
+  L->frames_sent = p->frames_sent;
+  L->bytes_sent  = p->bytes_sent;
+  L->connected   = p->connected;
+  L->good_ns     = now_ns;
+}
+
+static void *
+vtpStreamingSupervisorThreadMain(void *arg)
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_PORT *p;
+  VTP_STREAMING_LINK_HEALTH *h;
+  vtpSupLink_t *L;
+  struct timespec req;
+  int i, reason, healthy, notify, sent, building, up;
+  uint64_t now;
+
+  while(vtpSupThreadRun)
+    {
+      req.tv_sec  = 0;
+      req.tv_nsec = VTP_SUPERVISOR_POLL_MS * 1000000;
+      while((nanosleep(&req, &req) != 0) && (errno == EINTR) && vtpSupThreadRun);
+
+      if(vtpStreamingSnapshot(&snap) != OK)
+	continue;
+      now = snap.timestamp_ns;
+
+      for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+	{
+	  if(!(vtpSup.streamMask & (1<<i)))
+	    continue;
+
+	  p = &snap.port[i];
+	  h = &vtpSup.link[i];
+	  L = &vtpSupLink[i];
+
+	  /* EB in reset: the frame counters restart, nothing to supervise */
+	  if(snap.eb_ctrl & 0x80000000)
+	    {
+	      vtpSupGood(i, p, now);
+	      continue;
+	    }
+
+	  sent     = (p->frames_sent != L->frames_sent);
+	  building = (p->frame_cnt != L->frame_cnt);
+	  up       = p->link_up && (p->udp || p->connected);
+	  reason   = 0;
+	  notify   = 0;
+
+	  pthread_mutex_lock(&vtpSupMutex);
+	  switch(h->state)
+	    {
+	    case VTP_LINK_OK:
+	      if(!p->link_up)
+		reason |= VTP_LINK_FAIL_PCS;
+	      if(!p->udp && L->connected && !p->connected)
+		reason |= VTP_LINK_FAIL_TCP;
+	      if(building && !sent &&
+		 ((now - L->good_ns) >= (uint64_t)vtpSup.stall_ms*1000000ull))
+		reason |= VTP_LINK_FAIL_STALL;
+
+	      if(reason)
+		{
+		  h->state       = VTP_LINK_FAILED;
+		  h->reason      = reason;
+		  h->action      = vtpSup.failover;
+		  h->target      = 0;
+		  h->switch_ms   = 0;
+		  h->lost_frames = 0;
+		  h->lost_bytes  = 0;
+		  h->nfail++;
+		}
+	      else if(sent || !building)
+		vtpSupGood(i, p, now);
+	      break;
+
+	    case VTP_LINK_FAILED:
+	      if(up)
+		{
+		  h->state = VTP_LINK_RECOVERING;
+		  L->recover_ns = now;
+		}
+	      break;
+
+	    case VTP_LINK_RECOVERING:
+	      if(!up)
+		h->state = VTP_LINK_FAILED;
+	      else if(sent && ((now - L->recover_ns) >= (uint64_t)vtpSup.stall_ms*1000000ull))
+		{
+		  /* Output flowing again for stall_ms: the MIG backlog had time to drain */
+		  vtpSupLost(i, p, now);
+		  h->switch_ms = (uint32_t)((L->recover_ns - L->good_ns)/1000000);
+		  h->state = VTP_LINK_OK;
+		  vtpSupGood(i, p, now);
+		  notify = 1;
+		}
+	      break;
+	    }
+	  healthy = vtpSupHealthyMask();
+	  pthread_mutex_unlock(&vtpSupMutex);
+
+	  if(notify)
+	    vtpSupAlarm(i, 0);
+
+	  if(!reason)
+	    continue;
+
+	  vtpSupAlarm(i, reason);
+
+	  if((vtpSup.failover == VTP_FAILOVER_REMAP) && (vtpSupPPMask != 0))
+	    {
+	      int target = vtpSupRemap(i, healthy);
+
+	      if(target != ERROR)
+		{
+		  pthread_mutex_lock(&vtpSupMutex);
+		  vtpSupLost(i, p, now);
+		  h->target = target;
+		  h->state  = VTP_LINK_SWITCHED;
+		  pthread_mutex_unlock(&vtpSupMutex);
+		  vtpSupAlarm(i, 0);
+		}
+	      else
+		printf("%s: ERROR: No healthy stream to take the payloads of stream %d\n",
+		       __func__, i+1);
+	    }
+	  else if((vtpSup.failover == VTP_FAILOVER_STANDBY) && (vtpSupStandbyMask & (1<<i)))
+	    {
+	      if(vtpSupStandby(i, p->udp, p->link_up) != OK)
+		printf("%s: ERROR: Stream %d standby destination not reachable\n",
+		       __func__, i+1);
+	    }
+	}
+    }
+
+  return NULL;
+}
+
+/* Start supervising the streams in streamMask while the run is active.
+    failover:  VTP_FAILOVER_NONE, _REMAP or _STANDBY
+    stall_ms:  time without sent frames (while the EB builds them)
+               before the link is declared stalled
+    ppInfo:    payload to stream assignment, needed for _REMAP
+*/
+int
+vtpStreamingSupervisorStart(int streamMask, int failover, int stall_ms, PP_CONF *ppInfo)
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  int i, rval;
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+  CHECKRANGE_INT(failover, VTP_FAILOVER_NONE, VTP_FAILOVER_STANDBY);
+  CHECKRANGE_INT(stall_ms, VTP_SUPERVISOR_POLL_MS, 60000);
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+  if(streamMask == 0)
+    {
+      printf("%s: ERROR: No streams selected\n",__func__);
+      return ERROR;
+    }
+  if((failover == VTP_FAILOVER_REMAP) && (ppInfo == NULL))
+    {
+      printf("%s: ERROR: Payload remapping needs ppInfo\n",__func__);
+      return ERROR;
+    }
+  if(vtpSupThreadRun)
+    {
+      printf("%s: ERROR: Supervisor already running\n",__func__);
+      return ERROR;
+    }
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  pthread_mutex_lock(&vtpSupMutex);
+  memset(&vtpSup, 0, sizeof(vtpSup));
+  vtpSup.streamMask = streamMask;
+  vtpSup.failover   = failover;
+  vtpSup.stall_ms   = stall_ms;
+
+  vtpSupPPMask = 0;
+  vtpSupPPUser = ppInfo;
+  if(ppInfo != NULL)
+    {
+      memcpy(vtpSupPP, ppInfo, sizeof(vtpSupPP));
+      vtpSupPPMask = snap.eb_ctrl & 0xFFFF;
+    }
+
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      vtpSupGood(i, &snap.port[i], snap.timestamp_ns);
+      vtpSupLink[i].frames_sent0 = snap.port[i].frames_sent;
+      vtpSupLink[i].bytes_sent0  = snap.port[i].bytes_sent;
+    }
+  vtpSup.running = 1;
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  vtpSupThreadRun = 1;
+  rval = pthread_create(&vtpSupThread, NULL, vtpStreamingSupervisorThreadMain, NULL);
+  if(rval != 0)
+    {
+      vtpSupThreadRun = 0;
+      vtpSup.running  = 0;
+      printf("%s: ERROR: pthread_create failed: %s\n", __func__, strerror(rval));
+      return ERROR;
+    }
+
+  return OK;
+}
+
+int
+vtpStreamingSupervisorStop()
+{
+  if(!vtpSupThreadRun)
+    return OK;
+
+  vtpSupThreadRun = 0;
+  pthread_join(vtpSupThread, NULL);
+
+  pthread_mutex_lock(&vtpSupMutex);
+  vtpSup.running = 0;
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  return OK;
+}
+
+int
+vtpStreamingSupervisorGetStatus(VTP_STREAMING_SUPERVISOR *status)
+{
+  if(status == NULL)
+    {
+      printf("%s: ERROR: NULL status pointer\n", __func__);
+      return ERROR;
+    }
+
+  pthread_mutex_lock(&vtpSupMutex);
+  *status = vtpSup;
+  pthread_mutex_unlock(&vtpSupMutex);
+
+  return OK;
+}
+
+int
+vtpStreamingSupervisorPrint()
+{
+  VTP_STREAMING_SUPERVISOR s;
+  VTP_STREAMING_LINK_HEALTH *h;
+  const char *state[] = { "ok", "FAILED", "remapped", "recovering" };
+  int i;
+
+  vtpStreamingSupervisorGetStatus(&s);
+
+  printf("---------------------------------------\n");
+  printf("--VTP Link Supervisor (failover %d, stall %d ms, %u alarms)\n",
+	 s.failover, s.stall_ms, s.nalarm);
+  printf("---------------------------------------\n");
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      if(!(s.streamMask & (1<<i)))
+	continue;
+      h = &s.link[i];
+      printf("  Stream %d  %-10s failures %u", i+1, state[h->state & 0x3], h->nfail);
+      if(h->nfail)
+	printf("  last: reason 0x%x, switch %u ms, lost %llu frames (~%llu bytes)",
+	       h->reason, h->switch_ms,
+	       (unsigned long long)h->lost_frames, (unsigned long long)h->lost_bytes);
+      printf("\n");
+    }
+
+  return OK;
+}
+
+
+
+/* Adaptive frame length
+    The frame length can only be changed while the streaming EB is in
+    reset, and the frame clock (vtpStreamingGetFrameTime) assumes it is
+    constant for the run, so the length is selected at Prestart from the
+    rates measured in the previous run:
+      End:       vtpStreamingFrameLenSave() stores the frame length and the
+                 per stream rates of the rate engine in a state file
+      Prestart:  vtpStreamingFrameLenSelect() picks the length that puts
+                 about target_bytes of the busiest stream into each frame
+                 (one full packet at the target packet size), bounded by
+                 max_latency_ns and changed by at most
+                 VTP_FRAMELEN_MAX_STEP per run.
+    vtpStreamingFrameLenRecord() writes the selection into the data
+    stream as a User Event.
+*/
+int
+vtpStreamingFrameLenSave(const char *fname)
+{
+  VTP_STREAMING_RATES r;
+  char tmp[512];
+  time_t t = time(NULL);
+  FILE *f;
+  int i;
+
+  if((fname == NULL) || (strlen(fname) > sizeof(tmp)-8))
+    return ERROR;
+
+  if((vtpStreamingGetFrameNs() == 0) || (vtpStreamingGetRates(&r) != OK))
+    {
+      printf("%s: ERROR: No rates measured\n", __func__);
+      return ERROR;
+    }
+
+  /* Write a new file and rename, so readers never see a partial state */
+  sprintf(tmp, "%s.tmp", fname);
+  f = fopen(tmp, "w");
+  if(f == NULL)
+    {
+      printf("%s: ERROR: Unable to open %s: %s\n", __func__, tmp, strerror(errno));
+      return ERROR;
+    }
+
+  fprintf(f, "# VTP streaming frame length state  %s", ctime(&t));
+  fprintf(f, "FRAMELEN %u\n", vtpStreamingGetFrameNs());
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    if(r.port[i].frames.max > 0)
+      fprintf(f, "STREAM %d %.0f %.3f\n", i+1,
+	      r.port[i].bytes.avg, r.port[i].pkts_per_frame.avg);
+  fclose(f);
+
+  if(rename(tmp, fname) != 0)
+    {
+      printf("%s: ERROR: rename %s: %s\n", __func__, fname, strerror(errno));
+      return ERROR;
+    }
+
+  return OK;
+}
+
+/* Returns the frame length (ns) to pass to vtpStreamingSetEbCfg().
+    default_ns is used when there is no (usable) state file. */
+int
+vtpStreamingFrameLenSelect(const char *fname, int target_bytes, int max_latency_ns,
+			   int default_ns, VTP_STREAMING_FRAMELEN *result)
+{
+  VTP_STREAMING_FRAMELEN sel;
+  char line[256];
+  FILE *f;
+  int stream;
+  unsigned int prev = 0;
+  double bps, ppf, want;
+
+  memset(&sel, 0, sizeof(sel));
+
+  if(max_latency_ns > VTP_FRAMELEN_MAX_NS) max_latency_ns = VTP_FRAMELEN_MAX_NS;
+  if(max_latency_ns < VTP_FRAMELEN_MIN_NS) max_latency_ns = VTP_FRAMELEN_MIN_NS;
+  if(default_ns > max_latency_ns)          default_ns = max_latency_ns;
+  if(default_ns < VTP_FRAMELEN_MIN_NS)     default_ns = VTP_FRAMELEN_MIN_NS;
+  if(target_bytes <= 0)
+    {
+      printf("%s: ERROR: Invalid target (%d bytes)\n", __func__, target_bytes);
+      return ERROR;
+    }
+
+  sel.frame_ns       = default_ns;
+  sel.target_bytes   = target_bytes;
+  sel.max_latency_ns = max_latency_ns;
+  sel.reason         = VTP_FRAMELEN_DEFAULT;
+  sel.stream         = -1;
+
+  f = (fname && fname[0]) ? fopen(fname, "r") : NULL;
+  if(f != NULL)
+    {
+      while(fgets(line, sizeof(line), f))
+	{
+	  if(sscanf(line, "FRAMELEN %u", &prev) == 1)
+	    continue;
+	  if((sscanf(line, "STREAM %d %lf %lf", &stream, &bps, &ppf) == 3) &&
+	     (stream >= 1) && (stream <= VTP_STREAMING_MAX_STREAMS) &&
+	     (bps > sel.bytes_per_s))
+	    {
+	      sel.stream         = stream-1;
+	      sel.bytes_per_s    = bps;
+	      sel.pkts_per_frame = ppf;
+	    }
+	}
+      fclose(f);
+    }
+  sel.prev_ns = prev;
+
+  if((prev > 0) && (sel.bytes_per_s > 0))
+    {
+      want = (double)target_bytes / sel.bytes_per_s * 1.0e9;
+      sel.reason = VTP_FRAMELEN_RATE;
+
+      if(want > prev*(double)VTP_FRAMELEN_MAX_STEP)
+	{
+	  want = prev*(double)VTP_FRAMELEN_MAX_STEP;
+	  sel.reason = VTP_FRAMELEN_STEP;
+	}
+      if(want < prev/(double)VTP_FRAMELEN_MAX_STEP)
+	{
+	  want = prev/(double)VTP_FRAMELEN_MAX_STEP;
+	  sel.reason = VTP_FRAMELEN_STEP;
+	}
+      if(want > max_latency_ns)
+	{
+	  want = max_latency_ns;
+	  sel.reason = VTP_FRAMELEN_LATENCY;
+	}
+      if(want < VTP_FRAMELEN_MIN_NS)
+	{
+	  want = VTP_FRAMELEN_MIN_NS;
+	  sel.reason = VTP_FRAMELEN_MIN;
+	}
+
+      if((prev <= (unsigned int)max_latency_ns) &&
+	 (fabs(want - prev) <= VTP_FRAMELEN_HYSTERESIS*prev))
+	{
+	  want = prev;
+	  sel.reason = VTP_FRAMELEN_UNCHANGED;
+	}
+
+      sel.frame_ns = (uint32_t)want;
+    }
+
+  /* The EB counts in 32 ns clocks - stay within the latency bound */
+  sel.frame_ns = (sel.frame_ns + 31) & ~31;
+  if(sel.frame_ns > (uint32_t)max_latency_ns)
+    sel.frame_ns -= 32;
+
+  printf("%s: %u ns (previous %u ns, stream %d %.1f MB/s %.2f pkts/frame, target %d bytes, bound %d ns, reason %d)\n",
+	 __func__, sel.frame_ns, sel.prev_ns, sel.stream+1, sel.bytes_per_s*1.0e-6,
+	 sel.pkts_per_frame, target_bytes, max_latency_ns, sel.reason);
+
+  if(result != NULL)
+    *result = sel;
+
+  return sel.frame_ns;
+}
+
+/* Frame length record User Event: frame_ns, prev_ns, target_bytes,
+   max_latency_ns, reason, stream, bytes/s, pkts/frame x1000 */
+int
+vtpStreamingFrameLenRecord(int streamMask, VTP_STREAMING_FRAMELEN *result)
+{
+  unsigned int ev[10];
+
+  if(result == NULL)
+    {
+      printf("%s: ERROR: NULL result\n", __func__);
+      return ERROR;
+    }
+
+  ev[0] = 9;
+  ev[1] = (VTP_STREAMING_FRAMELEN_TAG<<16) | (0x1<<8);
+  ev[2] = result->frame_ns;
+  ev[3] = result->prev_ns;
+  ev[4] = result->target_bytes;
+  ev[5] = result->max_latency_ns;
+  ev[6] = result->reason;
+  ev[7] = result->stream;
+  ev[8] = (unsigned int)((result->bytes_per_s < 4.0e9) ? result->bytes_per_s : 0xFFFFFFFF);
+  ev[9] = (unsigned int)(result->pkts_per_frame*1000.);
+
+  return vtpStreamingEvioWriteUserEvent(streamMask, ev);
+}
+
+
+
+/* Path MTU discovery
+    The MTU of each tcpClient is written from the configuration by
+    vtpStreamingSetNetCfg().  vtpStreamingMtuTune() checks it against the
+    path to each destination before the sockets are opened: a binary
+    search with don't-fragment UDP probes to an echo port at the
+    destination (vtpStreamRecv -E) finds the largest IP packet that gets
+    through, and the tcpClient MTU is lowered to it if needed.
+
+    The probes are sent by the Linux network stack of the VTP (management
+    interface), not by the tcpClient.  Sizes that stack cannot send (larger
+    than its interface MTU) are not tested, and a local send failure is not
+    taken as a loss on the path: the MTU is only lowered when a probe that
+    was sent gets no echo while a smaller one does.
+*/
+#define VTP_MTU_PROBE_LOCAL  1     /* vtpStreamingMtuTry: not sent */
+
+static int
+vtpStreamingMtuTry(int sock, uint32_t seq, int size, int timeout_ms)
+{
+  char buf[VTP_TCPIP_MTU_JUMBO*2];
+  VTP_MTU_PROBE_HDR *hdr = (VTP_MTU_PROBE_HDR *)buf;
+  struct pollfd pfd;
+  uint64_t t0;
+  int n, left;
+
+  if((size - VTP_MTU_IPUDP_HDR) > (int)sizeof(buf))
+    return VTP_MTU_PROBE_LOCAL;
+
+  memset(buf, 0, size - VTP_MTU_IPUDP_HDR);
+  hdr->magic = htonl(VTP_MTU_PROBE_MAGIC);
+  hdr->seq   = htonl(seq);
+  hdr->size  = htonl(size);
+
+  if(send(sock, buf, size - VTP_MTU_IPUDP_HDR, 0) < 0)
+    return VTP_MTU_PROBE_LOCAL;   /* EMSGSIZE: larger than the local interface MTU */
+
+  t0 = vtpStreamingNowNs();
+  pfd.fd     = sock;
+  pfd.events = POLLIN;
+  while((left = timeout_ms - (int)((vtpStreamingNowNs() - t0)/1000000)) > 0)
+    {
+      if(poll(&pfd, 1, left) <= 0)
+	break;
+      n = recv(sock, buf, sizeof(buf), 0);
+      if((n >= (int)sizeof(VTP_MTU_PROBE_HDR)) &&
+	 (ntohl(hdr->magic) == VTP_MTU_PROBE_MAGIC) && (ntohl(hdr->seq) == seq))
+	return OK;
+    }
+
+  return ERROR;
+}
+
+/* Largest IP packet size in [min_mtu, max_mtu] that reaches host:port and
+   is echoed back.  max_mtu if no probe that was sent got lost (sizes the
+   VTP cannot send itself are not evidence against the path).  ERROR if
+   not even min_mtu gets through. */
+int
+vtpStreamingMtuProbe(const char *host, int port, int min_mtu, int max_mtu, int timeout_ms)
+{
+  struct addrinfo hints, *res = NULL;
+  static uint32_t seq = 0;
+  int sock, lo, hi, mid, try, rval, pmtu, lost = 0, local = 0;
+
+  if((host == NULL) || (port <= 0) || (port > 65535) ||
+     (min_mtu < VTP_MTU_PROBE_MIN) || (max_mtu < min_mtu) || (timeout_ms <= 0))
+    {
+      printf("%s: ERROR: Invalid arguments\n", __func__);
+      return ERROR;
+    }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  if(getaddrinfo(host, NULL, &hints, &res) != 0)
+    {
+      printf("%s: ERROR: Unable to resolve %s\n", __func__, host);
+      return ERROR;
+    }
+  ((struct sockaddr_in *)res->ai_addr)->sin_port = htons(port);
+
+  sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if((sock < 0) || (connect(sock, res->ai_addr, res->ai_addrlen) < 0))
+    {
+      printf("%s: ERROR: socket to %s:%d: %s\n", __func__, host, port, strerror(errno));
+      if(sock >= 0) close(sock);
+      freeaddrinfo(res);
+      return ERROR;
+    }
+  freeaddrinfo(res);
+
+  /* Set DF, but ignore the path MTU the kernel learned for its own route:
+     sends fail only above the local interface MTU */
+  pmtu = IP_PMTUDISC_PROBE;
+  setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu));
+
+  /* lo always gets through, hi never does (or cannot be sent).  Most
+     paths carry the configured MTU, so try that right after the minimum. */
+  lo = -1;
+  hi = max_mtu + 1;
+  mid = min_mtu;
+  while(hi - lo > VTP_MTU_PROBE_STEP)
+    {
+      for(rval = ERROR, try = 0; (rval == ERROR) && (try < VTP_MTU_PROBE_TRIES); try++)
+	rval = vtpStreamingMtuTry(sock, ++seq, mid, timeout_ms);
+
+      if(rval == OK)
+	lo = mid;
+      else if(lo < 0)
+	break;
+      else
+	{
+	  hi = mid;
+	  if(rval == ERROR)
+	    lost = 1;
+	  else
+	    local = 1;
+	}
+
+      mid = (hi == max_mtu + 1) ? max_mtu : (lo + hi) / 2;
+    }
+  close(sock);
+
+  if(lo < 0)
+    {
+      printf("%s: ERROR: No echo from %s:%d\n", __func__, host, port);
+      return ERROR;
+    }
+
+  if(!lost && (lo < max_mtu))
+    {
+      if(local)
+	printf("%s: %s:%d: sizes above %d not testable from the VTP network stack\n",
+	       __func__, host, port, lo);
+      return max_mtu;
+    }
+
+  return lo;
+}
+
+/* Probe the destination of every stream in streamMask (before the sockets
+   are opened) and lower the tcpClient MTU to what the path carries.
+   The probes go out of the Linux network stack of the management
+   interface, not the streaming links: sizes above the management
+   interface MTU cannot be sent, so jumbo frames are never verified and
+   the MTU can only be lowered below the management interface MTU.
+   max_mtu is the largest size probed (0 or above the firmware MTU: the
+   firmware MTU).  The result is kept per stream for
+   vtpStreamingSetNetCfg() and the hot reconfiguration.
+   Streams with the same destination are probed once.
+   Returns the mask of streams that were probed. */
+int
+vtpStreamingMtuTune(int streamMask, int echo_port, int max_mtu, int timeout_ms)
+{
+  uint32_t dest[VTP_STREAMING_MAX_STREAMS], cfg[VTP_STREAMING_MAX_STREAMS];
+  int inst, jj, udp, mtu[VTP_STREAMING_MAX_STREAMS], probed=0;
+  struct in_addr a;
+  char host[INET_ADDRSTRLEN];
+
+  CHECKINIT;
+  CHECKTYPE(VTP_FW_TYPE_FADCSTREAM,0);
+
+  streamMask &= (1<<VTP_STREAMING_MAX_STREAMS)-1;
+
+  VLOCK;
+  udp = (vtp->ebiorx[0].Ctrl & 0x100) ? 1 : 0;
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      dest[inst] = udp ? vtp->tcpClient[inst].UDP_DEST_ADDR : vtp->tcpClient[inst].TCP_DEST_ADDR[0];
+      cfg[inst]  = udp ? VTP_TCPIP_MTU_JUMBO : VTP_TCPIP_MTU_DEFAULT;
+      if((max_mtu > 0) && ((uint32_t)max_mtu < cfg[inst]))
+	cfg[inst] = max_mtu;
+    }
+  VUNLOCK;
+
+  printf("%s: Probing from the management interface: can only lower the MTU below its interface MTU\n",
+	 __func__);
+
+  for(inst=0; inst<VTP_STREAMING_MAX_STREAMS; inst++)
+    {
+      if(!(streamMask & (1<<inst)) || (dest[inst] == 0) || (cfg[inst] < VTP_MTU_PROBE_MIN))
+	continue;
+
+      for(jj=0; jj<inst; jj++)
+	if((probed & (1<<jj)) && (dest[jj] == dest[inst]) && (cfg[jj] == cfg[inst]))
+	  break;
+
+      if(jj < inst)
+	mtu[inst] = mtu[jj];
+      else
+	{
+	  a.s_addr = htonl(dest[inst]);
+	  inet_ntop(AF_INET, &a, host, sizeof(host));
+	  mtu[inst] = vtpStreamingMtuProbe(host, echo_port, VTP_MTU_PROBE_MIN, cfg[inst], timeout_ms);
+	  if(mtu[inst] == ERROR)
+	    {
+	      printf("%s: WARNING: Stream %d keeps MTU %u (no probe echo from %s:%d)\n",
+		     __func__, inst+1, cfg[inst], host, echo_port);
+	      continue;
+	    }
+	}
+      probed |= (1<<inst);
+
+      vtpStreamingTunedMtu[inst] = (mtu[inst] < (int)cfg[inst]) ? mtu[inst] : 0;
+      VLOCK;
+      vtp->tcpClient[inst].MTU = vtpStreamingNetMtu(inst, udp);
+      VUNLOCK;
+      printf("%s: Stream %d path MTU %d (configured %u)\n", __func__, inst+1, mtu[inst], cfg[inst]);
+    }
+
+  return probed;
+}
+
+/* Payload efficiency of each stream from the EBIORX counters:
+    fill: average payload per packet / payload room of an MTU packet
+    wire: payload / (payload + Ethernet, IP, UDP/TCP and EJFAT headers) */
+int
+vtpStreamingMtuPrint(int streamMask)
+{
+  VTP_STREAMING_SNAPSHOT snap;
+  VTP_STREAMING_PORT *p;
+  double avg, room, hdr;
+  int i;
+
+  if(vtpStreamingSnapshot(&snap) != OK)
+    return ERROR;
+
+  printf("---------------------------------------\n");
+  printf("--VTP Streaming Payload Efficiency\n");
+  printf("---------------------------------------\n");
+  printf("           MTU       packets        bytes  bytes/pkt   fill   wire\n");
+  for(i=0; i<VTP_STREAMING_MAX_STREAMS; i++)
+    {
+      p = &snap.port[i];
+      if(!(streamMask & (1<<i)) || (p->pkts_sent == 0))
+	continue;
+
+      /* preamble+SFD 8, MAC 14, FCS 4, IFG 12 */
+      hdr = 38 + (p->udp ? VTP_MTU_IPUDP_HDR : 40);
+      if(p->udp && (snap.eb_ctrl3 & VTP_STREB_EJFAT_EN))
+	hdr += VTP_EJFAT_LB_HDR_LEN + VTP_EJFAT_RE_HDR_LEN;
+      room = (double)p->tcp_mtu - (hdr - 38);
+      avg  = (double)p->bytes_sent / p->pkts_sent;
+
+      printf("  Port %d %6u %13llu %12llu %10.1f %5.1f%% %5.1f%%\n", i, p->tcp_mtu,
+	     (unsigned long long)p->pkts_sent, (unsigned long long)p->bytes_sent, avg,
+	     (room > 0) ? 100.*avg/room : 0., 100.*avg/(avg + hdr));
+    }
+
+  return OK;
+}
@@ -86,7 +86,7 @@ load_firmware()
 int
 main(int argc, char *argv[])
 {
-  int stat;
+  int stat, telemetry_only=0;
 #ifdef IPC
   int count;
   pthread_t gScalerThread;
@@ -119,6 +119,20 @@ main(int argc, char *argv[])
     goto CLOSE;
   }
 
+  /* -t : stay resident and only publish telemetry */
+  if((argc > 1) && (strcmp(argv[1], "-t") == 0))
+    telemetry_only = 1;
+
+#ifndef IPC
+  if(!telemetry_only)
+    goto CLOSE;
+#endif // IPC
+
+  /* vtpserver is the single writer of the shared memory telemetry ring.
+     vtpSendSerdes() below reads it back */
+  if(vtpTelemetryStart(1000, VTP_TELEMETRY_LTM) != OK)
+    printf("Unable to start telemetry publisher\n");
+
 #ifdef IPC
   /* connect to IPC server */
   printf("Connect to IPC server...\n");
@@ -144,6 +158,9 @@ main(int argc, char *argv[])
   }
 #endif // IPC
 
+  while(telemetry_only)
+    sleep(1);
+
 CLOSE:
 
 #ifdef IPC